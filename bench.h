@@ -0,0 +1,159 @@
+/*
+ * This file contains small helpers shared by the benchmark programs: a
+ * monotonic nanosecond clock, a fast, seedable pseudo-random number
+ * generator, so that every benchmark generates the same workload on every
+ * run, a Zipfian key generator and a latency histogram.  Include it before
+ * any system header.  Programs using bench_zipf_init() must link with -lm.
+ */
+
+#ifndef __BENCH_H
+#define __BENCH_H
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdint.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+/*
+ * Returns the current value of the monotonic clock in nanoseconds.
+ */
+static inline uint64_t bench_now_ns() {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/*
+ * Returns the next number from a xorshift64* generator whose state is held
+ * in `*state`.  The state must be seeded with a nonzero value.
+ */
+static inline uint64_t bench_rand(uint64_t* state) {
+  uint64_t x = *state;
+  x ^= x >> 12;
+  x ^= x << 25;
+  x ^= x >> 27;
+  *state = x;
+  return x * 0x2545F4914F6CDD1DULL;
+}
+
+/*
+ * Fills `keys[0..n)` with a random permutation of the integers 0..n-1.
+ */
+static inline void bench_shuffled_keys(int* keys, int n, uint64_t seed) {
+  for (int i = 0; i < n; i++) {
+    keys[i] = i;
+  }
+  for (int i = n - 1; i > 0; i--) {
+    int j = (int)(bench_rand(&seed) % (uint64_t)(i + 1));
+    int tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+}
+
+/*
+ * This structure holds the state of a generator of Zipfian-distributed
+ * ranks in [0, n), where rank 0 is the most popular.  The skew `theta` is
+ * between 0 (uniform) and 1 (exclusive); 0.99 is the usual choice.  Ranks
+ * are generated with the method of Gray et al., "Quickly Generating
+ * Billion-Record Synthetic Databases" (SIGMOD 1994), as in YCSB.
+ */
+struct bench_zipf {
+  uint64_t n;
+  double theta;
+  double alpha;
+  double zetan;
+  double eta;
+};
+
+/*
+ * Initializes a Zipfian generator.  This takes time linear in `n`.
+ */
+static inline void bench_zipf_init(struct bench_zipf* z, uint64_t n,
+    double theta) {
+  double zetan = 0;
+  for (uint64_t i = 1; i <= n; i++) {
+    zetan += 1.0 / pow((double)i, theta);
+  }
+  double zeta2 = 1.0 + 1.0 / pow(2.0, theta);
+  z->n = n;
+  z->theta = theta;
+  z->alpha = 1.0 / (1.0 - theta);
+  z->zetan = zetan;
+  z->eta = (1.0 - pow(2.0 / n, 1.0 - theta)) / (1.0 - zeta2 / zetan);
+}
+
+/*
+ * Returns the next Zipfian rank, drawing randomness from the xorshift state
+ * `*state`.
+ */
+static inline uint64_t bench_zipf_next(struct bench_zipf* z,
+    uint64_t* state) {
+  double u = (bench_rand(state) >> 11) * (1.0 / 9007199254740992.0);
+  double uz = u * z->zetan;
+  if (uz < 1.0) {
+    return 0;
+  }
+  if (uz < 1.0 + pow(0.5, z->theta)) {
+    return 1;
+  }
+  uint64_t rank = (uint64_t)(z->n * pow(z->eta * u - z->eta + 1.0, z->alpha));
+  return rank < z->n ? rank : z->n - 1;
+}
+
+/*
+ * This structure is a histogram of latencies in nanoseconds.  Each power of
+ * two is split into BENCH_HIST_SUB buckets, so percentiles are accurate to
+ * within about 6% at any scale while the histogram stays a few kilobytes.
+ */
+#define BENCH_HIST_SUB 16
+#define BENCH_HIST_BUCKETS (61 * BENCH_HIST_SUB)
+
+struct bench_hist {
+  uint64_t counts[BENCH_HIST_BUCKETS];
+  uint64_t n;
+  uint64_t total;
+  uint64_t max;
+};
+
+static inline void bench_hist_reset(struct bench_hist* h) {
+  memset(h, 0, sizeof(struct bench_hist));
+}
+
+/*
+ * Records one latency of `ns` nanoseconds.
+ */
+static inline void bench_hist_record(struct bench_hist* h, uint64_t ns) {
+  int bucket = (int)ns;
+  if (ns >= BENCH_HIST_SUB) {
+    int e = 63 - __builtin_clzll(ns);
+    bucket = (e - 3) * BENCH_HIST_SUB + (int)(ns >> (e - 4)) - BENCH_HIST_SUB;
+  }
+  h->counts[bucket]++;
+  h->n++;
+  h->total += ns;
+  h->max = ns > h->max ? ns : h->max;
+}
+
+/*
+ * Returns the smallest latency in the bucket holding the `p`-th percentile
+ * (0 < p <= 100) of the recorded latencies.
+ */
+static inline uint64_t bench_hist_percentile(struct bench_hist* h, double p) {
+  uint64_t target = (uint64_t)ceil(h->n * p / 100.0), seen = 0;
+  for (int i = 0; i < BENCH_HIST_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= target && h->counts[i] > 0) {
+      if (i < BENCH_HIST_SUB) {
+        return i;
+      }
+      int e = i / BENCH_HIST_SUB + 3;
+      return (uint64_t)(i % BENCH_HIST_SUB + BENCH_HIST_SUB) << (e - 4);
+    }
+  }
+  return h->max;
+}
+
+#endif
@@ -0,0 +1,79 @@
+/*
+ * This file contains a benchmark comparing batched lookups with
+ * bst_get_batch() against a loop of one-at-a-time bst_get() calls, on trees
+ * large enough that most lookups miss in cache.
+ *
+ * Usage: ./bench_batch [num_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys inserted into each tree, and the number of keys
+ * looked up per bst_get_batch() call.
+ */
+#define DEFAULT_NUM_KEYS 4000000
+#define BATCH_SIZE 1024
+
+/*
+ * Runs the benchmark for a single tree mode and prints the cost of both
+ * lookup strategies in nanoseconds per lookup.
+ */
+void bench_mode(const char* name, int mode, int* keys, int* lookups, int n) {
+  struct bst* bst = bst_create_mode(mode);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &keys[i]);
+  }
+
+  void** values = malloc(n * sizeof(void*));
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < n; i++) {
+    values[i] = bst_get(bst, lookups[i]);
+  }
+  uint64_t single_ns = bench_now_ns() - start;
+
+  uintptr_t check = 0;
+  for (int i = 0; i < n; i++) {
+    check ^= (uintptr_t)values[i];
+  }
+
+  start = bench_now_ns();
+  for (int i = 0; i < n; i += BATCH_SIZE) {
+    int count = n - i < BATCH_SIZE ? n - i : BATCH_SIZE;
+    bst_get_batch(bst, &lookups[i], count, &values[i]);
+  }
+  uint64_t batch_ns = bench_now_ns() - start;
+
+  for (int i = 0; i < n; i++) {
+    check ^= (uintptr_t)values[i];
+  }
+
+  printf("%-10s bst_get       %8.1f ns/lookup\n", name, (double)single_ns / n);
+  printf("%-10s bst_get_batch %8.1f ns/lookup  (%.2fx, results %s)\n", name,
+    (double)batch_ns / n, (double)single_ns / batch_ns,
+    check == 0 ? "match" : "DIFFER");
+
+  free(values);
+  bst_free(bst);
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int* keys = malloc(n * sizeof(int));
+  int* lookups = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  bench_shuffled_keys(lookups, n, 2);
+
+  printf("== %d shuffled keys, batches of %d\n", n, BATCH_SIZE);
+  bench_mode("plain", BST_PLAIN, keys, lookups, n);
+  bench_mode("balanced", BST_BALANCED, keys, lookups, n);
+
+  free(lookups);
+  free(keys);
+  return 0;
+}
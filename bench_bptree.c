@@ -0,0 +1,82 @@
+/*
+ * This file contains a benchmark comparing BSTs created in BST_BPTREE mode
+ * against the pointer-based BST_PLAIN and BST_BALANCED modes on inserts,
+ * lookups and range sums over shuffled keys.
+ *
+ * Usage: ./bench_bptree [num_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys inserted into each tree, and the number of range
+ * sums computed.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define NUM_RANGE_SUMS 10000
+
+/*
+ * Runs the benchmark for a single tree mode and prints one line per
+ * operation with its average cost in nanoseconds.
+ */
+void bench_mode(const char* name, int mode, int* keys, int* lookups, int n) {
+  struct bst* bst = bst_create_mode(mode);
+
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &keys[i]);
+  }
+  uint64_t insert_ns = bench_now_ns() - start;
+
+  /*
+   * Accumulate the lookup results so the compiler can't drop the lookups.
+   */
+  uintptr_t check = 0;
+  start = bench_now_ns();
+  for (int i = 0; i < n; i++) {
+    check += (uintptr_t)bst_get(bst, lookups[i]);
+  }
+  uint64_t get_ns = bench_now_ns() - start;
+
+  long long sums = 0;
+  int width = n / 100;
+  start = bench_now_ns();
+  for (int i = 0; i < NUM_RANGE_SUMS; i++) {
+    int lower = lookups[i];
+    sums += bst_range_sum64(bst, lower, lower + width);
+  }
+  uint64_t sum_ns = bench_now_ns() - start;
+
+  printf("%-10s insert      %8.1f ns/op\n", name, (double)insert_ns / n);
+  printf("%-10s get         %8.1f ns/op\n", name, (double)get_ns / n);
+  printf("%-10s range_sum   %8.1f ns/op  (width %d, checksum %llx)\n", name,
+    (double)sum_ns / NUM_RANGE_SUMS, width,
+    (unsigned long long)(sums ^ (long long)(check != 0)));
+
+  bst_free(bst);
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  if (n < NUM_RANGE_SUMS) {
+    n = NUM_RANGE_SUMS;
+  }
+  int* keys = malloc(n * sizeof(int));
+  int* lookups = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  bench_shuffled_keys(lookups, n, 2);
+
+  printf("== %d shuffled keys\n", n);
+  bench_mode("plain", BST_PLAIN, keys, lookups, n);
+  bench_mode("balanced", BST_BALANCED, keys, lookups, n);
+  bench_mode("bptree", BST_BPTREE, keys, lookups, n);
+
+  free(lookups);
+  free(keys);
+  return 0;
+}
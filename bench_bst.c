@@ -0,0 +1,345 @@
+/*
+ * This file contains a configurable benchmark for the BST interface.  It
+ * loads a tree with keys in a chosen order, then times a mix of lookups and
+ * updates with keys drawn from a chosen distribution, followed by range sums
+ * and a full in-order scan.  Every operation is timed individually, and
+ * results are printed as CSV, one line per operation type, so that runs can
+ * be compared across builds by a script.
+ *
+ * Usage: ./bench_bst [options]
+ *   --mode M        plain, balanced, bptree or concurrent (default balanced)
+ *   --dist D        sorted, reverse, uniform or zipf (default uniform)
+ *   --mix X         read (95% lookups), mixed (50%) or write (5%)
+ *                   (default read)
+ *   --size N[,N..]  tree sizes, with optional K/M suffixes (default 1M)
+ *   --ops N         number of operations in the mixed phase (default: the
+ *                   tree size)
+ *   --theta T       Zipfian skew, between 0 and 1 (default 0.99)
+ *   --width W       number of keys covered by each range sum (default 100)
+ *   --seed S        random seed (default 1)
+ *   --no-header     don't print the CSV header line
+ *
+ * Keys are the integers 0..N-1.  With the sorted and reverse distributions,
+ * the tree is loaded in that order and operations sweep through the keys in
+ * the same order.  With uniform and zipf, the tree is loaded in random order
+ * and operations pick keys at random; under zipf, the popular keys are
+ * scattered over the key space.  An update removes a key and inserts it
+ * again, so the tree keeps its size, and the two halves are reported as
+ * separate remove and insert operations.
+ *
+ * Each output line reports, for one operation type: the number of operations
+ * timed, the throughput, the 50th, 90th, 99th and 99.9th percentile and
+ * maximum latency in nanoseconds, and the peak resident set size of the
+ * process so far in kilobytes.  Latencies include about 20ns of timer
+ * overhead.  The scan line reports per-element figures.
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+
+#include "bst.h"
+
+/*
+ * Operation types reported, in output order.
+ */
+#define OP_LOAD 0
+#define OP_GET 1
+#define OP_INSERT 2
+#define OP_REMOVE 3
+#define OP_RANGE_SUM 4
+#define OP_SCAN 5
+#define NUM_OP_TYPES 6
+
+const char* OP_NAMES[NUM_OP_TYPES] =
+  {"load", "get", "insert", "remove", "range_sum", "scan"};
+
+/*
+ * Maximum number of sizes that can be given to --size.
+ */
+#define MAX_SIZES 16
+
+/*
+ * This structure holds the benchmark configuration.
+ */
+struct config {
+  const char* mode_name;
+  int mode;
+  const char* dist;
+  const char* mix;
+  int read_percent;
+  long sizes[MAX_SIZES];
+  int num_sizes;
+  long ops;
+  double theta;
+  int width;
+  uint64_t seed;
+  int header;
+};
+
+/*
+ * Returns the peak resident set size of the process in kilobytes.
+ */
+long peak_rss_kb() {
+  struct rusage usage;
+  getrusage(RUSAGE_SELF, &usage);
+  return usage.ru_maxrss;
+}
+
+/*
+ * Parses a count with an optional K or M suffix.
+ */
+long parse_count(const char* s) {
+  char* end;
+  long n = strtol(s, &end, 10);
+  if (*end == 'K' || *end == 'k') {
+    n *= 1000;
+  } else if (*end == 'M' || *end == 'm') {
+    n *= 1000000;
+  }
+  return n;
+}
+
+/*
+ * Prints a usage message and exits.
+ */
+void usage(const char* name) {
+  fprintf(stderr, "usage: %s [--mode plain|balanced|bptree|concurrent] "
+    "[--dist sorted|reverse|uniform|zipf] [--mix read|mixed|write] "
+    "[--size N[,N..]] [--ops N] [--theta T] [--width W] [--seed S] "
+    "[--no-header]\n", name);
+  exit(2);
+}
+
+void parse_args(struct config* cfg, int argc, char** argv) {
+  cfg->mode_name = "balanced";
+  cfg->mode = BST_BALANCED;
+  cfg->dist = "uniform";
+  cfg->mix = "read";
+  cfg->read_percent = 95;
+  cfg->sizes[0] = 1000000;
+  cfg->num_sizes = 1;
+  cfg->ops = 0;
+  cfg->theta = 0.99;
+  cfg->width = 100;
+  cfg->seed = 1;
+  cfg->header = 1;
+
+  for (int i = 1; i < argc; i++) {
+    const char* arg = argv[i];
+    if (strcmp(arg, "--no-header") == 0) {
+      cfg->header = 0;
+      continue;
+    }
+    if (i + 1 == argc) {
+      usage(argv[0]);
+    }
+    const char* value = argv[++i];
+    if (strcmp(arg, "--mode") == 0) {
+      const char* modes[4] = {"plain", "balanced", "bptree", "concurrent"};
+      int values[4] = {BST_PLAIN, BST_BALANCED, BST_BPTREE, BST_CONCURRENT};
+      cfg->mode = -1;
+      for (int m = 0; m < 4; m++) {
+        if (strcmp(value, modes[m]) == 0) {
+          cfg->mode = values[m];
+          cfg->mode_name = modes[m];
+        }
+      }
+      if (cfg->mode < 0) {
+        usage(argv[0]);
+      }
+    } else if (strcmp(arg, "--dist") == 0) {
+      if (strcmp(value, "sorted") && strcmp(value, "reverse")
+          && strcmp(value, "uniform") && strcmp(value, "zipf")) {
+        usage(argv[0]);
+      }
+      cfg->dist = value;
+    } else if (strcmp(arg, "--mix") == 0) {
+      if (strcmp(value, "read") == 0) {
+        cfg->read_percent = 95;
+      } else if (strcmp(value, "mixed") == 0) {
+        cfg->read_percent = 50;
+      } else if (strcmp(value, "write") == 0) {
+        cfg->read_percent = 5;
+      } else {
+        usage(argv[0]);
+      }
+      cfg->mix = value;
+    } else if (strcmp(arg, "--size") == 0) {
+      cfg->num_sizes = 0;
+      char* copy = strdup(value);
+      for (char* tok = strtok(copy, ","); tok && cfg->num_sizes < MAX_SIZES;
+          tok = strtok(NULL, ",")) {
+        cfg->sizes[cfg->num_sizes++] = parse_count(tok);
+      }
+      free(copy);
+    } else if (strcmp(arg, "--ops") == 0) {
+      cfg->ops = parse_count(value);
+    } else if (strcmp(arg, "--theta") == 0) {
+      cfg->theta = atof(value);
+    } else if (strcmp(arg, "--width") == 0) {
+      cfg->width = atoi(value);
+    } else if (strcmp(arg, "--seed") == 0) {
+      cfg->seed = strtoull(value, NULL, 10);
+    } else {
+      usage(argv[0]);
+    }
+  }
+  if (cfg->theta <= 0 || cfg->theta >= 1) {
+    cfg->theta = 0.99;
+  }
+}
+
+/*
+ * Prints the CSV line for one operation type.  `elapsed_ns` is the total
+ * wall time of the phase the operations ran in.
+ */
+void report(struct config* cfg, long size, int op, struct bench_hist* h,
+    uint64_t elapsed_ns) {
+  if (h->n == 0) {
+    return;
+  }
+  printf("%s,%s,%s,%ld,%s,%llu,%.0f,%llu,%llu,%llu,%llu,%llu,%ld\n",
+    cfg->mode_name, cfg->dist, cfg->mix, size, OP_NAMES[op],
+    (unsigned long long)h->n, h->n * 1e9 / elapsed_ns,
+    (unsigned long long)bench_hist_percentile(h, 50),
+    (unsigned long long)bench_hist_percentile(h, 90),
+    (unsigned long long)bench_hist_percentile(h, 99),
+    (unsigned long long)bench_hist_percentile(h, 99.9),
+    (unsigned long long)h->max, peak_rss_kb());
+}
+
+/*
+ * Runs the benchmark for one tree size.
+ */
+void run(struct config* cfg, long size) {
+  int n = (int)size;
+  int sequential = strcmp(cfg->dist, "sorted") == 0
+    || strcmp(cfg->dist, "reverse") == 0;
+  int reverse = strcmp(cfg->dist, "reverse") == 0;
+  int zipf = strcmp(cfg->dist, "zipf") == 0;
+  long ops = cfg->ops > 0 ? cfg->ops : size;
+  uint64_t state = cfg->seed;
+  struct bench_hist* hists = malloc(NUM_OP_TYPES * sizeof(struct bench_hist));
+  uint64_t elapsed[NUM_OP_TYPES];
+  for (int op = 0; op < NUM_OP_TYPES; op++) {
+    bench_hist_reset(&hists[op]);
+    elapsed[op] = 0;
+  }
+
+  /*
+   * Keys in load order.  Random operations pick a position in this array,
+   * so under zipf the popular keys are the ones loaded first, which are at
+   * random places in the key space.
+   */
+  int* keys = malloc(n * sizeof(int));
+  if (sequential) {
+    for (int i = 0; i < n; i++) {
+      keys[i] = reverse ? n - 1 - i : i;
+    }
+  } else {
+    bench_shuffled_keys(keys, n, cfg->seed);
+  }
+  struct bench_zipf z;
+  if (zipf) {
+    bench_zipf_init(&z, n, cfg->theta);
+  }
+
+  struct bst* bst = bst_create_mode(cfg->mode);
+  uint64_t phase = bench_now_ns();
+  for (int i = 0; i < n; i++) {
+    uint64_t start = bench_now_ns();
+    bst_insert(bst, keys[i], &keys[i]);
+    bench_hist_record(&hists[OP_LOAD], bench_now_ns() - start);
+  }
+  elapsed[OP_LOAD] = bench_now_ns() - phase;
+
+  /*
+   * The mixed phase.  All operation types share its wall time, so each
+   * type's throughput is its share of the phase.
+   */
+  uintptr_t check = 0;
+  phase = bench_now_ns();
+  for (long i = 0; i < ops; i++) {
+    int pos;
+    if (sequential) {
+      pos = (int)(i % n);
+    } else if (zipf) {
+      pos = (int)bench_zipf_next(&z, &state);
+    } else {
+      pos = (int)(bench_rand(&state) % n);
+    }
+    int key = keys[pos];
+    if ((int)(bench_rand(&state) % 100) < cfg->read_percent) {
+      uint64_t start = bench_now_ns();
+      check += (uintptr_t)bst_get(bst, key);
+      bench_hist_record(&hists[OP_GET], bench_now_ns() - start);
+    } else {
+      uint64_t start = bench_now_ns();
+      bst_remove(bst, key);
+      uint64_t mid = bench_now_ns();
+      bst_insert(bst, key, &keys[pos]);
+      bench_hist_record(&hists[OP_REMOVE], mid - start);
+      bench_hist_record(&hists[OP_INSERT], bench_now_ns() - mid);
+    }
+  }
+  elapsed[OP_GET] = elapsed[OP_INSERT] = elapsed[OP_REMOVE] =
+    bench_now_ns() - phase;
+
+  long range_sums = ops / 10 > 0 ? ops / 10 : 1;
+  phase = bench_now_ns();
+  for (long i = 0; i < range_sums; i++) {
+    int lower = (int)(bench_rand(&state) % n);
+    uint64_t start = bench_now_ns();
+    check += bst_range_sum64(bst, lower, lower + cfg->width - 1);
+    bench_hist_record(&hists[OP_RANGE_SUM], bench_now_ns() - start);
+  }
+  elapsed[OP_RANGE_SUM] = bench_now_ns() - phase;
+
+  /*
+   * A full scan is timed in batches of 64 elements, and each batch is
+   * recorded as 64 elements of equal cost, since timing every element
+   * would cost more than visiting it.
+   */
+  phase = bench_now_ns();
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    uint64_t start = bench_now_ns();
+    int count = 0;
+    for (; count < 64 && bst_iterator_has_next(iter); count++) {
+      check += bst_iterator_next(iter, NULL);
+    }
+    uint64_t per = (bench_now_ns() - start) / count;
+    for (int j = 0; j < count; j++) {
+      bench_hist_record(&hists[OP_SCAN], per);
+    }
+  }
+  bst_iterator_free(iter);
+  elapsed[OP_SCAN] = bench_now_ns() - phase;
+
+  for (int op = 0; op < NUM_OP_TYPES; op++) {
+    report(cfg, size, op, &hists[op], elapsed[op]);
+  }
+  if (check == 1) {
+    fprintf(stderr, "unlikely checksum\n");
+  }
+  bst_free(bst);
+  free(keys);
+  free(hists);
+}
+
+int main(int argc, char** argv) {
+  struct config cfg;
+  parse_args(&cfg, argc, argv);
+  if (cfg.header) {
+    printf("mode,dist,mix,size,op,count,ops_per_sec,p50_ns,p90_ns,p99_ns,"
+      "p999_ns,max_ns,peak_rss_kb\n");
+  }
+  for (int i = 0; i < cfg.num_sizes; i++) {
+    run(&cfg, cfg.sizes[i]);
+  }
+  return 0;
+}
@@ -0,0 +1,110 @@
+/*
+ * This file contains a benchmark comparing the memory footprint and lookup
+ * speed of BST_COMPACT trees, whose nodes are linked by 32-bit indices,
+ * with the pointer-linked nodes of BST_PLAIN and BST_BALANCED trees and the
+ * B+-tree of BST_BPTREE trees.  For each mode, it inserts shuffled keys and
+ * reports how much the process's resident memory grew per key, then times
+ * looking every key up in random order and summing every key with an
+ * in-order iterator.  Each mode runs in its own child process, so that
+ * memory freed by one mode can't be reused by the next.
+ *
+ * Usage: ./bench_compact [num_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys in each tree.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+
+/*
+ * Returns the resident memory of this process in bytes, as reported by
+ * /proc/self/statm, or 0 if it can't be read.
+ */
+long resident_bytes() {
+  long pages = 0, resident = 0;
+  FILE* statm = fopen("/proc/self/statm", "r");
+  if (statm == NULL) {
+    return 0;
+  }
+  if (fscanf(statm, "%ld %ld", &pages, &resident) != 2) {
+    resident = 0;
+  }
+  fclose(statm);
+  return resident * sysconf(_SC_PAGESIZE);
+}
+
+/*
+ * Builds a tree of `n` keys in `mode`, measures it and prints one row of
+ * results.
+ */
+void bench_mode(const char* label, int mode, int* keys, int* order, int n) {
+  long before = resident_bytes();
+  uint64_t start = bench_now_ns();
+  struct bst* bst = bst_create_mode(mode);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &keys[i]);
+  }
+  uint64_t insert = bench_now_ns() - start;
+  long grown = resident_bytes() - before;
+
+  long found = 0;
+  start = bench_now_ns();
+  for (int i = 0; i < n; i++) {
+    found += bst_get(bst, order[i]) != NULL;
+  }
+  uint64_t get = bench_now_ns() - start;
+
+  long long sum = 0;
+  start = bench_now_ns();
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    sum += bst_iterator_next(iter, NULL);
+  }
+  bst_iterator_free(iter);
+  uint64_t scan = bench_now_ns() - start;
+
+  printf("%-10s %12.1f %10.1f %10.1f %10.1f %8d\n", label,
+    (double)grown / n, (double)insert / n, (double)get / n,
+    (double)scan / n, bst_height(bst));
+  if (found != n || sum != (long long)n * (n - 1) / 2) {
+    printf("  !! wrong results: found %ld of %d keys, sum %lld\n", found, n,
+      sum);
+  }
+  bst_free(bst);
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int* keys = malloc(n * sizeof(int));
+  int* order = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  bench_shuffled_keys(order, n, 2);
+
+  printf("== %d shuffled keys: resident bytes per key, ns per key\n", n);
+  printf("%-10s %12s %10s %10s %10s %8s\n", "mode", "bytes/key", "insert",
+    "get", "scan", "height");
+  const char* labels[] = {"plain", "balanced", "bptree", "compact"};
+  int modes[] = {BST_PLAIN, BST_BALANCED, BST_BPTREE, BST_COMPACT};
+  for (int m = 0; m < 4; m++) {
+    fflush(stdout);
+    pid_t child = fork();
+    if (child == 0) {
+      bench_mode(labels[m], modes[m], keys, order, n);
+      fflush(stdout);
+      _exit(0);
+    }
+    waitpid(child, NULL, 0);
+  }
+  free(order);
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,126 @@
+/*
+ * This file contains a benchmark measuring how the read throughput of a
+ * BST_CONCURRENT tree scales with the number of reader threads, both with
+ * and without a writer thread inserting and removing keys at the same time.
+ *
+ * Usage: ./bench_concurrent [num_keys] [max_readers]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys in the tree, and how long each configuration runs,
+ * in milliseconds.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define RUN_MS 500
+
+/*
+ * State shared between the threads of a run.  Readers look up random keys
+ * until `stop` is set, and the writer, if there is one, toggles keys at and
+ * above `num_keys` in and out of the tree until then.
+ */
+struct bst* shared;
+int num_keys;
+int stop;
+
+/*
+ * Each reader thread looks up random keys and returns the number of lookups
+ * it made (cast to a pointer).
+ */
+void* reader(void* arg) {
+  uint64_t state = (uint64_t)(long)arg;
+  long lookups = 0, found = 0;
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+    for (int i = 0; i < 64; i++) {
+      found += bst_get(shared, (int)(bench_rand(&state) % num_keys)) != NULL;
+    }
+    lookups += 64;
+  }
+  return (void*)(lookups + (found < 0));
+}
+
+/*
+ * The writer thread inserts and removes keys that readers never look for,
+ * and returns the number of writes it made (cast to a pointer).
+ */
+void* writer(void* arg) {
+  long writes = 0;
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+    int key = num_keys + (int)(writes % 1024);
+    if ((writes / 1024) % 2 == 0) {
+      bst_insert(shared, key, &num_keys);
+    } else {
+      bst_remove(shared, key);
+    }
+    writes++;
+  }
+  return (void*)writes;
+}
+
+/*
+ * Runs `readers` reader threads, plus a writer thread if `with_writer` is
+ * set, for RUN_MS milliseconds, and prints the combined read throughput.
+ */
+void bench_readers(int readers, int with_writer) {
+  pthread_t threads[readers + 1];
+  stop = 0;
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < readers; i++) {
+    pthread_create(&threads[i], NULL, reader, (void*)(long)(i + 1));
+  }
+  if (with_writer) {
+    pthread_create(&threads[readers], NULL, writer, NULL);
+  }
+  struct timespec run = {RUN_MS / 1000, (RUN_MS % 1000) * 1000000L};
+  nanosleep(&run, NULL);
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+  long lookups = 0, writes = 0;
+  for (int i = 0; i < readers; i++) {
+    void* result;
+    pthread_join(threads[i], &result);
+    lookups += (long)result;
+  }
+  if (with_writer) {
+    void* result;
+    pthread_join(threads[readers], &result);
+    writes = (long)result;
+  }
+  uint64_t ns = bench_now_ns() - start;
+  printf("%3d readers %-10s %8.2f M lookups/s  (%.2f M/s per reader, "
+    "%.2f M writes/s)\n", readers, with_writer ? "+ writer" : "",
+    lookups * 1e3 / ns, lookups * 1e3 / ns / readers, writes * 1e3 / ns);
+}
+
+int main(int argc, char** argv) {
+  num_keys = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int max_readers = argc > 2 ? atoi(argv[2])
+    : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int* keys = malloc(num_keys * sizeof(int));
+  bench_shuffled_keys(keys, num_keys, 1);
+  shared = bst_create_mode(BST_CONCURRENT);
+  for (int i = 0; i < num_keys; i++) {
+    bst_insert(shared, keys[i], &num_keys);
+  }
+  free(keys);
+
+  printf("== random bst_get() over %d keys in a BST_CONCURRENT tree\n",
+    num_keys);
+  for (int with_writer = 0; with_writer <= 1; with_writer++) {
+    for (int readers = 1; readers <= max_readers; readers *= 2) {
+      bench_readers(readers, with_writer);
+    }
+  }
+
+  bst_free(shared);
+  return 0;
+}
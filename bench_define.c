@@ -0,0 +1,120 @@
+/*
+ * This file contains a benchmark comparing trees generated with
+ * BST_DEFINE() against the `int`-keyed trees of bst.c.  For BST_PLAIN and
+ * BST_BALANCED trees, it times inserting shuffled keys, looking each of them
+ * up and removing them all, in:
+ *
+ *   bst        struct bst from bst.c
+ *   int        BST_DEFINE(..., int, BST_CMP_NUMERIC)
+ *   int-fnptr  BST_DEFINE() over `int` with a comparator called through a
+ *              function pointer, which the compiler can't inline (it is
+ *              called twice per node, see bst_define.h)
+ *   int64      BST_DEFINE(..., int64_t, BST_CMP_NUMERIC)
+ *
+ * Usage: ./bench_define [num_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+#include "bst_define.h"
+
+/*
+ * Default number of keys in each tree, and the number of times each
+ * measurement is repeated (the fastest run is reported).
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define ROUNDS 3
+
+/*
+ * A comparator the compiler can't see through, called through a pointer
+ * read from a volatile variable at every comparison.
+ */
+int compare_ints(int a, int b) {
+  return (a > b) - (a < b);
+}
+
+int (* volatile compare_ptr)(int, int) = compare_ints;
+
+#define CMP_INDIRECT(a, b) compare_ptr((a), (b))
+
+BST_DEFINE(int_tree, int, BST_CMP_NUMERIC)
+BST_DEFINE(fnptr_tree, int, CMP_INDIRECT)
+BST_DEFINE(i64_tree, int64_t, BST_CMP_NUMERIC)
+
+/*
+ * Times inserting, looking up and removing `keys[0..n)` in a fresh tree
+ * created with `mode`, with `prefix` naming the tree's functions, ROUNDS
+ * times, and prints the fastest time each phase took per key.  `sink` keeps
+ * the lookups from being optimized away.
+ */
+#define BENCH_TREE(label, prefix, key_of, mode, keys, n) do { \
+  uint64_t insert = UINT64_MAX, get = UINT64_MAX, remove = UINT64_MAX; \
+  for (int r = 0; r < ROUNDS; r++) { \
+    uint64_t start = bench_now_ns(); \
+    struct prefix* tree = prefix##_create_mode(mode); \
+    for (int i = 0; i < (n); i++) { \
+      prefix##_insert(tree, key_of((keys)[i]), &(keys)[i]); \
+    } \
+    insert = min_ns(insert, bench_now_ns() - start); \
+    start = bench_now_ns(); \
+    for (int i = 0; i < (n); i++) { \
+      sink += prefix##_get(tree, key_of((keys)[i])) != NULL; \
+    } \
+    get = min_ns(get, bench_now_ns() - start); \
+    start = bench_now_ns(); \
+    for (int i = 0; i < (n); i++) { \
+      prefix##_remove(tree, key_of((keys)[i])); \
+    } \
+    remove = min_ns(remove, bench_now_ns() - start); \
+    prefix##_free(tree); \
+  } \
+  print_row(label, mode, insert, get, remove, n); \
+} while (0)
+
+/*
+ * Returns the shorter of two times.
+ */
+uint64_t min_ns(uint64_t a, uint64_t b) {
+  return a < b ? a : b;
+}
+
+/*
+ * Prints one row of results, in ns per key.
+ */
+void print_row(const char* label, int mode, uint64_t insert, uint64_t get,
+    uint64_t remove, int n) {
+  printf("%-10s %-10s %10.1f %10.1f %10.1f\n", label,
+    mode == BST_PLAIN ? "plain" : "balanced", (double)insert / n,
+    (double)get / n, (double)remove / n);
+}
+
+/*
+ * Key conversions for BENCH_TREE(): 64-bit keys are spread beyond the range
+ * of an int.
+ */
+#define AS_INT(key) (key)
+#define AS_I64(key) ((int64_t)(key) << 20)
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int* keys = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  long sink = 0;
+
+  printf("== ns per key for %d shuffled keys\n", n);
+  printf("%-10s %-10s %10s %10s %10s\n", "tree", "mode", "insert", "get",
+    "remove");
+  int modes[] = {BST_PLAIN, BST_BALANCED};
+  for (int m = 0; m < 2; m++) {
+    BENCH_TREE("bst", bst, AS_INT, modes[m], keys, n);
+    BENCH_TREE("int", int_tree, AS_INT, modes[m], keys, n);
+    BENCH_TREE("int-fnptr", fnptr_tree, AS_INT, modes[m], keys, n);
+    BENCH_TREE("int64", i64_tree, AS_I64, modes[m], keys, n);
+  }
+  free(keys);
+  return sink == 8L * ROUNDS * n ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/*
+ * This file contains a benchmark measuring the cost of full in-order scans
+ * with BST iterators, in nanoseconds per element visited.
+ *
+ * Usage: ./bench_iterator [num_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys inserted into each tree, and the number of full
+ * scans timed for each tree.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define NUM_SCANS 5
+
+/*
+ * Times full scans of a tree and prints the average cost per element.
+ */
+void bench_scan(const char* name, struct bst* bst) {
+  long long check = 0;
+  int n = bst_size(bst);
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < NUM_SCANS; i++) {
+    struct bst_iterator* iter = bst_iterator_create(bst);
+    while (bst_iterator_has_next(iter)) {
+      check += bst_iterator_next(iter, NULL);
+    }
+    bst_iterator_free(iter);
+  }
+  uint64_t ns = bench_now_ns() - start;
+  printf("%-18s %6.2f ns/element  (checksum %lld)\n", name,
+    (double)ns / ((double)n * NUM_SCANS), check / NUM_SCANS);
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int* keys = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  printf("== full scans over %d keys\n", n);
+
+  int modes[3] = {BST_PLAIN, BST_BALANCED, BST_BPTREE};
+  const char* names[3] = {"plain (shuffled)", "balanced", "bptree"};
+  for (int m = 0; m < 3; m++) {
+    struct bst* bst = bst_create_mode(modes[m]);
+    for (int i = 0; i < n; i++) {
+      bst_insert(bst, keys[i], NULL);
+    }
+    bench_scan(names[m], bst);
+    bst_free(bst);
+  }
+
+  /*
+   * A tree built from sorted keys has its nodes laid out in pre-order, so
+   * a scan touches memory far more sequentially.
+   */
+  for (int i = 0; i < n; i++) {
+    keys[i] = i;
+  }
+  struct bst* bst = bst_build_sorted(keys, NULL, n);
+  bench_scan("bulk-built", bst);
+  bst_free(bst);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,139 @@
+/*
+ * This file contains a benchmark measuring the throughput of the lock-free
+ * BST in lfbst.c from 1 to N threads, each running the same random mix of
+ * lookups, inserts and removals.  For comparison, it runs the same workload
+ * on a BST_CONCURRENT tree, whose writers are serialized by a lock.
+ *
+ * Usage: ./bench_lockfree [num_keys] [max_threads] [update_percent]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <time.h>
+#include <pthread.h>
+
+#include "bst.h"
+#include "lfbst.h"
+
+/*
+ * Default number of keys in the key range (half of which are in the tree at
+ * any time), default percentage of operations that are updates, and how
+ * long each configuration runs, in milliseconds.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define DEFAULT_UPDATE_PERCENT 20
+#define RUN_MS 500
+
+/*
+ * State shared between the threads of a run.  Exactly one of `lf` and `bst`
+ * is set.  Workers run until `stop` is set.
+ */
+struct lfbst* lf;
+struct bst* bst;
+int num_keys;
+int update_percent;
+int stop;
+
+/*
+ * Each worker thread runs random operations on keys in [0, num_keys), half
+ * of the updates being inserts and half removals, and returns the number of
+ * operations it made (cast to a pointer).
+ */
+void* worker(void* arg) {
+  uint64_t state = (uint64_t)(long)arg;
+  long ops = 0;
+  uintptr_t check = 0;
+  while (!__atomic_load_n(&stop, __ATOMIC_RELAXED)) {
+    for (int i = 0; i < 64; i++) {
+      uint64_t r = bench_rand(&state);
+      int key = (int)(r % num_keys);
+      int op = (int)((r >> 32) % 200);
+      if (op < update_percent) {
+        if (lf) {
+          lfbst_insert(lf, key, &num_keys);
+        } else {
+          bst_insert(bst, key, &num_keys);
+        }
+      } else if (op < 2 * update_percent) {
+        if (lf) {
+          lfbst_remove(lf, key);
+        } else {
+          bst_remove(bst, key);
+        }
+      } else {
+        check += (uintptr_t)(lf ? lfbst_get(lf, key) : bst_get(bst, key));
+      }
+    }
+    ops += 64;
+  }
+  return (void*)(ops + (check == 1));
+}
+
+/*
+ * Runs `threads` worker threads for RUN_MS milliseconds and returns the
+ * combined throughput in millions of operations per second.
+ */
+double bench_threads(int threads) {
+  pthread_t ids[threads];
+  stop = 0;
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < threads; i++) {
+    pthread_create(&ids[i], NULL, worker, (void*)(long)(i + 1));
+  }
+  struct timespec run = {RUN_MS / 1000, (RUN_MS % 1000) * 1000000L};
+  nanosleep(&run, NULL);
+  __atomic_store_n(&stop, 1, __ATOMIC_RELAXED);
+
+  long ops = 0;
+  for (int i = 0; i < threads; i++) {
+    void* result;
+    pthread_join(ids[i], &result);
+    ops += (long)result;
+  }
+  return ops * 1e3 / (bench_now_ns() - start);
+}
+
+int main(int argc, char** argv) {
+  num_keys = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int max_threads = argc > 2 ? atoi(argv[2])
+    : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int percent = argc > 3 ? atoi(argv[3]) : DEFAULT_UPDATE_PERCENT;
+  update_percent = percent;
+
+  /*
+   * Start both trees half full, with every even key, inserted in random
+   * order.
+   */
+  int* keys = malloc(num_keys * sizeof(int));
+  bench_shuffled_keys(keys, num_keys, 1);
+  lf = lfbst_create();
+  bst = bst_create_mode(BST_CONCURRENT);
+  for (int i = 0; i < num_keys; i++) {
+    if (keys[i] % 2 == 0) {
+      lfbst_insert(lf, keys[i], &num_keys);
+      bst_insert(bst, keys[i], &num_keys);
+    }
+  }
+  free(keys);
+
+  printf("== %d%% updates over %d keys, in M ops/s\n", percent, num_keys);
+  printf("%8s %12s %12s\n", "threads", "lock-free", "concurrent");
+  struct lfbst* lf_tree = lf;
+  struct bst* bst_tree = bst;
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    lf = lf_tree;
+    bst = NULL;
+    double lf_mops = bench_threads(threads);
+    lf = NULL;
+    bst = bst_tree;
+    double bst_mops = bench_threads(threads);
+    printf("%8d %12.2f %12.2f\n", threads, lf_mops, bst_mops);
+  }
+
+  lfbst_free(lf_tree);
+  bst_free(bst_tree);
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+ * This file contains a benchmark measuring the speedup of
+ * bst_height_parallel() over bst_height() on a large BST_PLAIN tree, for
+ * thread counts from 1 up to the number of cores.
+ *
+ * Usage: ./bench_parallel [num_keys] [max_threads]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys inserted into the tree, and the number of times
+ * each measurement is repeated.
+ */
+#define DEFAULT_NUM_KEYS 10000000
+#define NUM_RUNS 5
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int max_threads = argc > 2 ? atoi(argv[2])
+    : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int* keys = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  struct bst* bst = bst_create();
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], NULL);
+  }
+  free(keys);
+
+  uint64_t start = bench_now_ns();
+  int height = 0;
+  for (int i = 0; i < NUM_RUNS; i++) {
+    height = bst_height(bst);
+  }
+  double serial_ms = (bench_now_ns() - start) / 1e6 / NUM_RUNS;
+  printf("== bst_height() of a plain tree with %d shuffled keys (height %d)\n",
+    n, height);
+  printf("%8s %10s %8s\n", "threads", "ms", "speedup");
+  printf("%8s %10.2f %8.2f\n", "serial", serial_ms, 1.0);
+
+  for (int threads = 1; threads <= max_threads; threads *= 2) {
+    int same = 1;
+    start = bench_now_ns();
+    for (int i = 0; i < NUM_RUNS; i++) {
+      same &= bst_height_parallel(bst, threads) == height;
+    }
+    double ms = (bench_now_ns() - start) / 1e6 / NUM_RUNS;
+    printf("%8d %10.2f %8.2f%s\n", threads, ms, serial_ms / ms,
+      same ? "" : "  (WRONG RESULT)");
+  }
+
+  bst_free(bst);
+  return 0;
+}
@@ -0,0 +1,356 @@
+/*
+ * This file contains a profiling harness that runs lookup and insert
+ * workloads against each tree layout and reports, per operation, the
+ * hardware events they cost as measured by Linux perf_event_open(): cycles,
+ * instructions, L1 data cache and last-level cache misses, data TLB misses
+ * and branch mispredictions.  This is what node layout and prefetching
+ * changes should be judged by, since wall time alone doesn't tell a cache
+ * miss from a mispredicted branch.
+ *
+ * Counters are only counted in user space, so they work with the default
+ * perf_event_paranoid setting of 2.  Any counter that can't be opened (in a
+ * virtual machine without a virtual PMU, for example, or when the CPU lacks
+ * that event) is reported as "n/a", and if none can be opened, the harness
+ * still reports wall time.  Counts include the loop that drives the
+ * operations, which costs a few instructions and no misses per operation.
+ *
+ * Usage: ./bench_perf [num_keys] [num_ops]
+ */
+
+#define _GNU_SOURCE
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+#include "bst.h"
+#include "frozen.h"
+
+/*
+ * Default number of keys in each tree, default number of lookups per lookup
+ * workload, number of keys looked up per bst_get_batch() call, and the skew
+ * of the Zipfian workload.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define DEFAULT_NUM_OPS 1000000
+#define BATCH_SIZE 1024
+#define ZIPF_THETA 0.99
+
+/*
+ * The hardware events counted around every workload.  Cache events count
+ * read misses, which is what lookups suffer from.
+ */
+#define NUM_EVENTS 7
+#define HW_CACHE_READ_MISS(cache) ((cache) \
+  | (PERF_COUNT_HW_CACHE_OP_READ << 8) \
+  | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+enum { CYCLES, INSTRUCTIONS, BRANCHES, BRANCH_MISSES, L1D_MISSES, LLC_MISSES,
+  DTLB_MISSES };
+
+const struct {
+  uint32_t type;
+  uint64_t config;
+} EVENTS[NUM_EVENTS] = {
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_INSTRUCTIONS},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+  {PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_L1D)},
+  {PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES},
+  {PERF_TYPE_HW_CACHE, HW_CACHE_READ_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+};
+
+/*
+ * File descriptor of each event's counter, or -1 if it couldn't be opened,
+ * and the errno of the first counter that couldn't be.
+ */
+int fds[NUM_EVENTS];
+int open_errno = 0;
+
+/*
+ * The result of one measured workload: wall time and the number of each
+ * event, both over all of its `ops` operations.  An event that wasn't
+ * counted has a count below zero.
+ */
+struct sample {
+  long ops;
+  uint64_t ns;
+  double counts[NUM_EVENTS];
+};
+
+/*
+ * Opens a counter for each event on the calling thread, disabled, counting
+ * user-space events only.  Returns the number of counters opened.
+ */
+int perf_open() {
+  int opened = 0;
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = EVENTS[i].type;
+    attr.config = EVENTS[i].config;
+    attr.disabled = 1;
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED
+      | PERF_FORMAT_TOTAL_TIME_RUNNING;
+    fds[i] = (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    if (fds[i] < 0 && open_errno == 0) {
+      open_errno = errno;
+    }
+    opened += fds[i] >= 0;
+  }
+  return opened;
+}
+
+void perf_close() {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    if (fds[i] >= 0) {
+      close(fds[i]);
+    }
+  }
+}
+
+/*
+ * Starts a measurement.  The clock is read last, so counter setup isn't
+ * timed.
+ */
+void perf_start(struct sample* s) {
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    if (fds[i] >= 0) {
+      ioctl(fds[i], PERF_EVENT_IOC_RESET, 0);
+      ioctl(fds[i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+  }
+  s->ns = bench_now_ns();
+}
+
+/*
+ * Ends a measurement of `ops` operations.  When there are more counters
+ * than the CPU has, the kernel time-shares them, so each count is scaled up
+ * by the fraction of the measurement its counter actually ran for.
+ */
+void perf_stop(struct sample* s, long ops) {
+  s->ns = bench_now_ns() - s->ns;
+  s->ops = ops;
+  for (int i = 0; i < NUM_EVENTS; i++) {
+    s->counts[i] = -1;
+    if (fds[i] < 0) {
+      continue;
+    }
+    ioctl(fds[i], PERF_EVENT_IOC_DISABLE, 0);
+    uint64_t data[3];
+    if (read(fds[i], data, sizeof(data)) == sizeof(data) && data[2] > 0) {
+      s->counts[i] = (double)data[0] * data[1] / data[2];
+    }
+  }
+}
+
+/*
+ * Prints a header line naming the columns printed by print_sample().
+ */
+void print_header() {
+  printf("%-14s %-7s %-10s %8s %8s %8s %9s %9s %9s %8s %8s\n", "layout", "op",
+    "workload", "ns/op", "cycles", "instr", "L1d-miss", "LLC-miss",
+    "dTLB-miss", "br-miss", "br-miss%");
+}
+
+/*
+ * Prints one count per operation, or "n/a" if it wasn't counted.
+ */
+void print_count(int width, double count, long ops) {
+  if (count < 0) {
+    printf(" %*s", width, "n/a");
+  } else {
+    printf(" %*.2f", width, count / ops);
+  }
+}
+
+/*
+ * Prints a sample as one line of per-operation costs, followed by the
+ * fraction of branches that were mispredicted.
+ */
+void print_sample(const char* layout, const char* op, const char* workload,
+    struct sample* s) {
+  printf("%-14s %-7s %-10s %8.1f", layout, op, workload,
+    (double)s->ns / s->ops);
+  print_count(8, s->counts[CYCLES], s->ops);
+  print_count(8, s->counts[INSTRUCTIONS], s->ops);
+  print_count(9, s->counts[L1D_MISSES], s->ops);
+  print_count(9, s->counts[LLC_MISSES], s->ops);
+  print_count(9, s->counts[DTLB_MISSES], s->ops);
+  print_count(8, s->counts[BRANCH_MISSES], s->ops);
+  if (s->counts[BRANCHES] > 0 && s->counts[BRANCH_MISSES] >= 0) {
+    printf(" %7.2f%%\n", 100 * s->counts[BRANCH_MISSES] / s->counts[BRANCHES]);
+  } else {
+    printf(" %8s\n", "n/a");
+  }
+}
+
+/*
+ * The layouts profiled.  "balanced+batch" is a BST_BALANCED tree looked up
+ * with bst_get_batch(), and "frozen" is a frozen copy of one.
+ */
+#define NUM_LAYOUTS 6
+#define LAYOUT_FROZEN -1
+#define LAYOUT_BATCH -2
+
+const struct {
+  const char* name;
+  int mode;
+} LAYOUTS[NUM_LAYOUTS] = {
+  {"plain", BST_PLAIN},
+  {"balanced", BST_BALANCED},
+  {"bptree", BST_BPTREE},
+  {"concurrent", BST_CONCURRENT},
+  {"frozen", LAYOUT_FROZEN},
+  {"balanced+batch", LAYOUT_BATCH},
+};
+
+/*
+ * Fills `lookups[0..ops)` with keys in [0, n) drawn from a lookup workload:
+ * "uniform" keys are drawn uniformly, "zipf" keys follow a Zipfian
+ * distribution whose popular keys are scattered across the key space, and
+ * "sequential" keys ascend, wrapping around.
+ */
+void make_lookups(const char* workload, int* lookups, long ops, int n) {
+  uint64_t state = 42;
+  if (strcmp(workload, "uniform") == 0) {
+    for (long i = 0; i < ops; i++) {
+      lookups[i] = (int)(bench_rand(&state) % n);
+    }
+  } else if (strcmp(workload, "zipf") == 0) {
+    int* scatter = malloc(n * sizeof(int));
+    bench_shuffled_keys(scatter, n, 7);
+    struct bench_zipf zipf;
+    bench_zipf_init(&zipf, n, ZIPF_THETA);
+    for (long i = 0; i < ops; i++) {
+      lookups[i] = scatter[bench_zipf_next(&zipf, &state)];
+    }
+    free(scatter);
+  } else {
+    for (long i = 0; i < ops; i++) {
+      lookups[i] = (int)(i % n);
+    }
+  }
+}
+
+/*
+ * Profiles building a tree of the given layout by inserting `keys[0..n)`,
+ * and returns the tree.  Frozen layouts are built from a balanced tree with
+ * bst_freeze(), which isn't profiled.
+ */
+struct bst* profile_inserts(int l, const char* workload, int* keys, int n) {
+  int mode = LAYOUTS[l].mode < 0 ? BST_BALANCED : LAYOUTS[l].mode;
+  struct bst* bst = bst_create_mode(mode);
+  struct sample s;
+  perf_start(&s);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &keys[i]);
+  }
+  perf_stop(&s, n);
+  if (LAYOUTS[l].mode >= 0) {
+    print_sample(LAYOUTS[l].name, "insert", workload, &s);
+  }
+  return bst;
+}
+
+/*
+ * Profiles `ops` lookups of `lookups` in a tree of the given layout.
+ */
+void profile_lookups(int l, struct bst* bst, struct bst_frozen* frozen,
+    const char* workload, int* lookups, long ops) {
+  uintptr_t check = 0;
+  struct sample s;
+  if (LAYOUTS[l].mode == LAYOUT_BATCH) {
+    void* values[BATCH_SIZE];
+    perf_start(&s);
+    for (long i = 0; i < ops; i += BATCH_SIZE) {
+      int batch = ops - i < BATCH_SIZE ? (int)(ops - i) : BATCH_SIZE;
+      bst_get_batch(bst, lookups + i, batch, values);
+      check += (uintptr_t)values[0];
+    }
+    perf_stop(&s, ops);
+  } else if (LAYOUTS[l].mode == LAYOUT_FROZEN) {
+    perf_start(&s);
+    for (long i = 0; i < ops; i++) {
+      check += (uintptr_t)bst_frozen_get(frozen, lookups[i]);
+    }
+    perf_stop(&s, ops);
+  } else {
+    perf_start(&s);
+    for (long i = 0; i < ops; i++) {
+      check += (uintptr_t)bst_get(bst, lookups[i]);
+    }
+    perf_stop(&s, ops);
+  }
+  print_sample(LAYOUTS[l].name, "get", workload, &s);
+  if (check == 1) {
+    printf("(unreachable)\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  long ops = argc > 2 ? atol(argv[2]) : DEFAULT_NUM_OPS;
+
+  int opened = perf_open();
+  if (opened == 0) {
+    printf("== Hardware counters are unavailable (perf_event_open: %s); "
+      "reporting wall time only\n", strerror(open_errno));
+  } else if (opened < NUM_EVENTS) {
+    printf("== %d of %d hardware counters are unavailable (perf_event_open: "
+      "%s)\n", NUM_EVENTS - opened, NUM_EVENTS, strerror(open_errno));
+  }
+  printf("== %d keys, %ld lookups per lookup workload; costs are per "
+    "operation\n", n, ops);
+  print_header();
+
+  /*
+   * Each tree is built from shuffled keys, so BST_PLAIN trees get their
+   * typical (about 1.39 log n) depth.  Sorted inserts are profiled for the
+   * layouts that keep themselves balanced; a BST_PLAIN tree would degenerate
+   * into a list.
+   */
+  int* keys = malloc(n * sizeof(int));
+  int* sorted = malloc(n * sizeof(int));
+  int* lookups = malloc(ops * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  for (int i = 0; i < n; i++) {
+    sorted[i] = i;
+  }
+  const char* workloads[] = {"uniform", "zipf", "sequential"};
+  for (int l = 0; l < NUM_LAYOUTS; l++) {
+    if (LAYOUTS[l].mode != BST_PLAIN && LAYOUTS[l].mode >= 0) {
+      bst_free(profile_inserts(l, "sorted", sorted, n));
+    }
+    struct bst* bst = profile_inserts(l, "random", keys, n);
+    struct bst_frozen* frozen = NULL;
+    if (LAYOUTS[l].mode == LAYOUT_FROZEN) {
+      frozen = bst_freeze(bst);
+    }
+    for (int w = 0; w < 3; w++) {
+      make_lookups(workloads[w], lookups, ops, n);
+      profile_lookups(l, bst, frozen, workloads[w], lookups, ops);
+    }
+    if (frozen != NULL) {
+      bst_frozen_free(frozen);
+    }
+    bst_free(bst);
+  }
+
+  perf_close();
+  free(lookups);
+  free(sorted);
+  free(keys);
+  return 0;
+}
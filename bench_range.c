@@ -0,0 +1,94 @@
+/*
+ * This file contains a benchmark for removing a range of keys from a BST,
+ * comparing one bst_remove() per key with a single bst_remove_range(), on
+ * BST_PLAIN and BST_BALANCED trees built from shuffled keys.  Each range of
+ * width w starts at a random key and holds about w keys.
+ *
+ * Usage: ./bench_range [num_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys in each tree, and the number of ranges removed from
+ * each tree.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define NUM_RANGES 10
+
+/*
+ * State of the random number generator that picks where ranges start.
+ */
+uint64_t rng = 42;
+
+/*
+ * Builds a tree created with `mode` from the keys in `keys`.
+ */
+struct bst* build(int mode, int* keys, int n) {
+  struct bst* bst = bst_create_mode(mode);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &keys[i]);
+  }
+  return bst;
+}
+
+/*
+ * Removes NUM_RANGES ranges of width `width` from a fresh tree created with
+ * `mode`, once key by key and once with bst_remove_range(), and prints the
+ * time each took per range.
+ */
+void bench_width(const char* name, int mode, int* keys, int n, int width) {
+  int starts[NUM_RANGES];
+  for (int i = 0; i < NUM_RANGES; i++) {
+    starts[i] = (int)(bench_rand(&rng) % (uint64_t)(n - width));
+  }
+
+  struct bst* bst = build(mode, keys, n);
+  uint64_t start = bench_now_ns();
+  for (int i = 0; i < NUM_RANGES; i++) {
+    for (int key = starts[i]; key < starts[i] + width; key++) {
+      bst_remove(bst, key);
+    }
+  }
+  uint64_t by_key = bench_now_ns() - start;
+  int size_by_key = bst_size(bst);
+  bst_free(bst);
+
+  bst = build(mode, keys, n);
+  start = bench_now_ns();
+  for (int i = 0; i < NUM_RANGES; i++) {
+    bst_remove_range(bst, starts[i], starts[i] + width - 1);
+  }
+  uint64_t by_range = bench_now_ns() - start;
+  int size_by_range = bst_size(bst);
+  bst_free(bst);
+
+  printf("%-10s %8d %14.1f %14.1f %8.1fx%s\n", name, width,
+    by_key / 1000.0 / NUM_RANGES, by_range / 1000.0 / NUM_RANGES,
+    (double)by_key / by_range,
+    size_by_key == size_by_range ? "" : "  (sizes differ!)");
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int* keys = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+
+  printf("== us per range removed from a tree of %d keys\n", n);
+  printf("%-10s %8s %14s %14s %9s\n", "tree", "width", "bst_remove",
+    "remove_range", "speedup");
+  int widths[] = {10, 1000, 100000};
+  for (int i = 0; i < 3; i++) {
+    if (widths[i] < n) {
+      bench_width("plain", BST_PLAIN, keys, n, widths[i]);
+      bench_width("balanced", BST_BALANCED, keys, n, widths[i]);
+    }
+  }
+  free(keys);
+  return 0;
+}
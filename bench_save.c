@@ -0,0 +1,72 @@
+/*
+ * This file contains a benchmark comparing the time it takes to get a
+ * queryable tree back after a restart by re-inserting every key, with the
+ * time it takes to load a tree saved with bst_save() using bst_load_mmap().
+ *
+ * Usage: ./bench_save [num_keys] [path]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+#include "frozen.h"
+
+/*
+ * Default number of keys in the tree, number of random lookups made on each
+ * tree, and default file the tree is saved to.
+ */
+#define DEFAULT_NUM_KEYS 10000000
+#define NUM_LOOKUPS 1000000
+#define DEFAULT_PATH "bench_save.tmp"
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  const char* path = argc > 2 ? argv[2] : DEFAULT_PATH;
+  int* keys = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  printf("== restoring a tree of %d keys\n", n);
+
+  uint64_t start = bench_now_ns();
+  struct bst* bst = bst_create_mode(BST_BALANCED);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], NULL);
+  }
+  printf("%-24s %10.2f ms\n", "rebuild with inserts",
+    (bench_now_ns() - start) / 1e6);
+
+  start = bench_now_ns();
+  if (bst_save(bst, path, NULL, NULL) != 0) {
+    printf("could not write %s\n", path);
+    return 1;
+  }
+  printf("%-24s %10.2f ms\n", "bst_save()", (bench_now_ns() - start) / 1e6);
+  bst_free(bst);
+
+  start = bench_now_ns();
+  struct bst_frozen* frozen = bst_load_mmap(path, NULL, NULL);
+  printf("%-24s %10.3f ms\n", "bst_load_mmap()",
+    (bench_now_ns() - start) / 1e6);
+
+  uint64_t state = 7;
+  uintptr_t check = 0;
+  start = bench_now_ns();
+  for (int i = 0; i < NUM_LOOKUPS; i++) {
+    int key = keys[bench_rand(&state) % n];
+    check += bst_frozen_range_sum(frozen, key, key) == key;
+  }
+  printf("%-24s %10.2f ns/op  (%lu found)\n", "lookups after loading",
+    (double)(bench_now_ns() - start) / NUM_LOOKUPS, (unsigned long)check);
+
+  start = bench_now_ns();
+  int ok = bst_frozen_verify(frozen);
+  printf("%-24s %10.2f ms  (%s)\n", "bst_frozen_verify()",
+    (bench_now_ns() - start) / 1e6, ok ? "ok" : "corrupt");
+
+  bst_frozen_free(frozen);
+  remove(path);
+  free(keys);
+  return 0;
+}
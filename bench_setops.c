@@ -0,0 +1,112 @@
+/*
+ * This file contains a benchmark for merging one BST_BALANCED | BST_UNIQUE
+ * tree into another, comparing a loop of bst_insert() calls with
+ * bst_union() on 1 up to the given number of threads, for a delta tree of
+ * several sizes merged into a large master tree.  Half of the keys of each
+ * delta are already in the master tree.  bst_intersect() and
+ * bst_difference() are timed alongside.
+ *
+ * Usage: ./bench_setops [master_keys] [max_threads]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys in the master tree.
+ */
+#define DEFAULT_MASTER_KEYS 1000000
+
+/*
+ * The master tree holds the even keys below twice its size.  A delta of `m`
+ * keys holds `m / 2` of those, spread evenly, and as many odd keys.
+ */
+int delta_key(int i, int m, int master) {
+  long long spread = (long long)(i / 2) * (2LL * master / m) * 2;
+  return (int)(spread % (2LL * master)) + (i % 2);
+}
+
+/*
+ * Builds a new master tree of `n` keys, inserted in shuffled order.
+ */
+struct bst* build_master(int* order, int n) {
+  struct bst* bst = bst_create_mode(BST_BALANCED | BST_UNIQUE);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, 2 * order[i], NULL);
+  }
+  return bst;
+}
+
+/*
+ * Builds a new delta tree of `m` keys to merge into a master of `master`
+ * keys.
+ */
+struct bst* build_delta(int m, int master) {
+  struct bst* bst = bst_create_mode(BST_BALANCED | BST_UNIQUE);
+  for (int i = 0; i < m; i++) {
+    bst_insert(bst, delta_key(i, m, master), NULL);
+  }
+  return bst;
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_MASTER_KEYS;
+  int max_threads = argc > 2 ? atoi(argv[2])
+    : (int)sysconf(_SC_NPROCESSORS_ONLN);
+  int* order = malloc(n * sizeof(int));
+  bench_shuffled_keys(order, n, 1);
+
+  printf("== ms to combine a delta with a master tree of %d keys\n", n);
+  printf("%-10s %8s %8s %10s %10s %10s\n", "operation", "delta", "threads",
+    "ms", "speedup", "size");
+  int deltas[] = {1000, 100000, 1000000};
+  for (int d = 0; d < 3; d++) {
+    int m = deltas[d] < n ? deltas[d] : n;
+
+    struct bst* master = build_master(order, n);
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < m; i++) {
+      bst_insert(master, delta_key(i, m, n), NULL);
+    }
+    uint64_t loop = bench_now_ns() - start;
+    printf("%-10s %8d %8d %10.2f %10s %10d\n", "insert", m, 1, loop / 1e6,
+      "1.00x", bst_size(master));
+    bst_free(master);
+
+    for (int threads = 1; threads <= max_threads; threads *= 2) {
+      master = build_master(order, n);
+      struct bst* delta = build_delta(m, n);
+      start = bench_now_ns();
+      bst_union(master, delta, threads);
+      uint64_t t = bench_now_ns() - start;
+      printf("%-10s %8d %8d %10.2f %9.2fx %10d\n", "union", m, threads,
+        t / 1e6, (double)loop / t, bst_size(master));
+      bst_free(master);
+    }
+
+    master = build_master(order, n);
+    struct bst* delta = build_delta(m, n);
+    start = bench_now_ns();
+    bst_intersect(master, delta, max_threads);
+    uint64_t t = bench_now_ns() - start;
+    printf("%-10s %8d %8d %10.2f %10s %10d\n", "intersect", m, max_threads,
+      t / 1e6, "", bst_size(master));
+    bst_free(master);
+
+    master = build_master(order, n);
+    delta = build_delta(m, n);
+    start = bench_now_ns();
+    bst_difference(master, delta, max_threads);
+    t = bench_now_ns() - start;
+    printf("%-10s %8d %8d %10.2f %10s %10d\n", "difference", m, max_threads,
+      t / 1e6, "", bst_size(master));
+    bst_free(master);
+  }
+  free(order);
+  return 0;
+}
@@ -0,0 +1,103 @@
+/*
+ * This file contains a benchmark for lookups under skewed access patterns,
+ * comparing BST_SPLAY trees, which move every key they look up to the root,
+ * with BST_PLAIN and BST_BALANCED trees.  Each tree is loaded with shuffled
+ * keys, then timed over a run of lookups with keys drawn from:
+ *
+ *   uniform    every key equally likely
+ *   zipf-0.8   Zipfian ranks with skew 0.8
+ *   zipf-0.99  Zipfian ranks with skew 0.99
+ *   hot-1%     90% of lookups spread over 1% of the keys, the rest uniform
+ *
+ * Keys are ranked by popularity in an order of their own, unrelated to the
+ * order they were loaded in, so popular keys sit at random places in the
+ * key space and at whatever depth loading left them.  (Keys loaded early
+ * end up near the root of a BST_PLAIN or BST_BALANCED tree, which would
+ * otherwise favor those.)
+ *
+ * Usage: ./bench_splay [num_keys] [num_lookups]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Default number of keys in each tree and of lookups timed on it.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define DEFAULT_NUM_LOOKUPS 2000000
+
+/*
+ * Key distributions, as described above.
+ */
+#define NUM_DISTS 4
+const char* DIST_NAMES[NUM_DISTS] = {"uniform", "zipf-0.8", "zipf-0.99",
+  "hot-1%"};
+
+/*
+ * Fills `picks[0..m)` with popularity ranks of `n` keys, drawn from
+ * distribution `dist`.
+ */
+void draw_positions(int* picks, long m, int n, int dist) {
+  uint64_t state = 42;
+  struct bench_zipf z;
+  if (dist == 1 || dist == 2) {
+    bench_zipf_init(&z, n, dist == 1 ? 0.8 : 0.99);
+  }
+  int hot = n / 100 > 0 ? n / 100 : 1;
+  for (long i = 0; i < m; i++) {
+    if (dist == 0) {
+      picks[i] = (int)(bench_rand(&state) % n);
+    } else if (dist == 3) {
+      int in_hot = bench_rand(&state) % 10 < 9;
+      picks[i] = (int)(bench_rand(&state) % (in_hot ? hot : n));
+    } else {
+      picks[i] = (int)bench_zipf_next(&z, &state);
+    }
+  }
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  long m = argc > 2 ? atol(argv[2]) : DEFAULT_NUM_LOOKUPS;
+  int* keys = malloc(n * sizeof(int));
+  int* ranked = malloc(n * sizeof(int));
+  int* picks = malloc(m * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  bench_shuffled_keys(ranked, n, 2);
+
+  printf("== ns per lookup, %d keys, %ld lookups\n", n, m);
+  printf("%-10s %10s %10s %10s %10s\n", "dist", "plain", "balanced", "splay",
+    "speedup");
+  const int modes[] = {BST_PLAIN, BST_BALANCED, BST_SPLAY};
+  for (int dist = 0; dist < NUM_DISTS; dist++) {
+    draw_positions(picks, m, n, dist);
+    double ns[3];
+    long found = 0;
+    for (int mode = 0; mode < 3; mode++) {
+      struct bst* bst = bst_create_mode(modes[mode]);
+      for (int i = 0; i < n; i++) {
+        bst_insert(bst, keys[i], &keys[i]);
+      }
+      uint64_t start = bench_now_ns();
+      for (long i = 0; i < m; i++) {
+        found += bst_get(bst, ranked[picks[i]]) != NULL;
+      }
+      ns[mode] = (double)(bench_now_ns() - start) / m;
+      bst_free(bst);
+    }
+    printf("%-10s %10.1f %10.1f %10.1f %9.2fx\n", DIST_NAMES[dist], ns[0],
+      ns[1], ns[2], ns[1] / ns[2]);
+    if (found != 3 * m) {
+      printf("  !! only %ld of %ld lookups found their key\n", found, 3 * m);
+    }
+  }
+  free(picks);
+  free(ranked);
+  free(keys);
+  return 0;
+}
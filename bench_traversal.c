@@ -0,0 +1,107 @@
+/*
+ * This file contains a benchmark for the functions that walk the nodes of a
+ * binary tree: bst_get(), bst_height() on a BST_PLAIN tree, a full scan
+ * with an iterator and bst_freeze().  Each one is timed on a tree built
+ * from shuffled keys and on a degenerate, list-like tree of the kind sorted
+ * inserts produce.
+ *
+ * Usage: ./bench_traversal [num_keys] [list_keys]
+ */
+
+#include "bench.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+#include "frozen.h"
+
+/*
+ * Default number of keys in the random tree and in the list-like tree.
+ * Building the list-like tree takes time quadratic in its size.
+ */
+#define DEFAULT_NUM_KEYS 1000000
+#define DEFAULT_LIST_KEYS 20000
+
+/*
+ * Number of times each walk is repeated, keeping the fastest time.
+ */
+#define REPEATS 5
+
+/*
+ * Runs each walk over `bst` REPEATS times and prints the fastest time of
+ * each, in nanoseconds per lookup for bst_get() and per node for the walks
+ * over the whole tree.
+ */
+void bench_tree(const char* name, struct bst* bst, int* lookups, int n) {
+  uint64_t best[4] = {UINT64_MAX, UINT64_MAX, UINT64_MAX, UINT64_MAX};
+  uintptr_t check = 0;
+  for (int r = 0; r < REPEATS; r++) {
+    uint64_t start = bench_now_ns();
+    for (int i = 0; i < n; i++) {
+      check += (uintptr_t)bst_get(bst, lookups[i]);
+    }
+    uint64_t t = bench_now_ns() - start;
+    best[0] = t < best[0] ? t : best[0];
+
+    start = bench_now_ns();
+    check += bst_height(bst);
+    t = bench_now_ns() - start;
+    best[1] = t < best[1] ? t : best[1];
+
+    start = bench_now_ns();
+    struct bst_iterator* iter = bst_iterator_create(bst);
+    while (bst_iterator_has_next(iter)) {
+      check += bst_iterator_next(iter, NULL);
+    }
+    bst_iterator_free(iter);
+    t = bench_now_ns() - start;
+    best[2] = t < best[2] ? t : best[2];
+
+    start = bench_now_ns();
+    struct bst_frozen* frozen = bst_freeze(bst);
+    t = bench_now_ns() - start;
+    bst_frozen_free(frozen);
+    best[3] = t < best[3] ? t : best[3];
+  }
+
+  printf("%-8s %8d %8d %10.2f %10.2f %10.2f %10.2f\n", name, n,
+    bst_height(bst), (double)best[0] / n, (double)best[1] / n,
+    (double)best[2] / n, (double)best[3] / n);
+  if (check == 1) {
+    printf("(unreachable)\n");
+  }
+}
+
+int main(int argc, char** argv) {
+  int n = argc > 1 ? atoi(argv[1]) : DEFAULT_NUM_KEYS;
+  int list_n = argc > 2 ? atoi(argv[2]) : DEFAULT_LIST_KEYS;
+
+  printf("== ns per lookup (get) or per node (others), fastest of %d runs\n",
+    REPEATS);
+  printf("%-8s %8s %8s %10s %10s %10s %10s\n", "tree", "keys", "height",
+    "get", "height", "scan", "freeze");
+
+  int* keys = malloc(n * sizeof(int));
+  bench_shuffled_keys(keys, n, 1);
+  struct bst* bst = bst_create();
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &keys[i]);
+  }
+  bench_shuffled_keys(keys, n, 2);
+  bench_tree("random", bst, keys, n);
+  bst_free(bst);
+  free(keys);
+
+  keys = malloc(list_n * sizeof(int));
+  bst = bst_create();
+  for (int i = 0; i < list_n; i++) {
+    keys[i] = i;
+    bst_insert(bst, i, &keys[i]);
+  }
+  bench_shuffled_keys(keys, list_n, 2);
+  bench_tree("list", bst, keys, list_n);
+  bst_free(bst);
+  free(keys);
+  return 0;
+}
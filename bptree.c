@@ -0,0 +1,613 @@
+/*
+ * This file contains an implementation of a B+-tree that stores integer keys
+ * with associated void* values, using the same ordering rules as the binary
+ * search tree in bst.c (duplicate keys are allowed, lookups and removals find
+ * the first matching key in key order).  It is used as the backend of BSTs
+ * created in BST_BPTREE mode.
+ *
+ * Each node holds a sorted array of keys and is only a few cache lines long,
+ * so a lookup touches one or two cache lines per level instead of one per
+ * key comparison.  All key/value pairs live in the leaves, which are linked
+ * in key order, so in-order scans and range sums are sequential walks over
+ * contiguous arrays.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bptree.h"
+
+/*
+ * Maximum number of keys held by a leaf node and by an internal node.  With
+ * 4-byte keys and 8-byte pointers, both kinds of node come out at a little
+ * over 3 cache lines.  Nodes other than the root never hold fewer than half
+ * of these.
+ */
+#define BPTREE_LEAF_KEYS 16
+#define BPTREE_INNER_KEYS 15
+#define BPTREE_LEAF_MIN (BPTREE_LEAF_KEYS / 2)
+#define BPTREE_INNER_MIN (BPTREE_INNER_KEYS / 2)
+
+/*
+ * This structure is the header shared by leaf and internal nodes.  `n` is the
+ * number of keys currently stored in the node.
+ */
+struct bptree_node {
+  int is_leaf;
+  int n;
+};
+
+/*
+ * This structure represents a leaf node.  `values[i]` is the value associated
+ * with `keys[i]`, and `next` points to the leaf holding the next larger keys.
+ */
+struct bptree_leaf {
+  struct bptree_node hdr;
+  struct bptree_leaf* next;
+  int keys[BPTREE_LEAF_KEYS];
+  void* values[BPTREE_LEAF_KEYS];
+};
+
+/*
+ * This structure represents an internal node with `hdr.n` separator keys and
+ * `hdr.n + 1` children.  Every key in `children[i]` is less than or equal to
+ * `keys[i]`, which is in turn less than or equal to every key in
+ * `children[i + 1]`.
+ */
+struct bptree_inner {
+  struct bptree_node hdr;
+  int keys[BPTREE_INNER_KEYS];
+  struct bptree_node* children[BPTREE_INNER_KEYS + 1];
+};
+
+/*
+ * This structure represents an entire B+-tree.  `height` is the number of
+ * edges between the root and the leaves (-1 for an empty tree).
+ */
+struct bptree {
+  struct bptree_node* root;
+  int size;
+  int height;
+};
+
+/*
+ * Returns the index of the first key in `keys[0..n)` that is greater than or
+ * equal to `key` (lower bound) or strictly greater than `key` (upper bound).
+ */
+static int lower_bound(int* keys, int n, int key) {
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (keys[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+static int upper_bound(int* keys, int n, int key) {
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = (lo + hi) / 2;
+    if (keys[mid] <= key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/*
+ * These functions allocate new, empty leaf and internal nodes.
+ */
+static struct bptree_leaf* leaf_create() {
+  struct bptree_leaf* leaf = malloc(sizeof(struct bptree_leaf));
+  leaf->hdr.is_leaf = 1;
+  leaf->hdr.n = 0;
+  leaf->next = NULL;
+  return leaf;
+}
+
+static struct bptree_inner* inner_create() {
+  struct bptree_inner* inner = malloc(sizeof(struct bptree_inner));
+  inner->hdr.is_leaf = 0;
+  inner->hdr.n = 0;
+  return inner;
+}
+
+/*
+ * This function allocates and initializes a new, empty B+-tree and returns a
+ * pointer to it.
+ */
+struct bptree* bptree_create() {
+  struct bptree* tree = malloc(sizeof(struct bptree));
+  tree->root = NULL;
+  tree->size = 0;
+  tree->height = -1;
+  return tree;
+}
+
+/*
+ * Frees the subtree rooted at `node`.  Recursion depth is bounded by the
+ * height of the tree, which is tiny because of the high fan-out.
+ */
+static void node_free(struct bptree_node* node) {
+  if (!node->is_leaf) {
+    struct bptree_inner* inner = (struct bptree_inner*)node;
+    for (int i = 0; i <= inner->hdr.n; i++) {
+      node_free(inner->children[i]);
+    }
+  }
+  free(node);
+}
+
+/*
+ * This function frees the memory associated with a B+-tree.  It does not
+ * free the values stored in the tree.
+ *
+ * Params:
+ *   tree - the B+-tree to be destroyed.  May not be NULL.
+ */
+void bptree_free(struct bptree* tree) {
+  assert(tree);
+  if (tree->root) {
+    node_free(tree->root);
+  }
+  free(tree);
+}
+
+/*
+ * This function returns the number of key/value pairs stored in a B+-tree.
+ */
+int bptree_size(struct bptree* tree) {
+  assert(tree);
+  return tree->size;
+}
+
+/*
+ * This function returns the height of a B+-tree, i.e. the number of edges
+ * between its root and its leaves, or -1 if the tree is empty.
+ */
+int bptree_height(struct bptree* tree) {
+  assert(tree);
+  return tree->height;
+}
+
+/*
+ * Inserts a key/value pair into the subtree rooted at `node`.  If `node` has
+ * to be split, the new right half is returned and the separator key that
+ * belongs between the two halves is stored in `*sep`; otherwise NULL is
+ * returned.  Equal keys are inserted after existing ones.
+ */
+static struct bptree_node* insert_rec(struct bptree_node* node, int key,
+    void* value, int* sep) {
+  if (node->is_leaf) {
+    struct bptree_leaf* leaf = (struct bptree_leaf*)node;
+    int pos = upper_bound(leaf->keys, leaf->hdr.n, key);
+    if (leaf->hdr.n < BPTREE_LEAF_KEYS) {
+      int tail = leaf->hdr.n - pos;
+      memmove(&leaf->keys[pos + 1], &leaf->keys[pos], tail * sizeof(int));
+      memmove(&leaf->values[pos + 1], &leaf->values[pos],
+        tail * sizeof(void*));
+      leaf->keys[pos] = key;
+      leaf->values[pos] = value;
+      leaf->hdr.n++;
+      return NULL;
+    }
+
+    /*
+     * The leaf is full, so lay out all BPTREE_LEAF_KEYS + 1 entries in order
+     * and split them evenly between this leaf and a new right sibling.
+     */
+    int keys[BPTREE_LEAF_KEYS + 1];
+    void* values[BPTREE_LEAF_KEYS + 1];
+    memcpy(keys, leaf->keys, pos * sizeof(int));
+    memcpy(values, leaf->values, pos * sizeof(void*));
+    keys[pos] = key;
+    values[pos] = value;
+    memcpy(&keys[pos + 1], &leaf->keys[pos],
+      (BPTREE_LEAF_KEYS - pos) * sizeof(int));
+    memcpy(&values[pos + 1], &leaf->values[pos],
+      (BPTREE_LEAF_KEYS - pos) * sizeof(void*));
+
+    struct bptree_leaf* right = leaf_create();
+    int left_n = (BPTREE_LEAF_KEYS + 1) / 2;
+    int right_n = BPTREE_LEAF_KEYS + 1 - left_n;
+    memcpy(leaf->keys, keys, left_n * sizeof(int));
+    memcpy(leaf->values, values, left_n * sizeof(void*));
+    memcpy(right->keys, &keys[left_n], right_n * sizeof(int));
+    memcpy(right->values, &values[left_n], right_n * sizeof(void*));
+    leaf->hdr.n = left_n;
+    right->hdr.n = right_n;
+    right->next = leaf->next;
+    leaf->next = right;
+    *sep = right->keys[0];
+    return (struct bptree_node*)right;
+  }
+
+  struct bptree_inner* inner = (struct bptree_inner*)node;
+  int i = upper_bound(inner->keys, inner->hdr.n, key);
+  int child_sep;
+  struct bptree_node* child = insert_rec(inner->children[i], key, value,
+    &child_sep);
+  if (child == NULL) {
+    return NULL;
+  }
+
+  /*
+   * The child was split, so its new right half has to be added right after
+   * it, along with the separator between the two.
+   */
+  if (inner->hdr.n < BPTREE_INNER_KEYS) {
+    int tail = inner->hdr.n - i;
+    memmove(&inner->keys[i + 1], &inner->keys[i], tail * sizeof(int));
+    memmove(&inner->children[i + 2], &inner->children[i + 1],
+      tail * sizeof(struct bptree_node*));
+    inner->keys[i] = child_sep;
+    inner->children[i + 1] = child;
+    inner->hdr.n++;
+    return NULL;
+  }
+
+  /*
+   * This node is full too, so split it.  The middle separator moves up to
+   * the parent rather than being copied into either half.
+   */
+  int keys[BPTREE_INNER_KEYS + 1];
+  struct bptree_node* children[BPTREE_INNER_KEYS + 2];
+  memcpy(keys, inner->keys, i * sizeof(int));
+  memcpy(children, inner->children, (i + 1) * sizeof(struct bptree_node*));
+  keys[i] = child_sep;
+  children[i + 1] = child;
+  memcpy(&keys[i + 1], &inner->keys[i],
+    (BPTREE_INNER_KEYS - i) * sizeof(int));
+  memcpy(&children[i + 2], &inner->children[i + 1],
+    (BPTREE_INNER_KEYS - i) * sizeof(struct bptree_node*));
+
+  struct bptree_inner* right = inner_create();
+  int left_n = (BPTREE_INNER_KEYS + 1) / 2;
+  int right_n = BPTREE_INNER_KEYS - left_n;
+  memcpy(inner->keys, keys, left_n * sizeof(int));
+  memcpy(inner->children, children, (left_n + 1) * sizeof(struct bptree_node*));
+  memcpy(right->keys, &keys[left_n + 1], right_n * sizeof(int));
+  memcpy(right->children, &children[left_n + 1],
+    (right_n + 1) * sizeof(struct bptree_node*));
+  inner->hdr.n = left_n;
+  right->hdr.n = right_n;
+  *sep = keys[left_n];
+  return (struct bptree_node*)right;
+}
+
+/*
+ * This function inserts a new key/value pair into a B+-tree.  If the key is
+ * already present, the new pair is placed after the existing ones.
+ *
+ * Params:
+ *   tree - the B+-tree into which to insert.  May not be NULL.
+ *   key - the key used to order the new pair.
+ *   value - the value to store alongside the key.
+ */
+void bptree_insert(struct bptree* tree, int key, void* value) {
+  assert(tree);
+  if (tree->root == NULL) {
+    tree->root = (struct bptree_node*)leaf_create();
+    tree->height = 0;
+  }
+
+  int sep;
+  struct bptree_node* right = insert_rec(tree->root, key, value, &sep);
+  if (right != NULL) {
+    struct bptree_inner* root = inner_create();
+    root->hdr.n = 1;
+    root->keys[0] = sep;
+    root->children[0] = tree->root;
+    root->children[1] = right;
+    tree->root = (struct bptree_node*)root;
+    tree->height++;
+  }
+  tree->size++;
+}
+
+/*
+ * This function stores a value under a key in a B+-tree, replacing the value
+ * of the first pair with that key in place if there is one, and inserting a
+ * new pair (see bptree_insert()) otherwise.
+ *
+ * Params:
+ *   tree - the B+-tree in which to store the value.  May not be NULL.
+ *   key - the key under which to store the value.
+ *   value - the value to store.
+ *   old - if not NULL and the key is already present, the value it replaces
+ *     is stored at this address.
+ *
+ * Return:
+ *   Returns 1 if the key was already present, or 0 if a new pair was
+ *   inserted.
+ */
+int bptree_upsert(struct bptree* tree, int key, void* value, void** old) {
+  int pos;
+  struct bptree_leaf* leaf = bptree_lower_bound(tree, key, &pos);
+  if (leaf == NULL || leaf->keys[pos] != key) {
+    bptree_insert(tree, key, value);
+    return 0;
+  }
+  if (old) {
+    *old = leaf->values[pos];
+  }
+  leaf->values[pos] = value;
+  return 1;
+}
+
+/*
+ * Restores the minimum occupancy of `parent->children[i]` after a removal
+ * left it one key short, either by borrowing a key from a sibling that can
+ * spare one or by merging the child with a sibling.
+ */
+static void fix_child(struct bptree_inner* parent, int i) {
+  struct bptree_node* child = parent->children[i];
+  struct bptree_node* left = i > 0 ? parent->children[i - 1] : NULL;
+  struct bptree_node* right =
+    i < parent->hdr.n ? parent->children[i + 1] : NULL;
+
+  if (child->is_leaf) {
+    struct bptree_leaf* c = (struct bptree_leaf*)child;
+    struct bptree_leaf* l = (struct bptree_leaf*)left;
+    struct bptree_leaf* r = (struct bptree_leaf*)right;
+    if (l && l->hdr.n > BPTREE_LEAF_MIN) {
+      memmove(&c->keys[1], c->keys, c->hdr.n * sizeof(int));
+      memmove(&c->values[1], c->values, c->hdr.n * sizeof(void*));
+      c->keys[0] = l->keys[l->hdr.n - 1];
+      c->values[0] = l->values[l->hdr.n - 1];
+      c->hdr.n++;
+      l->hdr.n--;
+      parent->keys[i - 1] = c->keys[0];
+      return;
+    } else if (r && r->hdr.n > BPTREE_LEAF_MIN) {
+      c->keys[c->hdr.n] = r->keys[0];
+      c->values[c->hdr.n] = r->values[0];
+      c->hdr.n++;
+      r->hdr.n--;
+      memmove(r->keys, &r->keys[1], r->hdr.n * sizeof(int));
+      memmove(r->values, &r->values[1], r->hdr.n * sizeof(void*));
+      parent->keys[i] = r->keys[0];
+      return;
+    }
+
+    /*
+     * Neither sibling can spare a key, so merge with one of them.  Always
+     * merge the right node of the pair into the left one.
+     */
+    if (l == NULL) {
+      l = c;
+      c = r;
+      i++;
+    }
+    memcpy(&l->keys[l->hdr.n], c->keys, c->hdr.n * sizeof(int));
+    memcpy(&l->values[l->hdr.n], c->values, c->hdr.n * sizeof(void*));
+    l->hdr.n += c->hdr.n;
+    l->next = c->next;
+    free(c);
+  } else {
+    struct bptree_inner* c = (struct bptree_inner*)child;
+    struct bptree_inner* l = (struct bptree_inner*)left;
+    struct bptree_inner* r = (struct bptree_inner*)right;
+    if (l && l->hdr.n > BPTREE_INNER_MIN) {
+      memmove(&c->keys[1], c->keys, c->hdr.n * sizeof(int));
+      memmove(&c->children[1], c->children,
+        (c->hdr.n + 1) * sizeof(struct bptree_node*));
+      c->keys[0] = parent->keys[i - 1];
+      c->children[0] = l->children[l->hdr.n];
+      c->hdr.n++;
+      parent->keys[i - 1] = l->keys[l->hdr.n - 1];
+      l->hdr.n--;
+      return;
+    } else if (r && r->hdr.n > BPTREE_INNER_MIN) {
+      c->keys[c->hdr.n] = parent->keys[i];
+      c->children[c->hdr.n + 1] = r->children[0];
+      c->hdr.n++;
+      parent->keys[i] = r->keys[0];
+      r->hdr.n--;
+      memmove(r->keys, &r->keys[1], r->hdr.n * sizeof(int));
+      memmove(r->children, &r->children[1],
+        (r->hdr.n + 1) * sizeof(struct bptree_node*));
+      return;
+    }
+
+    if (l == NULL) {
+      l = c;
+      c = r;
+      i++;
+    }
+    l->keys[l->hdr.n] = parent->keys[i - 1];
+    memcpy(&l->keys[l->hdr.n + 1], c->keys, c->hdr.n * sizeof(int));
+    memcpy(&l->children[l->hdr.n + 1], c->children,
+      (c->hdr.n + 1) * sizeof(struct bptree_node*));
+    l->hdr.n += c->hdr.n + 1;
+    free(c);
+  }
+
+  /*
+   * The node at index `i` was merged into its left sibling, so drop it and
+   * the separator in front of it from the parent.
+   */
+  int tail = parent->hdr.n - i;
+  memmove(&parent->keys[i - 1], &parent->keys[i], tail * sizeof(int));
+  memmove(&parent->children[i], &parent->children[i + 1],
+    tail * sizeof(struct bptree_node*));
+  parent->hdr.n--;
+}
+
+/*
+ * Removes the first pair with key `key` (in key order) from the subtree
+ * rooted at `node`.  Returns 1 if a pair was removed or 0 if the key was not
+ * found.  The caller is responsible for fixing `node` if it underflows.
+ */
+static int remove_rec(struct bptree_node* node, int key) {
+  if (node->is_leaf) {
+    struct bptree_leaf* leaf = (struct bptree_leaf*)node;
+    int pos = lower_bound(leaf->keys, leaf->hdr.n, key);
+    if (pos == leaf->hdr.n || leaf->keys[pos] != key) {
+      return 0;
+    }
+    leaf->hdr.n--;
+    int tail = leaf->hdr.n - pos;
+    memmove(&leaf->keys[pos], &leaf->keys[pos + 1], tail * sizeof(int));
+    memmove(&leaf->values[pos], &leaf->values[pos + 1], tail * sizeof(void*));
+    return 1;
+  }
+
+  /*
+   * Copies of `key` may be spread over several adjacent children when they
+   * are separated by keys equal to `key`, so try each of them in order.
+   */
+  struct bptree_inner* inner = (struct bptree_inner*)node;
+  int i = lower_bound(inner->keys, inner->hdr.n, key);
+  int removed = remove_rec(inner->children[i], key);
+  while (!removed && i < inner->hdr.n && inner->keys[i] == key) {
+    i++;
+    removed = remove_rec(inner->children[i], key);
+  }
+  if (removed) {
+    struct bptree_node* child = inner->children[i];
+    int min = child->is_leaf ? BPTREE_LEAF_MIN : BPTREE_INNER_MIN;
+    if (child->n < min) {
+      fix_child(inner, i);
+    }
+  }
+  return removed;
+}
+
+/*
+ * This function removes the first key/value pair with a given key from a
+ * B+-tree.  If the key is not present, the tree is unchanged.
+ *
+ * Params:
+ *   tree - the B+-tree from which to remove.  May not be NULL.
+ *   key - the key of the pair to be removed.
+ *
+ * Return:
+ *   Returns 1 if a pair was removed and 0 otherwise.
+ */
+int bptree_remove(struct bptree* tree, int key) {
+  assert(tree);
+  if (tree->root == NULL || !remove_rec(tree->root, key)) {
+    return 0;
+  }
+  tree->size--;
+
+  /*
+   * Shrink the tree when the root runs out of keys.
+   */
+  struct bptree_node* root = tree->root;
+  if (root->is_leaf && root->n == 0) {
+    free(root);
+    tree->root = NULL;
+    tree->height = -1;
+  } else if (!root->is_leaf && root->n == 0) {
+    tree->root = ((struct bptree_inner*)root)->children[0];
+    free(root);
+    tree->height--;
+  }
+  return 1;
+}
+
+/*
+ * This function finds the first key/value pair (in key order) whose key is
+ * greater than or equal to `key`.  It returns the leaf containing that pair
+ * and stores the pair's position within the leaf in `*pos`, or returns NULL
+ * if every key in the tree is less than `key`.
+ *
+ * Params:
+ *   tree - the B+-tree to search.  May not be NULL.
+ *   key - the lower bound to search for.
+ *   pos - the address at which to store the position of the pair within the
+ *     returned leaf.  May not be NULL.
+ */
+struct bptree_leaf* bptree_lower_bound(struct bptree* tree, int key,
+    int* pos) {
+  assert(tree && pos);
+  struct bptree_node* node = tree->root;
+  if (node == NULL) {
+    return NULL;
+  }
+  while (!node->is_leaf) {
+    struct bptree_inner* inner = (struct bptree_inner*)node;
+    node = inner->children[lower_bound(inner->keys, inner->hdr.n, key)];
+  }
+  struct bptree_leaf* leaf = (struct bptree_leaf*)node;
+  *pos = lower_bound(leaf->keys, leaf->hdr.n, key);
+  if (*pos == leaf->hdr.n) {
+    leaf = leaf->next;
+    *pos = 0;
+  }
+  return leaf;
+}
+
+/*
+ * These functions give read access to a leaf returned by
+ * bptree_lower_bound(): the number of pairs it holds, the key and value at a
+ * given position, and the leaf holding the next larger keys (or NULL).
+ */
+int bptree_leaf_count(struct bptree_leaf* leaf) {
+  return leaf->hdr.n;
+}
+
+int bptree_leaf_key(struct bptree_leaf* leaf, int pos) {
+  return leaf->keys[pos];
+}
+
+void* bptree_leaf_value(struct bptree_leaf* leaf, int pos) {
+  return leaf->values[pos];
+}
+
+struct bptree_leaf* bptree_leaf_next(struct bptree_leaf* leaf) {
+  return leaf->next;
+}
+
+/*
+ * This function returns the value associated with the first pair (in key
+ * order) with a given key in a B+-tree, or NULL if the key is not present.
+ *
+ * Params:
+ *   tree - the B+-tree to search.  May not be NULL.
+ *   key - the key whose value is to be returned.
+ */
+void* bptree_get(struct bptree* tree, int key) {
+  int pos;
+  struct bptree_leaf* leaf = bptree_lower_bound(tree, key, &pos);
+  if (leaf == NULL || leaf->keys[pos] != key) {
+    return NULL;
+  }
+  return leaf->values[pos];
+}
+
+/*
+ * This function computes the sum of all keys in a B+-tree between `lower`
+ * and `upper` (both inclusive).  After a single descent to the first key in
+ * the range, it scans the linked leaves sequentially.
+ *
+ * Params:
+ *   tree - the B+-tree within which to compute a range sum.  May not be NULL.
+ *   lower - the inclusive lower bound of the range.
+ *   upper - the inclusive upper bound of the range.
+ */
+long long bptree_range_sum(struct bptree* tree, int lower, int upper) {
+  long long sum = 0;
+  int pos;
+  struct bptree_leaf* leaf = bptree_lower_bound(tree, lower, &pos);
+  while (leaf != NULL) {
+    for (; pos < leaf->hdr.n; pos++) {
+      if (leaf->keys[pos] > upper) {
+        return sum;
+      }
+      sum += leaf->keys[pos];
+    }
+    leaf = leaf->next;
+    pos = 0;
+  }
+  return sum;
+}
@@ -0,0 +1,47 @@
+/*
+ * This file contains the definition of the interface for a B+-tree that can
+ * be used as a cache-conscious backend for the binary search tree interface
+ * in bst.h.  You can find descriptions of the B+-tree functions, including
+ * their parameters and their return values, in bptree.c.
+ */
+
+#ifndef __BPTREE_H
+#define __BPTREE_H
+
+/*
+ * Structure used to represent a B+-tree.
+ */
+struct bptree;
+
+/*
+ * Structure used to represent a B+-tree leaf node.  Leaves are linked in key
+ * order, so this is also what an in-order scan walks through.
+ */
+struct bptree_leaf;
+
+/*
+ * B+-tree interface function prototypes.  Refer to bptree.c for
+ * documentation about each of these functions.
+ */
+struct bptree* bptree_create();
+void bptree_free(struct bptree* tree);
+int bptree_size(struct bptree* tree);
+int bptree_height(struct bptree* tree);
+void bptree_insert(struct bptree* tree, int key, void* value);
+int bptree_upsert(struct bptree* tree, int key, void* value, void** old);
+int bptree_remove(struct bptree* tree, int key);
+void* bptree_get(struct bptree* tree, int key);
+long long bptree_range_sum(struct bptree* tree, int lower, int upper);
+
+/*
+ * B+-tree leaf scanning prototypes, used to iterate over the tree in key
+ * order.  Refer to bptree.c for documentation about each of these functions.
+ */
+struct bptree_leaf* bptree_lower_bound(struct bptree* tree, int key,
+  int* pos);
+int bptree_leaf_count(struct bptree_leaf* leaf);
+int bptree_leaf_key(struct bptree_leaf* leaf, int pos);
+void* bptree_leaf_value(struct bptree_leaf* leaf, int pos);
+struct bptree_leaf* bptree_leaf_next(struct bptree_leaf* leaf);
+
+#endif
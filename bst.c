@@ -10,9 +10,16 @@
  */
 
 #include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <pthread.h>
 
 #include "bst.h"
-#include "stack.h"
+#include "bptree.h"
+#include "cbst.h"
+#include "frozen.h"
+#include "epoch.h"
+#include "forkjoin.h"
 #include <assert.h>
 
 /*
@@ -23,300 +30,3009 @@
  * node.  Nodes in the BST should be ordered based on this `key` field.  The
  * `value` field stores data associated with the key.
  *
- * You should not modify this structure.
+ * The `size` field holds the number of nodes in the subtree rooted at this
+ * node (including the node itself) and is kept up to date in every mode.  It
+ * lets bst_size() run in constant time and bst_select()/bst_rank() run in
+ * time proportional to the height of the tree.  Likewise, the `sum` field
+ * holds the sum of all keys in the subtree rooted at this node as a 64-bit
+ * integer, which lets bst_range_sum() run in time proportional to the height
+ * of the tree.
+ *
+ * The `height` field is only maintained for trees created in BST_BALANCED
+ * and BST_CONCURRENT modes, where it holds the height of the subtree rooted
+ * at this node (a leaf has height 0).  It is used to keep the tree
+ * AVL-balanced.
+ *
+ * The `seq` field is only used in BST_CONCURRENT mode, where it records the
+ * write during which the node was created (see node_own()).  It fits in the
+ * padding after `key`, so it doesn't make nodes any larger.
  */
 struct bst_node {
   int key;
+  unsigned int seq;
   void* value;
   struct bst_node* left;
   struct bst_node* right;
+  int size;
+  int height;
+  long long sum;
+};
+
+
+/*
+ * Nodes are not allocated individually with malloc().  Instead, each BST owns
+ * a pool that carves nodes out of large contiguous chunks.  Chunks start out
+ * at BST_POOL_MIN_CHUNK nodes and double in size up to BST_POOL_MAX_CHUNK
+ * nodes, so even a tree with tens of millions of nodes is backed by only a
+ * few dozen chunks.
+ */
+#define BST_POOL_MIN_CHUNK 1024
+#define BST_POOL_MAX_CHUNK (1 << 20)
+
+/*
+ * This structure represents a single chunk of nodes within a pool.  Chunks
+ * are kept in a singly-linked list so they can all be released at once.
+ */
+struct bst_chunk {
+  struct bst_chunk* next;
+  struct bst_node nodes[];
 };
 
+/*
+ * This structure represents a node pool.  Nodes released by bst_remove() are
+ * pushed onto `free_list` (linked through their `left` fields) and handed out
+ * again before any fresh node is carved from the current chunk.  `used` and
+ * `capacity` track how much of the most recently allocated chunk (the head of
+ * `chunks`) has been handed out.  A pool may be shared by several trees
+ * (see bst_split()), and `refs` counts the trees using it.  When operation
+ * counters are kept (see bst_stats()), `allocs` and `frees` count the nodes
+ * handed out and back.
+ */
+struct bst_pool {
+  struct bst_chunk* chunks;
+  struct bst_node* free_list;
+  int used;
+  int capacity;
+  int refs;
+#ifdef BST_STATS
+  unsigned long long allocs;
+  unsigned long long frees;
+#endif
+};
 
 /*
- * This structure represents an entire BST.  It specifically contains a
- * reference to the root node of the tree.
+ * This structure represents an entire BST.  It contains a reference to the
+ * root node of the tree, the mode the tree was created in (one of the BST_*
+ * modes defined in bst.h), the `policy` it applies to duplicate keys
+ * (BST_UNIQUE, BST_MULTI or 0 for neither) and the pool its nodes are
+ * allocated from.  Trees
+ * created in BST_BPTREE mode keep their data in the B+-tree `bpt` instead,
+ * and trees created in BST_COMPACT mode in the compact tree `cbt` (see
+ * cbst.c); neither kind has a root or pool.
+ *
+ * Trees created in BST_CONCURRENT mode also have a `lock` that serializes
+ * writers, an epoch domain `epoch` through which replaced nodes are retired
+ * (see epoch.c), a counter `write_seq` of the writes made so far, and an
+ * array `unlinked` of the nodes the current write has replaced.  Their root
+ * is always read and written atomically.  In every other mode, `epoch`
+ * is NULL.
  *
- * You should not modify this structure.
+ * BST_CONCURRENT trees can also have snapshots (see bst_snapshot()), which
+ * are themselves represented by a `struct bst` whose `source` is the tree
+ * they were taken from (`source` is NULL in every other tree).  A tree keeps
+ * its live snapshots in a list starting at `snapshots` and linked through
+ * their `next` fields.  `version` counts the writes made to a tree, and a
+ * snapshot's `version` is the number of writes its tree had made when it was
+ * taken.  `snap_seq` is the value of `write_seq` when the newest snapshot
+ * was taken.  Nodes replaced while an older snapshot may still see them wait
+ * in `deferred` until every such snapshot has been released.
+ *
+ * When bst.c is compiled with BST_STATS defined, every tree also keeps its
+ * operation counters in `stats` (see bst_stats()).
  */
 struct bst {
   struct bst_node* root;
+  int mode;
+  int policy;
+  struct bst_pool* pool;
+  struct bptree* bpt;
+  struct cbst* cbt;
+  struct epoch* epoch;
+  unsigned int write_seq;
+  pthread_mutex_t lock;
+  struct bst* source;
+  struct bst* snapshots;
+  struct bst* next;
+  unsigned long long version;
+  unsigned int snap_seq;
+  struct bst_deferred* deferred;
+  int deferred_first;
+  int deferred_n;
+  int deferred_cap;
+  struct bst_node** unlinked;
+  int unlinked_n;
+  int unlinked_cap;
+#ifdef BST_STATS
+  struct bst_stats stats;
+#endif
+};
+
+/*
+ * Adds `n` to an operation counter.  Counters only exist when bst.c is
+ * compiled with BST_STATS defined; otherwise STAT_ADD() expands to nothing
+ * and its arguments are never evaluated, so uninstrumented builds pay
+ * nothing for them.  Readers of a BST_CONCURRENT tree update its counters
+ * concurrently, so they are updated with relaxed atomic adds.  STAT_ONLY()
+ * likewise keeps a statement only in instrumented builds.
+ */
+#ifdef BST_STATS
+#define STAT_ADD(counter, n) \
+  ((void)__atomic_fetch_add(&(counter), (n), __ATOMIC_RELAXED))
+#define STAT_ONLY(stmt) stmt
+#else
+#define STAT_ADD(counter, n) ((void)0)
+#define STAT_ONLY(stmt)
+#endif
+
+/*
+ * This structure represents a node that was replaced in the write numbered
+ * `version`, and that snapshots taken before that write may still see.
+ */
+struct bst_deferred {
+  struct bst_node* node;
+  unsigned long long version;
 };
 
+/*
+ * This function allocates and initializes a new, empty node pool.
+ */
+static struct bst_pool* bst_pool_create() {
+  struct bst_pool* pool = malloc(sizeof(struct bst_pool));
+  pool->chunks = NULL;
+  pool->free_list = NULL;
+  pool->used = 0;
+  pool->capacity = 0;
+  pool->refs = 1;
+#ifdef BST_STATS
+  pool->allocs = 0;
+  pool->frees = 0;
+#endif
+  return pool;
+}
+
+/*
+ * This function frees a node pool along with every node ever allocated from
+ * it, with one call to free() per chunk rather than one per node.
+ */
+static void bst_pool_free(struct bst_pool* pool) {
+  struct bst_chunk* next, * curr = pool->chunks;
+  while (curr != NULL) {
+    next = curr->next;
+    free(curr);
+    curr = next;
+  }
+  free(pool);
+}
+
+/*
+ * This function returns an uninitialized node from a pool, recycling a
+ * previously released node if there is one and otherwise carving one out of
+ * the current chunk (allocating a new, larger chunk if that one is full).
+ */
+static struct bst_node* bst_pool_alloc(struct bst_pool* pool) {
+  STAT_ADD(pool->allocs, 1);
+  struct bst_node* node = pool->free_list;
+  if (node != NULL) {
+    pool->free_list = node->left;
+    return node;
+  }
+  if (pool->used == pool->capacity) {
+    int capacity = pool->capacity ? pool->capacity * 2 : BST_POOL_MIN_CHUNK;
+    if (capacity > BST_POOL_MAX_CHUNK) {
+      capacity = BST_POOL_MAX_CHUNK;
+    }
+    struct bst_chunk* chunk = malloc(sizeof(struct bst_chunk)
+      + capacity * sizeof(struct bst_node));
+    chunk->next = pool->chunks;
+    pool->chunks = chunk;
+    pool->used = 0;
+    pool->capacity = capacity;
+  }
+  return &pool->chunks->nodes[pool->used++];
+}
+
+/*
+ * This function returns a node to its pool so it can be reused by a later
+ * allocation.  The node's memory is not handed back to the system until the
+ * whole pool is freed.
+ */
+static void bst_pool_release(struct bst_pool* pool, struct bst_node* node) {
+  STAT_ADD(pool->frees, 1);
+  node->left = pool->free_list;
+  pool->free_list = node;
+}
+
+/*
+ * This function returns a block of `n` consecutive, uninitialized nodes from
+ * a pool.  The block gets a chunk of its own, which becomes the pool's
+ * current (full) chunk, so later allocations start a new chunk after it.
+ */
+static struct bst_node* bst_pool_alloc_block(struct bst_pool* pool, int n) {
+  STAT_ADD(pool->allocs, n);
+  struct bst_chunk* chunk = malloc(sizeof(struct bst_chunk)
+    + n * sizeof(struct bst_node));
+  chunk->next = pool->chunks;
+  pool->chunks = chunk;
+  pool->used = n;
+  pool->capacity = n;
+  return chunk->nodes;
+}
+
+/*
+ * This function moves every chunk and released node of the pool `from` into
+ * the pool `into`, which keeps its current chunk, and frees `from`.  Nodes
+ * allocated from either pool may then be released to `into`.  The part of
+ * the current chunk of `from` that was never handed out is not used again.
+ * The trees that used `from` must be switched over to `into` by the caller.
+ */
+static void bst_pool_merge(struct bst_pool* into, struct bst_pool* from) {
+  if (from->chunks != NULL) {
+    if (into->chunks == NULL) {
+      into->chunks = from->chunks;
+      into->used = from->used;
+      into->capacity = from->capacity;
+    } else {
+      struct bst_chunk* last = from->chunks;
+      while (last->next != NULL) {
+        last = last->next;
+      }
+      last->next = into->chunks->next;
+      into->chunks->next = from->chunks;
+    }
+  }
+  if (from->free_list != NULL) {
+    struct bst_node* last = from->free_list;
+    while (last->left != NULL) {
+      last = last->left;
+    }
+    last->left = into->free_list;
+    into->free_list = from->free_list;
+  }
+#ifdef BST_STATS
+  into->allocs += from->allocs;
+  into->frees += from->frees;
+#endif
+  free(from);
+}
+
+/*
+ * Reclaim function for the epoch domain of a BST_CONCURRENT tree, which hands
+ * retired nodes back to the tree's pool.  It is only ever called by a writer
+ * holding the tree's lock (or by bst_free()), so the pool needs no locking of
+ * its own.
+ */
+static void bst_pool_reclaim(void* pool, void* node) {
+  bst_pool_release(pool, node);
+}
+
 /*
  * This function should allocate and initialize a new, empty, BST and return
- * a pointer to it.
+ * a pointer to it.  The tree is created in BST_PLAIN mode.
+ */
+struct bst* bst_create()
+{
+  return bst_create_mode(BST_PLAIN);
+}
+
+/*
+ * This function allocates and initializes a new, empty BST that operates in
+ * the specified mode and returns a pointer to it.
+ *
+ * Params:
+ *   mode - one of the BST_* modes defined in bst.h.  BST_PLAIN trees never
+ *     rebalance, so their shape depends entirely on insertion order.
+ *     BST_BALANCED trees are kept AVL-balanced by bst_insert() and
+ *     bst_remove(), so their height stays O(log n) for any insertion order.
+ *     BST_BPTREE trees store their keys in a cache-conscious B+-tree (see
+ *     bptree.c) rather than in binary nodes.  BST_CONCURRENT trees are
+ *     AVL-balanced trees that any number of threads may read while other
+ *     threads write them (see "Concurrent access" below).  BST_COMPACT
+ *     trees are weight-balanced trees whose nodes live in one array and
+ *     link to their children by 32-bit index (see cbst.c), which roughly
+ *     halves the memory each key takes.  BST_SPLAY trees move every key
+ *     they look up to the root (see "Self-adjusting trees" below), so keys
+ *     that are looked up often stay cheap to find.
+ *
+ *     The mode may be combined with BST_UNIQUE, in which case inserting a
+ *     key that is already present replaces its value in place (see
+ *     bst_upsert()), or, in BST_PLAIN and BST_BALANCED mode, with BST_MULTI,
+ *     in which case it adds the value to those the key's node already holds
+ *     (see "Multi-value nodes" below).
  */
-struct bst* bst_create(int val) 
+struct bst* bst_create_mode(int mode)
 {
+  int policy = mode & (BST_UNIQUE | BST_MULTI);
+  mode &= ~(BST_UNIQUE | BST_MULTI);
+  assert(mode == BST_PLAIN || mode == BST_BALANCED || mode == BST_BPTREE
+    || mode == BST_CONCURRENT || mode == BST_COMPACT || mode == BST_SPLAY);
+  assert(policy != (BST_UNIQUE | BST_MULTI));
+  assert(policy != BST_MULTI || mode == BST_PLAIN || mode == BST_BALANCED);
   struct bst* tree = malloc(sizeof(struct bst));
   tree->root = NULL;
+  tree->mode = mode;
+  tree->policy = policy;
+  tree->pool = NULL;
+  tree->bpt = NULL;
+  tree->cbt = NULL;
+  tree->epoch = NULL;
+  tree->write_seq = 0;
+  tree->source = NULL;
+  tree->snapshots = NULL;
+  tree->next = NULL;
+  tree->version = 0;
+  tree->snap_seq = 0;
+  tree->deferred = NULL;
+  tree->deferred_first = 0;
+  tree->deferred_n = 0;
+  tree->deferred_cap = 0;
+  tree->unlinked = NULL;
+  tree->unlinked_n = 0;
+  tree->unlinked_cap = 0;
+#ifdef BST_STATS
+  memset(&tree->stats, 0, sizeof(struct bst_stats));
+#endif
+  if(mode == BST_BPTREE)
+  {
+    tree->bpt = bptree_create();
+  }
+  else if(mode == BST_COMPACT)
+  {
+    tree->cbt = cbst_create();
+  }
+  else
+  {
+    tree->pool = bst_pool_create();
+  }
+  if(mode == BST_CONCURRENT)
+  {
+    tree->epoch = epoch_create(bst_pool_reclaim, tree->pool);
+    pthread_mutex_init(&tree->lock, NULL);
+  }
   return tree;
 }
 
+static void snapshot_release(struct bst* snap);
+static void free_values(struct bst_node* node);
+static void release_nodes(struct bst* bst, struct bst_node* node);
+
 /*
  * This function should free the memory associated with a BST.  While this
  * function should up all memory used in the BST itself, it should not free
  * any memory allocated to the pointer values stored in the BST.  This is the
- * responsibility of the caller.
+ * responsibility of the caller.  All nodes live in the tree's pool, so they
+ * are released chunk by chunk without walking the tree, except in BST_MULTI
+ * trees, where each node's array of values is freed first.  If the pool is
+ * shared with other trees (see bst_split()), it outlives this one, and the
+ * tree's nodes are handed back to it one at a time instead.  No other thread
+ * may be using the BST when it is freed, and every snapshot of it must
+ * already have been freed.  Freeing a snapshot releases it (see
+ * bst_snapshot()).
+ *
+ * Params:
+ *   bst - the BST to be destroyed.  May not be NULL.
+ */
+void bst_free(struct bst* bst)
+{
+  if(bst->source != NULL)
+  {
+    snapshot_release(bst);
+    return;
+  }
+  if(bst->mode == BST_CONCURRENT)
+  {
+    assert(bst->snapshots == NULL);
+    epoch_free(bst->epoch);
+    pthread_mutex_destroy(&bst->lock);
+    free(bst->deferred);
+    free(bst->unlinked);
+  }
+  if(bst->mode == BST_BPTREE)
+  {
+    bptree_free(bst->bpt);
+  }
+  else if(bst->mode == BST_COMPACT)
+  {
+    cbst_free(bst->cbt);
+  }
+  else if(--bst->pool->refs > 0)
+  {
+    release_nodes(bst, bst->root);
+  }
+  else
+  {
+    if(bst->policy == BST_MULTI)
+    {
+      free_values(bst->root);
+    }
+    bst_pool_free(bst->pool);
+  }
+  free(bst);
+  return;
+}
+
+/*
+ * Returns the number of nodes in the subtree rooted at `node`.
+ */
+static int node_size(struct bst_node* node) {
+  return node ? node->size : 0;
+}
+
+/*
+ * Returns the sum of the keys in the subtree rooted at `node`.
+ */
+static long long node_sum(struct bst_node* node) {
+  return node ? node->sum : 0;
+}
+
+/*****************************************************************************
+ **
+ ** Iterative traversal
+ **
+ *****************************************************************************/
+
+/*
+ * Every walk over a tree that can't follow a single search path is driven
+ * by an explicit node stack rather than by recursion, since a BST_PLAIN tree
+ * built from sorted keys is as deep as it is large and would overflow the
+ * thread's stack.  A node stack holds the nodes a walk still has to visit,
+ * at most one per level of the tree.  It starts out in `inline_items`,
+ * inside the structure itself (which usually lives on the caller's stack),
+ * and only moves to the heap if the tree is deeper than BST_STACK_INLINE
+ * levels, so walking a balanced tree allocates nothing.
+ */
+#define BST_STACK_INLINE 64
+
+struct node_stack {
+  struct bst_node** items;
+  int top;
+  int capacity;
+  struct bst_node* inline_items[BST_STACK_INLINE];
+};
+
+/*
+ * Initializes an empty node stack.
+ */
+static void stack_init(struct node_stack* stack) {
+  stack->items = stack->inline_items;
+  stack->top = 0;
+  stack->capacity = BST_STACK_INLINE;
+}
+
+/*
+ * Frees the heap buffer of a node stack, if it has one.
+ */
+static void stack_free(struct node_stack* stack) {
+  if (stack->items != stack->inline_items) {
+    free(stack->items);
+  }
+}
+
+/*
+ * Pushes `node` onto a node stack, moving the stack to a larger heap buffer
+ * if it is full.
+ */
+static void stack_push(struct node_stack* stack, struct bst_node* node) {
+  if (stack->top == stack->capacity) {
+    stack->capacity *= 2;
+    if (stack->items == stack->inline_items) {
+      stack->items = malloc(stack->capacity * sizeof(struct bst_node*));
+      memcpy(stack->items, stack->inline_items,
+        stack->top * sizeof(struct bst_node*));
+    } else {
+      stack->items = realloc(stack->items,
+        stack->capacity * sizeof(struct bst_node*));
+    }
+  }
+  stack->items[stack->top++] = node;
+}
+
+/*
+ * Returns the node on top of a non-empty node stack, without popping it.
+ */
+static struct bst_node* stack_peek(struct node_stack* stack) {
+  return stack->items[stack->top - 1];
+}
+
+/*
+ * Pops the node on top of a non-empty node stack and returns it.
+ */
+static struct bst_node* stack_pop(struct node_stack* stack) {
+  return stack->items[--stack->top];
+}
+
+/*
+ * Pushes `node` and its chain of left descendants onto a node stack, leaving
+ * the smallest key of the subtree rooted at `node` on top.  Popping a node
+ * and pushing the left chain of its right child then visits the keys in
+ * order.  The right child of each node pushed is prefetched, since that is
+ * where the walk goes once the node is popped.
+ */
+static void stack_push_left(struct node_stack* stack, struct bst_node* node) {
+  for (; node != NULL; node = node->left) {
+    __builtin_prefetch(node->right);
+    stack_push(stack, node);
+  }
+}
+
+/*
+ * Returns the height of the subtree rooted at `node` (-1 if it is empty).
+ * The walk follows left children where there are any and right children
+ * otherwise, so it goes straight down chains of single children, and only
+ * pushes (and prefetches) the right child of nodes that have two.  Each run
+ * down to a leaf ends at a depth that is a candidate for the height.  The
+ * depth of each pushed node is kept at the same index of `depths`, which
+ * grows along with the node stack.
+ */
+static int node_height(struct bst_node* node) {
+  struct node_stack pending;
+  int inline_depths[BST_STACK_INLINE];
+  int* depths = inline_depths;
+  int depths_cap = BST_STACK_INLINE;
+  int height = -1, depth = 0;
+  stack_init(&pending);
+  while (1) {
+    for (; node != NULL; depth++) {
+      if (node->left != NULL && node->right != NULL) {
+        __builtin_prefetch(node->right);
+        stack_push(&pending, node->right);
+        if (pending.capacity > depths_cap) {
+          int* grown = malloc(pending.capacity * sizeof(int));
+          memcpy(grown, depths, depths_cap * sizeof(int));
+          if (depths != inline_depths) {
+            free(depths);
+          }
+          depths = grown;
+          depths_cap = pending.capacity;
+        }
+        depths[pending.top - 1] = depth + 1;
+      }
+      node = node->left != NULL ? node->left : node->right;
+    }
+    height = depth - 1 > height ? depth - 1 : height;
+    if (pending.top == 0) {
+      break;
+    }
+    depth = depths[pending.top - 1];
+    node = stack_pop(&pending);
+  }
+  if (depths != inline_depths) {
+    free(depths);
+  }
+  stack_free(&pending);
+  return height;
+}
+
+/*****************************************************************************
+ **
+ ** Multi-value nodes (BST_MULTI trees)
+ **
+ *****************************************************************************/
+
+/*
+ * A BST_MULTI tree keeps a single node per key, however many values are
+ * inserted under it, so duplicate keys don't make any search longer.  The
+ * `value` field of each node points to an array of all of the values
+ * inserted under its key, in insertion order.  An array starts out with
+ * room for BST_VALUES_MIN values and doubles in capacity whenever it fills
+ * up.  Functions that report one value per key (bst_get(), bst_select(),
+ * iterators and bst_freeze()) report the first value inserted, while
+ * bst_count() and bst_get_all() see all of them.  Since every key occupies
+ * a single node, bst_size(), bst_select(), bst_rank() and the range sums
+ * count each key once, and bst_remove() removes a key along with all of its
+ * values.
+ */
+#define BST_VALUES_MIN 2
+
+struct bst_values {
+  int n;
+  int capacity;
+  void* items[];
+};
+
+/*
+ * Returns a new value array holding just `value`.
+ */
+static struct bst_values* values_create(void* value) {
+  struct bst_values* values = malloc(sizeof(struct bst_values)
+    + BST_VALUES_MIN * sizeof(void*));
+  values->n = 1;
+  values->capacity = BST_VALUES_MIN;
+  values->items[0] = value;
+  return values;
+}
+
+/*
+ * Appends `value` to a value array, growing the array if it is full, and
+ * returns the array, which may have moved.
+ */
+static struct bst_values* values_append(struct bst_values* values,
+    void* value) {
+  if (values->n == values->capacity) {
+    values->capacity *= 2;
+    values = realloc(values, sizeof(struct bst_values)
+      + values->capacity * sizeof(void*));
+  }
+  values->items[values->n++] = value;
+  return values;
+}
+
+/*
+ * Appends every value of the array `second` to the array `first`, frees
+ * `second`, and returns `first`, which may have moved.
+ */
+static struct bst_values* values_concat(struct bst_values* first,
+    struct bst_values* second) {
+  if (first->n + second->n > first->capacity) {
+    while (first->n + second->n > first->capacity) {
+      first->capacity *= 2;
+    }
+    first = realloc(first, sizeof(struct bst_values)
+      + first->capacity * sizeof(void*));
+  }
+  memcpy(&first->items[first->n], second->items, second->n * sizeof(void*));
+  first->n += second->n;
+  free(second);
+  return first;
+}
+
+/*
+ * Returns the value that `node` reports for its key in a tree with the given
+ * duplicate key policy: the node's value, or the first of its values in a
+ * BST_MULTI tree.
+ */
+static void* node_value(int policy, struct bst_node* node) {
+  if (policy == BST_MULTI) {
+    return ((struct bst_values*)node->value)->items[0];
+  }
+  return node->value;
+}
+
+/*
+ * Frees the value array of every node in the subtree rooted at `node`.  Left
+ * children wait on a node stack while the walk follows right children.
+ */
+static void free_values(struct bst_node* node) {
+  struct node_stack pending;
+  stack_init(&pending);
+  while (node != NULL || pending.top > 0) {
+    if (node == NULL) {
+      node = stack_pop(&pending);
+    }
+    free(node->value);
+    if (node->left != NULL) {
+      stack_push(&pending, node->left);
+    }
+    node = node->right;
+  }
+  stack_free(&pending);
+}
+
+/*****************************************************************************
+ **
+ ** Concurrent access (BST_CONCURRENT mode)
+ **
+ *****************************************************************************/
+
+/*
+ * A BST_CONCURRENT tree is an AVL tree that is never modified in place once
+ * readers can see it.  A writer takes the tree's lock and copies every node
+ * it needs to change (the search path plus any rotated nodes), links the
+ * copies together, and finally publishes the new root with a single atomic
+ * store.  A reader that loaded the old root keeps seeing a complete,
+ * consistent old version of the tree, so readers take no locks and never
+ * wait for writers.  Nodes replaced by a write are retired through the
+ * tree's epoch domain and go back to the pool only once every reader that
+ * might still be looking at them has finished.
+ *
+ * Readers wrap every operation in read_begin()/read_end() and load the root
+ * with bst_root().  In the other modes, these cost next to nothing.
+ */
+static void read_begin(struct bst* bst) {
+  if (bst->epoch != NULL) {
+    epoch_enter(bst->epoch);
+  }
+}
+
+static void read_end(struct bst* bst) {
+  if (bst->epoch != NULL) {
+    epoch_exit(bst->epoch);
+  }
+}
+
+static struct bst_node* bst_root(struct bst* bst) {
+  return __atomic_load_n(&bst->root, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Resets the write counter of every node in the subtree rooted at `node`.
+ * Left children wait on a node stack while the walk follows right children.
+ */
+static void reset_seq(struct bst_node* node) {
+  struct node_stack pending;
+  stack_init(&pending);
+  while (node != NULL || pending.top > 0) {
+    if (node == NULL) {
+      node = stack_pop(&pending);
+    }
+    node->seq = 0;
+    if (node->left != NULL) {
+      stack_push(&pending, node->left);
+    }
+    node = node->right;
+  }
+  stack_free(&pending);
+}
+
+/*
+ * Retires a node that the current write has unlinked from a BST_CONCURRENT
+ * tree.  If a live snapshot may still see the node, that is, if it was
+ * created no later than the write before the newest snapshot was taken, it
+ * is deferred until the snapshots taken before this write are gone.
+ * Otherwise it goes straight to the epoch domain, to be reclaimed once no
+ * reader is looking at it.  (After `write_seq` wraps around, every node
+ * looks old, so nodes are deferred conservatively.)
+ */
+static void node_retire(struct bst* bst, struct bst_node* node) {
+  if (bst->snapshots == NULL || node->seq > bst->snap_seq) {
+    epoch_retire(bst->epoch, node);
+    return;
+  }
+  if (bst->deferred_n == bst->deferred_cap) {
+    bst->deferred_cap = bst->deferred_cap ? 2 * bst->deferred_cap : 64;
+    bst->deferred = realloc(bst->deferred,
+      bst->deferred_cap * sizeof(struct bst_deferred));
+  }
+  bst->deferred[bst->deferred_n].node = node;
+  bst->deferred[bst->deferred_n++].version = bst->version;
+}
+
+/*
+ * These functions bracket a write to a BST.  In BST_CONCURRENT mode,
+ * write_begin() takes the tree's lock and starts a new write, so that nodes
+ * created from here on are recognized as private to this write, and
+ * write_end() publishes `root` as the new root, retires the nodes the write
+ * unlinked, and releases the lock.  On the (rare) occasion that the write
+ * counter wraps around, every node's counter is reset so that no old node
+ * can be mistaken for a new one.
+ */
+static void write_begin(struct bst* bst) {
+  if (bst->mode != BST_CONCURRENT) {
+    return;
+  }
+  pthread_mutex_lock(&bst->lock);
+  bst->version++;
+  if (++bst->write_seq == 0) {
+    reset_seq(bst->root);
+    bst->write_seq = 1;
+    bst->snap_seq = 0;
+  }
+}
+
+static void write_end(struct bst* bst, struct bst_node* root) {
+  __atomic_store_n(&bst->root, root, __ATOMIC_RELEASE);
+  if (bst->mode == BST_CONCURRENT) {
+    for (int i = 0; i < bst->unlinked_n; i++) {
+      node_retire(bst, bst->unlinked[i]);
+    }
+    bst->unlinked_n = 0;
+    pthread_mutex_unlock(&bst->lock);
+  }
+}
+
+/*
+ * Records that the current write has replaced or removed `node`.  Readers
+ * can still reach it through the old root until write_end() publishes the
+ * new one, so it is only retired then.
+ */
+static void node_unlink(struct bst* bst, struct bst_node* node) {
+  if (bst->unlinked_n == bst->unlinked_cap) {
+    bst->unlinked_cap = bst->unlinked_cap ? 2 * bst->unlinked_cap : 64;
+    bst->unlinked = realloc(bst->unlinked,
+      bst->unlinked_cap * sizeof(struct bst_node*));
+  }
+  bst->unlinked[bst->unlinked_n++] = node;
+}
+
+/*
+ * Returns the first node with key `key` on the search path from `node`, or
+ * NULL if there is none.
+ */
+static struct bst_node* node_find(struct bst_node* node, int key) {
+  while (node != NULL && node->key != key) {
+    node = key < node->key ? node->left : node->right;
+  }
+  return node;
+}
+
+/*
+ * Releases a snapshot created by bst_snapshot().  Deferred nodes are kept
+ * in the order they were replaced, so once the snapshot is unlinked, every
+ * node replaced no later than the write following the oldest remaining
+ * snapshot can be retired from the front of the list.
+ */
+static void snapshot_release(struct bst* snap) {
+  struct bst* bst = snap->source;
+  pthread_mutex_lock(&bst->lock);
+  struct bst** link = &bst->snapshots;
+  while (*link != snap) {
+    link = &(*link)->next;
+  }
+  *link = snap->next;
+
+  unsigned long long oldest = ULLONG_MAX;
+  for (struct bst* s = bst->snapshots; s != NULL; s = s->next) {
+    oldest = s->version < oldest ? s->version : oldest;
+  }
+  while (bst->deferred_first < bst->deferred_n
+      && bst->deferred[bst->deferred_first].version <= oldest) {
+    epoch_retire(bst->epoch, bst->deferred[bst->deferred_first++].node);
+  }
+  if (bst->deferred_first > bst->deferred_n / 2) {
+    bst->deferred_n -= bst->deferred_first;
+    memmove(bst->deferred, bst->deferred + bst->deferred_first,
+      bst->deferred_n * sizeof(struct bst_deferred));
+    bst->deferred_first = 0;
+  }
+  pthread_mutex_unlock(&bst->lock);
+  free(snap);
+}
+
+/*
+ * Returns a version of `node` that the current write may modify.  In
+ * BST_CONCURRENT mode, this is a fresh copy of `node` unless `node` was
+ * itself created during the current write, and the original is retired.
+ * In every other mode, it is `node` itself.
+ */
+static struct bst_node* node_own(struct bst* bst, struct bst_node* node) {
+  if (bst->mode != BST_CONCURRENT || node->seq == bst->write_seq) {
+    return node;
+  }
+  struct bst_node* copy = bst_pool_alloc(bst->pool);
+  *copy = *node;
+  copy->seq = bst->write_seq;
+  node_unlink(bst, node);
+  return copy;
+}
+
+/*
+ * Calls node_own() on every node on the search path from `node` to the first
+ * node with key `key`, storing the owned version of that node in `*found`,
+ * and returns the new root of the subtree.  The key must be present.  The
+ * recursion depth is bounded by the height of the tree, which is
+ * logarithmic in BST_CONCURRENT mode.
+ */
+static struct bst_node* own_path(struct bst* bst, struct bst_node* node,
+    int key, struct bst_node** found) {
+  node = node_own(bst, node);
+  if (key == node->key) {
+    *found = node;
+  } else if (key < node->key) {
+    node->left = own_path(bst, node->left, key, found);
+  } else {
+    node->right = own_path(bst, node->right, key, found);
+  }
+  return node;
+}
+
+/*
+ * This function should return the total number of elements stored in a given
+ * BST.  Every node records the size of its subtree, so this is just the size
+ * recorded at the root.
+ *
+ * Params:
+ *   bst - the BST whose elements are to be counted.  May not be NULL.
+ */
+int bst_size(struct bst* bst)
+{
+  assert(bst);
+  if(bst->mode == BST_BPTREE)
+  {
+    return bptree_size(bst->bpt);
+  }
+  if(bst->mode == BST_COMPACT)
+  {
+    return cbst_size(bst->cbt);
+  }
+  read_begin(bst);
+  int size = node_size(bst_root(bst));
+  read_end(bst);
+  return size;
+}
+
+/*****************************************************************************
+ **
+ ** Self-adjusting trees (BST_SPLAY mode)
+ **
+ *****************************************************************************/
+
+/*
+ * A BST_SPLAY tree is a splay tree (Sleator and Tarjan, "Self-adjusting
+ * binary search trees", JACM 32(3), 1985): every lookup, insert and removal
+ * ends by rotating the last node it reached up to the root.  Frequently used
+ * keys therefore stay near the root, and the amortized cost of a lookup is
+ * O(log(m / f)) for a key that makes up a fraction f of m accesses, however
+ * the keys were inserted.  Lookups restructure the tree, so a BST_SPLAY tree
+ * may not be read by one thread while another uses it, even if neither of
+ * them writes.
+ *
+ * Splaying is done bottom-up along the search path, which is recorded on a
+ * node stack since a splay tree can be arbitrarily deep.  The `height`
+ * field of nodes is not maintained.
+ */
+
+/*
+ * Rotates `node` above its parent `parent`.  Whatever pointed to `parent`
+ * must then be made to point to `node` by the caller.  `node` takes over
+ * the subtree size and key sum of `parent`, and `parent` loses `node` but
+ * gains `node`'s inner child, so `parent`'s other child, which is off the
+ * search path and likely not in cache, is never read.
+ */
+static void splay_rotate(struct bst_node* node, struct bst_node* parent) {
+  int left = parent->left == node;
+  struct bst_node** down = left ? &parent->left : &parent->right;
+  struct bst_node** inner = left ? &node->right : &node->left;
+  int size = parent->size;
+  long long sum = parent->sum;
+  parent->size += node_size(*inner) - node->size;
+  parent->sum += node_sum(*inner) - node->sum;
+  *down = *inner;
+  *inner = parent;
+  node->size = size;
+  node->sum = sum;
+}
+
+/*
+ * Splays the node on top of `path`, which holds a search path that starts
+ * at the node `*root` points to, up to `*root`, and empties `path`.  Each
+ * step moves the node up two levels, rotating the grandparent first when
+ * the node and its parent are children on the same side (zig-zig) and the
+ * parent first otherwise (zig-zag), with a single rotation (zig) left for
+ * when the node's parent is the root.
+ */
+static void splay(struct node_stack* path, struct bst_node** root) {
+  struct bst_node* node = stack_pop(path);
+  while (path->top > 0) {
+    struct bst_node* parent = stack_pop(path);
+    if (path->top == 0) {
+      splay_rotate(node, parent);
+      break;
+    }
+    struct bst_node* grand = stack_pop(path);
+    int parent_left = grand->left == parent;
+    if (parent_left == (parent->left == node)) {
+      /*
+       * Rotating `parent` above `grand` hands `grand` the inner child of
+       * `parent`, which is off the search path.  Its size and key sum are
+       * those of `parent` less `node`'s subtree and `parent` itself.
+       */
+      struct bst_node** down = parent_left ? &grand->left : &grand->right;
+      struct bst_node** inner = parent_left ? &parent->right : &parent->left;
+      int size = grand->size;
+      long long sum = grand->sum;
+      grand->size -= node->size + 1;
+      grand->sum -= node->sum + parent->key;
+      *down = *inner;
+      *inner = grand;
+      parent->size = size;
+      parent->sum = sum;
+      splay_rotate(node, parent);
+    } else {
+      splay_rotate(node, parent);
+      *(parent_left ? &grand->left : &grand->right) = node;
+      splay_rotate(node, grand);
+    }
+
+    /*
+     * Whatever pointed to `grand` now points to `node`.
+     */
+    if (path->top > 0) {
+      struct bst_node* above = stack_peek(path);
+      *(above->left == grand ? &above->left : &above->right) = node;
+    }
+  }
+  *root = node;
+}
+
+/*
+ * Looks for the first node with key `key` on its search path in a BST_SPLAY
+ * tree and splays it to the root, or splays the last node on the path if
+ * the key is not present.  Returns the node, or NULL if the key is not
+ * present, and stores the number of nodes visited in `*visited`.
+ */
+static struct bst_node* splay_find(struct bst* bst, int key, int* visited) {
+  struct node_stack path;
+  stack_init(&path);
+  struct bst_node* node = bst->root;
+  while (node != NULL) {
+    stack_push(&path, node);
+    if (node->key == key) {
+      break;
+    }
+    node = key < node->key ? node->left : node->right;
+  }
+  *visited = path.top;
+  if (path.top > 0) {
+    splay(&path, &bst->root);
+  }
+  stack_free(&path);
+  return node;
+}
+
+/*
+ * Links the childless node `tree` into a BST_SPLAY tree after every node
+ * with the same key, as in a BST_PLAIN tree, and splays it to the root.
+ */
+static void splay_insert(struct bst* bst, struct bst_node* tree) {
+  struct node_stack path;
+  stack_init(&path);
+  struct bst_node** link = &bst->root;
+  while (*link != NULL) {
+    struct bst_node* node = *link;
+    stack_push(&path, node);
+    node->size++;
+    node->sum += tree->key;
+    link = tree->key < node->key ? &node->left : &node->right;
+  }
+  STAT_ADD(bst->stats.insert.nodes_visited, path.top);
+  STAT_ADD(bst->stats.insert.comparisons, path.top);
+  *link = tree;
+  stack_push(&path, tree);
+  splay(&path, &bst->root);
+  stack_free(&path);
+}
+
+/*
+ * Removes the first node with key `key` on its search path from a BST_SPLAY
+ * tree and returns it, or returns NULL if the key is not present.  The node
+ * is first splayed to the root.  Its left subtree's largest node is then
+ * splayed to the top of that subtree, which leaves it without a right child,
+ * so the root's right subtree can take its place.
+ */
+static struct bst_node* splay_remove(struct bst* bst, int key) {
+  int visited;
+  struct bst_node* node = splay_find(bst, key, &visited);
+  STAT_ADD(bst->stats.remove.nodes_visited, visited);
+  STAT_ADD(bst->stats.remove.comparisons, 2 * visited - (node != NULL));
+  if (node == NULL) {
+    return NULL;
+  }
+  struct bst_node* left = node->left;
+  if (left == NULL) {
+    bst->root = node->right;
+    return node;
+  }
+  struct node_stack path;
+  stack_init(&path);
+  for (struct bst_node* max = left; max != NULL; max = max->right) {
+    stack_push(&path, max);
+  }
+  splay(&path, &left);
+  stack_free(&path);
+  left->right = node->right;
+  left->size += node_size(node->right);
+  left->sum += node_sum(node->right);
+  bst->root = left;
+  return node;
+}
+
+/*****************************************************************************
+ **
+ ** AVL balancing helpers (BST_BALANCED and BST_CONCURRENT modes)
+ **
+ *****************************************************************************/
+
+/*
+ * Returns the height of the subtree rooted at `node`, or -1 for an empty
+ * subtree.  Only meaningful in BST_BALANCED and BST_CONCURRENT modes.
+ */
+static int avl_height(struct bst_node* node) {
+  return node ? node->height : -1;
+}
+
+/*
+ * Recomputes the size, key sum and height of `node` from those of its
+ * children.
+ */
+static void node_update(struct bst_node* node) {
+  int left = avl_height(node->left);
+  int right = avl_height(node->right);
+  node->height = (left > right ? left : right) + 1;
+  node->size = node_size(node->left) + node_size(node->right) + 1;
+  node->sum = node_sum(node->left) + node_sum(node->right) + node->key;
+}
+
+/*
+ * Rotates the subtree rooted at `node` to the left/right and returns the new
+ * root of the subtree.  Rotations preserve the in-order sequence of keys.
+ *
+ * The AVL functions below all take the tree being modified as their first
+ * argument, and call node_own() on every node before changing it.
+ */
+static struct bst_node* avl_rotate_left(struct bst* bst,
+    struct bst_node* node) {
+  node = node_own(bst, node);
+  struct bst_node* pivot = node_own(bst, node->right);
+  node->right = pivot->left;
+  pivot->left = node;
+  node_update(node);
+  node_update(pivot);
+  return pivot;
+}
+
+static struct bst_node* avl_rotate_right(struct bst* bst,
+    struct bst_node* node) {
+  node = node_own(bst, node);
+  struct bst_node* pivot = node_own(bst, node->left);
+  node->left = pivot->right;
+  pivot->right = node;
+  node_update(node);
+  node_update(pivot);
+  return pivot;
+}
+
+/*
+ * Restores the AVL property at `node`, assuming both of its subtrees are
+ * already AVL trees whose heights differ by at most 2.  Returns the new root
+ * of the subtree.  `node` must already be owned by the current write.
+ */
+static struct bst_node* avl_rebalance(struct bst* bst, struct bst_node* node) {
+  int balance = avl_height(node->left) - avl_height(node->right);
+  if (balance > 1) {
+    if (avl_height(node->left->left) < avl_height(node->left->right)) {
+      node->left = avl_rotate_left(bst, node->left);
+    }
+    return avl_rotate_right(bst, node);
+  } else if (balance < -1) {
+    if (avl_height(node->right->right) < avl_height(node->right->left)) {
+      node->right = avl_rotate_right(bst, node->right);
+    }
+    return avl_rotate_left(bst, node);
+  }
+  node_update(node);
+  return node;
+}
+
+/*
+ * Inserts `tree` into the AVL subtree rooted at `ptr` and returns the new
+ * root of that subtree.  Equal keys go to the right, as in BST_PLAIN mode.
+ * Recursion depth is bounded by the (logarithmic) height of the tree.
+ */
+static struct bst_node* avl_insert(struct bst* bst, struct bst_node* ptr,
+    struct bst_node* tree) {
+  if (ptr == NULL) {
+    return tree;
+  }
+  STAT_ADD(bst->stats.insert.nodes_visited, 1);
+  STAT_ADD(bst->stats.insert.comparisons, 1);
+  ptr = node_own(bst, ptr);
+  if (tree->key >= ptr->key) {
+    ptr->right = avl_insert(bst, ptr->right, tree);
+  } else {
+    ptr->left = avl_insert(bst, ptr->left, tree);
+  }
+  return avl_rebalance(bst, ptr);
+}
+
+/*
+ * Detaches the minimum node of the AVL subtree rooted at `ptr`, storing it in
+ * `*min`, and returns the new root of the subtree.
+ */
+static struct bst_node* avl_remove_min(struct bst* bst, struct bst_node* ptr,
+    struct bst_node** min) {
+  STAT_ADD(bst->stats.remove.nodes_visited, 1);
+  if (ptr->left == NULL) {
+    *min = ptr;
+    return ptr->right;
+  }
+  ptr = node_own(bst, ptr);
+  ptr->left = avl_remove_min(bst, ptr->left, min);
+  return avl_rebalance(bst, ptr);
+}
+
+/*
+ * Removes the first node with key `key` encountered on the search path from
+ * the AVL subtree rooted at `ptr`, storing it in `*removed` (or NULL if the
+ * key is not present), and returns the new root of the subtree.  In
+ * BST_CONCURRENT mode, the key must be present, since every node on the
+ * search path is copied.
+ */
+static struct bst_node* avl_remove(struct bst* bst, struct bst_node* ptr,
+    int key, struct bst_node** removed) {
+  if (ptr == NULL) {
+    *removed = NULL;
+    return NULL;
+  }
+  STAT_ADD(bst->stats.remove.nodes_visited, 1);
+  STAT_ADD(bst->stats.remove.comparisons, key == ptr->key ? 1 : 2);
+  if (key == ptr->key) {
+    *removed = ptr;
+    if (ptr->left == NULL) {
+      return ptr->right;
+    } else if (ptr->right == NULL) {
+      return ptr->left;
+    }
+    struct bst_node* succ;
+    struct bst_node* right = avl_remove_min(bst, ptr->right, &succ);
+    succ = node_own(bst, succ);
+    succ->left = ptr->left;
+    succ->right = right;
+    return avl_rebalance(bst, succ);
+  }
+  ptr = node_own(bst, ptr);
+  if (key < ptr->key) {
+    ptr->left = avl_remove(bst, ptr->left, key, removed);
+  } else {
+    ptr->right = avl_remove(bst, ptr->right, key, removed);
+  }
+  return avl_rebalance(bst, ptr);
+}
+
+/*
+ * Returns a new node, taken from the pool of `bst`, that holds `key` and
+ * `value` and has no children.
+ */
+static struct bst_node* node_create(struct bst* bst, int key, void* value) {
+  struct bst_node* node = bst_pool_alloc(bst->pool);
+  node->key = key;
+  node->seq = bst->write_seq;
+  node->value = value;
+  node->right = NULL;
+  node->left = NULL;
+  node->size = 1;
+  node->sum = key;
+  node->height = 0;
+  return node;
+}
+
+/*
+ * Links the childless node `tree` into a BST_PLAIN tree below the last node
+ * on its key's search path.
+ */
+static void plain_insert(struct bst* bst, struct bst_node* tree)
+{
+  struct bst_node* ptr;
+  int key = tree->key;
+  if(bst->root == NULL)
+  {
+    bst->root = tree;
+    return;
+  }
+  else {
+    ptr = bst->root;
+  }
+  //using the while to insert check the key for the left side
+  //and right side
+  //every node on the way down gains one node in its subtree
+  int node = 1;
+  int visited = 0;
+  while(node == 1)
+  {
+    visited++;
+    ptr->size++;
+    ptr->sum += key;
+    if(tree->key >= ptr->key)
+    {
+      if(ptr->right == NULL)
+      {
+        node = 0;
+        ptr->right = tree;
+      }
+      else
+        ptr = ptr->right;
+    }
+    else if(tree->key < ptr->key)
+    {
+      if(ptr->left == NULL)
+      {
+        node = 0;
+        ptr->left = tree;
+      }
+      else
+        ptr = ptr->left;
+    }
+  }
+  STAT_ADD(bst->stats.insert.nodes_visited, visited);
+  STAT_ADD(bst->stats.insert.comparisons, visited);
+}
+
+/*
+ * Stores `value` under `key` in a binary (non-B+-tree) BST without adding a
+ * node for a key that is already present.  If the first node with key `key`
+ * exists, `value` is added to its values in a BST_MULTI tree, and otherwise
+ * replaces its value in place, with the old value stored in `*old` (if
+ * `old` is not NULL).  Only the search path is copied in BST_CONCURRENT
+ * mode, and nothing is allocated in any other mode.  If the key is not
+ * present, a new node is inserted as bst_insert() would.  Returns 1 if the
+ * key was present and 0 otherwise.
+ */
+static int insert_unique(struct bst* bst, int key, void* value, void** old)
+{
+  write_begin(bst);
+  int visited;
+  struct bst_node* node = bst->mode == BST_SPLAY
+    ? splay_find(bst, key, &visited) : node_find(bst->root, key);
+  struct bst_node* root = bst->root;
+  if(node != NULL)
+  {
+    if(bst->mode == BST_CONCURRENT)
+    {
+      root = own_path(bst, root, key, &node);
+    }
+    if(bst->policy == BST_MULTI)
+    {
+      node->value = values_append(node->value, value);
+    }
+    else
+    {
+      if(old != NULL)
+      {
+        *old = node->value;
+      }
+      node->value = value;
+    }
+    write_end(bst, root);
+    return 1;
+  }
+
+  if(bst->policy == BST_MULTI)
+  {
+    value = values_create(value);
+  }
+  struct bst_node* tree = node_create(bst, key, value);
+  if(bst->mode == BST_PLAIN)
+  {
+    plain_insert(bst, tree);
+    root = bst->root;
+  }
+  else if(bst->mode == BST_SPLAY)
+  {
+    splay_insert(bst, tree);
+    root = bst->root;
+  }
+  else
+  {
+    root = avl_insert(bst, root, tree);
+  }
+  write_end(bst, root);
+  return 0;
+}
+
+/*
+ * This function should insert a new key/value pair into the BST.  The key
+ * should be used to order the key/value pair with respect to the other data
+ * stored in the BST.  The value should be stored along with the key, once the
+ * right location in the tree is found.  If the key is already present, the
+ * new pair goes after the existing ones, unless the tree was created with
+ * BST_UNIQUE, in which case `value` replaces the key's value (see
+ * bst_upsert()), or BST_MULTI, in which case it is added to the key's
+ * values.
+ *
+ * Params:
+ *   bst - the BST into which a new key/value pair is to be inserted.  May not
+ *     be NULL.
+ *   key - an integer value that should be used to order the key/value pair
+ *     being inserted with respect to the other data in the BST.
+ *   value - the value being inserted into the BST.  This should be stored in
+ *     the BST alongside the key.  Note that this parameter has type void*,
+ *     which means that a pointer of any type can be passed.
+ */
+void bst_insert(struct bst* bst, int key, void* value)
+{
+  assert(bst->source == NULL);
+  STAT_ADD(bst->stats.insert.calls, 1);
+  if(bst->mode == BST_BPTREE)
+  {
+    if(bst->policy == BST_UNIQUE)
+    {
+      bptree_upsert(bst->bpt, key, value, NULL);
+    }
+    else
+    {
+      bptree_insert(bst->bpt, key, value);
+    }
+    return;
+  }
+  if(bst->mode == BST_COMPACT)
+  {
+    if(bst->policy == BST_UNIQUE)
+    {
+      cbst_upsert(bst->cbt, key, value, NULL);
+    }
+    else
+    {
+      cbst_insert(bst->cbt, key, value);
+    }
+    return;
+  }
+  if(bst->policy != 0)
+  {
+    insert_unique(bst, key, value, NULL);
+    return;
+  }
+
+  //in BST_CONCURRENT mode, the pool may only be touched under the lock
+  write_begin(bst);
+  struct bst_node* tree = node_create(bst, key, value);
+  if(bst->mode == BST_BALANCED || bst->mode == BST_CONCURRENT)
+  {
+    write_end(bst, avl_insert(bst, bst->root, tree));
+    return;
+  }
+  if(bst->mode == BST_SPLAY)
+  {
+    splay_insert(bst, tree);
+    return;
+  }
+  plain_insert(bst, tree);
+  return;
+}
+
+/*
+ * This function stores a value under a key in a BST, replacing the value of
+ * the key in place if the key is already present and inserting a new
+ * key/value pair otherwise.  Replacing a value allocates nothing, except
+ * that a BST_CONCURRENT tree copies the search path to the key as every
+ * write does.  In a tree with duplicate keys, the value of the first pair
+ * with the key (the one bst_get() returns) is replaced.  This is what
+ * bst_insert() does in BST_UNIQUE trees.  Not supported in BST_MULTI trees.
+ *
+ * Params:
+ *   bst - the BST in which to store the value.  May not be NULL.
+ *   key - the key under which to store the value.
+ *   value - the value to store.
+ *   old - if not NULL and the key is already present, the value it replaces
+ *     is stored at this address.
+ *
+ * Return:
+ *   Returns 1 if the key was already present (and its value was replaced),
+ *   or 0 if a new key/value pair was inserted.
+ */
+int bst_upsert(struct bst* bst, int key, void* value, void** old)
+{
+  assert(bst->source == NULL && bst->policy != BST_MULTI);
+  STAT_ADD(bst->stats.insert.calls, 1);
+  if(bst->mode == BST_BPTREE)
+  {
+    return bptree_upsert(bst->bpt, key, value, old);
+  }
+  if(bst->mode == BST_COMPACT)
+  {
+    return cbst_upsert(bst->cbt, key, value, old);
+  }
+  return insert_unique(bst, key, value, old);
+}
+
+
+/*
+ * This function should remove a key/value pair with a specified key from a
+ * given BST.  If multiple values with the same key exist in the tree, this
+ * function should remove the first one it encounters (i.e. the one closest to
+ * the root of the tree).  If the key is not present, the tree is unchanged.
+ * In a BST_MULTI tree, the key is removed along with all of its values.
+ *
+ * Params:
+ *   bst - the BST from which a key/value pair is to be removed.  May not
+ *     be NULL.
+ *   key - the key of the key/value pair to be removed from the BST.
+ */
+void bst_remove(struct bst* bst, int key)
+{
+  assert(bst->source == NULL);
+  STAT_ADD(bst->stats.remove.calls, 1);
+  if(bst->mode == BST_BPTREE)
+  {
+    bptree_remove(bst->bpt, key);
+    return;
+  }
+  if(bst->mode == BST_COMPACT)
+  {
+    cbst_remove(bst->cbt, key);
+    return;
+  }
+  if(bst->mode == BST_BALANCED)
+  {
+    struct bst_node* removed;
+    bst->root = avl_remove(bst, bst->root, key, &removed);
+    if(removed != NULL)
+    {
+      if(bst->policy == BST_MULTI)
+      {
+        free(removed->value);
+      }
+      bst_pool_release(bst->pool, removed);
+    }
+    return;
+  }
+  if(bst->mode == BST_CONCURRENT)
+  {
+    //readers may still be looking at the removed node, so retire it
+    struct bst_node* removed = NULL;
+    write_begin(bst);
+    struct bst_node* root = bst->root;
+    if(node_find(root, key) != NULL)
+    {
+      root = avl_remove(bst, root, key, &removed);
+      node_unlink(bst, removed);
+    }
+    write_end(bst, root);
+    return;
+  }
+  if(bst->mode == BST_SPLAY)
+  {
+    struct bst_node* removed = splay_remove(bst, key);
+    if(removed != NULL)
+    {
+      bst_pool_release(bst->pool, removed);
+    }
+    return;
+  }
+
+  struct bst_node* node_n = bst->root;
+  struct bst_node** link = &bst->root;
+  int visited = 0;
+
+  while(node_n != NULL && key != node_n->key)
+  {
+    visited++;
+    if(key < node_n->key)
+    {
+      link = &node_n->left;
+      node_n = node_n->left;
+    }
+    else
+    {
+      link = &node_n->right;
+      node_n = node_n->right;
+    }
+  }
+  STAT_ADD(bst->stats.remove.nodes_visited, visited + (node_n != NULL));
+  STAT_ADD(bst->stats.remove.comparisons, 2 * visited + (node_n != NULL));
+  if(node_n == NULL)
+  {
+    return;
+  }
+  //walk the same path again, every node above node_n loses one node
+  for(struct bst_node* ptr = bst->root; ptr != node_n;)
+  {
+    ptr->size--;
+    ptr->sum -= key;
+    ptr = key < ptr->key ? ptr->left : ptr->right;
+  }
+  //Check if the left is NULL, the right child (possibly NULL) takes its place
+  if(node_n->left == NULL)
+  {
+    *link = node_n->right;
+  }
+  //Check if the right is NULL, the left child takes its place
+  else if(node_n->right == NULL)
+  {
+    *link = node_n->left;
+  }
+
+  else {
+    struct bst_node* node_s;
+    struct bst_node* parent_s;
+
+    node_s = node_n->right;
+    parent_s = node_n;
+    STAT_ADD(bst->stats.remove.nodes_visited, 1);
+    while(node_s->left != NULL)
+    {
+      STAT_ADD(bst->stats.remove.nodes_visited, 1);
+      parent_s = node_s;
+      node_s = node_s->left;
+    }
+    //node_s moves up, so every node between it and node_n loses it
+    for(struct bst_node* ptr = node_n->right; ptr != node_s; ptr = ptr->left)
+    {
+      ptr->size--;
+      ptr->sum -= node_s->key;
+    }
+      node_s->size = node_n->size - 1;
+      node_s->sum = node_n->sum - key;
+      node_s->left = node_n->left;
+      if(node_s != node_n->right)
+      {
+        parent_s->left = node_s->right;
+        node_s->right = node_n->right;
+      }
+      *link = node_s;
+  }
+  if(bst->policy == BST_MULTI)
+  {
+    free(node_n->value);
+  }
+  bst_pool_release(bst->pool, node_n);
+  return;
+}
+/*
+ * This function should return the value associated with a specified key in a
+ * given BST.  If multiple values with the same key exist in the tree, this
+ * function should return the first one it encounters (i.e. the one closest to
+ * the root of the tree).  If the BST does not contain the specified key, this
+ * function should return NULL.
+ *
+ * Params:
+ *   bst - the BST from which a key/value pair is to be removed.  May not
+ *     be NULL.
+ *   key - the key of the key/value pair whose value is to be returned.
+ *
+ * Return:
+ *   Should return the value associated with the key `key` in `bst` or NULL,
+ *   if the key `key` was not found in `bst`.
+ */
+
+#ifdef BST_STATS
+/*
+ * Records a lookup that visited `visited` nodes in the operation counters of
+ * `bst`.  Every node visited costs one equality comparison, and every node
+ * but the one holding the key (if `found`) one more to pick a child.
+ */
+static void stats_lookup(struct bst* bst, int visited, int found) {
+  STAT_ADD(bst->stats.get.nodes_visited, visited);
+  STAT_ADD(bst->stats.get.comparisons, 2 * visited - found);
+  STAT_ADD(bst->stats.depths[visited < BST_STATS_DEPTHS ? visited
+    : BST_STATS_DEPTHS - 1], 1);
+}
+
+/*
+ * Returns the node holding `key` below `node`, like node_find(), and records
+ * the lookup in the operation counters of `bst`.
+ */
+static struct bst_node* stats_find(struct bst* bst, struct bst_node* node,
+    int key) {
+  int visited = 0;
+  while (node != NULL && node->key != key) {
+    node = key < node->key ? node->left : node->right;
+    visited++;
+  }
+  stats_lookup(bst, visited + (node != NULL), node != NULL);
+  return node;
+}
+#endif
+
+void* bst_get(struct bst* bst, int key) 
+{
+  if(bst == NULL)
+    return NULL;
+
+  STAT_ADD(bst->stats.get.calls, 1);
+  if(bst->mode == BST_BPTREE)
+    return bptree_get(bst->bpt, key);
+  if(bst->mode == BST_COMPACT)
+    return cbst_get(bst->cbt, key);
+  if(bst->mode == BST_SPLAY)
+  {
+    int visited;
+    struct bst_node* found = splay_find(bst, key, &visited);
+    STAT_ONLY(stats_lookup(bst, visited, found != NULL));
+    return found ? found->value : NULL;
+  }
+
+  read_begin(bst);
+#ifdef BST_STATS
+  struct bst_node* node = stats_find(bst, bst_root(bst), key);
+#else
+  struct bst_node* node = node_find(bst_root(bst), key);
+#endif
+  void* value = node ? node_value(bst->policy, node) : NULL;
+  read_end(bst);
+  return value;
+}
+
+/*
+ * Number of lookups that bst_get_batch() keeps in flight at once.  This
+ * should be large enough to cover memory latency with independent work, but
+ * small enough that the in-flight state stays in registers and L1.
+ */
+#define BST_BATCH_WIDTH 16
+
+/*
+ * This function looks up a batch of keys in a BST, storing the value
+ * associated with each key exactly as bst_get() would return it.  Rather
+ * than finishing one lookup before starting the next, it advances up to
+ * BST_BATCH_WIDTH lookups one level at a time in round-robin fashion and
+ * prefetches the next node of each one, so the cache misses of independent
+ * lookups overlap instead of being paid one after another.
+ *
+ * Params:
+ *   bst - the BST in which to look up the keys.  May not be NULL.
+ *   keys - the keys to look up.
+ *   n - the number of keys in `keys`.
+ *   values - the array in which the value associated with each key (or NULL
+ *     if a key is not present) is stored.  Must have room for `n` values.
+ */
+void bst_get_batch(struct bst* bst, const int* keys, int n, void** values) {
+  assert(bst);
+  STAT_ADD(bst->stats.get.calls, n);
+  if (bst->mode == BST_BPTREE) {
+    for (int i = 0; i < n; i++) {
+      values[i] = bptree_get(bst->bpt, keys[i]);
+    }
+    return;
+  }
+  if (bst->mode == BST_COMPACT) {
+    for (int i = 0; i < n; i++) {
+      values[i] = cbst_get(bst->cbt, keys[i]);
+    }
+    return;
+  }
+  if (bst->mode == BST_SPLAY) {
+    /*
+     * Each lookup reshapes the tree for the next one, so they can't be
+     * interleaved.
+     */
+    for (int i = 0; i < n; i++) {
+      int visited;
+      struct bst_node* found = splay_find(bst, keys[i], &visited);
+      STAT_ONLY(stats_lookup(bst, visited, found != NULL));
+      values[i] = found ? found->value : NULL;
+    }
+    return;
+  }
+
+  /*
+   * Each slot holds the current node of one in-flight lookup along with the
+   * index of the key it is looking for.  When a lookup finishes, its slot is
+   * refilled with the next key that hasn't been started yet.  When
+   * operation counters are kept, `steps` counts the nodes each lookup has
+   * left behind.
+   */
+  read_begin(bst);
+  struct bst_node* root = bst_root(bst);
+  struct bst_node* nodes[BST_BATCH_WIDTH];
+  int slots[BST_BATCH_WIDTH];
+  STAT_ONLY(int steps[BST_BATCH_WIDTH]);
+  int active = 0, next = 0;
+  while (active < BST_BATCH_WIDTH && next < n) {
+    STAT_ONLY(steps[active] = 0);
+    nodes[active] = root;
+    slots[active++] = next++;
+  }
+
+  while (active > 0) {
+    for (int j = 0; j < active; j++) {
+      struct bst_node* node = nodes[j];
+      int key = keys[slots[j]];
+      if (node != NULL && node->key != key) {
+        node = key < node->key ? node->left : node->right;
+        __builtin_prefetch(node);
+        nodes[j] = node;
+        STAT_ONLY(steps[j]++);
+        continue;
+      }
+
+      /*
+       * This lookup is done, either because it found the key or because it
+       * fell off the tree.  Start a new one in its slot, or shrink the set
+       * of active lookups if there are none left to start.
+       */
+      values[slots[j]] = node ? node_value(bst->policy, node) : NULL;
+      STAT_ONLY(stats_lookup(bst, steps[j] + (node != NULL), node != NULL));
+      if (next < n) {
+        STAT_ONLY(steps[j] = 0);
+        nodes[j] = root;
+        slots[j] = next++;
+      } else {
+        active--;
+        STAT_ONLY(steps[j] = steps[active]);
+        nodes[j] = nodes[active];
+        slots[j] = slots[active];
+        j--;
+      }
+    }
+  }
+  read_end(bst);
+}
+
+
+/*****************************************************************************
+ **
+ ** Bulk construction
+ **
+ *****************************************************************************/
+
+/*
+ * Builds a perfectly balanced tree out of the sorted pairs in positions
+ * [lo, hi) of `keys` and `values`, taking nodes from `block` in order
+ * starting at index `*next`, and returns its root.  Nodes are taken in
+ * pre-order, so every node is immediately followed in memory by its left
+ * child and the nodes near the root, which every search visits, share cache
+ * lines.  The recursion depth is logarithmic in the number of pairs.
+ */
+static struct bst_node* build_sorted(struct bst_node* block, int* next,
+    const int* keys, void** values, int lo, int hi) {
+  if (lo >= hi) {
+    return NULL;
+  }
+  int mid = lo + (hi - lo) / 2;
+  struct bst_node* node = &block[(*next)++];
+  node->key = keys[mid];
+  node->seq = 0;
+  node->value = values ? values[mid] : NULL;
+  node->left = build_sorted(block, next, keys, values, lo, mid);
+  node->right = build_sorted(block, next, keys, values, mid + 1, hi);
+  node_update(node);
+  return node;
+}
+
+/*
+ * This function builds a new BST from arrays of keys and values that are
+ * already sorted by key.  It runs in linear time, which is much faster than
+ * inserting the pairs one at a time, and the resulting tree is perfectly
+ * balanced: the heights of the two subtrees of every node differ by at most
+ * one.  All nodes are allocated as a single contiguous block.  The new tree
+ * is created in BST_BALANCED mode, so it stays balanced under later inserts
+ * and removals.
+ *
+ * Params:
+ *   keys - the keys to store, in ascending (non-decreasing) order.
+ *   values - the value associated with each key in `keys`, or NULL to store
+ *     a NULL value with every key.
+ *   n - the number of pairs.
+ *
+ * Return:
+ *   Returns a pointer to the new BST.
+ */
+struct bst* bst_build_sorted(const int* keys, void** values, int n) {
+  assert(n >= 0);
+  for (int i = 1; i < n; i++) {
+    assert(keys[i - 1] <= keys[i]);
+  }
+  struct bst* bst = bst_create_mode(BST_BALANCED);
+  if (n > 0) {
+    struct bst_node* block = bst_pool_alloc_block(bst->pool, n);
+    int next = 0;
+    bst->root = build_sorted(block, &next, keys, values, 0, n);
+  }
+  return bst;
+}
+
+/*****************************************************************************
+ **
+ ** Order-statistic queries
+ **
+ *****************************************************************************/
+
+/*
+ * This function returns the key with a given rank in a BST, i.e. the `k`-th
+ * smallest key, counting from 0.  It uses the subtree sizes recorded in each
+ * node, so it runs in time proportional to the height of the tree.  When
+ * several nodes share a key, each one occupies its own rank.  B+-tree nodes
+ * do not record subtree sizes, so this is not supported in BST_BPTREE mode.
+ * BST_COMPACT trees record them too (see cbst_select()).
+ *
+ * Params:
+ *   bst - the BST to query.  May not be NULL.
+ *   k - the rank of the key to return.  Must satisfy 0 <= k < bst_size(bst).
+ *   value - if not NULL, the value associated with the selected key is stored
+ *     at this address.
+ *
+ * Return:
+ *   Should return the `k`-th smallest key in `bst`.
+ */
+int bst_select(struct bst* bst, int k, void** value) {
+  assert(bst && bst->mode != BST_BPTREE);
+  if (bst->mode == BST_COMPACT) {
+    return cbst_select(bst->cbt, k, value);
+  }
+  read_begin(bst);
+  struct bst_node* node = bst_root(bst);
+  assert(k >= 0 && k < node_size(node));
+  while (1) {
+    int left = node_size(node->left);
+    if (k < left) {
+      node = node->left;
+    } else if (k > left) {
+      k -= left + 1;
+      node = node->right;
+    } else {
+      break;
+    }
+  }
+  if (value) {
+    *value = node_value(bst->policy, node);
+  }
+  int key = node->key;
+  read_end(bst);
+  return key;
+}
+
+/*
+ * Returns the number of nodes in the subtree rooted at `node` whose keys are
+ * less than `key`, or, if `inclusive` is nonzero, less than or equal to it.
+ */
+static int node_rank(struct bst_node* node, int key, int inclusive) {
+  int rank = 0;
+  while (node != NULL) {
+    if (key < node->key || (key == node->key && !inclusive)) {
+      node = node->left;
+    } else {
+      rank += node_size(node->left) + 1;
+      node = node->right;
+    }
+  }
+  return rank;
+}
+
+/*
+ * This function returns the rank of a key in a BST, i.e. the number of keys
+ * stored in the BST that are strictly less than `key`.  The key itself does
+ * not need to be present in the BST.  It runs in time proportional to the
+ * height of the tree.  Not supported in BST_BPTREE mode.
+ *
+ * Params:
+ *   bst - the BST to query.  May not be NULL.
+ *   key - the key whose rank is to be computed.
+ *
+ * Return:
+ *   Should return the number of keys in `bst` that are less than `key`.
+ */
+int bst_rank(struct bst* bst, int key) {
+  assert(bst && bst->mode != BST_BPTREE);
+  if (bst->mode == BST_COMPACT) {
+    return cbst_rank(bst->cbt, key, 0);
+  }
+  read_begin(bst);
+  int rank = node_rank(bst_root(bst), key, 0);
+  read_end(bst);
+  return rank;
+}
+
+/*****************************************************************************
+ **
+ ** Duplicate keys
+ **
+ *****************************************************************************/
+
+/*
+ * This function returns the number of values stored under a key in a BST.
+ * In a BST_MULTI tree, this is the number of values the key's node holds.
+ * Otherwise, it is the number of key/value pairs with the key, which is
+ * computed from the subtree sizes recorded in each node as the difference
+ * between two ranks, so it takes time proportional to the height of the
+ * tree however many duplicates there are (also in BST_COMPACT mode).  In
+ * BST_BPTREE mode, the pairs are counted one by one.
+ *
+ * Params:
+ *   bst - the BST to query.  May not be NULL.
+ *   key - the key whose values are to be counted.
+ *
+ * Return:
+ *   Returns the number of values stored under `key` in `bst` (0 if the key
+ *   is not present).
+ */
+int bst_count(struct bst* bst, int key) {
+  assert(bst);
+  int count = 0;
+  if (bst->mode == BST_BPTREE) {
+    int pos;
+    struct bptree_leaf* leaf = bptree_lower_bound(bst->bpt, key, &pos);
+    for (; leaf != NULL; leaf = bptree_leaf_next(leaf), pos = 0) {
+      for (; pos < bptree_leaf_count(leaf); pos++, count++) {
+        if (bptree_leaf_key(leaf, pos) != key) {
+          return count;
+        }
+      }
+    }
+    return count;
+  }
+  if (bst->mode == BST_COMPACT) {
+    return cbst_rank(bst->cbt, key, 1) - cbst_rank(bst->cbt, key, 0);
+  }
+
+  read_begin(bst);
+  struct bst_node* root = bst_root(bst);
+  if (bst->policy == BST_MULTI) {
+    struct bst_node* node = node_find(root, key);
+    count = node ? ((struct bst_values*)node->value)->n : 0;
+  } else {
+    count = node_rank(root, key, 1) - node_rank(root, key, 0);
+  }
+  read_end(bst);
+  return count;
+}
+
+/*
+ * This function copies the values stored under a key in a BST, in the order
+ * they were inserted, into an array.  In a BST_MULTI tree, they are copied
+ * straight out of the key's node.  Otherwise, they are collected from the
+ * key/value pairs with the key in key order, as a range iterator would
+ * visit them.
+ *
+ * Params:
+ *   bst - the BST to query.  May not be NULL.
+ *   key - the key whose values are to be copied.
+ *   values - the array into which the values are copied.  May be NULL if
+ *     `max` is 0.
+ *   max - the maximum number of values to copy.
+ *
+ * Return:
+ *   Returns the number of values stored under `key` in `bst`, which may be
+ *   more than `max`, in which case only the first `max` values are copied.
+ */
+int bst_get_all(struct bst* bst, int key, void** values, int max) {
+  assert(bst && max >= 0);
+  int count = 0;
+  if (bst->policy == BST_MULTI) {
+    read_begin(bst);
+    struct bst_node* node = node_find(bst_root(bst), key);
+    if (node != NULL) {
+      struct bst_values* all = node->value;
+      count = all->n;
+      for (int i = 0; i < count && i < max; i++) {
+        values[i] = all->items[i];
+      }
+    }
+    read_end(bst);
+    return count;
+  }
+
+  struct bst_iterator* iter = bst_iterator_create_range(bst, key, key);
+  while (bst_iterator_has_next(iter)) {
+    void* value;
+    bst_iterator_next(iter, &value);
+    if (count < max) {
+      values[count] = value;
+    }
+    count++;
+  }
+  bst_iterator_free(iter);
+  return count;
+}
+
+
+/*****************************************************************************
+ **
+ ** Split and join (BST_PLAIN and BST_BALANCED modes)
+ **
+ *****************************************************************************/
+
+/*
+ * Splitting a tree at a key and joining two trees whose keys don't overlap
+ * both work by relinking the nodes along a single path, so neither copies
+ * or allocates a node.  Since the nodes stay where they are, the trees that
+ * come out of a split share their node pool, and a join merges the pools of
+ * two trees that didn't share one (see bst_join()).
+ */
+
+/*
+ * Hands every node in the subtree rooted at `node` back to the pool of
+ * `bst`, freeing its array of values first in a BST_MULTI tree.  Each node
+ * is released once its children have been pushed onto a node stack.
+ */
+static void release_nodes(struct bst* bst, struct bst_node* node) {
+  struct node_stack pending;
+  stack_init(&pending);
+  while (node != NULL || pending.top > 0) {
+    if (node == NULL) {
+      node = stack_pop(&pending);
+    }
+    if (node->left != NULL) {
+      stack_push(&pending, node->left);
+    }
+    struct bst_node* right = node->right;
+    if (bst->policy == BST_MULTI) {
+      free(node->value);
+    }
+    bst_pool_release(bst->pool, node);
+    node = right;
+  }
+  stack_free(&pending);
+}
+
+/*
+ * Splits the BST_PLAIN subtree rooted at `node` into one holding the keys
+ * less than `key`, stored in `*left`, and one holding the rest, stored in
+ * `*right`.  The walk down the search path for `key` hands each node to the
+ * left or the right tree, hooking it below the node last handed to the same
+ * side, and leaves the path on a node stack.  The sizes and sums of the
+ * nodes on the path are then fixed up from the bottom.
+ */
+static void plain_split(struct bst_node* node, int key,
+    struct bst_node** left, struct bst_node** right) {
+  struct node_stack path;
+  stack_init(&path);
+  while (node != NULL) {
+    stack_push(&path, node);
+    if (node->key < key) {
+      *left = node;
+      left = &node->right;
+      node = node->right;
+    } else {
+      *right = node;
+      right = &node->left;
+      node = node->left;
+    }
+  }
+  *left = NULL;
+  *right = NULL;
+  while (path.top > 0) {
+    node = stack_pop(&path);
+    node->size = node_size(node->left) + node_size(node->right) + 1;
+    node->sum = node_sum(node->left) + node_sum(node->right) + node->key;
+  }
+  stack_free(&path);
+}
+
+/*
+ * Joins the BST_PLAIN subtrees `left` and `right`, where no key in `left` is
+ * greater than any key in `right`, by hooking `right` below the largest key
+ * of `left`.  Returns the root of the joined subtree.
+ */
+static struct bst_node* plain_join(struct bst_node* left,
+    struct bst_node* right) {
+  if (left == NULL || right == NULL) {
+    return left != NULL ? left : right;
+  }
+  struct bst_node* node = left;
+  while (1) {
+    node->size += right->size;
+    node->sum += right->sum;
+    if (node->right == NULL) {
+      break;
+    }
+    node = node->right;
+  }
+  node->right = right;
+  return left;
+}
+
+/*
+ * Joins the AVL subtrees `left` and `right` with the single node `mid`
+ * between them (no key in `left` may be greater than that of `mid`, and no
+ * key in `right` less) and returns the root of the joined AVL subtree.  The
+ * walk goes down the inner edge of the taller subtree until it reaches a
+ * subtree about as tall as the other one, puts `mid` in its place with the
+ * two of them as children, and rebalances on the way back up.  This takes
+ * time proportional to the difference between the heights of the subtrees.
+ */
+static struct bst_node* avl_join(struct bst* bst, struct bst_node* left,
+    struct bst_node* mid, struct bst_node* right) {
+  int hl = avl_height(left), hr = avl_height(right);
+  if (hl > hr + 1) {
+    left->right = avl_join(bst, left->right, mid, right);
+    return avl_rebalance(bst, left);
+  } else if (hr > hl + 1) {
+    right->left = avl_join(bst, left, mid, right->left);
+    return avl_rebalance(bst, right);
+  }
+  mid->left = left;
+  mid->right = right;
+  node_update(mid);
+  return mid;
+}
+
+/*
+ * Splits the AVL subtree rooted at `node` like plain_split(), but keeps both
+ * halves AVL-balanced by joining each node on the search path back together
+ * with the part of its subtree that stays on its side.  The joins along the
+ * path take O(log n) time altogether, as does the recursion.
+ */
+static void avl_split(struct bst* bst, struct bst_node* node, int key,
+    struct bst_node** left, struct bst_node** right) {
+  if (node == NULL) {
+    *left = NULL;
+    *right = NULL;
+    return;
+  }
+  struct bst_node* part;
+  if (node->key < key) {
+    avl_split(bst, node->right, key, &part, right);
+    *left = avl_join(bst, node->left, node, part);
+  } else {
+    avl_split(bst, node->left, key, left, &part);
+    *right = avl_join(bst, part, node, node->right);
+  }
+}
+
+/*
+ * Splits the subtree rooted at `node` of a BST_PLAIN or BST_BALANCED tree
+ * into the keys less than `key` (stored in `*left`) and the rest (stored in
+ * `*right`), and joins two such subtrees back together, as the mode of
+ * `bst` requires.  avl_join2() joins two AVL subtrees by taking the
+ * smallest key of the right one as the middle node.
+ */
+static void node_split(struct bst* bst, struct bst_node* node, int key,
+    struct bst_node** left, struct bst_node** right) {
+  if (bst->mode == BST_PLAIN) {
+    plain_split(node, key, left, right);
+  } else {
+    avl_split(bst, node, key, left, right);
+  }
+}
+
+static struct bst_node* avl_join2(struct bst* bst, struct bst_node* left,
+    struct bst_node* right) {
+  if (left == NULL || right == NULL) {
+    return left != NULL ? left : right;
+  }
+  struct bst_node* mid;
+  right = avl_remove_min(bst, right, &mid);
+  return avl_join(bst, left, mid, right);
+}
+
+static struct bst_node* node_join(struct bst* bst, struct bst_node* left,
+    struct bst_node* right) {
+  if (bst->mode == BST_PLAIN) {
+    return plain_join(left, right);
+  }
+  return avl_join2(bst, left, right);
+}
+
+/*
+ * This function splits a BST in two at a key: every key/value pair whose key
+ * is at least `key` moves to a new tree, which is returned, while `bst`
+ * keeps the rest.  No node is copied; the nodes along the search path for
+ * `key` are relinked, so a split takes time proportional to the height of
+ * the tree.  BST_BALANCED trees stay balanced on both sides.  The new tree
+ * has the same mode and duplicate key policy as `bst`, and shares its node
+ * pool.  Trees that share a pool may be used by only one thread at a time
+ * between them.  Only supported in BST_PLAIN and BST_BALANCED modes.
+ *
+ * Params:
+ *   bst - the BST to split.  May not be NULL.
+ *   key - the smallest key that moves to the new tree.
+ *
+ * Return:
+ *   Returns a new BST holding the pairs of `bst` whose keys are at least
+ *   `key`.  It must be freed with bst_free() (or joined into another tree).
+ */
+struct bst* bst_split(struct bst* bst, int key) {
+  assert(bst && (bst->mode == BST_PLAIN || bst->mode == BST_BALANCED));
+  struct bst* right = bst_create_mode(bst->mode | bst->policy);
+  bst_pool_free(right->pool);
+  right->pool = bst->pool;
+  right->pool->refs++;
+  struct bst_node* root = bst->root;
+  node_split(bst, root, key, &bst->root, &right->root);
+  return right;
+}
+
+/*
+ * Moves every node of the tree `from` into the pool of `into` by rebuilding
+ * the tree as a perfectly balanced one (see bst_build_sorted()) out of a
+ * block of fresh nodes, and hands the old nodes back to the pool of `from`.
+ * This is how bst_join() joins two trees whose pools are both shared with
+ * other trees, so neither pool can be merged into the other.
+ */
+static void move_nodes(struct bst* into, struct bst* from) {
+  int n = node_size(from->root);
+  if (n == 0) {
+    return;
+  }
+  int* keys = malloc(n * sizeof(int));
+  void** values = malloc(n * sizeof(void*));
+  int i = 0;
+  struct node_stack pending;
+  stack_init(&pending);
+  stack_push_left(&pending, from->root);
+  while (pending.top > 0) {
+    struct bst_node* node = stack_pop(&pending);
+    keys[i] = node->key;
+    values[i++] = node->value;
+    stack_push_left(&pending, node->right);
+    bst_pool_release(from->pool, node);
+  }
+  stack_free(&pending);
+
+  struct bst_node* block = bst_pool_alloc_block(into->pool, n);
+  int next = 0;
+  from->root = build_sorted(block, &next, keys, values, 0, n);
+  free(values);
+  free(keys);
+}
+
+/*
+ * Makes the nodes of the tree `from` part of the pool of the tree `into`,
+ * so that they can be linked into `into` (see bst_join()).  If either tree
+ * has a pool of its own, that pool is merged into the other one, and both
+ * trees then share it.  Otherwise, the nodes of `from` are moved.
+ */
+static void share_pool(struct bst* into, struct bst* from) {
+  if (into->pool == from->pool) {
+    return;
+  }
+  if (from->pool->refs == 1) {
+    bst_pool_merge(into->pool, from->pool);
+    from->pool = into->pool;
+    into->pool->refs++;
+  } else if (into->pool->refs == 1) {
+    bst_pool_merge(from->pool, into->pool);
+    into->pool = from->pool;
+    into->pool->refs++;
+  } else {
+    move_nodes(into, from);
+  }
+}
+
+/*
+ * This function joins two BSTs: every key/value pair of `right` moves into
+ * `left`, and `right` is freed.  No key in `left` may be greater than any
+ * key in `right` (nor equal to one, in BST_UNIQUE and BST_MULTI trees).  No
+ * node is copied; the two trees are linked together along a single path,
+ * so a join takes time proportional to the height of the trees.  Both trees
+ * must have the same mode and duplicate key policy.  Only supported in
+ * BST_PLAIN and BST_BALANCED modes.
+ *
+ * Trees created separately have pools of their own, and one of them is
+ * merged into the other.  If both pools are shared with other trees (as
+ * when pieces split off two different trees are joined), the nodes of
+ * `right` are copied into the pool of `left` instead, in linear time.
+ *
+ * Params:
+ *   left - the BST to join into.  May not be NULL.
+ *   right - the BST whose pairs are moved to `left`.  May not be NULL, and
+ *     may not be used again afterwards.
+ */
+void bst_join(struct bst* left, struct bst* right) {
+  assert(left && right && left != right);
+  assert(left->mode == BST_PLAIN || left->mode == BST_BALANCED);
+  assert(right->mode == left->mode && right->policy == left->policy);
+#ifndef NDEBUG
+  if (left->root != NULL && right->root != NULL) {
+    struct bst_node* max = left->root;
+    struct bst_node* min = right->root;
+    for (; max->right != NULL; max = max->right);
+    for (; min->left != NULL; min = min->left);
+    assert(left->policy == 0 ? max->key <= min->key : max->key < min->key);
+  }
+#endif
+
+  share_pool(left, right);
+  left->root = node_join(left, left->root, right->root);
+  right->root = NULL;
+  bst_free(right);
+}
+
+/*
+ * This function removes every key/value pair whose key lies between `lower`
+ * and `upper` (both inclusive) from a BST.  In BST_PLAIN and BST_BALANCED
+ * modes, the range is split off the tree and the rest joined back together
+ * (see bst_split() and bst_join()), so removing k pairs takes time
+ * proportional to the height of the tree plus k, rather than k descents
+ * from the root.  In the other modes, the pairs are removed one at a time.
+ *
+ * Params:
+ *   bst - the BST from which to remove the pairs.  May not be NULL.
+ *   lower - the inclusive lower bound of the keys to remove.
+ *   upper - the inclusive upper bound of the keys to remove.
+ *
+ * Return:
+ *   Returns the number of pairs removed (the number of keys, in a BST_MULTI
+ *   tree).
+ */
+int bst_remove_range(struct bst* bst, int lower, int upper) {
+  assert(bst && bst->source == NULL);
+  if (lower > upper) {
+    return 0;
+  }
+  if (bst->mode == BST_PLAIN || bst->mode == BST_BALANCED) {
+    struct bst_node* below;
+    struct bst_node* range;
+    struct bst_node* above = NULL;
+    node_split(bst, bst->root, lower, &below, &range);
+    if (upper < INT_MAX) {
+      node_split(bst, range, upper + 1, &range, &above);
+    }
+    int removed = node_size(range);
+    release_nodes(bst, range);
+    bst->root = node_join(bst, below, above);
+    return removed;
+  }
+
+  /*
+   * Collect the keys first, since an iterator can't be used on a tree that
+   * is being modified.
+   */
+  int n = 0, capacity = 64;
+  int* keys = malloc(capacity * sizeof(int));
+  struct bst_iterator* iter = bst_iterator_create_range(bst, lower, upper);
+  while (bst_iterator_has_next(iter)) {
+    if (n == capacity) {
+      capacity *= 2;
+      keys = realloc(keys, capacity * sizeof(int));
+    }
+    keys[n++] = bst_iterator_next(iter, NULL);
+  }
+  bst_iterator_free(iter);
+  for (int i = 0; i < n; i++) {
+    bst_remove(bst, keys[i]);
+  }
+  free(keys);
+  return n;
+}
+
+/*****************************************************************************
+ **
+ ** Set operations (BST_PLAIN and BST_BALANCED modes)
+ **
+ *****************************************************************************/
+
+/*
+ * bst_union(), bst_intersect() and bst_difference() combine two trees with
+ * the join-based algorithms of Blelloch, Ferizovic and Sun ("Just Join for
+ * Parallel Ordered Sets", SPAA 2016).  The key at the root of the second
+ * tree splits the first one into the keys less than, equal to and greater
+ * than it; the two sides are combined independently (in parallel, on a
+ * fork-join pool, where both are large) and joined back together around
+ * the middle.  Combining a tree of m keys with one of n >= m keys takes
+ * O(m log(n/m + 1)) work, and the longest chain of dependent steps is
+ * O(log^2 n) long.  Both inputs are consumed, and every node of the result
+ * is a node of one of them.
+ *
+ * The algorithms need the AVL height bound, so BST_PLAIN inputs are first
+ * relinked into perfectly balanced shape, in time linear in the size of
+ * both trees, which outweighs the bound above when one tree is small.  Set operations
+ * on subtrees whose combined size is at most BST_SET_CUTOFF run serially.
+ * Within that cutoff, a union with a subtree less than 1/BST_SET_RATIO the
+ * size of the other inserts its nodes one at a time instead: every split
+ * and join touches nodes off the search path, and the descents are cheaper
+ * in practice.  Above it, even a small tree is split recursively, so that
+ * merging a small delta into a large tree is spread across the pool and
+ * keeps to the bound above.
+ */
+#define BST_SET_CUTOFF 4096
+#define BST_SET_RATIO 4
+
+#define SET_UNION 0
+#define SET_INTERSECT 1
+#define SET_DIFFERENCE 2
+
+/*
+ * This structure holds what every step of a set operation needs: the tree
+ * receiving the result (whose pool and duplicate key policy apply), the
+ * fork-join pool (or NULL to run serially), which operation it is, and a
+ * lock that serializes handing dropped nodes back to the node pool.
+ */
+struct set_op {
+  struct bst* bst;
+  struct fj_pool* pool;
+  int kind;
+  pthread_mutex_t lock;
+};
+
+/*
+ * node_balance() relinks the nodes of the subtree rooted at `node` into a
+ * perfectly balanced subtree holding the same keys in the same order, with
+ * valid heights, and returns its root.  It walks the nodes in order, and
+ * relink() turns the next `n` nodes of the walk into a subtree with a
+ * recursion that is logarithmic in depth.  Each node is taken off the walk,
+ * which moves on to its right subtree, before its links are overwritten, so
+ * the nodes never need to be listed in an array of their own.
+ */
+static struct bst_node* relink(struct node_stack* walk, int n) {
+  if (n == 0) {
+    return NULL;
+  }
+  struct bst_node* left = relink(walk, n / 2);
+  struct bst_node* node = stack_pop(walk);
+  stack_push_left(walk, node->right);
+  node->left = left;
+  node->right = relink(walk, n - n / 2 - 1);
+  node_update(node);
+  return node;
+}
+
+static struct bst_node* node_balance(struct bst_node* node) {
+  struct node_stack walk;
+  stack_init(&walk);
+  int n = node_size(node);
+  stack_push_left(&walk, node);
+  node = relink(&walk, n);
+  stack_free(&walk);
+  return node;
+}
+
+/*
+ * Hands the nodes of the subtree rooted at `node` back to the node pool
+ * (see release_nodes()) on behalf of a set operation, which may be doing the
+ * same on other threads.
+ */
+static void set_drop(struct set_op* op, struct bst_node* node) {
+  if (node != NULL) {
+    pthread_mutex_lock(&op->lock);
+    release_nodes(op->bst, node);
+    pthread_mutex_unlock(&op->lock);
+  }
+}
+
+/*
+ * Merges the single node `b` into the AVL subtree `a` as a union would (see
+ * set_combine() below) and returns the new root of the subtree.  Inserting
+ * it directly touches one path of `a`, where splitting `a` around it would
+ * take it apart and join it back together along that path.
+ */
+static struct bst_node* set_insert(struct set_op* op, struct bst_node* a,
+    struct bst_node* b) {
+  struct bst_node* node = node_find(a, b->key);
+  if (node == NULL || op->bst->policy == 0) {
+    return avl_insert(op->bst, a, b);
+  }
+  if (op->bst->policy == BST_UNIQUE) {
+    node->value = b->value;
+  } else {
+    node->value = values_concat(node->value, b->value);
+    b->value = NULL;
+  }
+  set_drop(op, b);
+  return a;
+}
+
+/*
+ * Merges every node of the AVL subtree `b` into the AVL subtree `a` with
+ * set_insert(), in key order, and returns the new root of the subtree.
+ */
+static struct bst_node* set_insert_all(struct set_op* op, struct bst_node* a,
+    struct bst_node* b) {
+  struct node_stack pending;
+  stack_init(&pending);
+  stack_push_left(&pending, b);
+  while (pending.top > 0) {
+    struct bst_node* node = stack_pop(&pending);
+    stack_push_left(&pending, node->right);
+    node->left = NULL;
+    node->right = NULL;
+    node_update(node);
+    a = set_insert(op, a, node);
+  }
+  stack_free(&pending);
+  return a;
+}
+
+/*
+ * Combines the AVL subtrees `a` and `b` as set operation `op` requires and
+ * returns the root of the resulting AVL subtree.  This is where the
+ * recursion described above happens.
+ */
+static struct bst_node* set_combine(struct set_op* op, struct bst_node* a,
+    struct bst_node* b);
+
+struct set_combine_arg {
+  struct set_op* op;
+  struct bst_node* a;
+  struct bst_node* b;
+  struct bst_node* result;
+};
+
+static void set_combine_task(struct fj_pool* pool, void* arg) {
+  struct set_combine_arg* c = arg;
+  c->result = set_combine(c->op, c->a, c->b);
+}
+
+static struct bst_node* set_combine(struct set_op* op, struct bst_node* a,
+    struct bst_node* b) {
+  if (a == NULL || b == NULL) {
+    if (op->kind == SET_UNION) {
+      return a != NULL ? a : b;
+    }
+    set_drop(op, b);
+    if (op->kind == SET_INTERSECT) {
+      set_drop(op, a);
+      return NULL;
+    }
+    return a;
+  }
+  if (op->kind == SET_UNION
+      && node_size(a) + node_size(b) <= BST_SET_CUTOFF
+      && node_size(b) * BST_SET_RATIO < node_size(a)) {
+    return set_insert_all(op, a, b);
+  }
+
+  /*
+   * Split `a` into the keys less than, equal to and greater than the key at
+   * the root of `b`.  The middle part holds every pair of `a` with that key,
+   * which is at most one pair in BST_UNIQUE and BST_MULTI trees.
+   */
+  int key = b->key;
+  struct bst_node* b_left = b->left;
+  struct bst_node* b_right = b->right;
+  struct bst_node* a_left;
+  struct bst_node* a_mid;
+  struct bst_node* a_right = NULL;
+  avl_split(op->bst, a, key, &a_left, &a_mid);
+  if (key < INT_MAX) {
+    avl_split(op->bst, a_mid, key + 1, &a_mid, &a_right);
+  }
+
+  /*
+   * Where duplicate keys are kept as separate pairs, rotations may have left
+   * copies of `key` in `b_left` too.  A union puts them in the middle, after
+   * those of `a`, so that every pair of `b` comes after the pairs of `a`
+   * with the same key.
+   */
+  struct bst_node* b_mid = NULL;
+  if (op->kind == SET_UNION && op->bst->policy == 0) {
+    avl_split(op->bst, b_left, key, &b_left, &b_mid);
+  }
+
+  struct bst_node* left;
+  struct bst_node* right;
+  if (op->pool != NULL
+      && node_size(a_left) + node_size(b_left) > BST_SET_CUTOFF
+      && node_size(a_right) + node_size(b_right) > BST_SET_CUTOFF) {
+    struct fj_task task;
+    struct set_combine_arg arg = {op, a_left, b_left, NULL};
+    fj_spawn(op->pool, &task, set_combine_task, &arg);
+    right = set_combine(op, a_right, b_right);
+    fj_join(op->pool, &task);
+    left = arg.result;
+  } else {
+    left = set_combine(op, a_left, b_left);
+    right = set_combine(op, a_right, b_right);
+  }
+
+  b->left = NULL;
+  b->right = NULL;
+  if (op->kind == SET_INTERSECT) {
+    set_drop(op, b);
+    return avl_join2(op->bst, avl_join2(op->bst, left, a_mid), right);
+  } else if (op->kind == SET_DIFFERENCE) {
+    set_drop(op, b);
+    set_drop(op, a_mid);
+    return avl_join2(op->bst, left, right);
+  }
+
+  /*
+   * In a union, the root of `b` stays.  In a BST_UNIQUE tree, its value
+   * replaces that of the pair it shares a key with in `a`, and in a
+   * BST_MULTI tree, the values of that pair come first.
+   */
+  if (a_mid != NULL && op->bst->policy == BST_UNIQUE) {
+    set_drop(op, a_mid);
+    a_mid = NULL;
+  } else if (a_mid != NULL && op->bst->policy == BST_MULTI) {
+    b->value = values_concat(a_mid->value, b->value);
+    a_mid->value = NULL;
+    set_drop(op, a_mid);
+    a_mid = NULL;
+  }
+  struct bst_node* mid = avl_join2(op->bst, a_mid, b_mid);
+  return avl_join(op->bst, avl_join2(op->bst, left, mid), b, right);
+}
+
+/*
+ * Runs set operation `kind` on the trees `a` and `b` with `threads` threads,
+ * leaving the result in `a` and freeing `b`.
+ */
+static void set_run(struct bst* a, struct bst* b, int kind, int threads) {
+  assert(a && b && a != b && threads >= 1);
+  assert(a->mode == BST_PLAIN || a->mode == BST_BALANCED);
+  assert(b->mode == a->mode && b->policy == a->policy);
+  share_pool(a, b);
+  if (a->mode == BST_PLAIN) {
+    a->root = node_balance(a->root);
+    b->root = node_balance(b->root);
+  }
+
+  struct set_op op;
+  op.bst = a;
+  op.pool = NULL;
+  op.kind = kind;
+  pthread_mutex_init(&op.lock, NULL);
+
+  /*
+   * A pool's threads are started for this call alone, which takes tens of
+   * microseconds each.  The work grows with the smaller tree, so a pool is
+   * only used when that tree has at least BST_SET_CUTOFF keys per thread.
+   */
+  int smaller = node_size(a->root) < node_size(b->root)
+    ? node_size(a->root) : node_size(b->root);
+  if (threads > 1 && smaller >= BST_SET_CUTOFF * threads) {
+    op.pool = fj_pool_create(threads);
+  }
+  a->root = set_combine(&op, a->root, b->root);
+  if (op.pool != NULL) {
+    fj_pool_free(op.pool);
+  }
+  pthread_mutex_destroy(&op.lock);
+  b->root = NULL;
+  bst_free(b);
+}
+
+/*
+ * This function merges one BST into another: afterwards, `a` holds every
+ * key/value pair that either tree held, and `b` is freed.  The result is
+ * the same as inserting every pair of `b` into `a` (see bst_insert()): in
+ * BST_UNIQUE trees, the value from `b` replaces that from `a` when both
+ * hold a key, in BST_MULTI trees, the values from `b` come after those
+ * from `a`, and otherwise, the pairs of `b` come after the pairs of `a`
+ * with the same key.  See "Set operations" above for how it works.  No node is
+ * copied, unless both trees share their pools with other trees (see
+ * bst_join()).  Only supported in BST_PLAIN and BST_BALANCED modes.
+ * BST_PLAIN trees are rebalanced first, which takes time linear in the size
+ * of both trees, so merging a small tree into a large one is only cheap in
+ * BST_BALANCED mode; a BST_PLAIN result is balanced.
+ *
+ * Params:
+ *   a - the BST to merge into.  May not be NULL.
+ *   b - the BST to merge into `a`.  May not be NULL, and may not be used
+ *     again afterwards.  It must have the same mode and duplicate key
+ *     policy as `a`.
+ *   threads - the number of threads to use, including the calling thread.
+ *     Must be at least 1.  If the smaller tree is too small to repay
+ *     starting the threads, the calling thread does all the work.
+ */
+void bst_union(struct bst* a, struct bst* b, int threads) {
+  set_run(a, b, SET_UNION, threads);
+}
+
+/*
+ * This function keeps the key/value pairs of `a` whose keys are also in `b`
+ * and removes the rest, then frees `b`.  It works like bst_union() and has
+ * the same requirements.  Like bst_union(), it takes time linear in the size
+ * of both trees in BST_PLAIN mode.
+ *
+ * Params:
+ *   a - the BST to filter.  May not be NULL.
+ *   b - the BST whose keys are kept in `a`.  May not be NULL, and may not be
+ *     used again afterwards.
+ *   threads - the number of threads to use, including the calling thread.
+ *     Must be at least 1.
+ */
+void bst_intersect(struct bst* a, struct bst* b, int threads) {
+  set_run(a, b, SET_INTERSECT, threads);
+}
+
+/*
+ * This function removes the key/value pairs of `a` whose keys are in `b`,
+ * then frees `b`.  It works like bst_union() and has the same requirements.
+ * Like bst_union(), it takes time linear in the size of both trees in
+ * BST_PLAIN mode.
+ *
+ * Params:
+ *   a - the BST to filter.  May not be NULL.
+ *   b - the BST whose keys are removed from `a`.  May not be NULL, and may
+ *     not be used again afterwards.
+ *   threads - the number of threads to use, including the calling thread.
+ *     Must be at least 1.
+ */
+void bst_difference(struct bst* a, struct bst* b, int threads) {
+  set_run(a, b, SET_DIFFERENCE, threads);
+}
+
+/*****************************************************************************
+ **
+ ** Persistent snapshots (BST_CONCURRENT mode)
+ **
+ *****************************************************************************/
+
+/*
+ * This function takes a snapshot of a BST_CONCURRENT tree: a read-only
+ * version of the tree as it is now, which later writes to the tree don't
+ * change.  Writes to a BST_CONCURRENT tree never modify a node in place,
+ * but copy the path from the root to the nodes they change (see node_own()),
+ * so a snapshot simply keeps the current root and shares every node with
+ * the tree.  Taking one costs O(1), and while it lives, each write keeps the
+ * O(log n) nodes it replaces around instead of reclaiming them.
+ *
+ * A snapshot can be passed to any function that only reads a BST, such as
+ * bst_get(), bst_range_sum() and bst_iterator_create(), from any number of
+ * threads.  It can't be modified.  Snapshots are released with bst_free(),
+ * in any order, and must all be released before the tree itself is freed.
  *
  * Params:
- *   bst - the BST to be destroyed.  May not be NULL.
+ *   bst - the BST to take a snapshot of.  Must be a BST_CONCURRENT tree
+ *     (not a snapshot).
+ *
+ * Return:
+ *   Returns a new read-only BST holding the key/value pairs `bst` holds now.
  */
-void free_bst_node(struct bst_node* node) 
-{
-  if (node->left == NULL && node->right == NULL) 
-  {
-    free(node);
-  }
-  else if (node->right != NULL) 
-  {
-    free_bst_node(node->right);
-  }
-  else (node->left != NULL);
-  {
-    free_bst_node(node->left);
-  }
-  free(node);
-}
+struct bst* bst_snapshot(struct bst* bst) {
+  assert(bst && bst->mode == BST_CONCURRENT && bst->source == NULL);
+  struct bst* snap = malloc(sizeof(struct bst));
+  memset(snap, 0, sizeof(struct bst));
+  snap->mode = BST_CONCURRENT;
+  snap->policy = bst->policy;
+  snap->source = bst;
 
-void bst_free(struct bst* bst) 
-{
-  free_bst_node(bst->root);
-  free(bst);
-  return;
+  pthread_mutex_lock(&bst->lock);
+  snap->root = bst->root;
+  snap->version = bst->version;
+  snap->next = bst->snapshots;
+  bst->snapshots = snap;
+  bst->snap_seq = bst->write_seq;
+  pthread_mutex_unlock(&bst->lock);
+  return snap;
 }
 
+/*****************************************************************************
+ **
+ ** Operation counters
+ **
+ *****************************************************************************/
+
 /*
- * This function should return the total number of elements stored in a given
- * BST.
+ * This function reports the operation counters of a BST: how many lookups,
+ * inserts and removals it has served and how many key comparisons and node
+ * visits they cost, how many nodes it has allocated and freed, and a
+ * histogram of the depths at which lookups ended.  Counters are only kept
+ * when bst.c is compiled with BST_STATS defined, and count everything since
+ * the tree was created or bst_stats_reset() was last called on it.
+ *
+ * In BST_BPTREE and BST_COMPACT modes, only the number of calls is
+ * counted.  In BST_CONCURRENT mode, removals first look for their key
+ * without counting it, and nodes copied by a write count as allocations,
+ * while nodes retired by a write only count as frees once they are
+ * reclaimed.  In every mode,
+ * bst_upsert() and inserts into BST_UNIQUE and BST_MULTI trees also look
+ * for their key first without counting it.  Each counter may be read while
+ * other threads update it, so the counters of a tree in use are not a
+ * consistent snapshot of one another.
  *
  * Params:
- *   bst - the BST whose elements are to be counted.  May not be NULL.
+ *   bst - the BST whose counters are to be reported.  May not be NULL.
+ *   out - the structure in which the counters are stored.  May not be NULL.
+ *
+ * Return:
+ *   Returns 1 if counters are kept, or 0 (and stores all zeros in `out`) if
+ *   bst.c was compiled without BST_STATS.
  */
-
-int bst_subtree(struct bst_node* root)
-{
-  int size = 1;
-  //number nodes in right tree of root
-  if(root->right != NULL)
-  {
-    size += bst_subtree(root->right);
-  }
-  //number nodes in left tree of root
-  if(root->left != NULL)
-  {
-    size += bst_subtree(root->left);
+int bst_stats(struct bst* bst, struct bst_stats* out) {
+  assert(bst && out);
+#ifdef BST_STATS
+  unsigned long long* from = (unsigned long long*)&bst->stats;
+  unsigned long long* to = (unsigned long long*)out;
+  for (size_t i = 0; i < sizeof(struct bst_stats) / sizeof(*from); i++) {
+    to[i] = __atomic_load_n(&from[i], __ATOMIC_RELAXED);
   }
-return size;
-}
-
-int bst_size(struct bst* bst) 
-{
-  assert(bst);
-  int size = 0;
-  if(bst->root != NULL)
-  {
-    size = bst_subtree(bst->root);
+  if (bst->pool != NULL) {
+    out->allocs = __atomic_load_n(&bst->pool->allocs, __ATOMIC_RELAXED);
+    out->frees = __atomic_load_n(&bst->pool->frees, __ATOMIC_RELAXED);
   }
-  return size;
+  return 1;
+#else
+  memset(out, 0, sizeof(struct bst_stats));
+  return 0;
+#endif
 }
 
 /*
- * This function should insert a new key/value pair into the BST.  The key
- * should be used to order the key/value pair with respect to the other data
- * stored in the BST.  The value should be stored along with the key, once the
- * right location in the tree is found.
+ * This function sets every operation counter of a BST back to zero.  It
+ * does nothing if bst.c was compiled without BST_STATS.
  *
  * Params:
- *   bst - the BST into which a new key/value pair is to be inserted.  May not
- *     be NULL.
- *   key - an integer value that should be used to order the key/value pair
- *     being inserted with respect to the other data in the BST.
- *   value - the value being inserted into the BST.  This should be stored in
- *     the BST alongside the key.  Note that this parameter has type void*,
- *     which means that a pointer of any type can be passed.
+ *   bst - the BST whose counters are to be reset.  May not be NULL.
  */
-void bst_insert(struct bst* bst, int key, void* value) 
-{
-  struct bst_node* ptr;
-  struct bst_node* tree = malloc(sizeof(struct bst_node));
-    
-  tree->key = key;
-  tree->value = value;
-  tree->right = NULL;
-  tree->left = NULL;
-  
-  if(bst->root == NULL)
-  {
-    bst->root = tree;
-    return;
-  }
-  else {
-    ptr = bst->root;
+void bst_stats_reset(struct bst* bst) {
+  assert(bst);
+#ifdef BST_STATS
+  unsigned long long* counters = (unsigned long long*)&bst->stats;
+  for (size_t i = 0; i < sizeof(struct bst_stats) / sizeof(*counters); i++) {
+    __atomic_store_n(&counters[i], 0, __ATOMIC_RELAXED);
   }
-  //using the while to insert check the key for the left side 
-  //and right side
-  int node = 1;
-  while(node == 1)
-  {
-    if(tree->key >= ptr->key)
-    {
-      if(ptr->right == NULL)
-      {
-        node = 0;
-        ptr->right = tree;
-      }
-      else 
-        ptr = ptr->right;
-    }
-    else if(tree->key < ptr->key)
-    {
-      if(ptr->left == NULL)
-      {
-        node = 0;
-        ptr->left = tree;     
-      }
-      else 
-        ptr = ptr->left;
-    }
+  if (bst->pool != NULL) {
+    __atomic_store_n(&bst->pool->allocs, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&bst->pool->frees, 0, __ATOMIC_RELAXED);
   }
-  return;
+#endif
 }
 
+/*****************************************************************************
+ **
+ ** Frozen snapshots
+ **
+ *****************************************************************************/
 
 /*
- * This function should remove a key/value pair with a specified key from a
- * given BST.  If multiple values with the same key exist in the tree, this
- * function should remove the first one it encounters (i.e. the one closest to
- * the root of the tree).
+ * This function creates a frozen, read-only copy of a BST (see frozen.c).
+ * The copy stores the tree's keys in contiguous arrays laid out for fast
+ * searching, so it is a good fit for trees that are built once and then
+ * queried many times.  Later changes to `bst` are not reflected in the
+ * frozen copy, and the two must be freed separately.
  *
  * Params:
- *   bst - the BST from which a key/value pair is to be removed.  May not
- *     be NULL.
- *   key - the key of the key/value pair to be removed from the BST.
+ *   bst - the BST to freeze.  May not be NULL.
+ *
+ * Return:
+ *   Returns a new frozen BST holding the same key/value pairs as `bst`.
  */
-void bst_remove(struct bst* bst, int key) 
-{
-  struct bst_node* node_n = bst->root;
-  struct bst_node* prve = NULL;
+struct bst_frozen* bst_freeze(struct bst* bst) {
+  assert(bst);
+  read_begin(bst);
+  struct bst_node* root = bst_root(bst);
+  int n = bst->mode == BST_BPTREE ? bptree_size(bst->bpt)
+    : bst->mode == BST_COMPACT ? cbst_size(bst->cbt) : node_size(root);
+  int* keys = malloc((n + 1) * sizeof(int));
+  void** values = malloc((n + 1) * sizeof(void*));
+  int i = 0;
 
-  while(node_n != NULL && key != node_n->key)
-  {
-    prve = node_n;
-    if(key < node_n->key)
-    {
-      node_n = node_n->left;
-    }
-    else if (node_n->key < key)
-    {
-      node_n = node_n->right;
-    }
-    else break;
-  }
-  //Check if the node left and right is the NULL
-  if(node_n->left == NULL && node_n->right == NULL)
-  {
-    if(node_n == prve->left)
-    {
-      prve->left = NULL;
+  if (bst->mode == BST_BPTREE) {
+    int pos;
+    struct bptree_leaf* leaf = bptree_lower_bound(bst->bpt, INT_MIN, &pos);
+    for (; leaf != NULL; leaf = bptree_leaf_next(leaf), pos = 0) {
+      for (; pos < bptree_leaf_count(leaf); pos++, i++) {
+        keys[i] = bptree_leaf_key(leaf, pos);
+        values[i] = bptree_leaf_value(leaf, pos);
+      }
     }
-    else
-      prve->right = NULL;
-  }
-  //Check if the left is not NULL and if right node is NULL
-  else if(node_n->left != NULL && node_n->right == NULL)
-  {
-    if(node_n == prve->left)
-    {
-      prve->left = node_n->left;
+  } else if (bst->mode == BST_COMPACT) {
+    struct cbst_iter* iter = cbst_iter_create(bst->cbt, INT_MIN, INT_MAX);
+    for (; cbst_iter_has_next(iter); i++) {
+      keys[i] = cbst_iter_next(iter, &values[i]);
     }
-    else
-      prve->right = node_n->left;
-  }
-  //Check if the right is not NULL and if left node is NULL
-  else if(node_n->left == NULL && node_n->right != NULL)
-  {
-    if(node_n == prve->left)
-    {
-      prve->left = node_n->right;
+    cbst_iter_free(iter);
+  } else {
+    /*
+     * Walk the tree in order, as an iterator would.
+     */
+    struct node_stack pending;
+    stack_init(&pending);
+    stack_push_left(&pending, root);
+    while (pending.top > 0) {
+      struct bst_node* node = stack_pop(&pending);
+      keys[i] = node->key;
+      values[i] = node_value(bst->policy, node);
+      i++;
+      stack_push_left(&pending, node->right);
     }
-    else
-      prve->right = node_n->right;
+    stack_free(&pending);
   }
-  
-  else {
-    struct bst_node* node_s;
-    struct bst_node* parent_s;
+  read_end(bst);
 
-    node_s = node_n->right;
-    parent_s = node_n;
-    while(node_s->left != NULL && node_s != NULL)
-    {
-      parent_s = node_s;
-      node_s = node_s->left;
-    }
-      node_s->left = node_n->left;
-      if(node_s != node_n->right)
-      {
-        parent_s->left = node_s->right;
-        node_s->right = node_n->right;
-      }
-      if (prve == NULL)
-      {
-        bst->root = node_s;
-      }
-      else if(node_n == prve->left)
-      {
-        prve->left = node_s;
-      }
-      else
-        prve->right = node_s;
-  }
-  free(node_n);
-  return;
+  assert(i == n);
+  struct bst_frozen* frozen = bst_frozen_create(keys, values, n);
+  free(values);
+  free(keys);
+  return frozen;
 }
+
 /*
- * This function should return the value associated with a specified key in a
- * given BST.  If multiple values with the same key exist in the tree, this
- * function should return the first one it encounters (i.e. the one closest to
- * the root of the tree).  If the BST does not contain the specified key, this
- * function should return NULL.
+ * This function saves the key/value pairs of a BST to a file, in a compact,
+ * versioned and checksummed format (see frozen.c) that bst_load_mmap() can
+ * query in place.  Values are saved as 64-bit codes produced by `encode`.
  *
  * Params:
- *   bst - the BST from which a key/value pair is to be removed.  May not
- *     be NULL.
- *   key - the key of the key/value pair whose value is to be returned.
+ *   bst - the BST to save.  May not be NULL.
+ *   path - the path of the file to write.  An existing file is replaced.
+ *   encode - the function that turns a value into a code, called with `arg`
+ *     and the value.  If this is NULL, each value's address is saved.
+ *   arg - passed as the first argument to every call to `encode`.
  *
  * Return:
- *   Should return the value associated with the key `key` in `bst` or NULL,
- *   if the key `key` was not found in `bst`.
+ *   Returns 0 on success, or -1 if the file could not be written.
  */
-
-void* get_bst_node(struct bst_node *ptr, int key) 
-{
-  if(ptr == NULL) 
-    return NULL;
-
-  else if(ptr->key == key) 
-    return ptr->value;
-
-  else if(key < ptr->key) 
-    return get_bst_node(ptr->left, key);
-
-  else 
-    return get_bst_node(ptr->right, key);
+int bst_save(struct bst* bst, const char* path,
+    unsigned long long (*encode)(void* arg, void* value), void* arg) {
+  struct bst_frozen* frozen = bst_freeze(bst);
+  int result = bst_frozen_save(frozen, path, encode, arg);
+  bst_frozen_free(frozen);
+  return result;
 }
 
-void* bst_get(struct bst* bst, int key) 
-{
-  if(bst == NULL)
-    return NULL;
-
-  return get_bst_node(bst->root, key);
+/*
+ * This function loads a file written by bst_save() by mapping it into
+ * memory, without reading or converting any of it up front, and returns it
+ * as a frozen BST that answers queries straight from the mapping.  Loading
+ * takes the same few system calls for a tree of any size.  Call
+ * bst_frozen_verify() to check the file's data against its checksum.
+ *
+ * Params:
+ *   path - the path of the file to load.
+ *   decode - the function that turns a saved code back into a value, called
+ *     with `arg` and the code each time a value is returned.  If this is
+ *     NULL, codes are returned cast to void*.
+ *   arg - passed as the first argument to every call to `decode`.
+ *
+ * Return:
+ *   Returns the loaded tree, which must be freed with bst_frozen_free(), or
+ *   NULL if the file is missing, corrupt or in an unsupported format.
+ */
+struct bst_frozen* bst_load_mmap(const char* path,
+    void* (*decode)(void* arg, unsigned long long code), void* arg) {
+  return bst_frozen_load(path, decode, arg);
 }
 
-
 /*****************************************************************************
  **
  ** BST puzzle functions
@@ -335,21 +3051,115 @@ void* bst_get(struct bst* bst, int key)
  * Return:
  *   Should return the height of bst.
  */
-int bst_height_val(struct bst_node* root)
-{
-  if(root == NULL)
+ int bst_height(struct bst* bst) 
+ {
+  if(bst->mode == BST_BALANCED || bst->mode == BST_CONCURRENT)
+  {
+    read_begin(bst);
+    int height = avl_height(bst_root(bst));
+    read_end(bst);
+    return height;
+  }
+  else if(bst->mode == BST_BPTREE)
   {
-    return -1;
+    return bptree_height(bst->bpt);
   }
-  int left = bst_height_val(root->left);
-  int right = bst_height_val(root->right);
-    return left > right ? left +1 : right +1;
+  else if(bst->mode == BST_COMPACT)
+  {
+    return cbst_height(bst->cbt);
+  }
+  return node_height(bst->root);
+ }
+
+/*
+ * Subtrees with at most this many nodes are measured serially by the
+ * parallel height computation below, since spawning a task for them would
+ * cost more than it saves.
+ */
+#define BST_PARALLEL_CUTOFF 4096
+
+/*
+ * bst_height_parallel() starts a new pool of threads on every call, and
+ * starting a thread takes tens of microseconds, about as long as walking
+ * ten thousand nodes.  Trees with fewer than this many nodes per thread
+ * are therefore walked serially.
+ */
+#define BST_PARALLEL_MIN_PER_THREAD 16384
+
+/*
+ * Computes the height of the subtree rooted at `node` on a fork-join pool
+ * (see forkjoin.c).  Wherever both children are larger than the cutoff, the
+ * left one is measured by a separate task while this call measures the
+ * right one.  Where only one child is, the small one is measured serially
+ * and the walk continues down the large one in a loop, so a degenerate,
+ * list-like tree doesn't make the recursion any deeper.
+ */
+static int par_height(struct fj_pool* pool, struct bst_node* node);
+
+struct par_height_arg {
+  struct bst_node* node;
+  int height;
+};
+
+static void par_height_task(struct fj_pool* pool, void* arg) {
+  struct par_height_arg* a = arg;
+  a->height = par_height(pool, a->node);
 }
 
- int bst_height(struct bst* bst) 
- {
-  return bst_height_val(bst->root);
- }
+static int par_height(struct fj_pool* pool, struct bst_node* node) {
+  int depth = 0, height = -1;
+  while (node != NULL) {
+    if (node_size(node) <= BST_PARALLEL_CUTOFF) {
+      int h = depth + node_height(node);
+      return h > height ? h : height;
+    }
+    struct bst_node* small = node->left;
+    struct bst_node* large = node->right;
+    if (node_size(small) > node_size(large)) {
+      small = node->right;
+      large = node->left;
+    }
+    if (node_size(small) > BST_PARALLEL_CUTOFF) {
+      struct fj_task task;
+      struct par_height_arg left = {node->left, 0};
+      fj_spawn(pool, &task, par_height_task, &left);
+      int right = par_height(pool, node->right);
+      fj_join(pool, &task);
+      int h = depth + 1 + (left.height > right ? left.height : right);
+      return h > height ? h : height;
+    }
+    int h = depth + 1 + node_height(small);
+    height = h > height ? h : height;
+    depth++;
+    node = large;
+  }
+  return height;
+}
+
+/*
+ * This function computes the same value as bst_height(), but splits the
+ * work of walking a BST_PLAIN tree across `threads` threads.  Trees in the
+ * other modes keep their height up to date, so for them this is just
+ * bst_height().  Each call starts and stops its own threads, so a tree with
+ * fewer than BST_PARALLEL_MIN_PER_THREAD nodes per thread is walked by the
+ * calling thread alone.
+ *
+ * Params:
+ *   bst - the BST whose height is to be computed.  May not be NULL.
+ *   threads - the number of threads to use, including the calling thread.
+ *     Must be at least 1.
+ */
+int bst_height_parallel(struct bst* bst, int threads) {
+  assert(bst && threads >= 1);
+  if (bst->mode != BST_PLAIN || threads == 1
+      || node_size(bst->root) < BST_PARALLEL_MIN_PER_THREAD * threads) {
+    return bst_height(bst);
+  }
+  struct fj_pool* pool = fj_pool_create(threads);
+  int height = par_height(pool, bst->root);
+  fj_pool_free(pool);
+  return height;
+}
 
 /*
  * This function should determine whether a specified value is a valid path
@@ -397,29 +3207,67 @@ int bst_path_sum(struct bst* bst, int sum) {
  *     equal to this bound should be included in the sum
  *
  * Return:
- *   Should return the sum of all keys in `bst` between `lower` and `upper`.
+ *   Should return the sum of all keys in `bst` between `lower` and `upper`,
+ *   truncated to an int.  Use bst_range_sum64() when the sum may overflow.
  */
 
-int get_bst_range_sum(struct bst_node* ptr, int lower, int upper)
+int bst_range_sum(struct bst* bst, int lower, int upper) 
 {
-  if (ptr == NULL) {
-    return 0;
-  }
-    else if(ptr->key > upper)
-    {
-      return get_bst_range_sum(ptr->left, lower, upper);
-    }
-    else if(ptr->key < lower)
-    {
-      return get_bst_range_sum(ptr->right, lower, upper);
+  return (int)bst_range_sum64(bst, lower, upper);
+}
+
+/*
+ * Returns the sum of all keys in the subtree rooted at `ptr` that are less
+ * than `bound` (or less than or equal to `bound`, if `inclusive` is set).
+ * Whenever the search moves right, the node's entire left subtree lies below
+ * the bound, so its recorded sum is added without visiting it.
+ */
+static long long prefix_sum(struct bst_node* ptr, int bound, int inclusive) {
+  long long sum = 0;
+  while (ptr != NULL) {
+    if (ptr->key < bound || (inclusive && ptr->key == bound)) {
+      sum += node_sum(ptr->left) + ptr->key;
+      ptr = ptr->right;
+    } else {
+      ptr = ptr->left;
     }
-  else
-    return ptr->key + get_bst_range_sum(ptr->left, lower, upper) + get_bst_range_sum(ptr->right, lower, upper);
+  }
+  return sum;
 }
 
-int bst_range_sum(struct bst* bst, int lower, int upper) 
-{
-  return get_bst_range_sum(bst->root, lower, upper);
+/*
+ * This function computes the same range sum as bst_range_sum(), but returns
+ * it as a 64-bit integer so that sums over large trees do not overflow.  It
+ * uses the key sums recorded in each node, so it runs in time proportional to
+ * the height of the tree no matter how many keys fall within the range.
+ * BST_BPTREE and BST_COMPACT trees don't record key sums, so in those modes
+ * it visits every key in the range and takes time proportional to the
+ * height plus the number of keys summed.
+ *
+ * Params:
+ *   bst - the BST within which to compute a range sum.  May not be NULL.
+ *   lower - the inclusive lower bound of the range.
+ *   upper - the inclusive upper bound of the range.
+ *
+ * Return:
+ *   Should return the sum of all keys in `bst` between `lower` and `upper`.
+ */
+long long bst_range_sum64(struct bst* bst, int lower, int upper) {
+  assert(bst);
+  if (lower > upper) {
+    return 0;
+  }
+  if (bst->mode == BST_BPTREE) {
+    return bptree_range_sum(bst->bpt, lower, upper);
+  }
+  if (bst->mode == BST_COMPACT) {
+    return cbst_range_sum(bst->cbt, lower, upper);
+  }
+  read_begin(bst);
+  struct bst_node* root = bst_root(bst);
+  long long sum = prefix_sum(root, upper, 1) - prefix_sum(root, lower, 0);
+  read_end(bst);
+  return sum;
 }
 
 /*****************************************************************************
@@ -429,24 +3277,101 @@ int bst_range_sum(struct bst* bst, int lower, int upper)
  *****************************************************************************/
 
 /*
- * Structure used to represent a binary search tree iterator.  It contains
- * only a reference to a stack to be used to implement the iterator.
+ * Structure used to represent a binary search tree iterator.  It contains a
+ * node stack (see "Iterative traversal" above) of the nodes whose keys are
+ * still to be visited, each one the parent of a subtree that has already
+ * been visited (or is being visited), with the next node to visit on top.
+ * The stack lives inside the iterator itself unless the tree is deeper than
+ * BST_STACK_INLINE levels, so a full scan allocates nothing besides the
+ * iterator.
  *
- * You should not modify this structure.
+ * Iterators over BST_BPTREE trees walk the linked leaves instead, keeping
+ * the current leaf and the position of the next pair within it, and
+ * iterators over BST_COMPACT trees wrap an iterator `compact` of cbst.c.
+ *
+ * An iterator stops before the first key greater than `upper`, and reports
+ * the value of each node as its tree's duplicate key `policy` requires (see
+ * node_value()).  Iterators over BST_CONCURRENT trees stay inside a
+ * read-side critical section of the tree's epoch domain `epoch` until they
+ * are freed, so they see the version of the tree that was current when they
+ * were created.
  */
 struct bst_iterator {
-  struct stack* stack;
+  struct epoch* epoch;
+  struct bptree_leaf* leaf;
+  int pos;
+  struct cbst_iter* compact;
+  int upper;
+  int policy;
+  struct node_stack stack;
 };
 
 /*
  * This function should allocate and initialize an iterator over a specified
- * BST and return a pointer to that iterator.
+ * BST and return a pointer to that iterator.  The iterator starts at the
+ * smallest key in the BST.  The BST should not be modified while the
+ * iterator is in use, except in BST_CONCURRENT mode, where the iterator
+ * visits the keys the BST held when the iterator was created.  In
+ * BST_SPLAY mode, looking a key up modifies the BST too.
  *
  * Params:
  *   bst - the BST for over which to create an iterator.  May not be NULL.
  */
 struct bst_iterator* bst_iterator_create(struct bst* bst) {
-  return NULL;
+  return bst_iterator_create_range(bst, INT_MIN, INT_MAX);
+}
+
+/*
+ * This function allocates and initializes an iterator over the keys of a
+ * BST that lie between `lower` and `upper` (both inclusive) and returns a
+ * pointer to it.  The iterator is used and freed exactly like one returned
+ * by bst_iterator_create().  Rather than starting at the smallest key and
+ * skipping forward, it seeks directly to the first key that is at least
+ * `lower`, so setting up the iterator takes time proportional to the height
+ * of the tree and each key in the range then takes amortized constant time.
+ *
+ * Params:
+ *   bst - the BST over which to create an iterator.  May not be NULL.
+ *   lower - the inclusive lower bound of the keys to visit.
+ *   upper - the inclusive upper bound of the keys to visit.
+ */
+struct bst_iterator* bst_iterator_create_range(struct bst* bst, int lower,
+    int upper) {
+  assert(bst);
+  struct bst_iterator* iter = malloc(sizeof(struct bst_iterator));
+  stack_init(&iter->stack);
+  iter->leaf = NULL;
+  iter->pos = 0;
+  iter->compact = NULL;
+  iter->upper = upper;
+  iter->policy = bst->policy;
+  iter->epoch = bst->epoch;
+  if (bst->mode == BST_BPTREE) {
+    iter->leaf = bptree_lower_bound(bst->bpt, lower, &iter->pos);
+    return iter;
+  }
+  if (bst->mode == BST_COMPACT) {
+    iter->compact = cbst_iter_create(bst->cbt, lower, upper);
+    return iter;
+  }
+
+  /*
+   * Every node at which the search for `lower` turns left has a key that is
+   * at least `lower`, and these are exactly the nodes that an iterator
+   * started at the smallest key would have left on its stack by the time it
+   * reached `lower`.
+   */
+  read_begin(bst);
+  struct bst_node* node = bst_root(bst);
+  while (node != NULL) {
+    if (node->key >= lower) {
+      stack_push(&iter->stack, node);
+      node = node->left;
+    } else {
+      node = node->right;
+    }
+  }
+  return iter;
 }
 
 /*
@@ -458,7 +3383,15 @@ struct bst_iterator* bst_iterator_create(struct bst* bst) {
  *   iter - the BST iterator to be destroyed.  May not be NULL.
  */
 void bst_iterator_free(struct bst_iterator* iter) {
-  return;
+  assert(iter);
+  if (iter->epoch != NULL) {
+    epoch_exit(iter->epoch);
+  }
+  if (iter->compact != NULL) {
+    cbst_iter_free(iter->compact);
+  }
+  stack_free(&iter->stack);
+  free(iter);
 }
 
 /*
@@ -472,7 +3405,14 @@ void bst_iterator_free(struct bst_iterator* iter) {
  *     not be NULL.
  */
 int bst_iterator_has_next(struct bst_iterator* iter) {
-  return 0;
+  assert(iter);
+  if (iter->leaf != NULL) {
+    return bptree_leaf_key(iter->leaf, iter->pos) <= iter->upper;
+  }
+  if (iter->compact != NULL) {
+    return cbst_iter_has_next(iter->compact);
+  }
+  return iter->stack.top > 0 && stack_peek(&iter->stack)->key <= iter->upper;
 }
 
 /*
@@ -492,17 +3432,38 @@ int bst_iterator_has_next(struct bst_iterator* iter) {
  * Parameters:
  *   iter - BST iterator.  The key and value associated with this iterator's
  *     current node should be returned, and the iterator should be updated to
- *     point to the next node in the BST (in in-order order).  May not be NULL.
+ *     point to the next node in the BST (in in-order order).  May not be NULL,
+ *     and must have at least one more node to visit.
  *   value - pointer at which the current BST node's value should be stored
- *     before this function returns.
+ *     before this function returns.  May be NULL if the value isn't needed.
  *
  * Return:
  *   This function should return the key associated with the current BST node
  *   pointed to by `iter`.
  */
 int bst_iterator_next(struct bst_iterator* iter, void** value) {
+  assert(bst_iterator_has_next(iter));
+  int key;
+  if (iter->leaf != NULL) {
+    key = bptree_leaf_key(iter->leaf, iter->pos);
+    if (value) {
+      *value = bptree_leaf_value(iter->leaf, iter->pos);
+    }
+    if (++iter->pos == bptree_leaf_count(iter->leaf)) {
+      iter->leaf = bptree_leaf_next(iter->leaf);
+      iter->pos = 0;
+    }
+    return key;
+  }
+  if (iter->compact != NULL) {
+    return cbst_iter_next(iter->compact, value);
+  }
+
+  struct bst_node* node = stack_pop(&iter->stack);
+  key = node->key;
   if (value) {
-    *value = NULL;
+    *value = node_value(iter->policy, node);
   }
-  return 0;
+  stack_push_left(&iter->stack, node->right);
+  return key;
 }
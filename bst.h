@@ -13,25 +13,159 @@
  */
 struct bst;
 
+/*
+ * Modes in which a binary search tree can be created with bst_create_mode().
+ * BST_PLAIN trees never rebalance; BST_BALANCED trees are kept AVL-balanced,
+ * so their height stays O(log n) regardless of insertion order.  BST_BPTREE
+ * trees keep their keys in a cache-conscious B+-tree behind the same
+ * interface, but range sums visit every key in the range.  BST_CONCURRENT
+ * trees are AVL-balanced and may be read by any number of threads without
+ * locks while other threads modify them; at most 128 threads may use them at
+ * once (see epoch.h).
+ * BST_COMPACT trees are weight-balanced and keep their nodes in one array,
+ * linked by 32-bit indices, taking half the memory per key of BST_BALANCED;
+ * like BST_BPTREE trees, they don't record key sums, so range sums visit
+ * every key in the range.
+ * BST_SPLAY trees are splay trees, which move each key they look up to the
+ * root, so that keys looked up often are found quickly.
+ */
+#define BST_PLAIN 0
+#define BST_BALANCED 1
+#define BST_BPTREE 2
+#define BST_CONCURRENT 3
+#define BST_COMPACT 4
+#define BST_SPLAY 5
+
+/*
+ * Flags that may be combined with any of the modes above (e.g.
+ * BST_BALANCED | BST_UNIQUE) to choose what happens when a key that is
+ * already present is inserted.  By default, every insert adds a new node and
+ * equal keys are kept side by side.  In BST_UNIQUE trees, the new value
+ * replaces the old one in place instead.  BST_MULTI trees keep one node per
+ * key that holds all of the values inserted under it; they can only be
+ * combined with BST_PLAIN or BST_BALANCED.
+ */
+#define BST_UNIQUE 0x100
+#define BST_MULTI 0x200
+
 /*
  * Basic binary search tree interface function prototypes.  Refer to bst.c for
  * documentation about each of these functions.
  */
 struct bst* bst_create();
+struct bst* bst_create_mode(int mode);
+struct bst* bst_build_sorted(const int* keys, void** values, int n);
 void bst_free(struct bst* bst);
 int bst_size(struct bst* bst);
 void bst_insert(struct bst* bst, int key, void* value);
 void bst_remove(struct bst* bst, int key);
 void* bst_get(struct bst* bst, int key);
+void bst_get_batch(struct bst* bst, const int* keys, int n, void** values);
+
+/*
+ * Duplicate key prototypes.  Refer to bst.c for documentation about each of
+ * these functions.
+ */
+int bst_upsert(struct bst* bst, int key, void* value, void** old);
+int bst_count(struct bst* bst, int key);
+int bst_get_all(struct bst* bst, int key, void** values, int max);
+
+/*
+ * Split and join prototypes.  Refer to bst.c for documentation about each of
+ * these functions.
+ */
+struct bst* bst_split(struct bst* bst, int key);
+void bst_join(struct bst* left, struct bst* right);
+int bst_remove_range(struct bst* bst, int lower, int upper);
+
+/*
+ * Set operation prototypes.  Refer to bst.c for documentation about each of
+ * these functions.
+ */
+void bst_union(struct bst* a, struct bst* b, int threads);
+void bst_intersect(struct bst* a, struct bst* b, int threads);
+void bst_difference(struct bst* a, struct bst* b, int threads);
 
 /*
  * Binary search tree "puzzle" function prototypes.  Refer to bst.c for
  * documentation about each of these functions.
  */
 int bst_height(struct bst* bst);
+int bst_height_parallel(struct bst* bst, int threads);
 int bst_path_sum(struct bst* bst, int sum);
 //int bst_path_sum_tree(int cur, int sum, struct bst_node* root);
 int bst_range_sum(struct bst* bst, int lower, int upper);
+long long bst_range_sum64(struct bst* bst, int lower, int upper);
+
+/*
+ * Order-statistic query prototypes.  Refer to bst.c for documentation about
+ * each of these functions.
+ */
+int bst_select(struct bst* bst, int k, void** value);
+int bst_rank(struct bst* bst, int key);
+
+/*
+ * Persistent snapshot prototype.  Refer to bst.c for documentation about
+ * this function.
+ */
+struct bst* bst_snapshot(struct bst* bst);
+
+/*
+ * Structure used to report the operation counters of a BST (see
+ * bst_stats()).  For each kind of operation, `calls` counts the operations
+ * made, while `comparisons` and `nodes_visited` count the key comparisons
+ * made and the nodes visited by all of those operations together.  `allocs`
+ * and `frees` count the nodes taken from and handed back to the tree's node
+ * pool.  `depths[d]` counts the lookups that visited `d` nodes before they
+ * found their key or fell off the tree; the last bucket also counts every
+ * deeper lookup.
+ */
+#define BST_STATS_DEPTHS 64
+
+struct bst_op_stats {
+  unsigned long long calls;
+  unsigned long long comparisons;
+  unsigned long long nodes_visited;
+};
+
+struct bst_stats {
+  struct bst_op_stats get;
+  struct bst_op_stats insert;
+  struct bst_op_stats remove;
+  unsigned long long allocs;
+  unsigned long long frees;
+  unsigned long long depths[BST_STATS_DEPTHS];
+};
+
+/*
+ * Operation counter prototypes.  Refer to bst.c for documentation about each
+ * of these functions.  Counters are only kept when bst.c is compiled with
+ * BST_STATS defined.
+ */
+int bst_stats(struct bst* bst, struct bst_stats* out);
+void bst_stats_reset(struct bst* bst);
+
+/*
+ * Structure used to represent a frozen (immutable) copy of a binary search
+ * tree.  Its interface is defined in frozen.h.
+ */
+struct bst_frozen;
+
+/*
+ * Frozen snapshot prototype.  Refer to bst.c for documentation about this
+ * function.
+ */
+struct bst_frozen* bst_freeze(struct bst* bst);
+
+/*
+ * Binary search tree file prototypes.  Refer to bst.c for documentation
+ * about each of these functions.  Saved trees are loaded back as frozen
+ * BSTs that are queried straight from the mapped file.
+ */
+int bst_save(struct bst* bst, const char* path,
+  unsigned long long (*encode)(void* arg, void* value), void* arg);
+struct bst_frozen* bst_load_mmap(const char* path,
+  void* (*decode)(void* arg, unsigned long long code), void* arg);
 
 /*
  * Structure used to represent a binary search tree iterator.
@@ -43,6 +177,8 @@ struct bst_iterator;
  * documentation about each of these functions.
  */
 struct bst_iterator* bst_iterator_create(struct bst* bst);
+struct bst_iterator* bst_iterator_create_range(struct bst* bst, int lower,
+  int upper);
 void bst_iterator_free(struct bst_iterator* iter);
 int bst_iterator_has_next(struct bst_iterator* iter);
 int bst_iterator_next(struct bst_iterator* iter, void** value);
@@ -0,0 +1,516 @@
+/*
+ * This file contains BST_DEFINE(), a macro that generates a binary search
+ * tree specialized for one key type and one comparator, for keys that don't
+ * fit the `int` keys of the trees in bst.c (64-bit IDs, strings, structs
+ * with a custom ordering).  The comparator is expanded inline at every step
+ * of every search, so a specialized tree pays no function pointer call per
+ * node visited.
+ *
+ * BST_DEFINE(name, key_t, cmp) defines `struct name`, a tree whose keys have
+ * type `key_t` and are ordered by `cmp(a, b)`, which must evaluate to a
+ * negative, zero or positive int as the key `a` is less than, equal to or
+ * greater than the key `b`.  `cmp` may be a function or a function-like
+ * macro, such as BST_CMP_NUMERIC or BST_CMP_STRING below.  Searches test
+ * `cmp(a, b) != 0` and `cmp(a, b) < 0` as separate expressions, which lets
+ * the compiler reduce each test to a single comparison for numeric keys, so
+ * `cmp` should be a macro, an inline function or a pure function (like
+ * strcmp()), which the compiler evaluates once per node.  Keys are stored
+ * by value: a tree of `const char*` keys stores the pointers, and the
+ * strings they point to must outlive the tree.
+ *
+ * Every identifier starting with `name_` (and `struct name_node`) is taken
+ * by the generated code.  The generated interface mirrors the one in bst.h:
+ *
+ *   struct name* name_create()
+ *   struct name* name_create_mode(int mode)
+ *     Return a new, empty tree.  `mode` is BST_PLAIN (the default) or
+ *     BST_BALANCED, optionally combined with BST_UNIQUE, as for
+ *     bst_create_mode().  BST_MULTI is not supported.
+ *   void name_free(struct name* tree)
+ *     Frees the tree and all of its nodes (but not the keys or values).
+ *   int name_size(struct name* tree)
+ *     Returns the number of key/value pairs in the tree, in constant time.
+ *   void name_insert(struct name* tree, key_t key, void* value)
+ *     Inserts a key/value pair.  Equal keys are kept side by side, with the
+ *     new pair after the existing ones, unless the tree is BST_UNIQUE, in
+ *     which case `value` replaces the value of the key in place.
+ *   int name_upsert(struct name* tree, key_t key, void* value, void** old)
+ *     Replaces the value of the key in place, storing the old value in
+ *     `*old` (if `old` is not NULL), or inserts a new pair.  Returns 1 if
+ *     the key was already present and 0 otherwise.
+ *   void name_remove(struct name* tree, key_t key)
+ *     Removes the first pair with key `key` on the search path, if any.
+ *   void* name_get(struct name* tree, key_t key)
+ *     Returns the value of the first pair with key `key` on the search path,
+ *     or NULL if the key is not present.
+ *   int name_height(struct name* tree)
+ *     Returns the height of the tree (-1 if it is empty).
+ *   struct name_iterator* name_iterator_create(struct name* tree)
+ *   void name_iterator_free(struct name_iterator* iter)
+ *   int name_iterator_has_next(struct name_iterator* iter)
+ *   key_t name_iterator_next(struct name_iterator* iter, void** value)
+ *     Iterate over the pairs of the tree in key order, as the bst_iterator
+ *     functions do.  The tree may not be modified while an iterator over it
+ *     is in use.
+ *
+ * For example, a tree keyed by 64-bit IDs is defined by
+ *
+ *   BST_DEFINE(id_tree, int64_t, BST_CMP_NUMERIC)
+ *
+ * at file scope, and used through id_tree_create(), id_tree_insert(), etc.
+ * All of the generated functions are static inline, so the macro may be
+ * expanded in any number of translation units, once per name in each.
+ */
+
+#ifndef __BST_DEFINE_H
+#define __BST_DEFINE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include <assert.h>
+
+#include "bst.h"
+
+/*
+ * Comparators for BST_DEFINE(): BST_CMP_NUMERIC orders any arithmetic key
+ * type by value, and BST_CMP_STRING orders NUL-terminated strings as
+ * strcmp() does.
+ */
+#define BST_CMP_NUMERIC(a, b) (((a) > (b)) - ((a) < (b)))
+#define BST_CMP_STRING(a, b) strcmp((a), (b))
+
+/*
+ * Nodes of generated trees come from a pool shared by every generated type,
+ * which works like the node pool in bst.c: nodes are carved out of chunks
+ * that start at BST_GEN_MIN_CHUNK nodes and double up to BST_GEN_MAX_CHUNK
+ * nodes, and released nodes are kept on a free list, linked through their
+ * first pointer-sized bytes.  The first node-sized slot of each chunk holds
+ * the link to the next chunk.
+ */
+#define BST_GEN_MIN_CHUNK 1024
+#define BST_GEN_MAX_CHUNK (1 << 20)
+
+struct bst_gen_pool {
+  char* chunks;
+  void* free_list;
+  int used;
+  int capacity;
+  size_t size;
+};
+
+/*
+ * Initializes an empty pool of nodes of `size` bytes each.
+ */
+static inline void bst_gen_pool_init(struct bst_gen_pool* pool, size_t size) {
+  pool->chunks = NULL;
+  pool->free_list = NULL;
+  pool->used = 0;
+  pool->capacity = 0;
+  pool->size = size;
+}
+
+/*
+ * Frees every chunk of a pool, and with them every node ever allocated from
+ * it.
+ */
+static inline void bst_gen_pool_free(struct bst_gen_pool* pool) {
+  char* chunk = pool->chunks;
+  while (chunk != NULL) {
+    char* next;
+    memcpy(&next, chunk, sizeof(char*));
+    free(chunk);
+    chunk = next;
+  }
+}
+
+/*
+ * Returns an uninitialized node from a pool, recycling a released node if
+ * there is one.
+ */
+static inline void* bst_gen_pool_alloc(struct bst_gen_pool* pool) {
+  void* node = pool->free_list;
+  if (node != NULL) {
+    memcpy(&pool->free_list, node, sizeof(void*));
+    return node;
+  }
+  if (pool->used == pool->capacity) {
+    int capacity = pool->capacity ? pool->capacity * 2 : BST_GEN_MIN_CHUNK;
+    if (capacity > BST_GEN_MAX_CHUNK) {
+      capacity = BST_GEN_MAX_CHUNK;
+    }
+    char* chunk = malloc((size_t)(capacity + 1) * pool->size);
+    memcpy(chunk, &pool->chunks, sizeof(char*));
+    pool->chunks = chunk;
+    pool->used = 0;
+    pool->capacity = capacity;
+  }
+  return pool->chunks + (size_t)++pool->used * pool->size;
+}
+
+/*
+ * Returns a node to its pool.
+ */
+static inline void bst_gen_pool_release(struct bst_gen_pool* pool,
+    void* node) {
+  memcpy(node, &pool->free_list, sizeof(void*));
+  pool->free_list = node;
+}
+
+/*
+ * Generates the tree type `struct name`, keyed by `key_t` and ordered by
+ * `cmp`, along with its interface (see the top of this file).  The helpers
+ * mirror those in bst.c: BST_BALANCED trees are AVL trees, updated by the
+ * recursive name_avl_* functions, and BST_PLAIN trees are updated in place
+ * without recursion.  Nodes only carry a height, which is left at 0 in
+ * BST_PLAIN trees.
+ */
+#define BST_DEFINE(name, key_t, cmp) \
+  \
+struct name##_node { \
+  key_t key; \
+  void* value; \
+  struct name##_node* left; \
+  struct name##_node* right; \
+  int height; \
+}; \
+  \
+struct name { \
+  struct name##_node* root; \
+  int mode; \
+  int policy; \
+  int size; \
+  struct bst_gen_pool pool; \
+}; \
+  \
+struct name##_iterator { \
+  struct name##_node** stack; \
+  int top; \
+  int capacity; \
+}; \
+  \
+static inline struct name* name##_create_mode(int mode) { \
+  struct name* tree = malloc(sizeof(struct name)); \
+  tree->root = NULL; \
+  tree->mode = mode & ~(BST_UNIQUE | BST_MULTI); \
+  tree->policy = mode & (BST_UNIQUE | BST_MULTI); \
+  assert(tree->mode == BST_PLAIN || tree->mode == BST_BALANCED); \
+  assert(tree->policy != BST_MULTI); \
+  tree->size = 0; \
+  bst_gen_pool_init(&tree->pool, sizeof(struct name##_node)); \
+  return tree; \
+} \
+  \
+static inline struct name* name##_create() { \
+  return name##_create_mode(BST_PLAIN); \
+} \
+  \
+static inline void name##_free(struct name* tree) { \
+  assert(tree); \
+  bst_gen_pool_free(&tree->pool); \
+  free(tree); \
+} \
+  \
+static inline int name##_size(struct name* tree) { \
+  assert(tree); \
+  return tree->size; \
+} \
+  \
+/* Returns the first node with key `key` below `node`, or NULL. */ \
+static inline struct name##_node* name##_find(struct name##_node* node, \
+    key_t key) { \
+  while (node != NULL && cmp(key, node->key) != 0) { \
+    node = cmp(key, node->key) < 0 ? node->left : node->right; \
+  } \
+  return node; \
+} \
+  \
+static inline void* name##_get(struct name* tree, key_t key) { \
+  assert(tree); \
+  struct name##_node* node = name##_find(tree->root, key); \
+  return node ? node->value : NULL; \
+} \
+  \
+static inline int name##_avl_height(struct name##_node* node) { \
+  return node ? node->height : -1; \
+} \
+  \
+static inline void name##_avl_update(struct name##_node* node) { \
+  int left = name##_avl_height(node->left); \
+  int right = name##_avl_height(node->right); \
+  node->height = (left > right ? left : right) + 1; \
+} \
+  \
+static inline struct name##_node* name##_avl_rotate_left( \
+    struct name##_node* node) { \
+  struct name##_node* pivot = node->right; \
+  node->right = pivot->left; \
+  pivot->left = node; \
+  name##_avl_update(node); \
+  name##_avl_update(pivot); \
+  return pivot; \
+} \
+  \
+static inline struct name##_node* name##_avl_rotate_right( \
+    struct name##_node* node) { \
+  struct name##_node* pivot = node->left; \
+  node->left = pivot->right; \
+  pivot->right = node; \
+  name##_avl_update(node); \
+  name##_avl_update(pivot); \
+  return pivot; \
+} \
+  \
+static inline struct name##_node* name##_avl_rebalance( \
+    struct name##_node* node) { \
+  int balance = name##_avl_height(node->left) \
+    - name##_avl_height(node->right); \
+  if (balance > 1) { \
+    if (name##_avl_height(node->left->left) \
+        < name##_avl_height(node->left->right)) { \
+      node->left = name##_avl_rotate_left(node->left); \
+    } \
+    return name##_avl_rotate_right(node); \
+  } else if (balance < -1) { \
+    if (name##_avl_height(node->right->right) \
+        < name##_avl_height(node->right->left)) { \
+      node->right = name##_avl_rotate_right(node->right); \
+    } \
+    return name##_avl_rotate_left(node); \
+  } \
+  name##_avl_update(node); \
+  return node; \
+} \
+  \
+/* Inserts `tree` below `ptr`, equal keys going right. */ \
+static struct name##_node* name##_avl_insert(struct name##_node* ptr, \
+    struct name##_node* tree) { \
+  if (ptr == NULL) { \
+    return tree; \
+  } \
+  if (cmp(tree->key, ptr->key) >= 0) { \
+    ptr->right = name##_avl_insert(ptr->right, tree); \
+  } else { \
+    ptr->left = name##_avl_insert(ptr->left, tree); \
+  } \
+  return name##_avl_rebalance(ptr); \
+} \
+  \
+static struct name##_node* name##_avl_remove_min(struct name##_node* ptr, \
+    struct name##_node** min) { \
+  if (ptr->left == NULL) { \
+    *min = ptr; \
+    return ptr->right; \
+  } \
+  ptr->left = name##_avl_remove_min(ptr->left, min); \
+  return name##_avl_rebalance(ptr); \
+} \
+  \
+/* Detaches the first node with key `key` below `ptr` into `*removed`. */ \
+static struct name##_node* name##_avl_remove(struct name##_node* ptr, \
+    key_t key, struct name##_node** removed) { \
+  if (ptr == NULL) { \
+    *removed = NULL; \
+    return NULL; \
+  } \
+  int c = cmp(key, ptr->key); \
+  if (c == 0) { \
+    *removed = ptr; \
+    if (ptr->left == NULL) { \
+      return ptr->right; \
+    } else if (ptr->right == NULL) { \
+      return ptr->left; \
+    } \
+    struct name##_node* succ; \
+    struct name##_node* right = name##_avl_remove_min(ptr->right, &succ); \
+    succ->left = ptr->left; \
+    succ->right = right; \
+    return name##_avl_rebalance(succ); \
+  } \
+  if (c < 0) { \
+    ptr->left = name##_avl_remove(ptr->left, key, removed); \
+  } else { \
+    ptr->right = name##_avl_remove(ptr->right, key, removed); \
+  } \
+  return name##_avl_rebalance(ptr); \
+} \
+  \
+/* Links the childless node `tree` below the end of its search path. */ \
+static inline void name##_plain_insert(struct name* tree, \
+    struct name##_node* node) { \
+  struct name##_node** link = &tree->root; \
+  while (*link != NULL) { \
+    link = cmp(node->key, (*link)->key) >= 0 ? &(*link)->right \
+      : &(*link)->left; \
+  } \
+  *link = node; \
+} \
+  \
+/* Unlinks the first node with key `key` on its search path, or NULL. */ \
+static inline struct name##_node* name##_plain_remove(struct name* tree, \
+    key_t key) { \
+  struct name##_node** link = &tree->root; \
+  while (*link != NULL) { \
+    int c = cmp(key, (*link)->key); \
+    if (c == 0) { \
+      break; \
+    } \
+    link = c < 0 ? &(*link)->left : &(*link)->right; \
+  } \
+  struct name##_node* node = *link; \
+  if (node == NULL) { \
+    return NULL; \
+  } \
+  if (node->left == NULL) { \
+    *link = node->right; \
+  } else if (node->right == NULL) { \
+    *link = node->left; \
+  } else { \
+    struct name##_node** succ = &node->right; \
+    while ((*succ)->left != NULL) { \
+      succ = &(*succ)->left; \
+    } \
+    struct name##_node* next = *succ; \
+    *succ = next->right; \
+    next->left = node->left; \
+    next->right = node->right; \
+    *link = next; \
+  } \
+  return node; \
+} \
+  \
+static inline void name##_insert_node(struct name* tree, key_t key, \
+    void* value) { \
+  struct name##_node* node = bst_gen_pool_alloc(&tree->pool); \
+  node->key = key; \
+  node->value = value; \
+  node->left = NULL; \
+  node->right = NULL; \
+  node->height = 0; \
+  if (tree->mode == BST_BALANCED) { \
+    tree->root = name##_avl_insert(tree->root, node); \
+  } else { \
+    name##_plain_insert(tree, node); \
+  } \
+  tree->size++; \
+} \
+  \
+static inline int name##_upsert(struct name* tree, key_t key, void* value, \
+    void** old) { \
+  assert(tree); \
+  struct name##_node* node = name##_find(tree->root, key); \
+  if (node != NULL) { \
+    if (old != NULL) { \
+      *old = node->value; \
+    } \
+    node->value = value; \
+    return 1; \
+  } \
+  name##_insert_node(tree, key, value); \
+  return 0; \
+} \
+  \
+static inline void name##_insert(struct name* tree, key_t key, \
+    void* value) { \
+  assert(tree); \
+  if (tree->policy == BST_UNIQUE) { \
+    name##_upsert(tree, key, value, NULL); \
+  } else { \
+    name##_insert_node(tree, key, value); \
+  } \
+} \
+  \
+static inline void name##_remove(struct name* tree, key_t key) { \
+  assert(tree); \
+  struct name##_node* removed; \
+  if (tree->mode == BST_BALANCED) { \
+    tree->root = name##_avl_remove(tree->root, key, &removed); \
+  } else { \
+    removed = name##_plain_remove(tree, key); \
+  } \
+  if (removed != NULL) { \
+    bst_gen_pool_release(&tree->pool, removed); \
+    tree->size--; \
+  } \
+} \
+  \
+static inline void name##_iterator_push_left(struct name##_iterator* iter, \
+    struct name##_node* node) { \
+  for (; node != NULL; node = node->left) { \
+    if (iter->top == iter->capacity) { \
+      iter->capacity *= 2; \
+      iter->stack = realloc(iter->stack, \
+        iter->capacity * sizeof(struct name##_node*)); \
+    } \
+    iter->stack[iter->top++] = node; \
+  } \
+} \
+  \
+static inline struct name##_iterator* name##_iterator_create( \
+    struct name* tree) { \
+  assert(tree); \
+  struct name##_iterator* iter = malloc(sizeof(struct name##_iterator)); \
+  iter->top = 0; \
+  iter->capacity = 64; \
+  iter->stack = malloc(iter->capacity * sizeof(struct name##_node*)); \
+  name##_iterator_push_left(iter, tree->root); \
+  return iter; \
+} \
+  \
+static inline void name##_iterator_free(struct name##_iterator* iter) { \
+  assert(iter); \
+  free(iter->stack); \
+  free(iter); \
+} \
+  \
+static inline int name##_iterator_has_next(struct name##_iterator* iter) { \
+  assert(iter); \
+  return iter->top > 0; \
+} \
+  \
+static inline key_t name##_iterator_next(struct name##_iterator* iter, \
+    void** value) { \
+  assert(iter && iter->top > 0); \
+  struct name##_node* node = iter->stack[--iter->top]; \
+  name##_iterator_push_left(iter, node->right); \
+  if (value != NULL) { \
+    *value = node->value; \
+  } \
+  return node->key; \
+} \
+  \
+/* BST_PLAIN trees may be deep, so their height is found with an explicit \
+   stack of nodes and their depths rather than by recursion. */ \
+static inline int name##_height(struct name* tree) { \
+  assert(tree); \
+  if (tree->mode == BST_BALANCED || tree->root == NULL) { \
+    return name##_avl_height(tree->root); \
+  } \
+  int height = 0, top = 0, capacity = 64; \
+  struct name##_node** nodes = malloc(capacity * sizeof(*nodes)); \
+  int* depths = malloc(capacity * sizeof(int)); \
+  nodes[top] = tree->root; \
+  depths[top++] = 0; \
+  while (top > 0) { \
+    struct name##_node* node = nodes[--top]; \
+    int depth = depths[top]; \
+    height = depth > height ? depth : height; \
+    if (top + 2 > capacity) { \
+      capacity *= 2; \
+      nodes = realloc(nodes, capacity * sizeof(*nodes)); \
+      depths = realloc(depths, capacity * sizeof(int)); \
+    } \
+    if (node->left != NULL) { \
+      nodes[top] = node->left; \
+      depths[top++] = depth + 1; \
+    } \
+    if (node->right != NULL) { \
+      nodes[top] = node->right; \
+      depths[top++] = depth + 1; \
+    } \
+  } \
+  free(nodes); \
+  free(depths); \
+  return height; \
+}
+
+#endif
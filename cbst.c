@@ -0,0 +1,608 @@
+/*
+ * This file contains an implementation of a compact binary search tree that
+ * stores integer keys with associated void* values, using the same ordering
+ * rules as the binary search tree in bst.c (duplicate keys are allowed, and
+ * are kept after the keys equal to them that were inserted earlier).  It is
+ * used as the backend of BSTs created in BST_COMPACT mode.
+ *
+ * All nodes live in one array that grows by doubling, and refer to their
+ * children by 32-bit index into it rather than by pointer.  Values are kept
+ * in a second array indexed the same way, so that the nodes visited by a
+ * search hold nothing but what the search reads: a node takes 16 bytes (4 of
+ * them per cache line) plus 8 for its value, against 48 for a node of
+ * bst.c.  Index 0 is a sentinel standing for the empty subtree, whose size
+ * is 0, so children can be followed without checking for NULL.
+ *
+ * The tree is weight-balanced, which lets the subtree size every node keeps
+ * for bst_select() and bst_rank() double as its balance information.  The
+ * balancing rules, and the parameters DELTA = 3 and GAMMA = 2, are those
+ * shown to be correct by Hirai and Yamamoto, "Balancing weight-balanced
+ * trees", Journal of Functional Programming 21(3), 2011.
+ */
+
+#include <stdlib.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "cbst.h"
+
+/*
+ * Weight-balance parameters.  The weight of a subtree is its size plus one.
+ * A node is balanced when neither of its subtrees weighs more than DELTA
+ * times the other.  When one does, a single rotation restores the balance if
+ * the outer grandchild on that side weighs more than 1/GAMMA of the inner
+ * one, and a double rotation is needed otherwise.
+ */
+#define CBST_DELTA 3
+#define CBST_GAMMA 2
+
+/*
+ * Maximum height of a tree.  A weight-balanced tree with DELTA = 3 is at most
+ * log(n + 1) / log(4/3) high, which is under 80 for any number of nodes that
+ * 32-bit indices can address.
+ */
+#define CBST_MAX_DEPTH 80
+
+/*
+ * Number of node slots a tree starts with.
+ */
+#define CBST_MIN_CAPACITY 16
+
+/*
+ * This structure represents a node.  `left` and `right` are the indices of
+ * its children (0 for none), and `size` is the number of nodes in the subtree
+ * rooted at it.  The node's value is stored separately, at the same index of
+ * the tree's `values` array.  Nodes on the free list are linked through
+ * `left`.
+ */
+struct cbst_node {
+  int key;
+  uint32_t left;
+  uint32_t right;
+  uint32_t size;
+};
+
+/*
+ * This structure represents an entire tree.  `nodes` and `values` each have
+ * room for `capacity` entries, of which the first `used` have been handed
+ * out at some point.  `nodes[0]` is the sentinel.  Slots freed by removals
+ * are kept on a list starting at `free_list` (0 if empty) and reused before
+ * the arrays grow.
+ */
+struct cbst {
+  struct cbst_node* nodes;
+  void** values;
+  uint32_t root;
+  uint32_t capacity;
+  uint32_t used;
+  uint32_t free_list;
+};
+
+/*
+ * This structure represents an in-order iterator.  `stack` holds the indices
+ * of the nodes whose keys are still to be returned but whose right subtrees
+ * haven't been entered, deepest last, like the node stack of bst.c's
+ * iterators.  The iterator stops before the first key greater than `upper`.
+ */
+struct cbst_iter {
+  struct cbst* tree;
+  int upper;
+  int top;
+  uint32_t stack[CBST_MAX_DEPTH];
+};
+
+/*
+ * This function allocates and initializes a new, empty compact tree and
+ * returns a pointer to it.
+ */
+struct cbst* cbst_create() {
+  struct cbst* tree = malloc(sizeof(struct cbst));
+  tree->capacity = CBST_MIN_CAPACITY;
+  tree->nodes = malloc(tree->capacity * sizeof(struct cbst_node));
+  tree->values = malloc(tree->capacity * sizeof(void*));
+  tree->nodes[0].key = 0;
+  tree->nodes[0].left = tree->nodes[0].right = 0;
+  tree->nodes[0].size = 0;
+  tree->values[0] = NULL;
+  tree->root = 0;
+  tree->used = 1;
+  tree->free_list = 0;
+  return tree;
+}
+
+/*
+ * This function frees the memory associated with a compact tree.  It does
+ * not free the values stored in the tree.
+ *
+ * Params:
+ *   tree - the tree to be destroyed.  May not be NULL.
+ */
+void cbst_free(struct cbst* tree) {
+  assert(tree);
+  free(tree->nodes);
+  free(tree->values);
+  free(tree);
+}
+
+/*
+ * This function returns the number of key/value pairs stored in a compact
+ * tree.
+ */
+int cbst_size(struct cbst* tree) {
+  assert(tree);
+  return (int)tree->nodes[tree->root].size;
+}
+
+/*
+ * This function returns the number of bytes of heap memory a compact tree
+ * currently occupies, counting the slots its arrays have reserved but not
+ * yet used.
+ */
+size_t cbst_memory(struct cbst* tree) {
+  assert(tree);
+  return sizeof(struct cbst)
+    + (size_t)tree->capacity * (sizeof(struct cbst_node) + sizeof(void*));
+}
+
+/*
+ * Returns the index of a free node slot holding `key` and `value`, with no
+ * children.  This may move the node array, so indices must not be
+ * dereferenced through pointers taken before the call.
+ */
+static uint32_t node_alloc(struct cbst* tree, int key, void* value) {
+  uint32_t i = tree->free_list;
+  if (i != 0) {
+    tree->free_list = tree->nodes[i].left;
+  } else {
+    if (tree->used == tree->capacity) {
+      assert(tree->capacity <= UINT32_MAX / 2);
+      tree->capacity *= 2;
+      tree->nodes = realloc(tree->nodes,
+        tree->capacity * sizeof(struct cbst_node));
+      tree->values = realloc(tree->values, tree->capacity * sizeof(void*));
+      assert(tree->nodes && tree->values);
+    }
+    i = tree->used++;
+  }
+  tree->nodes[i].key = key;
+  tree->nodes[i].left = tree->nodes[i].right = 0;
+  tree->nodes[i].size = 1;
+  tree->values[i] = value;
+  return i;
+}
+
+/*
+ * Returns the node slot `i` to the free list.
+ */
+static void node_release(struct cbst* tree, uint32_t i) {
+  tree->nodes[i].left = tree->free_list;
+  tree->free_list = i;
+}
+
+/*
+ * Returns the weight of the subtree rooted at `i` (its size plus one).  The
+ * result is 64 bits wide so that it can be multiplied by the balance
+ * parameters without overflowing.
+ */
+static inline uint64_t weight(struct cbst_node* nodes, uint32_t i) {
+  return (uint64_t)nodes[i].size + 1;
+}
+
+/*
+ * Recomputes the size of node `i` from those of its children.
+ */
+static inline void update(struct cbst_node* nodes, uint32_t i) {
+  nodes[i].size = nodes[nodes[i].left].size + nodes[nodes[i].right].size + 1;
+}
+
+/*
+ * These functions perform single rotations around node `i` and return the
+ * index of the node that takes its place.
+ */
+static uint32_t rotate_left(struct cbst_node* nodes, uint32_t i) {
+  uint32_t r = nodes[i].right;
+  nodes[i].right = nodes[r].left;
+  nodes[r].left = i;
+  update(nodes, i);
+  update(nodes, r);
+  return r;
+}
+
+static uint32_t rotate_right(struct cbst_node* nodes, uint32_t i) {
+  uint32_t l = nodes[i].left;
+  nodes[i].left = nodes[l].right;
+  nodes[l].right = i;
+  update(nodes, i);
+  update(nodes, l);
+  return l;
+}
+
+/*
+ * Restores the weight balance of node `i` after one of its subtrees grew or
+ * shrank by one node, and returns the index of the node that takes its
+ * place.  Its subtrees must themselves be balanced.
+ */
+static uint32_t balance(struct cbst_node* nodes, uint32_t i) {
+  uint32_t l = nodes[i].left, r = nodes[i].right;
+  if (weight(nodes, r) > CBST_DELTA * weight(nodes, l)) {
+    if (weight(nodes, nodes[r].left) >= CBST_GAMMA
+        * weight(nodes, nodes[r].right)) {
+      nodes[i].right = rotate_right(nodes, r);
+    }
+    return rotate_left(nodes, i);
+  }
+  if (weight(nodes, l) > CBST_DELTA * weight(nodes, r)) {
+    if (weight(nodes, nodes[l].right) >= CBST_GAMMA
+        * weight(nodes, nodes[l].left)) {
+      nodes[i].left = rotate_left(nodes, l);
+    }
+    return rotate_right(nodes, i);
+  }
+  update(nodes, i);
+  return i;
+}
+
+/*
+ * Links the detached node `n` into the subtree rooted at `i`, after every key
+ * equal to its own, and returns the index of the subtree's new root.
+ */
+static uint32_t insert_rec(struct cbst_node* nodes, uint32_t i, uint32_t n) {
+  if (i == 0) {
+    return n;
+  }
+  if (nodes[n].key < nodes[i].key) {
+    nodes[i].left = insert_rec(nodes, nodes[i].left, n);
+  } else {
+    nodes[i].right = insert_rec(nodes, nodes[i].right, n);
+  }
+  return balance(nodes, i);
+}
+
+/*
+ * This function inserts a new key/value pair into a compact tree.  If the
+ * key is already present, the new pair is placed after the existing ones.
+ *
+ * Params:
+ *   tree - the tree into which to insert.  May not be NULL.
+ *   key - the key used to order the new pair.
+ *   value - the value to store alongside the key.
+ */
+void cbst_insert(struct cbst* tree, int key, void* value) {
+  assert(tree);
+  uint32_t n = node_alloc(tree, key, value);
+  tree->root = insert_rec(tree->nodes, tree->root, n);
+}
+
+/*
+ * Returns the index of the first node holding `key` on the search path from
+ * the root, or 0 if there is none.
+ */
+static uint32_t find(struct cbst* tree, int key) {
+  struct cbst_node* nodes = tree->nodes;
+  uint32_t i = tree->root;
+  while (i != 0 && nodes[i].key != key) {
+    i = key < nodes[i].key ? nodes[i].left : nodes[i].right;
+  }
+  return i;
+}
+
+/*
+ * This function stores a value under a key in a compact tree, replacing the
+ * value of a pair with that key in place if there is one, and inserting a
+ * new pair (see cbst_insert()) otherwise.
+ *
+ * Params:
+ *   tree - the tree in which to store the value.  May not be NULL.
+ *   key - the key under which to store the value.
+ *   value - the value to store.
+ *   old - if not NULL and the key is already present, the value it replaces
+ *     is stored at this address.
+ *
+ * Return:
+ *   Returns 1 if the key was already present, or 0 if a new pair was
+ *   inserted.
+ */
+int cbst_upsert(struct cbst* tree, int key, void* value, void** old) {
+  assert(tree);
+  uint32_t i = find(tree, key);
+  if (i == 0) {
+    cbst_insert(tree, key, value);
+    return 0;
+  }
+  if (old) {
+    *old = tree->values[i];
+  }
+  tree->values[i] = value;
+  return 1;
+}
+
+/*
+ * Unlinks the node with the smallest key from the nonempty subtree rooted at
+ * `i`, stores its index in `*min` and returns the index of the subtree's new
+ * root.
+ */
+static uint32_t remove_min(struct cbst_node* nodes, uint32_t i,
+    uint32_t* min) {
+  if (nodes[i].left == 0) {
+    *min = i;
+    return nodes[i].right;
+  }
+  nodes[i].left = remove_min(nodes, nodes[i].left, min);
+  return balance(nodes, i);
+}
+
+/*
+ * Unlinks the first node holding `key` on the search path from `i`, stores
+ * its index in `*removed` (left untouched if there is no such node) and
+ * returns the index of the subtree's new root.
+ */
+static uint32_t remove_rec(struct cbst_node* nodes, uint32_t i, int key,
+    uint32_t* removed) {
+  if (i == 0) {
+    return 0;
+  }
+  if (key < nodes[i].key) {
+    nodes[i].left = remove_rec(nodes, nodes[i].left, key, removed);
+  } else if (key > nodes[i].key) {
+    nodes[i].right = remove_rec(nodes, nodes[i].right, key, removed);
+  } else {
+    *removed = i;
+    if (nodes[i].left == 0) {
+      return nodes[i].right;
+    }
+    if (nodes[i].right == 0) {
+      return nodes[i].left;
+    }
+
+    /*
+     * Replace the node with the smallest node of its right subtree, which
+     * keeps equal keys in insertion order.
+     */
+    uint32_t min;
+    uint32_t right = remove_min(nodes, nodes[i].right, &min);
+    nodes[min].left = nodes[i].left;
+    nodes[min].right = right;
+    i = min;
+  }
+  return balance(nodes, i);
+}
+
+/*
+ * This function removes a key/value pair with a given key from a compact
+ * tree.  If there are several, the first one on the search path from the
+ * root is removed, as in bst.c.
+ *
+ * Params:
+ *   tree - the tree from which to remove a pair.  May not be NULL.
+ *   key - the key of the pair to be removed.
+ *
+ * Return:
+ *   Returns 1 if a pair was removed and 0 otherwise.
+ */
+int cbst_remove(struct cbst* tree, int key) {
+  assert(tree);
+  uint32_t removed = 0;
+  tree->root = remove_rec(tree->nodes, tree->root, key, &removed);
+  if (removed == 0) {
+    return 0;
+  }
+  node_release(tree, removed);
+  return 1;
+}
+
+/*
+ * This function returns the value associated with a key in a compact tree,
+ * or NULL if the key is not present.  If there are several pairs with the
+ * key, the value of the first one on the search path from the root is
+ * returned, as in bst.c.
+ *
+ * Params:
+ *   tree - the tree to search.  May not be NULL.
+ *   key - the key whose value is to be returned.
+ */
+void* cbst_get(struct cbst* tree, int key) {
+  assert(tree);
+  return tree->values[find(tree, key)];
+}
+
+/*
+ * This function finds the pair of a compact tree that comes `k`-th in key
+ * order (counting from 0).
+ *
+ * Params:
+ *   tree - the tree to search.  May not be NULL.
+ *   k - the position of the pair to find.
+ *   value - if not NULL, the value of the pair is stored at this address.
+ *
+ * Return:
+ *   Returns the key of the `k`-th pair.  `k` must be less than the size of
+ *   the tree.
+ */
+int cbst_select(struct cbst* tree, int k, void** value) {
+  assert(tree && k >= 0 && k < cbst_size(tree));
+  struct cbst_node* nodes = tree->nodes;
+  uint32_t i = tree->root;
+  uint32_t pos = (uint32_t)k;
+  for (;;) {
+    uint32_t left = nodes[nodes[i].left].size;
+    if (pos == left) {
+      break;
+    }
+    if (pos < left) {
+      i = nodes[i].left;
+    } else {
+      pos -= left + 1;
+      i = nodes[i].right;
+    }
+  }
+  if (value) {
+    *value = tree->values[i];
+  }
+  return nodes[i].key;
+}
+
+/*
+ * This function counts the pairs of a compact tree whose keys are less than
+ * `key`, or less than or equal to it if `inclusive` is nonzero.
+ *
+ * Params:
+ *   tree - the tree to search.  May not be NULL.
+ *   key - the key to rank.
+ *   inclusive - whether pairs with the key itself are counted.
+ */
+int cbst_rank(struct cbst* tree, int key, int inclusive) {
+  assert(tree);
+  struct cbst_node* nodes = tree->nodes;
+  uint32_t i = tree->root;
+  int rank = 0;
+  while (i != 0) {
+    if (key < nodes[i].key || (key == nodes[i].key && !inclusive)) {
+      i = nodes[i].left;
+    } else {
+      rank += nodes[nodes[i].left].size + 1;
+      i = nodes[i].right;
+    }
+  }
+  return rank;
+}
+
+/*
+ * This function returns the height of a compact tree, i.e. the number of
+ * edges on its longest root-to-leaf path, or -1 if the tree is empty.  It
+ * walks the whole tree with an explicit stack.
+ */
+int cbst_height(struct cbst* tree) {
+  assert(tree);
+  if (tree->root == 0) {
+    return -1;
+  }
+  struct cbst_node* nodes = tree->nodes;
+  uint32_t stack[CBST_MAX_DEPTH];
+  int depths[CBST_MAX_DEPTH];
+  int top = 0, height = 0;
+  stack[0] = tree->root;
+  depths[0] = 0;
+  while (top >= 0) {
+    uint32_t i = stack[top];
+    int depth = depths[top--];
+    if (depth > height) {
+      height = depth;
+    }
+    if (nodes[i].left != 0) {
+      stack[++top] = nodes[i].left;
+      depths[top] = depth + 1;
+    }
+    if (nodes[i].right != 0) {
+      stack[++top] = nodes[i].right;
+      depths[top] = depth + 1;
+    }
+  }
+  return height;
+}
+
+/*
+ * Positions `iter` on the first pair of `tree` whose key is greater than or
+ * equal to `lower`, to stop after `upper`.
+ */
+static void seek(struct cbst_iter* iter, struct cbst* tree, int lower,
+    int upper) {
+  struct cbst_node* nodes = tree->nodes;
+  iter->tree = tree;
+  iter->upper = upper;
+  iter->top = -1;
+  for (uint32_t i = tree->root; i != 0; ) {
+    if (nodes[i].key < lower) {
+      i = nodes[i].right;
+    } else {
+      iter->stack[++iter->top] = i;
+      i = nodes[i].left;
+    }
+  }
+}
+
+/*
+ * This function computes the sum of all keys in a compact tree between
+ * `lower` and `upper` (both inclusive), by iterating over them.  Nodes
+ * don't record key sums, which would take another 8 bytes each, so this
+ * takes time proportional to the number of keys in the range.
+ *
+ * Params:
+ *   tree - the tree within which to compute a range sum.  May not be NULL.
+ *   lower - the inclusive lower bound of the range.
+ *   upper - the inclusive upper bound of the range.
+ */
+long long cbst_range_sum(struct cbst* tree, int lower, int upper) {
+  assert(tree);
+  struct cbst_iter iter;
+  long long sum = 0;
+  seek(&iter, tree, lower, upper);
+  while (cbst_iter_has_next(&iter)) {
+    sum += cbst_iter_next(&iter, NULL);
+  }
+  return sum;
+}
+
+/*
+ * Pushes node `i` and the nodes down its leftmost path onto an iterator's
+ * stack.
+ */
+static void push_left(struct cbst_iter* iter, uint32_t i) {
+  struct cbst_node* nodes = iter->tree->nodes;
+  while (i != 0) {
+    iter->stack[++iter->top] = i;
+    i = nodes[i].left;
+  }
+}
+
+/*
+ * This function creates an in-order iterator over the pairs of a compact
+ * tree whose keys lie between `lower` and `upper` (both inclusive).  The
+ * tree must not be modified while the iterator is in use.
+ *
+ * Params:
+ *   tree - the tree over which to iterate.  May not be NULL.
+ *   lower - the smallest key to return.
+ *   upper - the largest key to return.
+ */
+struct cbst_iter* cbst_iter_create(struct cbst* tree, int lower, int upper) {
+  assert(tree);
+  struct cbst_iter* iter = malloc(sizeof(struct cbst_iter));
+  seek(iter, tree, lower, upper);
+  return iter;
+}
+
+/*
+ * This function frees an iterator created with cbst_iter_create().
+ */
+void cbst_iter_free(struct cbst_iter* iter) {
+  free(iter);
+}
+
+/*
+ * This function returns 1 if an iterator has pairs left to return and 0
+ * otherwise.
+ */
+int cbst_iter_has_next(struct cbst_iter* iter) {
+  return iter->top >= 0
+    && iter->tree->nodes[iter->stack[iter->top]].key <= iter->upper;
+}
+
+/*
+ * This function advances an iterator to its next pair.
+ *
+ * Params:
+ *   iter - the iterator to advance.  Must have pairs left.
+ *   value - if not NULL, the value of the pair is stored at this address.
+ *
+ * Return:
+ *   Returns the key of the pair.
+ */
+int cbst_iter_next(struct cbst_iter* iter, void** value) {
+  assert(cbst_iter_has_next(iter));
+  uint32_t i = iter->stack[iter->top--];
+  if (value) {
+    *value = iter->tree->values[i];
+  }
+  push_left(iter, iter->tree->nodes[i].right);
+  return iter->tree->nodes[i].key;
+}
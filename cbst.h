@@ -0,0 +1,52 @@
+/*
+ * This file contains the definition of the interface for a compact binary
+ * search tree, whose nodes live in one contiguous array and refer to their
+ * children by 32-bit index.  It is used as the backend of BSTs created in
+ * BST_COMPACT mode.  You can find descriptions of the compact tree
+ * functions, including their parameters and their return values, in cbst.c.
+ */
+
+#ifndef __CBST_H
+#define __CBST_H
+
+#include <stddef.h>
+
+/*
+ * Structure used to represent a compact binary search tree.
+ */
+struct cbst;
+
+/*
+ * Structure used to represent an in-order iterator over a compact binary
+ * search tree.
+ */
+struct cbst_iter;
+
+/*
+ * Compact binary search tree interface function prototypes.  Refer to cbst.c
+ * for documentation about each of these functions.
+ */
+struct cbst* cbst_create();
+void cbst_free(struct cbst* tree);
+int cbst_size(struct cbst* tree);
+int cbst_height(struct cbst* tree);
+size_t cbst_memory(struct cbst* tree);
+void cbst_insert(struct cbst* tree, int key, void* value);
+int cbst_upsert(struct cbst* tree, int key, void* value, void** old);
+int cbst_remove(struct cbst* tree, int key);
+void* cbst_get(struct cbst* tree, int key);
+int cbst_select(struct cbst* tree, int k, void** value);
+int cbst_rank(struct cbst* tree, int key, int inclusive);
+long long cbst_range_sum(struct cbst* tree, int lower, int upper);
+
+/*
+ * Compact binary search tree iterator prototypes.  Refer to cbst.c for
+ * documentation about each of these functions.
+ */
+struct cbst_iter* cbst_iter_create(struct cbst* tree, int lower,
+    int upper);
+void cbst_iter_free(struct cbst_iter* iter);
+int cbst_iter_has_next(struct cbst_iter* iter);
+int cbst_iter_next(struct cbst_iter* iter, void** value);
+
+#endif
@@ -0,0 +1,270 @@
+/*
+ * This file contains an implementation of epoch-based memory reclamation.
+ * See the documentation below for more information on the individual
+ * functions in this implementation.
+ *
+ * Readers bracket every access to the shared structure with epoch_enter()
+ * and epoch_exit(), which only write to a slot owned by the calling thread,
+ * so readers never wait for each other or for writers.  A thread that
+ * unlinks a piece of memory hands it to epoch_retire() instead of freeing
+ * it.  The domain keeps a global epoch counter, which can only move forward
+ * once every reader inside a critical section has observed its current
+ * value.  Memory retired in epoch e is therefore unreachable by any reader
+ * once the global epoch reaches e + 2, and is only then passed to the
+ * domain's reclaim function.
+ *
+ * Each thread retires memory into lists kept in its own slot, so several
+ * threads may retire memory concurrently.  The reclaim function is always
+ * called by a thread that is inside epoch_retire() (or by epoch_free()).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+
+#include "epoch.h"
+
+/*
+ * Maximum number of threads that may use epoch domains at the same time.
+ * Thread ids are handed back when a thread exits, so this only limits how
+ * many threads can be alive at once.
+ */
+#define EPOCH_MAX_THREADS 128
+
+/*
+ * Number of memory blocks a thread retires between attempts to advance the
+ * global epoch and reclaim memory.
+ */
+#define EPOCH_COLLECT_EVERY 64
+
+/*
+ * This structure holds the memory a thread retired during a single epoch,
+ * in a growable array.
+ */
+struct epoch_limbo {
+  void** items;
+  int n;
+  int capacity;
+  unsigned long epoch;
+};
+
+/*
+ * This structure represents one thread's view of an epoch domain.  `active`
+ * is 0 while the thread is outside any critical section, and otherwise
+ * holds the epoch it observed on entry, shifted left by one with the low bit
+ * set.  `nest` counts nested epoch_enter() calls.  Retired memory sits in
+ * the three limbo lists, indexed by retirement epoch modulo 3.  Slots are
+ * padded to a multiple of a cache line so that readers on different cores
+ * don't contend for the same line.
+ */
+struct epoch_slot {
+  unsigned long active;
+  int nest;
+  int retired;
+  struct epoch_limbo limbo[3];
+  char pad[64 - (2 * sizeof(unsigned long) + 3 * sizeof(struct epoch_limbo))
+    % 64];
+};
+
+/*
+ * This structure represents an epoch reclamation domain.
+ */
+struct epoch {
+  unsigned long global;
+  void (*reclaim)(void* arg, void* ptr);
+  void* arg;
+  struct epoch_slot slots[EPOCH_MAX_THREADS];
+};
+
+/*
+ * Thread ids are process-wide and handed out on first use.  `thread_id` is
+ * the calling thread's id (or -1 if it doesn't have one yet), `ids_in_use`
+ * records which ids are taken, and `id_key` makes sure a thread's id is
+ * handed back when it exits.
+ */
+static __thread int thread_id = -1;
+static int ids_in_use[EPOCH_MAX_THREADS];
+static pthread_key_t id_key;
+static pthread_once_t id_key_once = PTHREAD_ONCE_INIT;
+
+static void release_thread_id(void* id) {
+  __atomic_store_n(&ids_in_use[(long)id - 1], 0, __ATOMIC_RELEASE);
+}
+
+static void create_id_key() {
+  pthread_key_create(&id_key, release_thread_id);
+}
+
+/*
+ * Returns the calling thread's id, claiming a free one if it doesn't have
+ * one yet.  Aborts the program if all EPOCH_MAX_THREADS ids are taken, since
+ * the thread would otherwise have no slot to announce its reads in.
+ */
+static int get_thread_id() {
+  if (thread_id >= 0) {
+    return thread_id;
+  }
+  pthread_once(&id_key_once, create_id_key);
+  for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+    int expected = 0;
+    if (__atomic_compare_exchange_n(&ids_in_use[i], &expected, 1, 0,
+        __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+      thread_id = i;
+      pthread_setspecific(id_key, (void*)(long)(i + 1));
+      return i;
+    }
+  }
+  fprintf(stderr, "epoch: more than %d threads using epoch reclamation\n",
+    EPOCH_MAX_THREADS);
+  abort();
+}
+
+/*
+ * This function allocates and initializes a new epoch domain.
+ *
+ * Params:
+ *   reclaim - the function called to actually free each block of retired
+ *     memory once no reader can be using it.
+ *   arg - passed as the first argument to every call to `reclaim`.
+ */
+struct epoch* epoch_create(void (*reclaim)(void* arg, void* ptr), void* arg) {
+  struct epoch* epoch = calloc(1, sizeof(struct epoch));
+  epoch->global = 1;
+  epoch->reclaim = reclaim;
+  epoch->arg = arg;
+  return epoch;
+}
+
+/*
+ * Passes every block of memory in a limbo list to the reclaim function and
+ * empties the list.
+ */
+static void limbo_reclaim(struct epoch* epoch, struct epoch_limbo* limbo) {
+  for (int i = 0; i < limbo->n; i++) {
+    epoch->reclaim(epoch->arg, limbo->items[i]);
+  }
+  limbo->n = 0;
+}
+
+/*
+ * This function frees an epoch domain, first reclaiming all memory that is
+ * still waiting to be reclaimed.  No thread may be inside a critical section
+ * of the domain when it is freed.
+ *
+ * Params:
+ *   epoch - the epoch domain to be destroyed.  May not be NULL.
+ */
+void epoch_free(struct epoch* epoch) {
+  assert(epoch);
+  for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+    assert(epoch->slots[i].nest == 0);
+    for (int j = 0; j < 3; j++) {
+      limbo_reclaim(epoch, &epoch->slots[i].limbo[j]);
+      free(epoch->slots[i].limbo[j].items);
+    }
+  }
+  free(epoch);
+}
+
+/*
+ * This function starts a read-side critical section on an epoch domain.
+ * Memory reachable from the shared structure after this call won't be
+ * reclaimed until the matching call to epoch_exit().  Critical sections may
+ * be nested.
+ *
+ * Params:
+ *   epoch - the epoch domain.  May not be NULL.
+ */
+void epoch_enter(struct epoch* epoch) {
+  struct epoch_slot* slot = &epoch->slots[get_thread_id()];
+  if (slot->nest++ > 0) {
+    return;
+  }
+  unsigned long global = __atomic_load_n(&epoch->global, __ATOMIC_RELAXED);
+  __atomic_store_n(&slot->active, (global << 1) | 1, __ATOMIC_RELAXED);
+
+  /*
+   * Make the announcement visible before reading anything from the shared
+   * structure.
+   */
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+/*
+ * This function ends a read-side critical section started with
+ * epoch_enter().  Pointers obtained inside the critical section must not be
+ * used after it ends.
+ *
+ * Params:
+ *   epoch - the epoch domain.  May not be NULL.
+ */
+void epoch_exit(struct epoch* epoch) {
+  struct epoch_slot* slot = &epoch->slots[get_thread_id()];
+  assert(slot->nest > 0);
+  if (--slot->nest == 0) {
+    __atomic_store_n(&slot->active, 0, __ATOMIC_RELEASE);
+  }
+}
+
+/*
+ * Tries to advance the global epoch, which succeeds only if every thread
+ * currently inside a critical section has observed the current epoch.
+ * Returns the (possibly new) global epoch.
+ */
+static unsigned long try_advance(struct epoch* epoch) {
+  unsigned long global = __atomic_load_n(&epoch->global, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  for (int i = 0; i < EPOCH_MAX_THREADS; i++) {
+    unsigned long active = __atomic_load_n(&epoch->slots[i].active,
+      __ATOMIC_ACQUIRE);
+    if ((active & 1) && (active >> 1) != global) {
+      return global;
+    }
+  }
+  __atomic_compare_exchange_n(&epoch->global, &global, global + 1, 0,
+    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+  return __atomic_load_n(&epoch->global, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * This function hands a block of memory that has been unlinked from the
+ * shared structure over to an epoch domain.  The domain passes it to its
+ * reclaim function once no reader can still be using it.  Every so often,
+ * this also tries to advance the global epoch and reclaims the calling
+ * thread's retired memory that has become safe to reclaim.
+ *
+ * Params:
+ *   epoch - the epoch domain.  May not be NULL.
+ *   ptr - the memory to retire.  It must no longer be reachable by readers
+ *     that enter a critical section after this call.
+ */
+void epoch_retire(struct epoch* epoch, void* ptr) {
+  struct epoch_slot* slot = &epoch->slots[get_thread_id()];
+  unsigned long global = __atomic_load_n(&epoch->global, __ATOMIC_ACQUIRE);
+  if (++slot->retired >= EPOCH_COLLECT_EVERY) {
+    slot->retired = 0;
+    global = try_advance(epoch);
+    for (int i = 0; i < 3; i++) {
+      struct epoch_limbo* limbo = &slot->limbo[i];
+      if (limbo->n > 0 && limbo->epoch + 2 <= global) {
+        limbo_reclaim(epoch, limbo);
+      }
+    }
+  }
+
+  /*
+   * If this epoch's list still holds memory from three or more epochs ago,
+   * that memory is safe to reclaim, so empty it before reusing the list.
+   */
+  struct epoch_limbo* limbo = &slot->limbo[global % 3];
+  if (limbo->epoch != global) {
+    limbo_reclaim(epoch, limbo);
+    limbo->epoch = global;
+  }
+  if (limbo->n == limbo->capacity) {
+    limbo->capacity = limbo->capacity ? limbo->capacity * 2 : 64;
+    limbo->items = realloc(limbo->items, limbo->capacity * sizeof(void*));
+  }
+  limbo->items[limbo->n++] = ptr;
+}
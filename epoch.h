@@ -0,0 +1,31 @@
+/*
+ * This file contains the definition of the interface for epoch-based memory
+ * reclamation, which lets readers traverse a shared data structure without
+ * taking locks while a writer unlinks and retires parts of it.  You can find
+ * descriptions of the epoch functions, including their parameters and their
+ * return values, in epoch.c.
+ *
+ * At most 128 threads may use epoch domains at the same time.  A thread
+ * beyond that aborts the program on its first call to epoch_enter() or
+ * epoch_retire().
+ */
+
+#ifndef __EPOCH_H
+#define __EPOCH_H
+
+/*
+ * Structure used to represent an epoch reclamation domain.
+ */
+struct epoch;
+
+/*
+ * Epoch interface function prototypes.  Refer to epoch.c for documentation
+ * about each of these functions.
+ */
+struct epoch* epoch_create(void (*reclaim)(void* arg, void* ptr), void* arg);
+void epoch_free(struct epoch* epoch);
+void epoch_enter(struct epoch* epoch);
+void epoch_exit(struct epoch* epoch);
+void epoch_retire(struct epoch* epoch, void* ptr);
+
+#endif
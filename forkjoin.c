@@ -0,0 +1,275 @@
+/*
+ * This file contains an implementation of a small work-stealing thread pool
+ * for fork-join computations.  See the documentation below for more
+ * information on the individual functions in this implementation.
+ *
+ * A pool of n threads is made up of the thread that created it plus n - 1
+ * worker threads.  Each of them owns a deque of spawned tasks.  A thread
+ * pushes the tasks it spawns onto the bottom of its own deque and, when it
+ * needs work, pops from the bottom again, so it runs its own tasks in
+ * depth-first order.  A thread whose deque is empty steals from the top of
+ * another thread's deque, taking the oldest (and so usually largest) task.
+ * A thread waiting to join a task keeps running other tasks until the one it
+ * is waiting for is done, so no thread ever blocks.
+ *
+ * Deques are protected by a lock each.  Tasks are expected to be coarse
+ * (callers stop spawning below a sequential cutoff), so the lock is rarely
+ * contended.
+ */
+
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdlib.h>
+#include <assert.h>
+#include <pthread.h>
+#include <sched.h>
+
+#include "forkjoin.h"
+
+/*
+ * Maximum number of tasks waiting in a single deque.  A thread whose deque
+ * is full runs the tasks it spawns right away instead.
+ */
+#define FJ_DEQUE_CAPACITY 1024
+
+/*
+ * This structure represents one thread's deque of spawned tasks.  Tasks
+ * `tasks[top..bottom)` are waiting to run.  Deques are padded so that the
+ * lock of one deque doesn't share a cache line with the end of another.
+ * `top` and `bottom` only change with the lock held, but are always written
+ * atomically, so that steal() may read them without the lock to skip empty
+ * deques.
+ */
+struct fj_deque {
+  pthread_mutex_t lock;
+  int top;
+  int bottom;
+  struct fj_task* tasks[FJ_DEQUE_CAPACITY];
+  char pad[64];
+};
+
+/*
+ * This structure represents a pool.  `deques[0]` belongs to the thread that
+ * created the pool, and `deques[i]` to the worker thread `threads[i - 1]`.
+ * Workers run until `shutdown` is set.
+ */
+struct fj_pool {
+  int n;
+  int shutdown;
+  struct fj_deque* deques;
+  pthread_t* threads;
+};
+
+/*
+ * The pool the calling thread belongs to, and the index of its deque in
+ * that pool.
+ */
+static __thread struct fj_pool* self_pool = NULL;
+static __thread int self_index = 0;
+
+/*
+ * Pops the newest task from the calling thread's own deque, or returns NULL
+ * if it is empty.
+ */
+static struct fj_task* pop_own(struct fj_pool* pool) {
+  struct fj_deque* deque = &pool->deques[self_index];
+  struct fj_task* task = NULL;
+  pthread_mutex_lock(&deque->lock);
+  int bottom = deque->bottom;
+  if (bottom > deque->top) {
+    task = deque->tasks[bottom - 1];
+    __atomic_store_n(&deque->bottom, bottom - 1, __ATOMIC_RELAXED);
+  }
+  pthread_mutex_unlock(&deque->lock);
+  return task;
+}
+
+/*
+ * Steals the oldest task from some other thread's deque, or returns NULL if
+ * every deque it looked at was empty.  Victims are tried in turn, starting
+ * at the thread after the calling one.
+ */
+static struct fj_task* steal(struct fj_pool* pool) {
+  for (int i = 1; i < pool->n; i++) {
+    struct fj_deque* deque = &pool->deques[(self_index + i) % pool->n];
+    if (__atomic_load_n(&deque->bottom, __ATOMIC_RELAXED)
+        <= __atomic_load_n(&deque->top, __ATOMIC_RELAXED)) {
+      continue;
+    }
+    struct fj_task* task = NULL;
+    pthread_mutex_lock(&deque->lock);
+    int top = deque->top;
+    if (deque->bottom > top) {
+      task = deque->tasks[top];
+      __atomic_store_n(&deque->top, top + 1, __ATOMIC_RELAXED);
+    }
+    pthread_mutex_unlock(&deque->lock);
+    if (task != NULL) {
+      return task;
+    }
+  }
+  return NULL;
+}
+
+/*
+ * Runs a task and marks it as done.
+ */
+static void run_task(struct fj_pool* pool, struct fj_task* task) {
+  task->fn(pool, task->arg);
+  __atomic_store_n(&task->done, 1, __ATOMIC_RELEASE);
+}
+
+/*
+ * Arguments passed to a worker thread.
+ */
+struct fj_worker_arg {
+  struct fj_pool* pool;
+  int index;
+};
+
+/*
+ * Main loop of a worker thread, which runs and steals tasks until the pool
+ * shuts down.
+ */
+static void* worker_loop(void* arg) {
+  struct fj_worker_arg* wa = arg;
+  self_pool = wa->pool;
+  self_index = wa->index;
+  struct fj_pool* pool = wa->pool;
+  free(wa);
+  while (!__atomic_load_n(&pool->shutdown, __ATOMIC_ACQUIRE)) {
+    struct fj_task* task = pop_own(pool);
+    if (task == NULL) {
+      task = steal(pool);
+    }
+    if (task != NULL) {
+      run_task(pool, task);
+    } else {
+      sched_yield();
+    }
+  }
+  return NULL;
+}
+
+/*
+ * This function creates a pool of `threads` threads, including the calling
+ * thread, which takes part in the pool's work whenever it spawns or joins
+ * tasks.  The extra threads look for work until the pool is freed, so a
+ * pool should only be kept around while there is work for it.
+ *
+ * Params:
+ *   threads - the number of threads in the pool.  Must be at least 1.
+ */
+struct fj_pool* fj_pool_create(int threads) {
+  assert(threads >= 1);
+  struct fj_pool* pool = malloc(sizeof(struct fj_pool));
+  pool->n = threads;
+  pool->shutdown = 0;
+  pool->deques = malloc(threads * sizeof(struct fj_deque));
+  pool->threads = malloc(threads * sizeof(pthread_t));
+  for (int i = 0; i < threads; i++) {
+    pthread_mutex_init(&pool->deques[i].lock, NULL);
+    pool->deques[i].top = 0;
+    pool->deques[i].bottom = 0;
+  }
+  self_pool = pool;
+  self_index = 0;
+  for (int i = 1; i < threads; i++) {
+    struct fj_worker_arg* wa = malloc(sizeof(struct fj_worker_arg));
+    wa->pool = pool;
+    wa->index = i;
+    pthread_create(&pool->threads[i - 1], NULL, worker_loop, wa);
+  }
+  return pool;
+}
+
+/*
+ * This function stops the worker threads of a pool and frees it.  Every
+ * spawned task must have been joined.
+ *
+ * Params:
+ *   pool - the pool to be destroyed.  May not be NULL.
+ */
+void fj_pool_free(struct fj_pool* pool) {
+  assert(pool);
+  __atomic_store_n(&pool->shutdown, 1, __ATOMIC_RELEASE);
+  for (int i = 1; i < pool->n; i++) {
+    pthread_join(pool->threads[i - 1], NULL);
+  }
+  for (int i = 0; i < pool->n; i++) {
+    assert(pool->deques[i].bottom == pool->deques[i].top);
+    pthread_mutex_destroy(&pool->deques[i].lock);
+  }
+  if (self_pool == pool) {
+    self_pool = NULL;
+  }
+  free(pool->threads);
+  free(pool->deques);
+  free(pool);
+}
+
+/*
+ * This function makes a task available to run on any thread of a pool.  It
+ * may only be called by the thread that created the pool or from within a
+ * task, and the caller must join the task before `task` goes out of scope.
+ *
+ * Params:
+ *   pool - the pool to run the task on.  May not be NULL.
+ *   task - storage for the task, which is initialized by this call.
+ *   fn - the function the task runs.
+ *   arg - passed to `fn` along with the pool.
+ */
+void fj_spawn(struct fj_pool* pool, struct fj_task* task,
+    void (*fn)(struct fj_pool* pool, void* arg), void* arg) {
+  assert(self_pool == pool);
+  task->fn = fn;
+  task->arg = arg;
+  task->done = 0;
+  struct fj_deque* deque = &pool->deques[self_index];
+  pthread_mutex_lock(&deque->lock);
+  if (deque->bottom == FJ_DEQUE_CAPACITY && deque->top > 0) {
+    /*
+     * Slide the waiting tasks back to the start of the array.
+     */
+    int n = deque->bottom - deque->top;
+    for (int i = 0; i < n; i++) {
+      deque->tasks[i] = deque->tasks[deque->top + i];
+    }
+    __atomic_store_n(&deque->top, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&deque->bottom, n, __ATOMIC_RELAXED);
+  }
+  int bottom = deque->bottom;
+  if (bottom < FJ_DEQUE_CAPACITY) {
+    deque->tasks[bottom] = task;
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    task = NULL;
+  }
+  pthread_mutex_unlock(&deque->lock);
+  if (task != NULL) {
+    run_task(pool, task);
+  }
+}
+
+/*
+ * This function waits for a spawned task to finish, running other tasks of
+ * the pool in the meantime.  Once it returns, everything the task wrote is
+ * visible to the caller.
+ *
+ * Params:
+ *   pool - the pool the task was spawned on.  May not be NULL.
+ *   task - the task to wait for.  May not be NULL.
+ */
+void fj_join(struct fj_pool* pool, struct fj_task* task) {
+  assert(self_pool == pool);
+  while (!__atomic_load_n(&task->done, __ATOMIC_ACQUIRE)) {
+    struct fj_task* next = pop_own(pool);
+    if (next == NULL) {
+      next = steal(pool);
+    }
+    if (next != NULL) {
+      run_task(pool, next);
+    } else {
+      sched_yield();
+    }
+  }
+}
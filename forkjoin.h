@@ -0,0 +1,39 @@
+/*
+ * This file contains the definition of the interface for a small
+ * work-stealing thread pool that runs fork-join computations, such as
+ * divide-and-conquer walks over the subtrees of a tree.  You can find
+ * descriptions of the fork-join functions, including their parameters and
+ * their return values, in forkjoin.c.
+ */
+
+#ifndef __FORKJOIN_H
+#define __FORKJOIN_H
+
+/*
+ * Structure used to represent a pool of worker threads.
+ */
+struct fj_pool;
+
+/*
+ * Structure used to represent a task that may run on any thread of a pool.
+ * Tasks are usually declared on the stack of the function that spawns them,
+ * which must join them before returning.  `fn` is called with the pool and
+ * `arg`; `done` is set once it has returned.
+ */
+struct fj_task {
+  void (*fn)(struct fj_pool* pool, void* arg);
+  void* arg;
+  int done;
+};
+
+/*
+ * Fork-join interface function prototypes.  Refer to forkjoin.c for
+ * documentation about each of these functions.
+ */
+struct fj_pool* fj_pool_create(int threads);
+void fj_pool_free(struct fj_pool* pool);
+void fj_spawn(struct fj_pool* pool, struct fj_task* task,
+  void (*fn)(struct fj_pool* pool, void* arg), void* arg);
+void fj_join(struct fj_pool* pool, struct fj_task* task);
+
+#endif
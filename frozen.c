@@ -0,0 +1,535 @@
+/*
+ * This file contains an implementation of a frozen BST: an immutable copy of
+ * a BST's keys and values laid out for fast, read-only queries.  See the
+ * documentation below for more information on the individual functions in
+ * this implementation.
+ *
+ * The keys are stored in Eytzinger (breadth-first) order in a single array:
+ * the root is at index 1 and the children of the node at index k are at
+ * indices 2k and 2k + 1.  A search therefore walks down the array with index
+ * arithmetic instead of pointer chasing, and the nodes it will visit a few
+ * levels further down sit next to each other in memory, so they can be
+ * prefetched well before they are needed.  Values are stored in a parallel
+ * array, along with a parallel array of prefix sums that turns any range sum
+ * into two searches and a subtraction.
+ *
+ * None of these arrays hold pointers into each other, so a frozen BST can be
+ * written to a file as is and later mapped back into memory and queried in
+ * place (see bst_frozen_save() and bst_frozen_load()).
+ */
+
+#define _POSIX_C_SOURCE 200112L
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <assert.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "frozen.h"
+
+/*
+ * Keys per 64-byte cache line.  A search prefetches the line holding the
+ * descendants of the current node BST_FROZEN_PREFETCH_LEVELS levels down,
+ * which is exactly the 16 keys starting at index 16k.
+ */
+#define BST_FROZEN_LINE_KEYS 16
+#define BST_FROZEN_PREFETCH_LEVELS 4
+
+/*
+ * This structure represents a frozen BST holding `n` keys.  `keys`, `values`
+ * and `prefix` are indexed by Eytzinger position, from 1 to `n`.  `prefix[k]`
+ * is the sum of all keys that come before `keys[k]` in sorted order, and
+ * `prefix[0]` is the sum of all keys, so that a search that runs off the end
+ * of the tree (and therefore returns position 0) yields the right sum.
+ *
+ * A frozen BST loaded from a file with bst_frozen_load() points straight
+ * into the file's mapping `map` (of `map_size` bytes) instead.  It has no
+ * `values` array, but an array `codes` of the 64-bit codes its values were
+ * saved as, and turns a code back into a value with `decode` only when the
+ * value is asked for.
+ */
+struct bst_frozen {
+  int n;
+  int* keys;
+  void** values;
+  long long* prefix;
+  const unsigned long long* codes;
+  void* (*decode)(void* arg, unsigned long long code);
+  void* decode_arg;
+  void* map;
+  size_t map_size;
+};
+
+/*
+ * Returns the value stored at Eytzinger position `k`.
+ */
+static void* value_at(struct bst_frozen* frozen, int k) {
+  if (frozen->values != NULL) {
+    return frozen->values[k];
+  }
+  unsigned long long code = frozen->codes[k];
+  return frozen->decode ? frozen->decode(frozen->decode_arg, code)
+    : (void*)(size_t)code;
+}
+
+/*
+ * Recursively copies the sorted arrays `keys` and `values`, starting at
+ * index `*next`, into the Eytzinger-ordered subtree of `frozen` rooted at
+ * position `k`, filling in prefix sums along the way.  The recursion depth is
+ * logarithmic in the number of keys.
+ */
+static void fill(struct bst_frozen* frozen, int k, int* keys, void** values,
+    int* next, long long* sum) {
+  if (k > frozen->n) {
+    return;
+  }
+  fill(frozen, 2 * k, keys, values, next, sum);
+  frozen->keys[k] = keys[*next];
+  frozen->values[k] = values[*next];
+  frozen->prefix[k] = *sum;
+  *sum += keys[*next];
+  (*next)++;
+  fill(frozen, 2 * k + 1, keys, values, next, sum);
+}
+
+/*
+ * This function creates a frozen BST from arrays of keys and values.  The
+ * arrays are copied, so the caller keeps ownership of them.
+ *
+ * Params:
+ *   keys - the keys to store, in ascending (non-decreasing) order.
+ *   values - the value associated with each key in `keys`.
+ *   n - the number of keys.
+ *
+ * Return:
+ *   Returns a pointer to the new frozen BST.
+ */
+struct bst_frozen* bst_frozen_create(int* keys, void** values, int n) {
+  assert(n >= 0);
+  struct bst_frozen* frozen = calloc(1, sizeof(struct bst_frozen));
+  frozen->n = n;
+
+  /*
+   * Align the key array to a cache line so that each group of 16 siblings
+   * prefetched by a search occupies exactly one line.
+   */
+  void* aligned;
+  int err = posix_memalign(&aligned, 64, (n + 1) * sizeof(int));
+  assert(err == 0);
+  frozen->keys = aligned;
+  frozen->values = malloc((n + 1) * sizeof(void*));
+  frozen->prefix = malloc((n + 1) * sizeof(long long));
+  frozen->keys[0] = 0;
+  frozen->values[0] = NULL;
+
+  int next = 0;
+  long long sum = 0;
+  fill(frozen, 1, keys, values, &next, &sum);
+  frozen->prefix[0] = sum;
+  return frozen;
+}
+
+/*
+ * This function frees the memory associated with a frozen BST.  It does not
+ * free the values stored in it.
+ *
+ * Params:
+ *   frozen - the frozen BST to be destroyed.  May not be NULL.
+ */
+void bst_frozen_free(struct bst_frozen* frozen) {
+  assert(frozen);
+  if (frozen->map != NULL) {
+    munmap(frozen->map, frozen->map_size);
+    free(frozen);
+    return;
+  }
+  free(frozen->keys);
+  free(frozen->values);
+  free(frozen->prefix);
+  free(frozen);
+}
+
+/*
+ * This function returns the number of keys stored in a frozen BST.
+ */
+int bst_frozen_size(struct bst_frozen* frozen) {
+  assert(frozen);
+  return frozen->n;
+}
+
+/*
+ * Returns the position of the first key in sorted order that is greater than
+ * or equal to `key` (or strictly greater than `key` if `strict` is set), or
+ * 0 if there is no such key.  The loop body has no data-dependent branches:
+ * the comparison result is folded into the index of the next node.  Once the
+ * search falls off the bottom of the tree, the answer is the last node at
+ * which it went left, which is recovered by stripping the trailing right
+ * turns (1 bits) and the final left turn from the index.
+ */
+static int lower_bound(struct bst_frozen* frozen, int key, int strict) {
+  int* keys = frozen->keys;
+  int n = frozen->n;
+  unsigned int k = 1;
+  while (k <= (unsigned int)n) {
+    __builtin_prefetch(keys + BST_FROZEN_LINE_KEYS * k);
+    k = 2 * k + (strict ? keys[k] <= key : keys[k] < key);
+  }
+  return (int)(k >> __builtin_ffs(~k));
+}
+
+/*
+ * This function returns the value associated with a key in a frozen BST.  If
+ * the key is stored more than once, the value of the first copy in sorted
+ * order is returned.
+ *
+ * Params:
+ *   frozen - the frozen BST to search.  May not be NULL.
+ *   key - the key whose value is to be returned.
+ *
+ * Return:
+ *   Returns the value associated with `key`, or NULL if `key` is not stored
+ *   in `frozen`.
+ */
+void* bst_frozen_get(struct bst_frozen* frozen, int key) {
+  assert(frozen);
+  int k = lower_bound(frozen, key, 0);
+  return k != 0 && frozen->keys[k] == key ? value_at(frozen, k) : NULL;
+}
+
+/*
+ * This function computes the sum of all keys in a frozen BST between `lower`
+ * and `upper` (both inclusive), using two searches and the stored prefix
+ * sums.
+ *
+ * Params:
+ *   frozen - the frozen BST within which to compute a range sum.  May not be
+ *     NULL.
+ *   lower - the inclusive lower bound of the range.
+ *   upper - the inclusive upper bound of the range.
+ */
+long long bst_frozen_range_sum(struct bst_frozen* frozen, int lower,
+    int upper) {
+  assert(frozen);
+  if (lower > upper) {
+    return 0;
+  }
+  int first = lower_bound(frozen, lower, 0);
+  int last = lower_bound(frozen, upper, 1);
+  return frozen->prefix[last] - frozen->prefix[first];
+}
+
+/*
+ * These functions iterate over a frozen BST in sorted order.
+ * bst_frozen_first() returns the position of the smallest key, and
+ * bst_frozen_next() returns the position of the key after the one at `pos`.
+ * Both return 0 when there are no more keys.  Moving to the next position
+ * takes amortized constant time.
+ */
+int bst_frozen_first(struct bst_frozen* frozen) {
+  assert(frozen);
+  if (frozen->n == 0) {
+    return 0;
+  }
+  int k = 1;
+  while (2 * k <= frozen->n) {
+    k = 2 * k;
+  }
+  return k;
+}
+
+int bst_frozen_next(struct bst_frozen* frozen, int pos) {
+  assert(frozen && pos > 0);
+  unsigned int k = pos;
+  if (2 * k + 1 <= (unsigned int)frozen->n) {
+    /*
+     * Step into the right subtree, then all the way down to its left.
+     */
+    k = 2 * k + 1;
+    while (2 * k <= (unsigned int)frozen->n) {
+      k = 2 * k;
+    }
+    return (int)k;
+  }
+
+  /*
+   * Climb while we are a right child, then once more to the parent of which
+   * we are in the left subtree.
+   */
+  return (int)(k >> __builtin_ffs(~k));
+}
+
+/*
+ * These functions return the key and value stored at a position returned by
+ * bst_frozen_first() or bst_frozen_next().
+ */
+int bst_frozen_key(struct bst_frozen* frozen, int pos) {
+  return frozen->keys[pos];
+}
+
+void* bst_frozen_value(struct bst_frozen* frozen, int pos) {
+  return value_at(frozen, pos);
+}
+
+/*****************************************************************************
+ **
+ ** Saving and loading
+ **
+ *****************************************************************************/
+
+/*
+ * A saved frozen BST is a header followed by the key, prefix sum and value
+ * code arrays, each starting on a 64-byte boundary and holding n + 1
+ * entries, exactly as they are laid out in memory.  All offsets are from the
+ * start of the file, so the file can be mapped at any address.  Numbers are
+ * stored in the byte order of the machine that saved the file, which is
+ * recorded in `byte_order` so that other machines can refuse the file.
+ *
+ * `header_checksum` covers the header (with that field set to 0), and is
+ * checked on every load.  `data_checksum` covers the three arrays, which
+ * would mean reading the whole file, so it is only checked on request (see
+ * bst_frozen_verify()).
+ */
+#define BST_FROZEN_MAGIC "BSTFROZN"
+#define BST_FROZEN_VERSION 1
+#define BST_FROZEN_BYTE_ORDER 0x01020304u
+
+struct bst_frozen_header {
+  char magic[8];
+  unsigned int version;
+  unsigned int byte_order;
+  unsigned long long n;
+  unsigned long long keys_offset;
+  unsigned long long prefix_offset;
+  unsigned long long codes_offset;
+  unsigned long long file_size;
+  unsigned long long data_checksum;
+  unsigned long long header_checksum;
+};
+
+/*
+ * Returns the offset of the first 64-byte boundary at or after `offset`.
+ */
+static unsigned long long align64(unsigned long long offset) {
+  return (offset + 63) & ~63ULL;
+}
+
+/*
+ * Folds `size` bytes at `data` into the running checksum `h`.  It consumes
+ * eight bytes per step, so checking a large file runs at memory speed.
+ */
+static unsigned long long checksum(unsigned long long h, const void* data,
+    size_t size) {
+  const unsigned char* bytes = data;
+  size_t i = 0;
+  for (; i + 8 <= size; i += 8) {
+    unsigned long long word;
+    memcpy(&word, bytes + i, 8);
+    h = (h ^ word) * 0x100000001b3ULL;
+    h ^= h >> 29;
+  }
+  for (; i < size; i++) {
+    h = (h ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return h;
+}
+
+/*
+ * Returns the checksum of the three arrays of a frozen BST.
+ */
+static unsigned long long data_checksum(const int* keys,
+    const long long* prefix, const unsigned long long* codes, int n) {
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  h = checksum(h, keys, (n + 1) * sizeof(int));
+  h = checksum(h, prefix, (n + 1) * sizeof(long long));
+  return checksum(h, codes, (n + 1) * sizeof(unsigned long long));
+}
+
+static unsigned long long header_checksum(struct bst_frozen_header header) {
+  header.header_checksum = 0;
+  return checksum(0xcbf29ce484222325ULL, &header, sizeof(header));
+}
+
+/*
+ * Writes `size` bytes from `data` to `file` at offset `offset`, padding the
+ * gap from the current position with zeros.  Returns 0 on success or -1 on
+ * error.
+ */
+static int write_at(FILE* file, unsigned long long offset, const void* data,
+    size_t size) {
+  static const char zeros[64];
+  long pos = ftell(file);
+  if (pos < 0 || (unsigned long long)pos > offset) {
+    return -1;
+  }
+  if (fwrite(zeros, 1, offset - pos, file) != offset - pos
+      || fwrite(data, 1, size, file) != size) {
+    return -1;
+  }
+  return 0;
+}
+
+/*
+ * This function writes a frozen BST to a file, from which it can be loaded
+ * back with bst_frozen_load().  Values are stored as 64-bit codes produced
+ * by `encode`, since pointers mean nothing to another process.
+ *
+ * Params:
+ *   frozen - the frozen BST to save.  May not be NULL.
+ *   path - the path of the file to write.  An existing file is replaced.
+ *   encode - the function that turns each value into a code, called with
+ *     `arg` and the value.  If this is NULL, each value's address is stored
+ *     as its code, which is only useful if values aren't real pointers.
+ *   arg - passed as the first argument to every call to `encode`.
+ *
+ * Return:
+ *   Returns 0 on success, or -1 if the file could not be written.
+ */
+int bst_frozen_save(struct bst_frozen* frozen, const char* path,
+    unsigned long long (*encode)(void* arg, void* value), void* arg) {
+  assert(frozen && path);
+  int n = frozen->n;
+  unsigned long long* codes = malloc((n + 1) * sizeof(unsigned long long));
+  codes[0] = 0;
+  for (int k = 1; k <= n; k++) {
+    void* value = value_at(frozen, k);
+    codes[k] = encode ? encode(arg, value) : (unsigned long long)(size_t)value;
+  }
+
+  struct bst_frozen_header header;
+  memset(&header, 0, sizeof(header));
+  memcpy(header.magic, BST_FROZEN_MAGIC, 8);
+  header.version = BST_FROZEN_VERSION;
+  header.byte_order = BST_FROZEN_BYTE_ORDER;
+  header.n = n;
+  header.keys_offset = align64(sizeof(header));
+  header.prefix_offset = align64(header.keys_offset + (n + 1) * sizeof(int));
+  header.codes_offset =
+    align64(header.prefix_offset + (n + 1) * sizeof(long long));
+  header.file_size =
+    header.codes_offset + (n + 1) * sizeof(unsigned long long);
+  header.data_checksum = data_checksum(frozen->keys, frozen->prefix, codes, n);
+  header.header_checksum = header_checksum(header);
+
+  FILE* file = fopen(path, "wb");
+  int err = file == NULL
+    || write_at(file, 0, &header, sizeof(header))
+    || write_at(file, header.keys_offset, frozen->keys, (n + 1) * sizeof(int))
+    || write_at(file, header.prefix_offset, frozen->prefix,
+      (n + 1) * sizeof(long long))
+    || write_at(file, header.codes_offset, codes,
+      (n + 1) * sizeof(unsigned long long));
+  if (file != NULL && fclose(file) != 0) {
+    err = 1;
+  }
+  free(codes);
+  return err ? -1 : 0;
+}
+
+/*
+ * This function maps a file written by bst_frozen_save() into memory and
+ * returns a frozen BST that is queried directly from the mapping.  Nothing
+ * is copied or converted, so loading takes the same short time for any size
+ * of file, and pages are only read from disk once queries touch them.  The
+ * header is checked, but the data is not (see bst_frozen_verify()).  The
+ * mapping is released by bst_frozen_free().  Files whose header doesn't
+ * describe exactly the layout bst_frozen_save() writes are rejected.
+ *
+ * Params:
+ *   path - the path of the file to load.
+ *   decode - the function that turns a saved code back into a value, called
+ *     with `arg` and the code whenever a value is returned.  If this is NULL,
+ *     codes are returned as values cast to void*.
+ *   arg - passed as the first argument to every call to `decode`.
+ *
+ * Return:
+ *   Returns the loaded frozen BST, or NULL if the file could not be mapped
+ *   or is not a valid saved frozen BST of this version and byte order.
+ */
+struct bst_frozen* bst_frozen_load(const char* path,
+    void* (*decode)(void* arg, unsigned long long code), void* arg) {
+  assert(path);
+  int fd = open(path, O_RDONLY);
+  if (fd < 0) {
+    return NULL;
+  }
+  struct stat st;
+  struct bst_frozen_header header;
+  if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(header)) {
+    close(fd);
+    return NULL;
+  }
+  void* map = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (map == MAP_FAILED) {
+    return NULL;
+  }
+
+  memcpy(&header, map, sizeof(header));
+  if (memcmp(header.magic, BST_FROZEN_MAGIC, 8) != 0
+      || header.version != BST_FROZEN_VERSION
+      || header.byte_order != BST_FROZEN_BYTE_ORDER
+      || header.header_checksum != header_checksum(header)
+      || header.file_size != (unsigned long long)st.st_size
+      || header.n >= INT_MAX) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  /*
+   * The checksum above only catches accidental damage, so make sure the
+   * arrays are laid out exactly as bst_frozen_save() lays out `n` keys,
+   * which keeps every query inside the mapping.
+   */
+  unsigned long long n = header.n;
+  unsigned long long keys_offset = align64(sizeof(header));
+  unsigned long long prefix_offset =
+    align64(keys_offset + (n + 1) * sizeof(int));
+  unsigned long long codes_offset =
+    align64(prefix_offset + (n + 1) * sizeof(long long));
+  if (header.keys_offset != keys_offset
+      || header.prefix_offset != prefix_offset
+      || header.codes_offset != codes_offset
+      || header.file_size != codes_offset
+        + (n + 1) * sizeof(unsigned long long)) {
+    munmap(map, st.st_size);
+    return NULL;
+  }
+
+  struct bst_frozen* frozen = calloc(1, sizeof(struct bst_frozen));
+  frozen->n = (int)header.n;
+  frozen->keys = (int*)((char*)map + header.keys_offset);
+  frozen->prefix = (long long*)((char*)map + header.prefix_offset);
+  frozen->codes = (unsigned long long*)((char*)map + header.codes_offset);
+  frozen->decode = decode;
+  frozen->decode_arg = arg;
+  frozen->map = map;
+  frozen->map_size = st.st_size;
+  return frozen;
+}
+
+/*
+ * This function checks the data of a frozen BST loaded with
+ * bst_frozen_load() against the checksum saved with it.  This reads the
+ * whole file, so it is kept separate from loading.
+ *
+ * Params:
+ *   frozen - the frozen BST to check.  May not be NULL.
+ *
+ * Return:
+ *   Returns 1 if the data matches its checksum (or `frozen` was not loaded
+ *   from a file), or 0 if the file has been corrupted.
+ */
+int bst_frozen_verify(struct bst_frozen* frozen) {
+  assert(frozen);
+  if (frozen->map == NULL) {
+    return 1;
+  }
+  const struct bst_frozen_header* header = frozen->map;
+  return data_checksum(frozen->keys, frozen->prefix, frozen->codes,
+    frozen->n) == header->data_checksum;
+}
@@ -0,0 +1,47 @@
+/*
+ * This file contains the definition of the interface for a frozen BST: an
+ * immutable, read-only copy of a BST laid out in contiguous arrays for fast
+ * lookups.  You can find descriptions of the frozen BST functions, including
+ * their parameters and their return values, in frozen.c.
+ */
+
+#ifndef __FROZEN_H
+#define __FROZEN_H
+
+/*
+ * Structure used to represent a frozen BST.
+ */
+struct bst_frozen;
+
+/*
+ * Frozen BST interface function prototypes.  Refer to frozen.c for
+ * documentation about each of these functions.  Frozen BSTs are normally
+ * created from a mutable BST with bst_freeze() (see bst.c).
+ */
+struct bst_frozen* bst_frozen_create(int* keys, void** values, int n);
+void bst_frozen_free(struct bst_frozen* frozen);
+int bst_frozen_size(struct bst_frozen* frozen);
+void* bst_frozen_get(struct bst_frozen* frozen, int key);
+long long bst_frozen_range_sum(struct bst_frozen* frozen, int lower,
+  int upper);
+
+/*
+ * Frozen BST file prototypes.  A saved frozen BST can be mapped back into
+ * memory and queried without being deserialized.
+ */
+int bst_frozen_save(struct bst_frozen* frozen, const char* path,
+  unsigned long long (*encode)(void* arg, void* value), void* arg);
+struct bst_frozen* bst_frozen_load(const char* path,
+  void* (*decode)(void* arg, unsigned long long code), void* arg);
+int bst_frozen_verify(struct bst_frozen* frozen);
+
+/*
+ * Frozen BST iteration prototypes.  Positions are opaque nonzero integers;
+ * a position of 0 means iteration is finished.
+ */
+int bst_frozen_first(struct bst_frozen* frozen);
+int bst_frozen_next(struct bst_frozen* frozen, int pos);
+int bst_frozen_key(struct bst_frozen* frozen, int pos);
+void* bst_frozen_value(struct bst_frozen* frozen, int pos);
+
+#endif
@@ -0,0 +1,481 @@
+/*
+ * This file contains an implementation of a lock-free binary search tree
+ * that stores integer keys with associated void* values.  Any number of
+ * threads may insert, remove and look up keys at the same time, and no
+ * operation ever waits for a lock held by another thread.  See the
+ * documentation below for more information on the individual functions in
+ * this implementation.
+ *
+ * The tree follows Natarajan and Mittal, "Fast Concurrent Lock-Free Binary
+ * Search Trees" (PPoPP 2014).  It is an external tree: key/value pairs live
+ * in the leaves, and internal nodes only route searches (keys less than an
+ * internal node's key are in its left subtree, all others in its right
+ * subtree).  Unlike the trees in bst.c, it stores each key at most once.
+ *
+ * Modifications work on edges rather than nodes.  The low bits of every
+ * child pointer hold two marks: an edge is *flagged* when the leaf it points
+ * to is being removed, and *tagged* when its parent is being removed.  A
+ * marked edge never changes again.  An insert replaces an unmarked edge to
+ * a leaf with a new internal node holding the old and the new leaf, using a
+ * single compare-and-swap.  A remove first flags the edge to its leaf (the
+ * point at which it takes effect), then tags the edge to the leaf's sibling
+ * and swings the nearest unmarked edge above the leaf's parent over to the
+ * sibling, unlinking the parent and the leaf.  Any thread that runs into a
+ * marked edge finishes that removal on the owner's behalf before retrying
+ * its own operation.
+ *
+ * Unlinked nodes are retired through an epoch domain (see epoch.c) and are
+ * only freed once every thread that might still be traversing them has
+ * finished its operation.
+ */
+
+#include <stdlib.h>
+#include <limits.h>
+#include <stdint.h>
+#include <assert.h>
+
+#include "lfbst.h"
+#include "epoch.h"
+
+/*
+ * Marks kept in the low bits of child pointers (see above).  Nodes come from
+ * malloc(), so these bits of a node's address are always 0.
+ */
+#define LFBST_FLAG ((uintptr_t)1)
+#define LFBST_TAG ((uintptr_t)2)
+#define LFBST_MARKS (LFBST_FLAG | LFBST_TAG)
+
+/*
+ * Keys of the three sentinel leaves, which are larger than any int key.
+ */
+#define LFBST_INF0 ((long long)INT_MAX + 1)
+#define LFBST_INF1 ((long long)INT_MAX + 2)
+#define LFBST_INF2 ((long long)INT_MAX + 3)
+
+/*
+ * This structure represents a single node in the tree.  Leaves have NULL
+ * children, and only leaves have values.  `left` and `right` are marked
+ * pointers, and are only ever read and written atomically.  A node's key and
+ * value never change once other threads can see it.
+ */
+struct lfbst_node {
+  long long key;
+  void* value;
+  uintptr_t left;
+  uintptr_t right;
+};
+
+/*
+ * This structure represents an entire lock-free BST.  `root` is the top of
+ * the sentinel structure, which never changes: `root` has key INF2, a
+ * sentinel leaf with key INF2 on its right and an internal node with key INF1
+ * on its left.  That node has a sentinel leaf with key INF1 on its right and
+ * holds the actual tree on its left, under a sentinel leaf with key INF0.
+ * The sentinels ensure that every leaf holding a real key has a parent and a
+ * grandparent.
+ */
+struct lfbst {
+  struct lfbst_node* root;
+  struct epoch* epoch;
+};
+
+/*
+ * This structure holds the result of a search for a key: the leaf the
+ * search ended at, its parent, and the last edge above the parent that was
+ * not tagged when the search passed it, which runs from `ancestor` to
+ * `successor`.
+ */
+struct lfbst_seek {
+  struct lfbst_node* ancestor;
+  struct lfbst_node* successor;
+  struct lfbst_node* parent;
+  struct lfbst_node* leaf;
+};
+
+/*
+ * Helpers for working with marked pointers.
+ */
+static struct lfbst_node* edge_node(uintptr_t edge) {
+  return (struct lfbst_node*)(edge & ~LFBST_MARKS);
+}
+
+static uintptr_t edge_load(uintptr_t* edge) {
+  return __atomic_load_n(edge, __ATOMIC_ACQUIRE);
+}
+
+static int edge_cas(uintptr_t* edge, uintptr_t expected, uintptr_t desired) {
+  return __atomic_compare_exchange_n(edge, &expected, desired, 0,
+    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE);
+}
+
+/*
+ * Returns the edge from `node` that a search for `key` follows.
+ */
+static uintptr_t* edge_toward(struct lfbst_node* node, long long key) {
+  return key < node->key ? &node->left : &node->right;
+}
+
+/*
+ * Allocates a new node with the given key, value and children.
+ */
+static struct lfbst_node* node_create(long long key, void* value,
+    struct lfbst_node* left, struct lfbst_node* right) {
+  struct lfbst_node* node = malloc(sizeof(struct lfbst_node));
+  node->key = key;
+  node->value = value;
+  node->left = (uintptr_t)left;
+  node->right = (uintptr_t)right;
+  return node;
+}
+
+/*
+ * Reclaim function for the tree's epoch domain.
+ */
+static void node_reclaim(void* arg, void* node) {
+  free(node);
+}
+
+/*
+ * This function allocates and initializes a new, empty lock-free BST and
+ * returns a pointer to it.
+ */
+struct lfbst* lfbst_create() {
+  struct lfbst* tree = malloc(sizeof(struct lfbst));
+  struct lfbst_node* s = node_create(LFBST_INF1, NULL,
+    node_create(LFBST_INF0, NULL, NULL, NULL),
+    node_create(LFBST_INF1, NULL, NULL, NULL));
+  tree->root = node_create(LFBST_INF2, NULL, s,
+    node_create(LFBST_INF2, NULL, NULL, NULL));
+  tree->epoch = epoch_create(node_reclaim, NULL);
+  return tree;
+}
+
+/*
+ * This function frees the memory associated with a lock-free BST.  It does
+ * not free the values stored in the tree, which is the responsibility of the
+ * caller.  No other thread may be using the tree when it is freed.
+ *
+ * Params:
+ *   tree - the tree to be destroyed.  May not be NULL.
+ */
+void lfbst_free(struct lfbst* tree) {
+  assert(tree);
+  epoch_free(tree->epoch);
+
+  /*
+   * The tree may be arbitrarily deep, so walk it with an explicit stack.
+   */
+  int cap = 64, top = 0;
+  struct lfbst_node** stack = malloc(cap * sizeof(struct lfbst_node*));
+  stack[top++] = tree->root;
+  while (top > 0) {
+    struct lfbst_node* node = stack[--top];
+    if (top + 2 > cap) {
+      cap *= 2;
+      stack = realloc(stack, cap * sizeof(struct lfbst_node*));
+    }
+    if (node->left) {
+      stack[top++] = edge_node(node->left);
+      stack[top++] = edge_node(node->right);
+    }
+    free(node);
+  }
+  free(stack);
+  free(tree);
+}
+
+/*
+ * Searches for `key`, filling in `*sr` (see struct lfbst_seek).
+ */
+static void seek(struct lfbst* tree, long long key, struct lfbst_seek* sr) {
+  struct lfbst_node* s = edge_node(tree->root->left);
+  sr->ancestor = tree->root;
+  sr->successor = s;
+  sr->parent = s;
+  uintptr_t parent_edge = edge_load(&s->left);
+  sr->leaf = edge_node(parent_edge);
+  uintptr_t current_edge = edge_load(edge_toward(sr->leaf, key));
+  struct lfbst_node* current = edge_node(current_edge);
+  while (current != NULL) {
+    if (!(parent_edge & LFBST_TAG)) {
+      sr->ancestor = sr->parent;
+      sr->successor = sr->leaf;
+    }
+    sr->parent = sr->leaf;
+    sr->leaf = current;
+    parent_edge = current_edge;
+    current_edge = edge_load(edge_toward(current, key));
+    current = edge_node(current_edge);
+  }
+}
+
+/*
+ * Retires the nodes unlinked by a successful cleanup(): every internal node
+ * on the search path for `key` from `successor` down to `parent`, and the
+ * flagged leaf hanging off each of them.  `sibling` is the subtree that took
+ * their place.  All of these edges are marked, so none of them can change.
+ */
+static void retire_path(struct lfbst* tree, long long key,
+    struct lfbst_node* successor, struct lfbst_node* parent,
+    struct lfbst_node* sibling) {
+  struct lfbst_node* node = successor;
+  while (1) {
+    struct lfbst_node* left = edge_node(edge_load(&node->left));
+    struct lfbst_node* right = edge_node(edge_load(&node->right));
+    struct lfbst_node* next = key < node->key ? left : right;
+    if (node == parent) {
+      epoch_retire(tree->epoch, left == sibling ? right : left);
+      epoch_retire(tree->epoch, node);
+      return;
+    }
+    epoch_retire(tree->epoch, next == left ? right : left);
+    epoch_retire(tree->epoch, node);
+    node = next;
+  }
+}
+
+/*
+ * Finishes the removal of a leaf below `sr->parent` whose edge has been
+ * flagged, by tagging the edge to its sibling and moving the sibling up to
+ * replace `sr->successor`.  Returns 1 if this call unlinked the leaf, or 0
+ * if the tree changed and the caller needs to search again.
+ */
+static int cleanup(struct lfbst* tree, long long key, struct lfbst_seek* sr) {
+  uintptr_t* successor_edge = edge_toward(sr->ancestor, key);
+  uintptr_t* child_edge;
+  uintptr_t* sibling_edge;
+  if (key < sr->parent->key) {
+    child_edge = &sr->parent->left;
+    sibling_edge = &sr->parent->right;
+  } else {
+    child_edge = &sr->parent->right;
+    sibling_edge = &sr->parent->left;
+  }
+
+  /*
+   * If the leaf on the search path isn't the one being removed, its sibling
+   * is, and the leaf on the search path is the one that moves up.
+   */
+  if (!(edge_load(child_edge) & LFBST_FLAG)) {
+    sibling_edge = child_edge;
+  }
+
+  __atomic_fetch_or(sibling_edge, LFBST_TAG, __ATOMIC_ACQ_REL);
+  uintptr_t sibling = edge_load(sibling_edge) & ~LFBST_TAG;
+  if (!edge_cas(successor_edge, (uintptr_t)sr->successor, sibling)) {
+    return 0;
+  }
+  retire_path(tree, key, sr->successor, sr->parent, edge_node(sibling));
+  return 1;
+}
+
+/*
+ * Returns 1 if a failed compare-and-swap on `edge`, which was expected to
+ * point to `leaf` unmarked, failed because a removal has marked it.
+ */
+static int marked_edge_to(uintptr_t* edge, struct lfbst_node* leaf) {
+  uintptr_t current = edge_load(edge);
+  return edge_node(current) == leaf && (current & LFBST_MARKS);
+}
+
+/*
+ * This function inserts a new key/value pair into a lock-free BST, unless
+ * the key is already present.
+ *
+ * Params:
+ *   tree - the tree into which to insert.  May not be NULL.
+ *   key - the key to insert.
+ *   value - the value to store alongside the key.
+ *
+ * Return:
+ *   Returns 1 if the key was inserted, or 0 if it was already in the tree
+ *   (in which case the tree is left unchanged).
+ */
+int lfbst_insert(struct lfbst* tree, int key, void* value) {
+  assert(tree);
+  struct lfbst_node* new_leaf = NULL;
+  struct lfbst_node* internal = NULL;
+  struct lfbst_seek sr;
+  int inserted = 0;
+  epoch_enter(tree->epoch);
+  while (1) {
+    seek(tree, key, &sr);
+    if (sr.leaf->key == key) {
+      break;
+    }
+
+    /*
+     * The new internal node has the old and the new leaf as children, in
+     * key order, and the larger of their keys.  The nodes are reused if the
+     * compare-and-swap fails, since nobody else has seen them yet.
+     */
+    if (new_leaf == NULL) {
+      new_leaf = node_create(key, value, NULL, NULL);
+      internal = node_create(0, NULL, NULL, NULL);
+    }
+    if (key < sr.leaf->key) {
+      internal->key = sr.leaf->key;
+      internal->left = (uintptr_t)new_leaf;
+      internal->right = (uintptr_t)sr.leaf;
+    } else {
+      internal->key = key;
+      internal->left = (uintptr_t)sr.leaf;
+      internal->right = (uintptr_t)new_leaf;
+    }
+    uintptr_t* edge = edge_toward(sr.parent, key);
+    if (edge_cas(edge, (uintptr_t)sr.leaf, (uintptr_t)internal)) {
+      inserted = 1;
+      break;
+    }
+    if (marked_edge_to(edge, sr.leaf)) {
+      cleanup(tree, key, &sr);
+    }
+  }
+  epoch_exit(tree->epoch);
+  if (!inserted) {
+    free(new_leaf);
+    free(internal);
+  }
+  return inserted;
+}
+
+/*
+ * This function removes a key from a lock-free BST.
+ *
+ * Params:
+ *   tree - the tree from which to remove the key.  May not be NULL.
+ *   key - the key to remove.
+ *
+ * Return:
+ *   Returns 1 if the key was removed, or 0 if it wasn't in the tree.
+ */
+int lfbst_remove(struct lfbst* tree, int key) {
+  assert(tree);
+  struct lfbst_node* leaf = NULL;
+  struct lfbst_seek sr;
+  int removed = 0;
+  epoch_enter(tree->epoch);
+  while (1) {
+    seek(tree, key, &sr);
+    if (leaf == NULL) {
+      /*
+       * Flagging the edge to the leaf is what removes the key.  After that,
+       * the leaf only needs to be unlinked, which another thread may do.
+       */
+      if (sr.leaf->key != key) {
+        break;
+      }
+      uintptr_t* edge = edge_toward(sr.parent, key);
+      if (edge_cas(edge, (uintptr_t)sr.leaf,
+          (uintptr_t)sr.leaf | LFBST_FLAG)) {
+        leaf = sr.leaf;
+        removed = 1;
+        if (cleanup(tree, key, &sr)) {
+          break;
+        }
+      } else if (marked_edge_to(edge, sr.leaf)) {
+        cleanup(tree, key, &sr);
+      }
+    } else if (sr.leaf != leaf || cleanup(tree, key, &sr)) {
+      break;
+    }
+  }
+  epoch_exit(tree->epoch);
+  return removed;
+}
+
+/*
+ * This function returns the value associated with a key in a lock-free BST.
+ *
+ * Params:
+ *   tree - the tree to search.  May not be NULL.
+ *   key - the key to look up.
+ *
+ * Return:
+ *   Returns the value stored with `key`, or NULL if the key isn't in the
+ *   tree.
+ */
+void* lfbst_get(struct lfbst* tree, int key) {
+  assert(tree);
+  epoch_enter(tree->epoch);
+  struct lfbst_node* node = tree->root;
+  uintptr_t edge;
+  while ((edge = edge_load(edge_toward(node, key))) != 0) {
+    node = edge_node(edge);
+  }
+  void* value = node->key == key ? node->value : NULL;
+  epoch_exit(tree->epoch);
+  return value;
+}
+
+/*
+ * Walks every leaf that may hold a key in [lower, upper], skipping subtrees
+ * that can't, and returns the number of keys in the range, storing their
+ * sum in `*sum`.
+ */
+static int walk_range(struct lfbst* tree, int lower, int upper,
+    long long* sum) {
+  int count = 0, cap = 64, top = 0;
+  struct lfbst_node** stack = malloc(cap * sizeof(struct lfbst_node*));
+  *sum = 0;
+  epoch_enter(tree->epoch);
+  stack[top++] = edge_node(edge_load(&edge_node(tree->root->left)->left));
+  while (top > 0) {
+    struct lfbst_node* node = stack[--top];
+    uintptr_t left = edge_load(&node->left);
+    if (left == 0) {
+      if (node->key >= lower && node->key <= upper) {
+        *sum += node->key;
+        count++;
+      }
+      continue;
+    }
+    if (top + 2 > cap) {
+      cap *= 2;
+      stack = realloc(stack, cap * sizeof(struct lfbst_node*));
+    }
+    if (upper >= node->key) {
+      stack[top++] = edge_node(edge_load(&node->right));
+    }
+    if (lower < node->key) {
+      stack[top++] = edge_node(left);
+    }
+  }
+  epoch_exit(tree->epoch);
+  free(stack);
+  return count;
+}
+
+/*
+ * This function returns the number of keys stored in a lock-free BST.  It
+ * walks the whole tree, so it takes time linear in the size of the tree.
+ * Like lfbst_range_sum(), it counts every key that is in the tree for the
+ * whole call, and may or may not count keys inserted or removed during it.
+ *
+ * Params:
+ *   tree - the tree whose size is to be computed.  May not be NULL.
+ */
+int lfbst_size(struct lfbst* tree) {
+  assert(tree);
+  long long sum;
+  return walk_range(tree, INT_MIN, INT_MAX, &sum);
+}
+
+/*
+ * This function computes the sum of all keys in a lock-free BST that lie
+ * between `lower` and `upper` (inclusive).  Only subtrees that can hold
+ * keys in the range are visited.  The sum is not taken atomically: it
+ * includes every key in the range that is in the tree for the whole call,
+ * and may or may not include keys inserted or removed while it runs.
+ *
+ * Params:
+ *   tree - the tree to search.  May not be NULL.
+ *   lower - the lower bound of the range (inclusive).
+ *   upper - the upper bound of the range (inclusive).
+ */
+long long lfbst_range_sum(struct lfbst* tree, int lower, int upper) {
+  assert(tree);
+  long long sum;
+  walk_range(tree, lower, upper, &sum);
+  return sum;
+}
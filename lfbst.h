@@ -0,0 +1,28 @@
+/*
+ * This file contains the definition of the interface for a lock-free binary
+ * search tree that any number of threads may read and modify at the same
+ * time.  You can find descriptions of the lock-free BST functions, including
+ * their parameters and their return values, in lfbst.c.
+ */
+
+#ifndef __LFBST_H
+#define __LFBST_H
+
+/*
+ * Structure used to represent a lock-free BST.
+ */
+struct lfbst;
+
+/*
+ * Lock-free BST interface function prototypes.  Refer to lfbst.c for
+ * documentation about each of these functions.
+ */
+struct lfbst* lfbst_create();
+void lfbst_free(struct lfbst* tree);
+int lfbst_insert(struct lfbst* tree, int key, void* value);
+int lfbst_remove(struct lfbst* tree, int key);
+void* lfbst_get(struct lfbst* tree, int key);
+int lfbst_size(struct lfbst* tree);
+long long lfbst_range_sum(struct lfbst* tree, int lower, int upper);
+
+#endif
@@ -0,0 +1,125 @@
+/*
+ * This file contains executable code for testing the BST_BALANCED mode of
+ * your BST implementation.  It inserts keys in orders that would make an
+ * unbalanced BST degenerate into a linked list and checks that the height of
+ * the tree stays logarithmic in its size.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bst.h"
+
+/*
+ * Number of ascending keys inserted in the large sorted-ingest test.
+ */
+#define NUM_SORTED_KEYS 10000000
+
+/*
+ * Number of keys inserted in each of the smaller ordering tests.
+ */
+#define NUM_KEYS 1000000
+
+/*
+ * This is the worst-case height of an AVL tree with `n` nodes, which is
+ * bounded by 1.44 * log2(n + 2).
+ */
+int avl_height_bound(int n) {
+  return (int)(1.4405 * log2(n + 2.0));
+}
+
+/*
+ * This is a helper function that checks a handful of keys spread across the
+ * range [0, n) can be found in the BST with the correct value.  It returns the
+ * number of keys that were not found (or found with the wrong value).
+ */
+int check_lookups(struct bst* bst, int n) {
+  int misses = 0;
+  for (int key = 0; key < n; key += n / 97 + 1) {
+    if (bst_get(bst, key) != (void*)(long)(key + 1)) {
+      misses++;
+    }
+  }
+  return misses;
+}
+
+/*
+ * This is a helper function that inserts the keys [0, n) into a fresh
+ * balanced BST in the order given by `order` (0 = ascending, 1 = descending,
+ * 2 = zig-zag, alternately taking the smallest and largest remaining key),
+ * then prints the resulting height along with its AVL bound.
+ */
+void test_order(const char* name, int order, int n) {
+  struct bst* bst = bst_create_mode(BST_BALANCED);
+  for (int i = 0; i < n; i++) {
+    int key;
+    if (order == 0) {
+      key = i;
+    } else if (order == 1) {
+      key = n - 1 - i;
+    } else {
+      key = (i % 2 == 0) ? i / 2 : n - 1 - i / 2;
+    }
+    bst_insert(bst, key, (void*)(long)(key + 1));
+  }
+  int height = bst_height(bst);
+  int bound = avl_height_bound(n);
+  printf("  -- %s: height within bound (expect 1): %d\n", name,
+    height <= bound);
+  printf("  -- %s: keys not found (expect 0): %d\n", name,
+    check_lookups(bst, n));
+  bst_free(bst);
+}
+
+int main(int argc, char** argv) {
+  /*
+   * Insert a large number of keys in ascending order.  An unbalanced BST
+   * would have height NUM_SORTED_KEYS - 1 here.
+   */
+  printf("== Inserting %d ascending keys into balanced BST...\n",
+    NUM_SORTED_KEYS);
+  struct bst* bst = bst_create_mode(BST_BALANCED);
+  for (int i = 0; i < NUM_SORTED_KEYS; i++) {
+    bst_insert(bst, i, (void*)(long)(i + 1));
+  }
+  printf("\n== Checking correct value from bst_size(): %d (expected %d)\n",
+    bst_size(bst), NUM_SORTED_KEYS);
+  printf("\n== Checking bst_height() stays bounded: %d (expected <= %d)\n",
+    bst_height(bst), avl_height_bound(NUM_SORTED_KEYS));
+  printf("\n== Checking lookups, keys not found (expect 0): %d\n",
+    check_lookups(bst, NUM_SORTED_KEYS));
+
+  /*
+   * Remove every other key and make sure the tree stays balanced while it
+   * shrinks.
+   */
+  printf("\n== Removing every even key from balanced BST...\n");
+  for (int i = 0; i < NUM_SORTED_KEYS; i += 2) {
+    bst_remove(bst, i);
+  }
+  int removed_found = 0, kept_missing = 0;
+  for (int i = 0; i < NUM_SORTED_KEYS; i += 1001) {
+    if (i % 2 == 0 && bst_get(bst, i) != NULL) {
+      removed_found++;
+    } else if (i % 2 == 1 && bst_get(bst, i) != (void*)(long)(i + 1)) {
+      kept_missing++;
+    }
+  }
+  printf("  -- removed keys still found (expect 0): %d\n", removed_found);
+  printf("  -- remaining keys not found (expect 0): %d\n", kept_missing);
+  printf("  -- height within bound (expect 1): %d\n",
+    bst_height(bst) <= avl_height_bound(NUM_SORTED_KEYS / 2));
+  bst_free(bst);
+
+  /*
+   * Try a few more insertion orders that are adversarial for an unbalanced
+   * BST.
+   */
+  printf("\n== Checking other insertion orders (%d keys each)...\n", NUM_KEYS);
+  test_order("ascending", 0, NUM_KEYS);
+  test_order("descending", 1, NUM_KEYS);
+  test_order("zig-zag", 2, NUM_KEYS);
+
+  return 0;
+}
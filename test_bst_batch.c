@@ -0,0 +1,91 @@
+/*
+ * This file contains executable code for testing batched lookups with
+ * bst_get_batch() against one-at-a-time lookups with bst_get().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Number of random keys inserted into each tree, the range they are drawn
+ * from, and the number of keys looked up in each batch.  The batch size is
+ * deliberately not a multiple of the number of lookups kept in flight.
+ */
+#define NUM_KEYS 100000
+#define KEY_RANGE 150000
+#define BATCH_SIZE 10007
+
+/*
+ * This is a helper function that fills a BST created in the given mode with
+ * random keys, looks up a batch of random keys (about a third of which are
+ * missing) both ways, and returns the number of results that differ.
+ */
+int check_batch(int mode) {
+  int* data = malloc(KEY_RANGE * sizeof(int));
+  int* keys = malloc(BATCH_SIZE * sizeof(int));
+  void** values = malloc(BATCH_SIZE * sizeof(void*));
+  struct bst* bst = bst_create_mode(mode);
+  srand(mode + 7);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    int key = rand() % KEY_RANGE;
+    data[i % KEY_RANGE] = key;
+    bst_insert(bst, key, &data[i % KEY_RANGE]);
+  }
+  for (int i = 0; i < BATCH_SIZE; i++) {
+    keys[i] = rand() % KEY_RANGE;
+  }
+
+  bst_get_batch(bst, keys, BATCH_SIZE, values);
+  int mismatches = 0;
+  for (int i = 0; i < BATCH_SIZE; i++) {
+    if (values[i] != bst_get(bst, keys[i])) {
+      mismatches++;
+    }
+  }
+
+  /*
+   * Batches smaller than the number of lookups kept in flight, including an
+   * empty batch, should work too.
+   */
+  bst_get_batch(bst, keys, 0, values);
+  bst_get_batch(bst, keys, 3, values);
+  for (int i = 0; i < 3; i++) {
+    if (values[i] != bst_get(bst, keys[i])) {
+      mismatches++;
+    }
+  }
+
+  bst_free(bst);
+  free(values);
+  free(keys);
+  free(data);
+  return mismatches;
+}
+
+int main(int argc, char** argv) {
+  printf("== Comparing bst_get_batch() against bst_get() on %d keys...\n",
+    BATCH_SIZE);
+  printf("  -- plain: mismatches (expect 0): %d\n", check_batch(BST_PLAIN));
+  printf("  -- balanced: mismatches (expect 0): %d\n",
+    check_batch(BST_BALANCED));
+  printf("  -- bptree: mismatches (expect 0): %d\n", check_batch(BST_BPTREE));
+
+  /*
+   * Looking up keys in an empty tree should return NULL for every key.
+   */
+  struct bst* bst = bst_create();
+  int keys[4] = {1, 2, 3, 4};
+  void* values[4] = {keys, keys, keys, keys};
+  bst_get_batch(bst, keys, 4, values);
+  int found = 0;
+  for (int i = 0; i < 4; i++) {
+    found += values[i] != NULL;
+  }
+  printf("\n== Checking batch lookups in an empty BST, found (expect 0): %d\n",
+    found);
+  bst_free(bst);
+
+  return 0;
+}
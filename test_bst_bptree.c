@@ -0,0 +1,136 @@
+/*
+ * This file contains executable code for testing BSTs created in BST_BPTREE
+ * mode.  It checks the B+-tree backend against a BST_BALANCED tree holding
+ * the same keys under a random mix of inserts and removals.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * This is the data that's used to test this program.  It's the same data
+ * used in test_bst.c.
+ */
+#define NUM_TEST_DATA 13
+const int TEST_DATA[NUM_TEST_DATA] =
+  {64, 32, 96, 16, 48, 80, 112, 8, 24, 56, 88, 104, 120};
+
+/*
+ * This array defines some range sums to compute within the tree defined above
+ * as triples: {lower, upper, sum}.
+ */
+#define NUM_RANGE_SUMS 5
+const int RANGE_SUMS[NUM_RANGE_SUMS][3] = {
+  {8, 120, 848},
+  {2, 40, 80},
+  {30, 90, 368},
+  {96, 96, 96},
+  {125, 200, 0}
+};
+
+/*
+ * Number of random operations applied to both trees in the differential
+ * test, and the range random keys are drawn from.  The key range is small
+ * enough that many keys are duplicated.
+ */
+#define NUM_OPS 200000
+#define KEY_RANGE 5000
+
+int main(int argc, char** argv) {
+  /*
+   * Insert the test data and check the basic operations.
+   */
+  printf("== Creating BST in BST_BPTREE mode...\n");
+  struct bst* bst = bst_create_mode(BST_BPTREE);
+  printf("\n== Inserting %d values into BST...\n", NUM_TEST_DATA);
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    bst_insert(bst, TEST_DATA[i], (void*)&TEST_DATA[i]);
+  }
+  printf("\n== Checking correct value from bst_size(): %d (expected %d)\n",
+    bst_size(bst), NUM_TEST_DATA);
+  printf("\n== Checking bst_height() of a single leaf: %d (expected 0)\n",
+    bst_height(bst));
+
+  printf("\n== Looking up values we know should be in the BST...\n");
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    int* value = bst_get(bst, TEST_DATA[i]);
+    if (value) {
+      printf("  -- bst_get(%3d): %3d (expected %3d)\n", TEST_DATA[i], *value,
+        TEST_DATA[i]);
+    } else {
+      printf("  -- bst_get(%3d) unexpectedly returned NULL\n", TEST_DATA[i]);
+    }
+  }
+
+  printf("\n== Checking range sums in the BST:\n");
+  for (int i = 0; i < NUM_RANGE_SUMS; i++) {
+    printf("  -- bst_range_sum(%d, %d): %d (expected %d)\n",
+      RANGE_SUMS[i][0], RANGE_SUMS[i][1],
+      bst_range_sum(bst, RANGE_SUMS[i][0], RANGE_SUMS[i][1]),
+      RANGE_SUMS[i][2]);
+  }
+  bst_free(bst);
+
+  /*
+   * Apply the same random inserts and removals to a B+-tree and a balanced
+   * binary tree and make sure they agree on every query.  Values record the
+   * key they were inserted with, so lookups can be checked even though
+   * duplicate keys may be found in a different order by the two trees.
+   */
+  printf("\n== Applying %d random operations to B+-tree and balanced BST...\n",
+    NUM_OPS);
+  struct bst* bpt = bst_create_mode(BST_BPTREE);
+  struct bst* avl = bst_create_mode(BST_BALANCED);
+  int* keys = malloc(KEY_RANGE * sizeof(int));
+  for (int i = 0; i < KEY_RANGE; i++) {
+    keys[i] = i;
+  }
+  int get_mismatches = 0, sum_mismatches = 0, size_mismatches = 0;
+  srand(5);
+  for (int i = 0; i < NUM_OPS; i++) {
+    int key = rand() % KEY_RANGE;
+    if (rand() % 5 < 3) {
+      bst_insert(bpt, key, &keys[key]);
+      bst_insert(avl, key, &keys[key]);
+    } else {
+      bst_remove(bpt, key);
+      bst_remove(avl, key);
+    }
+    if (bst_get(bpt, key) != bst_get(avl, key)) {
+      get_mismatches++;
+    }
+    int lower = rand() % KEY_RANGE;
+    int upper = lower + rand() % 200;
+    if (bst_range_sum64(bpt, lower, upper)
+        != bst_range_sum64(avl, lower, upper)) {
+      sum_mismatches++;
+    }
+    if (bst_size(bpt) != bst_size(avl)) {
+      size_mismatches++;
+    }
+  }
+  printf("  -- bst_get() mismatches (expect 0): %d\n", get_mismatches);
+  printf("  -- bst_range_sum64() mismatches (expect 0): %d\n", sum_mismatches);
+  printf("  -- bst_size() mismatches (expect 0): %d\n", size_mismatches);
+
+  /*
+   * Drain both trees completely, which exercises merging all the way back
+   * down to an empty tree.
+   */
+  for (int key = 0; key < KEY_RANGE; key++) {
+    while (bst_get(avl, key) != NULL) {
+      bst_remove(avl, key);
+      bst_remove(bpt, key);
+    }
+  }
+  printf("\n== Checking B+-tree is empty after draining: size %d, height %d "
+    "(expected 0, -1)\n", bst_size(bpt), bst_height(bpt));
+
+  free(keys);
+  bst_free(avl);
+  bst_free(bpt);
+
+  return 0;
+}
@@ -0,0 +1,179 @@
+/*
+ * This file contains executable code for testing BSTs built from sorted
+ * arrays with bst_build_sorted().  It runs the same checks as test_bst.c on
+ * a tree built in one step instead of by repeated insertion.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bst.h"
+
+/*
+ * This is the data that's used to test this program.  It's the same data
+ * used in test_bst.c, which forms a tree of height 3.
+ */
+#define NUM_TEST_DATA 13
+const int TEST_DATA[NUM_TEST_DATA] =
+  {64, 32, 96, 16, 48, 80, 112, 8, 24, 56, 88, 104, 120};
+#define TEST_DATA_BST_HEIGHT 3
+
+/*
+ * This array defines some range sums to compute within the tree defined above
+ * as triples: {lower, upper, sum}.
+ */
+#define NUM_RANGE_SUMS 10
+const int RANGE_SUMS[NUM_RANGE_SUMS][3] = {
+  {8, 120, 848},
+  {0, 200, 848},
+  {2, 40, 80},
+  {24, 60, 160},
+  {30, 90, 368},
+  {60, 70, 64},
+  {60, 112, 544},
+  {84, 110, 288},
+  {96, 96, 96},
+  {125, 200, 0}
+};
+
+/*
+ * This array contains values from the TEST_DATA array above that we'll try
+ * to remove from the BST, in ascending order.
+ */
+#define NUM_DATA_TO_REMOVE 4
+const int TEST_DATA_TO_REMOVE[NUM_DATA_TO_REMOVE] = {16, 48, 64, 104};
+
+/*
+ * Number of keys in the large build, which is perfectly balanced with
+ * height floor(log2(NUM_LARGE_KEYS)).
+ */
+#define NUM_LARGE_KEYS 1000000
+#define LARGE_BST_HEIGHT 19
+
+/*
+ * This is a helper function that's used to compare integers when sorting with
+ * qsort().
+ */
+int cmp_ints(const void* a, const void* b) {
+  return *(int*)a - *(int*)b;
+}
+
+int main(int argc, char** argv) {
+  /*
+   * Sort the testing data and build a BST from it.  The value stored with
+   * each key is the address of that key in the sorted array.
+   */
+  int* sorted = malloc(NUM_TEST_DATA * sizeof(int));
+  void** values = malloc(NUM_TEST_DATA * sizeof(void*));
+  memcpy(sorted, TEST_DATA, NUM_TEST_DATA * sizeof(int));
+  qsort(sorted, NUM_TEST_DATA, sizeof(int), cmp_ints);
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    values[i] = &sorted[i];
+  }
+  printf("== Building BST from %d sorted values...\n", NUM_TEST_DATA);
+  struct bst* bst = bst_build_sorted(sorted, values, NUM_TEST_DATA);
+
+  printf("\n== Checking correct value from bst_size(): %d (expected %d)\n",
+    bst_size(bst), NUM_TEST_DATA);
+  printf("\n== Checking correct value from bst_height(): %d (expected %d)\n",
+    bst_height(bst), TEST_DATA_BST_HEIGHT);
+
+  printf("\n== Looking up values we know should be in the BST...\n");
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    int* value = bst_get(bst, TEST_DATA[i]);
+    if (value) {
+      printf("  -- bst_get(%3d): %3d (expected %3d)\n", TEST_DATA[i], *value,
+        TEST_DATA[i]);
+    } else {
+      printf("  -- bst_get(%3d) unexpectedly returned NULL\n", TEST_DATA[i]);
+    }
+  }
+
+  printf("\n== Looking up values we know should NOT be in the BST...\n");
+  for (int i = 0, k = 0; i < sorted[NUM_TEST_DATA - 1]; i++) {
+    if (i == sorted[k]) {
+      k++;
+    } else if (bst_get(bst, i) != NULL) {
+      printf("  -- bst_get(%3d) unexpectedly returned a non-NULL value\n", i);
+    }
+  }
+
+  printf("\n== Checking range sums in the BST:\n");
+  for (int i = 0; i < NUM_RANGE_SUMS; i++) {
+    printf("  -- bst_range_sum(%d, %d): %d (expected %d)\n", RANGE_SUMS[i][0],
+      RANGE_SUMS[i][1], bst_range_sum(bst, RANGE_SUMS[i][0],
+      RANGE_SUMS[i][1]), RANGE_SUMS[i][2]);
+  }
+
+  printf("\n== Removing keys from BST...\n");
+  for (int i = 0; i < NUM_DATA_TO_REMOVE; i++) {
+    bst_remove(bst, TEST_DATA_TO_REMOVE[i]);
+    if (bst_get(bst, TEST_DATA_TO_REMOVE[i])) {
+      printf("  -- key %3d still present in BST after removal\n",
+        TEST_DATA_TO_REMOVE[i]);
+    } else {
+      printf("  -- key %3d correctly removed from BST\n",
+        TEST_DATA_TO_REMOVE[i]);
+    }
+  }
+  printf("\n== Checking correct value from bst_size(): %d (expected %d)\n",
+    bst_size(bst), NUM_TEST_DATA - NUM_DATA_TO_REMOVE);
+
+  printf("\n== Looking up values we know should still be in the BST...\n");
+  for (int i = 0, k = 0; i < NUM_TEST_DATA; i++) {
+    if (k < NUM_DATA_TO_REMOVE && sorted[i] == TEST_DATA_TO_REMOVE[k]) {
+      k++;
+      continue;
+    }
+    int* value = bst_get(bst, sorted[i]);
+    if (value) {
+      printf("  -- bst_get(%3d): %3d (expected %3d)\n", sorted[i], *value,
+        sorted[i]);
+    } else {
+      printf("  -- bst_get(%3d) unexpectedly returned NULL\n", sorted[i]);
+    }
+  }
+  bst_free(bst);
+  free(values);
+  free(sorted);
+
+  /*
+   * Build a large tree (without values) and make sure it is perfectly
+   * balanced and stays balanced as it is modified.
+   */
+  printf("\n== Building BST from %d sorted keys...\n", NUM_LARGE_KEYS);
+  int* keys = malloc(NUM_LARGE_KEYS * sizeof(int));
+  for (int i = 0; i < NUM_LARGE_KEYS; i++) {
+    keys[i] = 2 * i;
+  }
+  bst = bst_build_sorted(keys, NULL, NUM_LARGE_KEYS);
+  printf("  -- bst_size(): %d (expected %d)\n", bst_size(bst), NUM_LARGE_KEYS);
+  printf("  -- bst_height(): %d (expected %d)\n", bst_height(bst),
+    LARGE_BST_HEIGHT);
+  printf("  -- bst_select(%d): %d (expected %d)\n", NUM_LARGE_KEYS / 3,
+    bst_select(bst, NUM_LARGE_KEYS / 3, NULL), 2 * (NUM_LARGE_KEYS / 3));
+  printf("  -- bst_range_sum64(0, %d): %lld (expected %lld)\n",
+    2 * NUM_LARGE_KEYS, bst_range_sum64(bst, 0, 2 * NUM_LARGE_KEYS),
+    (long long)NUM_LARGE_KEYS * (NUM_LARGE_KEYS - 1));
+  for (int i = 0; i < NUM_LARGE_KEYS; i += 2) {
+    bst_remove(bst, 2 * i);
+    bst_insert(bst, 2 * i + 1, NULL);
+  }
+  printf("  -- bst_size() after updates: %d (expected %d)\n", bst_size(bst),
+    NUM_LARGE_KEYS);
+  printf("  -- bst_height() after updates within AVL bound (expect 1): %d\n",
+    bst_height(bst) <= 28);
+  bst_free(bst);
+  free(keys);
+
+  /*
+   * Building from an empty array gives an empty tree.
+   */
+  bst = bst_build_sorted(NULL, NULL, 0);
+  printf("\n== Checking empty build: size %d, height %d (expected 0, -1)\n",
+    bst_size(bst), bst_height(bst));
+  bst_free(bst);
+
+  return 0;
+}
@@ -0,0 +1,155 @@
+/*
+ * This file contains executable code for testing BSTs created in BST_COMPACT
+ * mode.  It checks the compact backend against a BST_BALANCED tree holding
+ * the same keys under a random mix of inserts and removals, and then checks
+ * the queries that rely on subtree sizes and the iterators.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Number of random operations applied to both trees in the differential
+ * test, and the range random keys are drawn from.  The key range is small
+ * enough that many keys are duplicated.
+ */
+#define NUM_OPS 200000
+#define KEY_RANGE 5000
+
+/*
+ * Number of keys inserted in ascending order to check that the tree stays
+ * balanced.
+ */
+#define NUM_SORTED 100000
+
+/*
+ * Returns 1 if the height of a weight-balanced tree of `n` nodes is within
+ * its bound of log(n + 1) / log(4/3), checked as (4/3)^height <= n + 1.
+ */
+int height_ok(int height, int n) {
+  double weight = 1;
+  for (int i = 0; i < height; i++) {
+    weight *= 4.0 / 3.0;
+  }
+  return weight <= n + 1.0;
+}
+
+int main(int argc, char** argv) {
+  /*
+   * Apply the same random inserts and removals to a compact tree and a
+   * balanced binary tree and make sure they agree on every query.  Values
+   * record the key they were inserted with, so lookups can be checked even
+   * though duplicate keys may be found in a different order by the two
+   * trees.
+   */
+  printf("== Applying %d random operations to compact and balanced BSTs...\n",
+    NUM_OPS);
+  struct bst* cbt = bst_create_mode(BST_COMPACT);
+  struct bst* avl = bst_create_mode(BST_BALANCED);
+  int* keys = malloc(KEY_RANGE * sizeof(int));
+  for (int i = 0; i < KEY_RANGE; i++) {
+    keys[i] = i;
+  }
+  int get_mismatches = 0, sum_mismatches = 0, size_mismatches = 0;
+  int rank_mismatches = 0, count_mismatches = 0;
+  srand(5);
+  for (int i = 0; i < NUM_OPS; i++) {
+    int key = rand() % KEY_RANGE;
+    if (rand() % 5 < 3) {
+      bst_insert(cbt, key, &keys[key]);
+      bst_insert(avl, key, &keys[key]);
+    } else {
+      bst_remove(cbt, key);
+      bst_remove(avl, key);
+    }
+    get_mismatches += bst_get(cbt, key) != bst_get(avl, key);
+    int lower = rand() % KEY_RANGE;
+    int upper = lower + rand() % 200;
+    sum_mismatches += bst_range_sum64(cbt, lower, upper)
+      != bst_range_sum64(avl, lower, upper);
+    size_mismatches += bst_size(cbt) != bst_size(avl);
+    rank_mismatches += bst_rank(cbt, lower) != bst_rank(avl, lower);
+    count_mismatches += bst_count(cbt, key) != bst_count(avl, key);
+  }
+  printf("  -- bst_get() mismatches (expect 0): %d\n", get_mismatches);
+  printf("  -- bst_range_sum64() mismatches (expect 0): %d\n", sum_mismatches);
+  printf("  -- bst_size() mismatches (expect 0): %d\n", size_mismatches);
+  printf("  -- bst_rank() mismatches (expect 0): %d\n", rank_mismatches);
+  printf("  -- bst_count() mismatches (expect 0): %d\n", count_mismatches);
+  printf("  -- height within the weight-balance bound (expect 1): %d\n",
+    height_ok(bst_height(cbt), bst_size(cbt)));
+
+  /*
+   * Both trees hold the same keys, so selecting and iterating must give the
+   * same keys in the same order.
+   */
+  int select_mismatches = 0;
+  for (int k = 0; k < bst_size(cbt); k++) {
+    select_mismatches += bst_select(cbt, k, NULL) != bst_select(avl, k, NULL);
+  }
+  printf("  -- bst_select() mismatches (expect 0): %d\n", select_mismatches);
+  int iter_mismatches = 0;
+  struct bst_iterator* citer = bst_iterator_create_range(cbt, 1000, 2000);
+  struct bst_iterator* aiter = bst_iterator_create_range(avl, 1000, 2000);
+  while (bst_iterator_has_next(aiter)) {
+    void* value;
+    int key = bst_iterator_next(citer, &value);
+    iter_mismatches += key != bst_iterator_next(aiter, NULL)
+      || value != &keys[key];
+  }
+  iter_mismatches += bst_iterator_has_next(citer);
+  bst_iterator_free(citer);
+  bst_iterator_free(aiter);
+  printf("  -- range iterator mismatches (expect 0): %d\n", iter_mismatches);
+
+  /*
+   * Drain both trees completely, which exercises rebalancing all the way
+   * back down to an empty tree.
+   */
+  for (int key = 0; key < KEY_RANGE; key++) {
+    while (bst_get(avl, key) != NULL) {
+      bst_remove(avl, key);
+      bst_remove(cbt, key);
+    }
+  }
+  printf("\n== Checking compact tree is empty after draining: size %d, "
+    "height %d (expected 0, -1)\n", bst_size(cbt), bst_height(cbt));
+  bst_free(avl);
+  bst_free(cbt);
+
+  /*
+   * Sorted inserts would leave a plain tree as a list.  Freed slots are
+   * reused, so refilling a drained tree must work just as well.
+   */
+  printf("\n== Inserting %d sorted keys into a BST_COMPACT | BST_UNIQUE "
+    "tree...\n", NUM_SORTED);
+  cbt = bst_create_mode(BST_COMPACT | BST_UNIQUE);
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < NUM_SORTED; i++) {
+      bst_insert(cbt, i, &keys[i % KEY_RANGE]);
+      bst_insert(cbt, i, &keys[(i + 1) % KEY_RANGE]);
+    }
+    printf("  -- round %d: size (expect %d): %d, height within the bound "
+      "(expect 1): %d\n", round, NUM_SORTED, bst_size(cbt),
+      height_ok(bst_height(cbt), NUM_SORTED));
+    if (round == 0) {
+      printf("  -- bst_remove_range(0, %d) removed (expect %d): %d\n",
+        NUM_SORTED, NUM_SORTED, bst_remove_range(cbt, 0, NUM_SORTED));
+    }
+  }
+  void* old = NULL;
+  int replaced = bst_upsert(cbt, 42, &keys[7], &old);
+  printf("  -- bst_upsert(42) replaced (expect 1): %d, old value (expect 43): "
+    "%d, new value (expect 7): %d\n", replaced, *(int*)old,
+    *(int*)bst_get(cbt, 42));
+  printf("  -- bst_select(%d) (expect %d): %d\n", NUM_SORTED / 2,
+    NUM_SORTED / 2, bst_select(cbt, NUM_SORTED / 2, NULL));
+  printf("  -- bst_get(%d) returns NULL (expect 1): %d\n", NUM_SORTED,
+    bst_get(cbt, NUM_SORTED) == NULL);
+  bst_free(cbt);
+
+  free(keys);
+  return 0;
+}
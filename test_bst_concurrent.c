@@ -0,0 +1,257 @@
+/*
+ * This file contains executable code for testing BSTs created in
+ * BST_CONCURRENT mode, both from a single thread (where they should behave
+ * exactly like BST_BALANCED trees) and with several reader threads running
+ * queries while a writer thread inserts and removes keys.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "bst.h"
+
+/*
+ * Number of keys in each tree, and the number of random inserts and removals
+ * made in the single-threaded comparison.
+ */
+#define NUM_KEYS 20000
+#define NUM_OPS 100000
+
+/*
+ * Number of reader threads in the stress test and number of inserts and
+ * removals made by the writer thread while they run.
+ */
+#define NUM_READERS 4
+#define NUM_WRITES 200000
+
+/*
+ * Width of the key ranges scanned by readers with range iterators.
+ */
+#define SCAN_WIDTH 64
+
+/*
+ * Every value stored in the trees points at the entry of this array that
+ * holds its key.
+ */
+int values[2 * NUM_KEYS];
+
+/*
+ * Returns the next number from a small linear congruential generator whose
+ * state is held in `*state`.  Each thread keeps its own state.
+ */
+unsigned int next_rand(unsigned int* state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 8;
+}
+
+/*
+ * This is a helper function that applies the same random inserts and
+ * removals to a BST_CONCURRENT tree and a BST_BALANCED tree and returns the
+ * number of queries on which the two disagree.
+ */
+int check_against_balanced() {
+  struct bst* concurrent = bst_create_mode(BST_CONCURRENT);
+  struct bst* balanced = bst_create_mode(BST_BALANCED);
+  unsigned int state = 1;
+  int mismatches = 0;
+  for (int i = 0; i < NUM_OPS; i++) {
+    int key = next_rand(&state) % (2 * NUM_KEYS);
+    if (next_rand(&state) % 3 == 0) {
+      bst_remove(concurrent, key);
+      bst_remove(balanced, key);
+    } else {
+      bst_insert(concurrent, key, &values[key]);
+      bst_insert(balanced, key, &values[key]);
+    }
+  }
+
+  if (bst_size(concurrent) != bst_size(balanced)
+      || bst_height(concurrent) != bst_height(balanced)) {
+    mismatches++;
+  }
+  for (int key = -1; key <= 2 * NUM_KEYS; key++) {
+    if (bst_get(concurrent, key) != bst_get(balanced, key)
+        || bst_rank(concurrent, key) != bst_rank(balanced, key)) {
+      mismatches++;
+    }
+  }
+  for (int k = 0; k < bst_size(balanced); k++) {
+    if (bst_select(concurrent, k, NULL) != bst_select(balanced, k, NULL)) {
+      mismatches++;
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    int lower = next_rand(&state) % (2 * NUM_KEYS);
+    int upper = lower + next_rand(&state) % NUM_KEYS;
+    if (bst_range_sum64(concurrent, lower, upper)
+        != bst_range_sum64(balanced, lower, upper)) {
+      mismatches++;
+    }
+  }
+
+  bst_free(balanced);
+  bst_free(concurrent);
+  return mismatches;
+}
+
+/*
+ * State shared between the threads of the stress test.  The tree always
+ * holds every even key below 2 * NUM_KEYS, while the writer inserts and
+ * removes odd keys, so readers know exactly which keys must be present and
+ * which may or may not be.
+ */
+struct bst* shared;
+int writer_done;
+
+/*
+ * The writer thread toggles random odd keys in and out of the shared tree,
+ * and removes all of them again at the end.
+ */
+void* writer(void* arg) {
+  char* present = calloc(NUM_KEYS, 1);
+  unsigned int state = 7;
+  for (int i = 0; i < NUM_WRITES; i++) {
+    int j = next_rand(&state) % NUM_KEYS;
+    int key = 2 * j + 1;
+    if (present[j]) {
+      bst_remove(shared, key);
+    } else {
+      bst_insert(shared, key, &values[key]);
+    }
+    present[j] = !present[j];
+  }
+  for (int j = 0; j < NUM_KEYS; j++) {
+    if (present[j]) {
+      bst_remove(shared, 2 * j + 1);
+    }
+  }
+  free(present);
+  __atomic_store_n(&writer_done, 1, __ATOMIC_RELEASE);
+  return NULL;
+}
+
+/*
+ * Each reader thread runs a random mix of queries against the shared tree
+ * until the writer is done, and returns the number of wrong answers it saw
+ * (cast to a pointer).
+ */
+void* reader(void* arg) {
+  unsigned int state = (unsigned int)(long)arg;
+  long errors = 0;
+  while (!__atomic_load_n(&writer_done, __ATOMIC_ACQUIRE)) {
+    int key = next_rand(&state) % (2 * NUM_KEYS);
+    int* value;
+    switch (next_rand(&state) % 4) {
+      case 0:
+        /*
+         * Even keys must always be found, odd keys may or may not be.
+         */
+        value = bst_get(shared, key);
+        if ((key % 2 == 0 || value != NULL) && value != &values[key]) {
+          errors++;
+        }
+        break;
+
+      case 1: {
+        /*
+         * A range sum must include every even key in the range, and can't be
+         * more than the sum of every integer in it.
+         */
+        int upper = key + next_rand(&state) % NUM_KEYS;
+        long long sum = bst_range_sum64(shared, key, upper);
+        long long evens = 0, all = 0;
+        for (int k = key; k <= upper && k < 2 * NUM_KEYS; k++) {
+          all += k;
+          evens += k % 2 == 0 ? k : 0;
+        }
+        if (sum < evens || sum > all) {
+          errors++;
+        }
+        break;
+      }
+
+      case 2: {
+        /*
+         * A range scan must visit keys in increasing order without skipping
+         * any even key.
+         */
+        int upper = key + SCAN_WIDTH - 1, expect = key;
+        struct bst_iterator* iter =
+          bst_iterator_create_range(shared, key, upper);
+        while (bst_iterator_has_next(iter)) {
+          int k = bst_iterator_next(iter, (void**)&value);
+          if (k < expect || (expect % 2 == 0 && k != expect)
+              || value != &values[k]) {
+            errors++;
+          }
+          expect = k + 1;
+        }
+        bst_iterator_free(iter);
+        if (expect < upper && expect < 2 * NUM_KEYS - 1) {
+          errors++;
+        }
+        break;
+      }
+
+      default: {
+        int size = bst_size(shared);
+        if (size < NUM_KEYS || size > 2 * NUM_KEYS) {
+          errors++;
+        }
+        break;
+      }
+    }
+  }
+  return (void*)errors;
+}
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < 2 * NUM_KEYS; i++) {
+    values[i] = i;
+  }
+
+  printf("== Comparing BST_CONCURRENT against BST_BALANCED after %d random "
+    "operations...\n", NUM_OPS);
+  printf("  -- mismatches (expect 0): %d\n", check_against_balanced());
+
+  shared = bst_create_mode(BST_CONCURRENT);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    bst_insert(shared, 2 * i, &values[2 * i]);
+  }
+
+  printf("\n== Running %d readers against a writer making %d changes...\n",
+    NUM_READERS, NUM_WRITES);
+  pthread_t threads[NUM_READERS + 1];
+  for (int i = 0; i < NUM_READERS; i++) {
+    pthread_create(&threads[i], NULL, reader, (void*)(long)(i + 1));
+  }
+  pthread_create(&threads[NUM_READERS], NULL, writer, NULL);
+
+  long errors = 0;
+  for (int i = 0; i < NUM_READERS; i++) {
+    void* result;
+    pthread_join(threads[i], &result);
+    errors += (long)result;
+  }
+  pthread_join(threads[NUM_READERS], NULL);
+  printf("  -- wrong answers seen by readers (expect 0): %ld\n", errors);
+
+  /*
+   * Once the writer has removed every odd key again, the tree should be
+   * back to holding exactly the even keys.
+   */
+  int missing = 0;
+  for (int i = 0; i < 2 * NUM_KEYS; i++) {
+    if (bst_get(shared, i) != (i % 2 == 0 ? &values[i] : NULL)) {
+      missing++;
+    }
+  }
+  printf("  -- bst_size(): %d (expected %d)\n", bst_size(shared), NUM_KEYS);
+  printf("  -- keys missing or left behind (expect 0): %d\n", missing);
+  printf("  -- bst_height() at most 20: %s\n",
+    bst_height(shared) <= 20 ? "yes" : "no");
+  bst_free(shared);
+
+  return 0;
+}
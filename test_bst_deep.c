@@ -0,0 +1,102 @@
+/*
+ * This file contains executable code for testing your BST implementation on
+ * degenerate, list-like trees, of the kind sorted inserts produce.  Every
+ * function that walks such a tree must do so without recursing once per
+ * level, so all of them are run on a thread whose stack is far too small
+ * for that.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "bst.h"
+#include "frozen.h"
+
+/*
+ * Number of keys in each list-like tree, and the stack size of the thread
+ * that walks them.  A recursive walk would need at least a few dozen bytes
+ * of stack per level.
+ */
+#define NUM_KEYS 10000
+#define STACK_SIZE (64 * 1024)
+
+/*
+ * Every value stored in the trees points at the entry of this array that
+ * holds its key.
+ */
+int values[NUM_KEYS];
+
+/*
+ * Runs every walk over a list-like tree whose keys were inserted in the
+ * order given by `step` (1 for ascending, -1 for descending) and prints the
+ * results.  Called on the small-stack thread.
+ */
+void check_list(const char* name, int step) {
+  struct bst* bst = bst_create();
+  for (int i = 0; i < NUM_KEYS; i++) {
+    int key = step > 0 ? i : NUM_KEYS - 1 - i;
+    bst_insert(bst, key, &values[key]);
+  }
+  printf("\n== Walking a tree of %d keys inserted in %s order...\n", NUM_KEYS,
+    name);
+  printf("  -- bst_height() (expect %d): %d\n", NUM_KEYS - 1,
+    bst_height(bst));
+  printf("  -- bst_height_parallel() (expect %d): %d\n", NUM_KEYS - 1,
+    bst_height_parallel(bst, 2));
+
+  int missing = 0;
+  for (int key = 0; key < NUM_KEYS; key++) {
+    missing += bst_get(bst, key) != &values[key];
+  }
+  printf("  -- keys not found by bst_get() (expect 0): %d\n", missing);
+
+  int out_of_order = 0, count = 0;
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    out_of_order += bst_iterator_next(iter, NULL) != count++;
+  }
+  bst_iterator_free(iter);
+  printf("  -- keys visited by an iterator (expect %d): %d, out of order "
+    "(expect 0): %d\n", NUM_KEYS, count, out_of_order);
+
+  struct bst_frozen* frozen = bst_freeze(bst);
+  printf("  -- keys in a frozen copy (expect %d): %d\n", NUM_KEYS,
+    bst_frozen_size(frozen));
+  bst_frozen_free(frozen);
+
+  void* value;
+  printf("  -- bst_select(%d) (expect %d): %d\n", NUM_KEYS / 2, NUM_KEYS / 2,
+    bst_select(bst, NUM_KEYS / 2, &value));
+  printf("  -- bst_range_sum64() over every key (expect %lld): %lld\n",
+    (long long)NUM_KEYS * (NUM_KEYS - 1) / 2,
+    bst_range_sum64(bst, 0, NUM_KEYS));
+
+  for (int key = 0; key < NUM_KEYS; key += 2) {
+    bst_remove(bst, key);
+  }
+  printf("  -- size after removing every even key (expect %d): %d\n",
+    NUM_KEYS / 2, bst_size(bst));
+  bst_free(bst);
+}
+
+void* walk_lists(void* arg) {
+  check_list("ascending", 1);
+  check_list("descending", -1);
+  return NULL;
+}
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < NUM_KEYS; i++) {
+    values[i] = i;
+  }
+  printf("== Running on a thread with a %d KB stack\n", STACK_SIZE / 1024);
+  pthread_attr_t attr;
+  pthread_attr_init(&attr);
+  pthread_attr_setstacksize(&attr, STACK_SIZE);
+  pthread_t thread;
+  pthread_create(&thread, &attr, walk_lists, NULL);
+  pthread_join(thread, NULL);
+  pthread_attr_destroy(&attr);
+  return 0;
+}
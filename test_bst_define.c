@@ -0,0 +1,187 @@
+/*
+ * This file contains executable code for testing trees generated with
+ * BST_DEFINE() for keys other than `int`: 64-bit integers, strings and a
+ * custom ordering.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+
+#include "bst_define.h"
+
+/*
+ * Number of keys inserted into each tree.
+ */
+#define NUM_KEYS 10000
+
+/*
+ * Orders ints from largest to smallest.
+ */
+static inline int descending(int a, int b) {
+  return (a < b) - (a > b);
+}
+
+BST_DEFINE(id_tree, int64_t, BST_CMP_NUMERIC)
+BST_DEFINE(str_tree, const char*, BST_CMP_STRING)
+BST_DEFINE(desc_tree, int, descending)
+
+/*
+ * Every value stored in the trees points at the entry of this array whose
+ * index is the number the key was made from.
+ */
+int values[NUM_KEYS];
+
+/*
+ * The strings used as keys of the string trees: the numbers 0..NUM_KEYS-1
+ * in decimal, so that their order as strings differs from their order as
+ * numbers.
+ */
+char strings[NUM_KEYS][8];
+
+/*
+ * Returns the `i`-th number of a scrambled order of 0..NUM_KEYS-1.
+ */
+int scrambled(int i) {
+  return (int)((i * 7919L) % NUM_KEYS);
+}
+
+/*
+ * Returns the 64-bit key made from the number `i`, which doesn't fit in an
+ * int.
+ */
+int64_t id_key(int i) {
+  return ((int64_t)i << 33) - 5;
+}
+
+/*
+ * Returns 1 if the height of a tree of `n` nodes is within the AVL bound.
+ */
+int avl_ok(int height, int n) {
+  int log = 0;
+  for (; (1 << log) <= n; log++);
+  return height <= 3 * log / 2 + 1;
+}
+
+/*
+ * Fills, queries and empties an id_tree created with `mode`, printing what
+ * it holds along the way.
+ */
+void check_ids(const char* name, int mode) {
+  printf("\n== 64-bit keys in a %s tree...\n", name);
+  struct id_tree* tree = id_tree_create_mode(mode);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    id_tree_insert(tree, id_key(scrambled(i)), &values[scrambled(i)]);
+  }
+  int wrong = 0;
+  for (int i = 0; i < NUM_KEYS; i++) {
+    wrong += id_tree_get(tree, id_key(i)) != &values[i];
+    wrong += id_tree_get(tree, id_key(i) + 1) != NULL;
+  }
+  printf("  -- size (expect %d): %d, wrong lookups (expect 0): %d\n",
+    NUM_KEYS, id_tree_size(tree), wrong);
+  if (mode == BST_BALANCED) {
+    printf("  -- height within the AVL bound (expect 1): %d\n",
+      avl_ok(id_tree_height(tree), NUM_KEYS));
+  } else {
+    struct bst* ints = bst_create();
+    for (int i = 0; i < NUM_KEYS; i++) {
+      bst_insert(ints, scrambled(i), NULL);
+    }
+    printf("  -- height (expect %d, as for the same keys in a struct bst): "
+      "%d\n", bst_height(ints), id_tree_height(tree));
+    bst_free(ints);
+  }
+
+  int in_order = 1, visited = 0;
+  struct id_tree_iterator* iter = id_tree_iterator_create(tree);
+  while (id_tree_iterator_has_next(iter)) {
+    void* value;
+    int64_t key = id_tree_iterator_next(iter, &value);
+    in_order &= key == id_key(visited) && value == &values[visited];
+    visited++;
+  }
+  id_tree_iterator_free(iter);
+  printf("  -- iterated in order (expect 1): %d\n",
+    in_order && visited == NUM_KEYS);
+
+  for (int i = 0; i < NUM_KEYS; i += 2) {
+    id_tree_remove(tree, id_key(i));
+  }
+  id_tree_remove(tree, id_key(NUM_KEYS));
+  wrong = 0;
+  for (int i = 0; i < NUM_KEYS; i++) {
+    wrong += id_tree_get(tree, id_key(i)) != (i % 2 ? &values[i] : NULL);
+  }
+  printf("  -- after removing even keys: size (expect %d): %d, wrong lookups "
+    "(expect 0): %d\n", NUM_KEYS / 2, id_tree_size(tree), wrong);
+  if (mode == BST_BALANCED) {
+    printf("  -- height within the AVL bound (expect 1): %d\n",
+      avl_ok(id_tree_height(tree), NUM_KEYS / 2));
+  }
+
+  id_tree_insert(tree, id_key(1), &values[0]);
+  void* found = id_tree_get(tree, id_key(1));
+  printf("  -- a duplicate key: size (expect %d): %d, get returns one of its "
+    "values (expect 1): %d\n", NUM_KEYS / 2 + 1, id_tree_size(tree),
+    found == &values[0] || found == &values[1]);
+  id_tree_remove(tree, id_key(1));
+  void* other = found == &values[0] ? &values[1] : &values[0];
+  printf("  -- after removing it once, get returns the other value (expect "
+    "1): %d\n", id_tree_get(tree, id_key(1)) == other);
+  id_tree_free(tree);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < NUM_KEYS; i++) {
+    values[i] = i;
+    snprintf(strings[i], sizeof(strings[i]), "%d", i);
+  }
+
+  check_ids("BST_PLAIN", BST_PLAIN);
+  check_ids("BST_BALANCED", BST_BALANCED);
+
+  printf("\n== String keys in a BST_BALANCED | BST_UNIQUE tree...\n");
+  struct str_tree* strs = str_tree_create_mode(BST_BALANCED | BST_UNIQUE);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    str_tree_insert(strs, strings[scrambled(i)], &values[0]);
+    str_tree_insert(strs, strings[scrambled(i)], &values[scrambled(i)]);
+  }
+  char key[8] = "1234";
+  printf("  -- size (expect %d): %d, get(\"1234\") from another buffer (expect "
+    "1234): %d\n", NUM_KEYS, str_tree_size(strs),
+    *(int*)str_tree_get(strs, key));
+  void* old = NULL;
+  int replaced = str_tree_upsert(strs, "42", &values[7], &old);
+  printf("  -- upsert(\"42\") replaced (expect 1): %d, old value (expect 42): "
+    "%d\n", replaced, *(int*)old);
+  replaced = str_tree_upsert(strs, "abc", &values[7], &old);
+  printf("  -- upsert(\"abc\") replaced (expect 0): %d, size (expect %d): %d\n",
+    replaced, NUM_KEYS + 1, str_tree_size(strs));
+  struct str_tree_iterator* siter = str_tree_iterator_create(strs);
+  const char* first[4];
+  for (int i = 0; i < 4; i++) {
+    first[i] = str_tree_iterator_next(siter, NULL);
+  }
+  str_tree_iterator_free(siter);
+  printf("  -- first keys (expect 0 1 10 100): %s %s %s %s\n", first[0],
+    first[1], first[2], first[3]);
+  str_tree_free(strs);
+
+  printf("\n== A custom comparator (largest key first)...\n");
+  struct desc_tree* desc = desc_tree_create_mode(BST_BALANCED);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    desc_tree_insert(desc, scrambled(i), &values[scrambled(i)]);
+  }
+  struct desc_tree_iterator* diter = desc_tree_iterator_create(desc);
+  int expect = NUM_KEYS - 1, descending_ok = 1;
+  while (desc_tree_iterator_has_next(diter)) {
+    descending_ok &= desc_tree_iterator_next(diter, NULL) == expect--;
+  }
+  desc_tree_iterator_free(diter);
+  printf("  -- iterated from largest to smallest (expect 1): %d\n",
+    descending_ok && expect == -1);
+  printf("  -- get(5) (expect 5): %d\n", *(int*)desc_tree_get(desc, 5));
+  desc_tree_free(desc);
+  return 0;
+}
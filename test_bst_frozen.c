@@ -0,0 +1,178 @@
+/*
+ * This file contains executable code for testing frozen BSTs created with
+ * bst_freeze().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+#include "frozen.h"
+
+/*
+ * This is the data that's used to test this program.  It's the same data
+ * used in test_bst.c.
+ */
+#define NUM_TEST_DATA 13
+const int TEST_DATA[NUM_TEST_DATA] =
+  {64, 32, 96, 16, 48, 80, 112, 8, 24, 56, 88, 104, 120};
+
+/*
+ * This array defines some range sums to compute within the tree defined above
+ * as triples: {lower, upper, sum}.
+ */
+#define NUM_RANGE_SUMS 10
+const int RANGE_SUMS[NUM_RANGE_SUMS][3] = {
+  {8, 120, 848},
+  {0, 200, 848},
+  {2, 40, 80},
+  {24, 60, 160},
+  {30, 90, 368},
+  {60, 70, 64},
+  {60, 112, 544},
+  {84, 110, 288},
+  {96, 96, 96},
+  {125, 200, 0}
+};
+
+/*
+ * Number of random keys used in the comparison against the mutable BST, and
+ * the range they are drawn from.
+ */
+#define NUM_RANDOM_KEYS 50000
+#define KEY_RANGE 20000
+
+/*
+ * This is a helper function that freezes a BST created in the given mode
+ * and filled with random keys and compares every query against the mutable
+ * BST.  It returns the number of mismatches.
+ */
+int check_random(int mode) {
+  int* keys = malloc(KEY_RANGE * sizeof(int));
+  for (int i = 0; i < KEY_RANGE; i++) {
+    keys[i] = i;
+  }
+  struct bst* bst = bst_create_mode(mode);
+  srand(mode + 1);
+  for (int i = 0; i < NUM_RANDOM_KEYS; i++) {
+    int key = rand() % KEY_RANGE;
+    bst_insert(bst, key, &keys[key]);
+  }
+  struct bst_frozen* frozen = bst_freeze(bst);
+
+  int mismatches = bst_frozen_size(frozen) != bst_size(bst);
+  for (int key = -1; key <= KEY_RANGE; key++) {
+    if (bst_frozen_get(frozen, key) != bst_get(bst, key)) {
+      mismatches++;
+    }
+  }
+  for (int i = 0; i < 1000; i++) {
+    int lower = rand() % KEY_RANGE - 10;
+    int upper = lower + rand() % KEY_RANGE;
+    if (bst_frozen_range_sum(frozen, lower, upper)
+        != bst_range_sum64(bst, lower, upper)) {
+      mismatches++;
+    }
+  }
+
+  /*
+   * Iteration should visit every key in non-decreasing order.
+   */
+  int visited = 0, prev = -1;
+  for (int pos = bst_frozen_first(frozen); pos != 0;
+      pos = bst_frozen_next(frozen, pos)) {
+    int key = bst_frozen_key(frozen, pos);
+    if (key < prev || bst_frozen_value(frozen, pos) != &keys[key]) {
+      mismatches++;
+    }
+    prev = key;
+    visited++;
+  }
+  if (visited != bst_size(bst)) {
+    mismatches++;
+  }
+
+  bst_frozen_free(frozen);
+  bst_free(bst);
+  free(keys);
+  return mismatches;
+}
+
+int main(int argc, char** argv) {
+  /*
+   * Build a BST from the testing data and freeze it.  The mutable BST is
+   * freed right away to make sure the frozen copy doesn't depend on it.
+   */
+  printf("== Creating BST and inserting %d values...\n", NUM_TEST_DATA);
+  struct bst* bst = bst_create();
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    bst_insert(bst, TEST_DATA[i], (void*)&TEST_DATA[i]);
+  }
+  printf("\n== Freezing BST...\n");
+  struct bst_frozen* frozen = bst_freeze(bst);
+  bst_free(bst);
+
+  printf("\n== Checking correct value from bst_frozen_size(): %d "
+    "(expected %d)\n", bst_frozen_size(frozen), NUM_TEST_DATA);
+
+  printf("\n== Looking up values we know should be in the frozen BST...\n");
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    int* value = bst_frozen_get(frozen, TEST_DATA[i]);
+    if (value) {
+      printf("  -- bst_frozen_get(%3d): %3d (expected %3d)\n", TEST_DATA[i],
+        *value, TEST_DATA[i]);
+    } else {
+      printf("  -- bst_frozen_get(%3d) unexpectedly returned NULL\n",
+        TEST_DATA[i]);
+    }
+  }
+
+  printf("\n== Looking up values we know should NOT be in the frozen BST...\n");
+  for (int i = -10; i < 140; i++) {
+    if (i % 8 != 0 || i < 8 || i > 120) {
+      if (bst_frozen_get(frozen, i) != NULL) {
+        printf("  -- bst_frozen_get(%3d) unexpectedly returned a non-NULL "
+          "value\n", i);
+      }
+    }
+  }
+
+  printf("\n== Checking range sums in the frozen BST:\n");
+  for (int i = 0; i < NUM_RANGE_SUMS; i++) {
+    printf("  -- bst_frozen_range_sum(%d, %d): %lld (expected %d)\n",
+      RANGE_SUMS[i][0], RANGE_SUMS[i][1],
+      bst_frozen_range_sum(frozen, RANGE_SUMS[i][0], RANGE_SUMS[i][1]),
+      RANGE_SUMS[i][2]);
+  }
+
+  printf("\n== Iterating over the frozen BST: key / value\n");
+  for (int pos = bst_frozen_first(frozen); pos != 0;
+      pos = bst_frozen_next(frozen, pos)) {
+    printf("  - %3d / %3d\n", bst_frozen_key(frozen, pos),
+      *(int*)bst_frozen_value(frozen, pos));
+  }
+  bst_frozen_free(frozen);
+
+  /*
+   * An empty tree should freeze into an empty frozen BST.
+   */
+  bst = bst_create();
+  frozen = bst_freeze(bst);
+  printf("\n== Checking frozen empty BST: size %d, first position %d, "
+    "range sum %lld (expected 0, 0, 0)\n", bst_frozen_size(frozen),
+    bst_frozen_first(frozen), bst_frozen_range_sum(frozen, 0, 100));
+  bst_frozen_free(frozen);
+  bst_free(bst);
+
+  /*
+   * Compare frozen copies against the mutable BSTs they were made from.
+   */
+  printf("\n== Comparing frozen BSTs against %d random keys...\n",
+    NUM_RANDOM_KEYS);
+  printf("  -- plain: mismatches (expect 0): %d\n", check_random(BST_PLAIN));
+  printf("  -- balanced: mismatches (expect 0): %d\n",
+    check_random(BST_BALANCED));
+  printf("  -- bptree: mismatches (expect 0): %d\n", check_random(BST_BPTREE));
+
+  return 0;
+}
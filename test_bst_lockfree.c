@@ -0,0 +1,244 @@
+/*
+ * This file contains executable code for testing the lock-free BST in
+ * lfbst.c, first from a single thread against a simple model, and then with
+ * several threads inserting, removing and looking up keys at once.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <pthread.h>
+
+#include "lfbst.h"
+
+/*
+ * Number of random operations in the single-threaded test, and the range
+ * its keys are drawn from.
+ */
+#define NUM_OPS 200000
+#define KEY_RANGE 5000
+
+/*
+ * Number of threads in the concurrent test, number of operations each
+ * thread makes, number of keys all threads fight over, and number of keys
+ * owned by each thread.
+ */
+#define NUM_THREADS 8
+#define THREAD_OPS 200000
+#define SHARED_KEYS 256
+#define OWNED_KEYS 2000
+
+/*
+ * Every value stored in the trees points at the entry of this array that
+ * holds its key.  Owned keys of thread t are SHARED_KEYS + t * OWNED_KEYS
+ * and up.
+ */
+#define MAX_KEY (SHARED_KEYS + NUM_THREADS * OWNED_KEYS)
+int values[MAX_KEY];
+
+/*
+ * Returns the next number from a small linear congruential generator whose
+ * state is held in `*state`.  Each thread keeps its own state.
+ */
+unsigned int next_rand(unsigned int* state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 8;
+}
+
+/*
+ * This is a helper function that applies random operations to a lock-free
+ * BST and to an array recording which keys should be present, and returns
+ * the number of results on which the two disagree.
+ */
+int check_against_model() {
+  struct lfbst* tree = lfbst_create();
+  char* present = calloc(KEY_RANGE, 1);
+  unsigned int state = 1;
+  int mismatches = 0, size = 0;
+  for (int i = 0; i < NUM_OPS; i++) {
+    int key = next_rand(&state) % KEY_RANGE;
+    switch (next_rand(&state) % 3) {
+      case 0:
+        if (lfbst_insert(tree, key, &values[key]) != !present[key]) {
+          mismatches++;
+        }
+        size += !present[key];
+        present[key] = 1;
+        break;
+      case 1:
+        if (lfbst_remove(tree, key) != present[key]) {
+          mismatches++;
+        }
+        size -= present[key];
+        present[key] = 0;
+        break;
+      default:
+        if (lfbst_get(tree, key) != (present[key] ? &values[key] : NULL)) {
+          mismatches++;
+        }
+        break;
+    }
+  }
+
+  if (lfbst_size(tree) != size) {
+    mismatches++;
+  }
+  for (int i = 0; i < 1000; i++) {
+    int lower = next_rand(&state) % KEY_RANGE - 10;
+    int upper = lower + next_rand(&state) % KEY_RANGE;
+    long long sum = 0;
+    for (int key = lower < 0 ? 0 : lower; key <= upper && key < KEY_RANGE;
+        key++) {
+      sum += present[key] ? key : 0;
+    }
+    if (lfbst_range_sum(tree, lower, upper) != sum) {
+      mismatches++;
+    }
+  }
+
+  free(present);
+  lfbst_free(tree);
+  return mismatches;
+}
+
+/*
+ * State shared between the threads of the concurrent test.  Every thread
+ * records, for each shared key, how many times its own inserts and removals
+ * of that key succeeded.
+ */
+struct lfbst* shared;
+int net[NUM_THREADS][SHARED_KEYS];
+
+/*
+ * Each worker thread runs a random mix of operations on the shared keys,
+ * which every thread modifies, and on its own keys, which only it modifies.
+ * On its own keys, every result must match what the thread itself did
+ * last.  On shared keys, a successful insert and a successful removal of a
+ * key must alternate, so in the end the net number of successful inserts of
+ * each key across all threads must be 1 if the key is present and 0 if not.
+ * Returns the number of wrong answers seen (cast to a pointer).
+ */
+void* worker(void* arg) {
+  int t = (int)(long)arg;
+  int base = SHARED_KEYS + t * OWNED_KEYS;
+  char* present = calloc(OWNED_KEYS, 1);
+  unsigned int state = t + 1;
+  long errors = 0;
+  long long owned_sum = 0;
+  for (int i = 0; i < THREAD_OPS; i++) {
+    unsigned int op = next_rand(&state) % 8;
+    if (op < 3) {
+      int key = next_rand(&state) % SHARED_KEYS;
+      void* value;
+      switch (op) {
+        case 0:
+          net[t][key] += lfbst_insert(shared, key, &values[key]);
+          break;
+        case 1:
+          net[t][key] -= lfbst_remove(shared, key);
+          break;
+        default:
+          value = lfbst_get(shared, key);
+          if (value != NULL && value != &values[key]) {
+            errors++;
+          }
+          break;
+      }
+      continue;
+    }
+
+    int j = next_rand(&state) % OWNED_KEYS;
+    int key = base + j;
+    switch (op) {
+      case 3:
+      case 4:
+        if (lfbst_insert(shared, key, &values[key]) != !present[j]) {
+          errors++;
+        }
+        owned_sum += present[j] ? 0 : key;
+        present[j] = 1;
+        break;
+      case 5:
+        if (lfbst_remove(shared, key) != present[j]) {
+          errors++;
+        }
+        owned_sum -= present[j] ? key : 0;
+        present[j] = 0;
+        break;
+      case 6:
+        if (lfbst_get(shared, key) != (present[j] ? &values[key] : NULL)) {
+          errors++;
+        }
+        break;
+      default:
+        /*
+         * Nobody else touches this thread's keys, so a range sum over them
+         * must be exact even while other threads change the tree.
+         */
+        if (lfbst_range_sum(shared, base, base + OWNED_KEYS - 1)
+            != owned_sum) {
+          errors++;
+        }
+        break;
+    }
+  }
+
+  /*
+   * Remove every owned key again, so the tree only holds shared keys.
+   */
+  for (int j = 0; j < OWNED_KEYS; j++) {
+    if (lfbst_remove(shared, base + j) != present[j]) {
+      errors++;
+    }
+  }
+  free(present);
+  return (void*)errors;
+}
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < MAX_KEY; i++) {
+    values[i] = i;
+  }
+
+  printf("== Comparing the lock-free BST against a model after %d random "
+    "operations...\n", NUM_OPS);
+  printf("  -- mismatches (expect 0): %d\n", check_against_model());
+
+  printf("\n== Running %d threads making %d operations each...\n",
+    NUM_THREADS, THREAD_OPS);
+  shared = lfbst_create();
+  pthread_t threads[NUM_THREADS];
+  for (int t = 0; t < NUM_THREADS; t++) {
+    pthread_create(&threads[t], NULL, worker, (void*)(long)t);
+  }
+  long errors = 0;
+  for (int t = 0; t < NUM_THREADS; t++) {
+    void* result;
+    pthread_join(threads[t], &result);
+    errors += (long)result;
+  }
+  printf("  -- wrong answers seen by threads (expect 0): %ld\n", errors);
+
+  int bad_keys = 0, size = 0;
+  long long sum = 0;
+  for (int key = 0; key < SHARED_KEYS; key++) {
+    int n = 0;
+    for (int t = 0; t < NUM_THREADS; t++) {
+      n += net[t][key];
+    }
+    void* value = lfbst_get(shared, key);
+    if (n != (value != NULL) || (value != NULL && value != &values[key])) {
+      bad_keys++;
+    }
+    size += n;
+    sum += n * key;
+  }
+  printf("  -- shared keys whose successful inserts and removals don't "
+    "match their final state (expect 0): %d\n", bad_keys);
+  printf("  -- lfbst_size() matches net inserts: %s\n",
+    lfbst_size(shared) == size ? "yes" : "no");
+  printf("  -- lfbst_range_sum() matches net inserts: %s\n",
+    lfbst_range_sum(shared, 0, MAX_KEY) == sum ? "yes" : "no");
+  lfbst_free(shared);
+
+  return 0;
+}
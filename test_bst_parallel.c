@@ -0,0 +1,102 @@
+/*
+ * This file contains executable code for testing bst_height_parallel()
+ * against bst_height() on trees of different shapes, sizes and modes, with
+ * different numbers of threads.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Thread counts each tree is measured with.
+ */
+#define NUM_THREAD_COUNTS 4
+const int THREAD_COUNTS[NUM_THREAD_COUNTS] = {1, 2, 4, 8};
+
+/*
+ * Returns the next number from a small linear congruential generator whose
+ * state is held in `*state`.
+ */
+unsigned int next_rand(unsigned int* state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 8;
+}
+
+/*
+ * This is a helper function that measures a tree with every thread count
+ * and returns the number of results that differ from bst_height().
+ */
+int check_tree(struct bst* bst) {
+  int expected = bst_height(bst), mismatches = 0;
+  for (int i = 0; i < NUM_THREAD_COUNTS; i++) {
+    if (bst_height_parallel(bst, THREAD_COUNTS[i]) != expected) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+int main(int argc, char** argv) {
+  unsigned int state = 1;
+
+  printf("== Checking plain trees of random keys...\n");
+  int sizes[5] = {0, 1, 100, 10000, 1000000};
+  for (int i = 0; i < 5; i++) {
+    struct bst* bst = bst_create();
+    for (int j = 0; j < sizes[i]; j++) {
+      bst_insert(bst, next_rand(&state) % (2 * sizes[i]), NULL);
+    }
+    printf("  -- %7d keys: mismatches (expect 0): %d\n", sizes[i],
+      check_tree(bst));
+    bst_free(bst);
+  }
+
+  /*
+   * Keys inserted in sorted order make a list-like tree, and keys inserted
+   * from both ends towards the middle make a long zig-zag.
+   */
+  printf("\n== Checking degenerate plain trees...\n");
+  struct bst* bst = bst_create();
+  for (int j = 0; j < 20000; j++) {
+    bst_insert(bst, j, NULL);
+  }
+  printf("  -- sorted: mismatches (expect 0): %d\n", check_tree(bst));
+  bst_free(bst);
+  bst = bst_create();
+  for (int j = 0; j < 10000; j++) {
+    bst_insert(bst, j, NULL);
+    bst_insert(bst, 40000 - j, NULL);
+  }
+  printf("  -- zig-zag: mismatches (expect 0): %d\n", check_tree(bst));
+  bst_free(bst);
+
+  /*
+   * A large random tree with a degenerate tail hanging off its largest key.
+   */
+  bst = bst_create();
+  for (int j = 0; j < 100000; j++) {
+    bst_insert(bst, next_rand(&state) % 100000, NULL);
+  }
+  for (int j = 0; j < 10000; j++) {
+    bst_insert(bst, 100000 + j, NULL);
+  }
+  printf("  -- random with a sorted tail: mismatches (expect 0): %d\n",
+    check_tree(bst));
+  bst_free(bst);
+
+  printf("\n== Checking the other modes...\n");
+  int modes[3] = {BST_BALANCED, BST_BPTREE, BST_CONCURRENT};
+  const char* names[3] = {"balanced", "bptree", "concurrent"};
+  for (int m = 0; m < 3; m++) {
+    bst = bst_create_mode(modes[m]);
+    for (int j = 0; j < 100000; j++) {
+      bst_insert(bst, next_rand(&state) % 100000, NULL);
+    }
+    printf("  -- %s: mismatches (expect 0): %d\n", names[m], check_tree(bst));
+    bst_free(bst);
+  }
+
+  return 0;
+}
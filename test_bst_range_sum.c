@@ -0,0 +1,120 @@
+/*
+ * This file contains executable code for testing the range sums computed by
+ * your BST implementation on larger trees, including sums that do not fit in
+ * an int.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "bst.h"
+
+/*
+ * Number of random keys inserted into each tree.
+ */
+#define NUM_KEYS 5000
+
+/*
+ * Number of random ranges checked against a brute-force sum.
+ */
+#define NUM_RANGES 2000
+
+/*
+ * This is a helper function that returns a random key in [-span, span].
+ */
+int random_key(int span) {
+  long long r = ((long long)rand() << 16) ^ rand();
+  return (int)(r % (2LL * span + 1) - span);
+}
+
+/*
+ * This is a helper function that computes a range sum the slow way, by
+ * looking at every key.
+ */
+long long brute_range_sum(int* keys, int n, int lower, int upper) {
+  long long sum = 0;
+  for (int i = 0; i < n; i++) {
+    if (keys[i] >= lower && keys[i] <= upper) {
+      sum += keys[i];
+    }
+  }
+  return sum;
+}
+
+/*
+ * This is a helper function that fills a BST created in the given mode with
+ * random keys (including duplicates), removes some of them, and compares
+ * bst_range_sum64() against a brute-force sum over many random ranges.  It
+ * returns the number of mismatches.
+ */
+int check_random(int mode, int span) {
+  int* keys = malloc(NUM_KEYS * sizeof(int));
+  struct bst* bst = bst_create_mode(mode);
+  srand(span);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    keys[i] = random_key(span);
+    bst_insert(bst, keys[i], NULL);
+  }
+  int n = 0;
+  for (int i = 0; i < NUM_KEYS; i++) {
+    if (i % 4 == 0) {
+      bst_remove(bst, keys[i]);
+    } else {
+      keys[n++] = keys[i];
+    }
+  }
+
+  int mismatches = 0;
+  for (int i = 0; i < NUM_RANGES; i++) {
+    int lower = random_key(span);
+    int upper = random_key(span);
+    if (bst_range_sum64(bst, lower, upper)
+        != brute_range_sum(keys, n, lower, upper)) {
+      mismatches++;
+    }
+  }
+  if (bst_range_sum64(bst, INT_MIN, INT_MAX)
+      != brute_range_sum(keys, n, INT_MIN, INT_MAX)) {
+    mismatches++;
+  }
+
+  bst_free(bst);
+  free(keys);
+  return mismatches;
+}
+
+int main(int argc, char** argv) {
+  /*
+   * Insert keys whose sum overflows an int and make sure the 64-bit range
+   * sum gets it right.
+   */
+  printf("== Inserting 4 keys of %d into BST...\n", INT_MAX);
+  struct bst* bst = bst_create();
+  for (int i = 0; i < 4; i++) {
+    bst_insert(bst, INT_MAX, NULL);
+  }
+  printf("\n== Checking bst_range_sum64(0, %d): %lld (expected %lld)\n",
+    INT_MAX, bst_range_sum64(bst, 0, INT_MAX), 4LL * INT_MAX);
+  printf("== Checking bst_range_sum64(%d, %d): %lld (expected %lld)\n",
+    INT_MIN, INT_MAX, bst_range_sum64(bst, INT_MIN, INT_MAX), 4LL * INT_MAX);
+  printf("== Checking bst_range_sum64(10, 0): %lld (expected 0)\n",
+    bst_range_sum64(bst, 10, 0));
+  bst_free(bst);
+
+  /*
+   * Compare against brute-force sums on random trees in each mode, with keys
+   * both small (lots of duplicates) and large (sums overflow an int).
+   */
+  printf("\n== Checking %d random range sums per tree...\n", NUM_RANGES);
+  printf("  -- plain, small keys: mismatches (expect 0): %d\n",
+    check_random(BST_PLAIN, 100));
+  printf("  -- plain, large keys: mismatches (expect 0): %d\n",
+    check_random(BST_PLAIN, INT_MAX));
+  printf("  -- balanced, small keys: mismatches (expect 0): %d\n",
+    check_random(BST_BALANCED, 100));
+  printf("  -- balanced, large keys: mismatches (expect 0): %d\n",
+    check_random(BST_BALANCED, INT_MAX));
+
+  return 0;
+}
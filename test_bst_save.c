@@ -0,0 +1,229 @@
+/*
+ * This file contains executable code for testing BSTs saved with bst_save()
+ * and loaded back with bst_load_mmap(), including how loading copes with
+ * damaged files.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+#include "frozen.h"
+
+/*
+ * Number of random keys saved, and the range they are drawn from.  The range
+ * is small enough that many keys are duplicated.
+ */
+#define NUM_KEYS 100000
+#define KEY_RANGE 50000
+
+/*
+ * File the tests save trees to.
+ */
+#define SAVE_PATH "test_bst_save.tmp"
+
+/*
+ * Every value stored in the tree points into this array.  Values are saved
+ * as their index in it.
+ */
+int values[NUM_KEYS];
+
+unsigned long long encode(void* arg, void* value) {
+  return (int*)value - (int*)arg;
+}
+
+void* decode(void* arg, unsigned long long code) {
+  return (int*)arg + code;
+}
+
+/*
+ * Returns the next number from a small linear congruential generator whose
+ * state is held in `*state`.
+ */
+unsigned int next_rand(unsigned int* state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 8;
+}
+
+/*
+ * This is a helper function that compares a loaded tree with the frozen
+ * copy of the tree it was saved from, and returns the number of differences.
+ */
+int compare(struct bst_frozen* loaded, struct bst_frozen* expected) {
+  int differences = 0;
+  if (bst_frozen_size(loaded) != bst_frozen_size(expected)) {
+    differences++;
+  }
+  for (int key = -1; key <= KEY_RANGE; key++) {
+    if (bst_frozen_get(loaded, key) != bst_frozen_get(expected, key)) {
+      differences++;
+    }
+  }
+  unsigned int state = 3;
+  for (int i = 0; i < 1000; i++) {
+    int lower = next_rand(&state) % KEY_RANGE;
+    int upper = lower + next_rand(&state) % KEY_RANGE;
+    if (bst_frozen_range_sum(loaded, lower, upper)
+        != bst_frozen_range_sum(expected, lower, upper)) {
+      differences++;
+    }
+  }
+  int a = bst_frozen_first(loaded), b = bst_frozen_first(expected);
+  while (a != 0 && b != 0) {
+    if (bst_frozen_key(loaded, a) != bst_frozen_key(expected, b)
+        || bst_frozen_value(loaded, a) != bst_frozen_value(expected, b)) {
+      differences++;
+    }
+    a = bst_frozen_next(loaded, a);
+    b = bst_frozen_next(expected, b);
+  }
+  return differences + (a != b);
+}
+
+/*
+ * Overwrites one byte of the saved file at `offset` with `byte`.
+ */
+void poke(long offset, int byte) {
+  FILE* file = fopen(SAVE_PATH, "r+b");
+  fseek(file, offset, SEEK_SET);
+  fputc(byte, file);
+  fclose(file);
+}
+
+/*
+ * The saved header, seen as the 64-bit words it is made of: the magic
+ * number, then the version and byte order, then n, the three array offsets,
+ * the file size and the two checksums.
+ */
+#define HEADER_WORDS 9
+#define WORD_N 2
+#define WORD_KEYS_OFFSET 3
+#define WORD_PREFIX_OFFSET 4
+#define WORD_CODES_OFFSET 5
+#define WORD_FILE_SIZE 6
+#define WORD_HEADER_CHECKSUM 8
+
+/*
+ * Overwrites word `word` of the saved file's header with `value` and
+ * recomputes the header checksum the same way bst_save() does, so that only
+ * the layout checks in bst_load_mmap() can tell the header was changed.
+ * Returns the word's old value.
+ */
+unsigned long long forge(int word, unsigned long long value) {
+  unsigned long long header[HEADER_WORDS];
+  FILE* file = fopen(SAVE_PATH, "r+b");
+  if (fread(header, sizeof(header), 1, file) != 1) {
+    fclose(file);
+    return 0;
+  }
+  unsigned long long old = header[word];
+  header[word] = value;
+  header[WORD_HEADER_CHECKSUM] = 0;
+  unsigned long long h = 0xcbf29ce484222325ULL;
+  for (int i = 0; i < HEADER_WORDS; i++) {
+    h = (h ^ header[i]) * 0x100000001b3ULL;
+    h ^= h >> 29;
+  }
+  header[WORD_HEADER_CHECKSUM] = h;
+  fseek(file, 0, SEEK_SET);
+  fwrite(header, sizeof(header), 1, file);
+  fclose(file);
+  return old;
+}
+
+int main(int argc, char** argv) {
+  unsigned int state = 1;
+  struct bst* bst = bst_create_mode(BST_BALANCED);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    bst_insert(bst, next_rand(&state) % KEY_RANGE, &values[i]);
+  }
+  struct bst_frozen* expected = bst_freeze(bst);
+
+  printf("== Saving and loading a BST with %d keys...\n", NUM_KEYS);
+  printf("  -- bst_save() returned (expect 0): %d\n",
+    bst_save(bst, SAVE_PATH, encode, values));
+  struct bst_frozen* loaded = bst_load_mmap(SAVE_PATH, decode, values);
+  printf("  -- loaded: %s\n", loaded ? "yes" : "no");
+  printf("  -- differences from the saved tree (expect 0): %d\n",
+    compare(loaded, expected));
+  printf("  -- range sum matches bst_range_sum64(): %s\n",
+    bst_frozen_range_sum(loaded, 100, 40000)
+      == bst_range_sum64(bst, 100, 40000) ? "yes" : "no");
+  printf("  -- bst_frozen_verify() (expect 1): %d\n", bst_frozen_verify(loaded));
+  bst_frozen_free(loaded);
+
+  /*
+   * A saved tree can be saved again from its mapping.
+   */
+  loaded = bst_load_mmap(SAVE_PATH, decode, values);
+  bst_frozen_save(loaded, SAVE_PATH ".2", encode, values);
+  bst_frozen_free(loaded);
+  loaded = bst_load_mmap(SAVE_PATH ".2", decode, values);
+  printf("  -- differences after saving a loaded tree again (expect 0): %d\n",
+    compare(loaded, expected));
+  bst_frozen_free(loaded);
+  remove(SAVE_PATH ".2");
+
+  printf("\n== Loading damaged files...\n");
+  poke(100000, 0x5a);
+  loaded = bst_load_mmap(SAVE_PATH, decode, values);
+  printf("  -- damaged data still loads: %s\n", loaded ? "yes" : "no");
+  printf("  -- bst_frozen_verify() (expect 0): %d\n", bst_frozen_verify(loaded));
+  bst_frozen_free(loaded);
+  poke(20, 0x5a);
+  printf("  -- damaged header loads (expect no): %s\n",
+    bst_load_mmap(SAVE_PATH, decode, values) ? "yes" : "no");
+  FILE* file = fopen(SAVE_PATH, "wb");
+  fputs("not a tree", file);
+  fclose(file);
+  printf("  -- other file loads (expect no): %s\n",
+    bst_load_mmap(SAVE_PATH, decode, values) ? "yes" : "no");
+  remove(SAVE_PATH);
+  printf("  -- missing file loads (expect no): %s\n",
+    bst_load_mmap(SAVE_PATH, decode, values) ? "yes" : "no");
+
+  /*
+   * A header with a valid checksum must still describe exactly the layout
+   * bst_save() writes for its number of keys, or queries would read past
+   * the end of the mapping.
+   */
+  printf("\n== Loading files with forged headers...\n");
+  bst_save(bst, SAVE_PATH, encode, values);
+  forge(WORD_N, forge(WORD_N, 0));
+  loaded = bst_load_mmap(SAVE_PATH, decode, values);
+  printf("  -- header rewritten unchanged loads (expect yes): %s\n",
+    loaded ? "yes" : "no");
+  bst_frozen_free(loaded);
+  const char* names[] = {"n = 100000000", "n - 1", "keys_offset + 64",
+    "prefix_offset + 64", "codes_offset - 64", "file_size - 8"};
+  int words[] = {WORD_N, WORD_N, WORD_KEYS_OFFSET, WORD_PREFIX_OFFSET,
+    WORD_CODES_OFFSET, WORD_FILE_SIZE};
+  for (int i = 0; i < 6; i++) {
+    unsigned long long old = forge(words[i], 0);
+    forge(words[i], i == 0 ? 100000000 : i == 1 ? old - 1
+      : i == 4 ? old - 64 : i == 5 ? old - 8 : old + 64);
+    loaded = bst_load_mmap(SAVE_PATH, decode, values);
+    printf("  -- header with %s loads (expect no): %s\n", names[i],
+      loaded ? "yes" : "no");
+    if (loaded != NULL) {
+      bst_frozen_free(loaded);
+    }
+    forge(words[i], old);
+  }
+  remove(SAVE_PATH);
+
+  printf("\n== Saving and loading an empty BST...\n");
+  struct bst* empty = bst_create();
+  bst_save(empty, SAVE_PATH, NULL, NULL);
+  loaded = bst_load_mmap(SAVE_PATH, NULL, NULL);
+  printf("  -- size: %d (expected 0)\n", bst_frozen_size(loaded));
+  printf("  -- bst_frozen_get(1) is NULL: %s\n",
+    bst_frozen_get(loaded, 1) == NULL ? "yes" : "no");
+  bst_frozen_free(loaded);
+  remove(SAVE_PATH);
+  bst_free(empty);
+
+  bst_frozen_free(expected);
+  bst_free(bst);
+  return 0;
+}
@@ -0,0 +1,170 @@
+/*
+ * This file contains executable code for testing in-order scans with BST
+ * iterators on larger trees in every mode, including a degenerate tree that
+ * is much deeper than the iterator's built-in stack, and range scans with
+ * iterators created by bst_iterator_create_range().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <limits.h>
+
+#include "bst.h"
+
+/*
+ * Number of random keys inserted into each tree, and the range they are
+ * drawn from.
+ */
+#define NUM_KEYS 100000
+#define KEY_RANGE 30000
+
+/*
+ * Number of keys inserted in ascending order into a plain tree, which turns
+ * it into a chain this many nodes deep.
+ */
+#define NUM_CHAIN_KEYS 5000
+
+/*
+ * This is a helper function that scans a BST with an iterator and returns
+ * the number of problems found: keys out of order, values that don't match
+ * their keys (every value points at a copy of its key), or a number of
+ * visited nodes that doesn't match bst_size().
+ */
+int check_scan(struct bst* bst) {
+  int problems = 0, visited = 0, prev = -1;
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    int* value;
+    int key = bst_iterator_next(iter, (void**)&value);
+    if (key < prev || *value != key) {
+      problems++;
+    }
+    prev = key;
+    visited++;
+  }
+  bst_iterator_free(iter);
+  return problems + (visited != bst_size(bst));
+}
+
+/*
+ * This is a helper function that scans the keys of a BST between `lower`
+ * and `upper` with a range iterator and returns the number of problems
+ * found: keys out of order or outside the range, values that don't match
+ * their keys, a number of keys other than `count`, or a sum of keys that
+ * doesn't match bst_range_sum64().
+ */
+int check_range_scan(struct bst* bst, int lower, int upper, int count) {
+  int problems = 0, visited = 0, prev = lower;
+  long long sum = 0;
+  struct bst_iterator* iter = bst_iterator_create_range(bst, lower, upper);
+  while (bst_iterator_has_next(iter)) {
+    int* value;
+    int key = bst_iterator_next(iter, (void**)&value);
+    if (key < prev || key > upper || *value != key) {
+      problems++;
+    }
+    prev = key;
+    sum += key;
+    visited++;
+  }
+  bst_iterator_free(iter);
+  if (sum != bst_range_sum64(bst, lower, upper)) {
+    problems++;
+  }
+  return problems + (visited != count);
+}
+
+/*
+ * This is a helper function that fills a BST created in the given mode with
+ * random keys and scans it, both in full and over many random ranges.
+ */
+int check_random(int mode, int* keys) {
+  int* counts = calloc(KEY_RANGE, sizeof(int));
+  struct bst* bst = bst_create_mode(mode);
+  srand(mode + 3);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    int key = rand() % KEY_RANGE;
+    bst_insert(bst, key, &keys[key]);
+    counts[key]++;
+  }
+  int problems = check_scan(bst);
+
+  /*
+   * Ranges may extend past either end of the keys in the tree, and some are
+   * empty because `upper` is less than `lower`.
+   */
+  for (int i = 0; i < 500; i++) {
+    int lower = rand() % (KEY_RANGE + 100) - 50;
+    int upper = lower + rand() % 500 - 10;
+    int count = 0;
+    for (int key = lower; key <= upper; key++) {
+      if (key >= 0 && key < KEY_RANGE) {
+        count += counts[key];
+      }
+    }
+    problems += check_range_scan(bst, lower, upper, count);
+  }
+  bst_free(bst);
+  free(counts);
+  return problems;
+}
+
+int main(int argc, char** argv) {
+  int* keys = malloc(KEY_RANGE * sizeof(int));
+  for (int i = 0; i < KEY_RANGE; i++) {
+    keys[i] = i;
+  }
+
+  printf("== Scanning BSTs holding %d random keys...\n", NUM_KEYS);
+  printf("  -- plain: problems (expect 0): %d\n",
+    check_random(BST_PLAIN, keys));
+  printf("  -- balanced: problems (expect 0): %d\n",
+    check_random(BST_BALANCED, keys));
+  printf("  -- bptree: problems (expect 0): %d\n",
+    check_random(BST_BPTREE, keys));
+
+  /*
+   * Keys inserted in descending order into a plain tree form a chain of
+   * left children, so the iterator has to hold all of them on its stack
+   * before visiting the first one.
+   */
+  printf("\n== Scanning a plain BST %d levels deep...\n", NUM_CHAIN_KEYS);
+  struct bst* bst = bst_create();
+  for (int i = NUM_CHAIN_KEYS - 1; i >= 0; i--) {
+    bst_insert(bst, i, &keys[i]);
+  }
+  printf("  -- height: %d (expected %d)\n", bst_height(bst),
+    NUM_CHAIN_KEYS - 1);
+  printf("  -- problems (expect 0): %d\n", check_scan(bst));
+  bst_free(bst);
+
+  /*
+   * Range scans at the very ends of the key space shouldn't overflow.
+   */
+  bst = bst_create_mode(BST_BALANCED);
+  bst_insert(bst, INT_MIN, &keys[0]);
+  bst_insert(bst, INT_MAX, &keys[1]);
+  struct bst_iterator* iter = bst_iterator_create_range(bst, INT_MAX, INT_MAX);
+  printf("\n== Checking range scan of [INT_MAX, INT_MAX] (expect 1 0): %d ",
+    bst_iterator_has_next(iter) && bst_iterator_next(iter, NULL) == INT_MAX);
+  printf("%d\n", bst_iterator_has_next(iter));
+  bst_iterator_free(iter);
+  bst_free(bst);
+
+  /*
+   * Iterators over empty trees have nothing to visit.
+   */
+  printf("\n== Checking iterators over empty BSTs (expect 0 0 0): ");
+  int modes[3] = {BST_PLAIN, BST_BALANCED, BST_BPTREE};
+  for (int i = 0; i < 3; i++) {
+    bst = bst_create_mode(modes[i]);
+    iter = bst_iterator_create(bst);
+    printf("%d ", bst_iterator_has_next(iter));
+    bst_iterator_free(iter);
+    bst_free(bst);
+  }
+  printf("\n");
+
+  free(keys);
+  return 0;
+}
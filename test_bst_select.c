@@ -0,0 +1,219 @@
+/*
+ * This file contains executable code for testing the order-statistic queries
+ * (bst_select() and bst_rank()) of your BST implementation, along with the
+ * subtree sizes that back them and bst_size().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bst.h"
+
+/*
+ * This is the data that's used to test this program.  It forms a tree that
+ * looks like this when inserted into a BST_PLAIN tree:
+ *
+ *               64
+ *              /  \
+ *             /    \
+ *            /      \
+ *           /        \
+ *          32        96
+ *         /  \      /  \
+ *        /    \    /    \
+ *       16    48  80    112
+ *      /  \     \   \   /  \
+ *     8   24    56  88 104 120
+ */
+#define NUM_TEST_DATA 13
+const int TEST_DATA[NUM_TEST_DATA] =
+  {64, 32, 96, 16, 48, 80, 112, 8, 24, 56, 88, 104, 120};
+
+/*
+ * This array contains values from the TEST_DATA array above that we'll try
+ * to remove from the BST.
+ */
+#define NUM_DATA_TO_REMOVE 4
+const int TEST_DATA_TO_REMOVE[NUM_DATA_TO_REMOVE] = {16, 48, 64, 104};
+
+/*
+ * Number of keys used in the randomized comparison against a sorted array.
+ */
+#define NUM_RANDOM_KEYS 20000
+
+/*
+ * This is a helper function that's used to compare integers when sorting with
+ * qsort().
+ */
+int cmp_ints(const void* a, const void* b) {
+  return *(int*)a - *(int*)b;
+}
+
+/*
+ * This is a helper function that counts how many entries of a sorted array
+ * are strictly less than `key` using binary search.
+ */
+int sorted_rank(int* sorted, int n, int key) {
+  int lo = 0, hi = n;
+  while (lo < hi) {
+    int mid = lo + (hi - lo) / 2;
+    if (sorted[mid] < key) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+  return lo;
+}
+
+/*
+ * This is a helper function that compares bst_size(), bst_select() and
+ * bst_rank() against a sorted array holding the same keys as the BST and
+ * returns the number of mismatches.
+ */
+int check_against_sorted(struct bst* bst, int* sorted, int n) {
+  int mismatches = 0;
+  if (bst_size(bst) != n) {
+    mismatches++;
+  }
+  for (int k = 0; k < n; k++) {
+    int* value;
+    int key = bst_select(bst, k, (void**)&value);
+    if (key != sorted[k] || *value != key) {
+      mismatches++;
+    }
+    if (bst_rank(bst, sorted[k]) != sorted_rank(sorted, n, sorted[k])) {
+      mismatches++;
+    }
+    int next = sorted[k] + 1;
+    if (bst_rank(bst, next) != sorted_rank(sorted, n, next)) {
+      mismatches++;
+    }
+  }
+  return mismatches;
+}
+
+/*
+ * This is a helper function that inserts NUM_RANDOM_KEYS random keys (with
+ * duplicates) into a BST created in the given mode, removes a third of them
+ * again and compares the order statistics against a sorted array at each
+ * step.
+ */
+void test_random(const char* name, int mode) {
+  int* keys = malloc(NUM_RANDOM_KEYS * sizeof(int));
+  int* sorted = malloc(NUM_RANDOM_KEYS * sizeof(int));
+  struct bst* bst = bst_create_mode(mode);
+  srand(1);
+  for (int i = 0; i < NUM_RANDOM_KEYS; i++) {
+    keys[i] = rand() % (NUM_RANDOM_KEYS / 2);
+    bst_insert(bst, keys[i], (void*)&keys[i]);
+  }
+  memcpy(sorted, keys, NUM_RANDOM_KEYS * sizeof(int));
+  qsort(sorted, NUM_RANDOM_KEYS, sizeof(int), cmp_ints);
+  printf("  -- %s: mismatches after inserting (expect 0): %d\n", name,
+    check_against_sorted(bst, sorted, NUM_RANDOM_KEYS));
+
+  /*
+   * Remove every third key.  Values of duplicate keys may be removed in a
+   * different order than they were inserted, so only keys are compared.
+   */
+  int n = 0;
+  for (int i = 0; i < NUM_RANDOM_KEYS; i++) {
+    if (i % 3 == 0) {
+      bst_remove(bst, keys[i]);
+    } else {
+      sorted[n++] = keys[i];
+    }
+  }
+  qsort(sorted, n, sizeof(int), cmp_ints);
+  int mismatches = bst_size(bst) != n;
+  for (int k = 0; k < n; k++) {
+    if (bst_select(bst, k, NULL) != sorted[k]) {
+      mismatches++;
+    }
+    if (bst_rank(bst, sorted[k]) != sorted_rank(sorted, n, sorted[k])) {
+      mismatches++;
+    }
+  }
+  printf("  -- %s: mismatches after removing (expect 0): %d\n", name,
+    mismatches);
+
+  bst_free(bst);
+  free(sorted);
+  free(keys);
+}
+
+int main(int argc, char** argv) {
+  /*
+   * Create a new BST and insert the testing data into it.  The value stored
+   * with each key is the address of that key in the TEST_DATA array.
+   */
+  printf("== Creating BST...\n");
+  struct bst* bst = bst_create();
+  printf("\n== Inserting %d values into BST...\n", NUM_TEST_DATA);
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    bst_insert(bst, TEST_DATA[i], (void*)&TEST_DATA[i]);
+  }
+
+  int* sorted = malloc(NUM_TEST_DATA * sizeof(int));
+  memcpy(sorted, TEST_DATA, NUM_TEST_DATA * sizeof(int));
+  qsort(sorted, NUM_TEST_DATA, sizeof(int), cmp_ints);
+
+  /*
+   * Make sure bst_select() returns the keys in sorted order along with their
+   * values.
+   */
+  printf("\n== Checking bst_select(): key / value (expected)\n");
+  for (int k = 0; k < NUM_TEST_DATA; k++) {
+    int* value;
+    int key = bst_select(bst, k, (void**)&value);
+    printf("  - bst_select(%2d): %3d / %3d (%3d)\n", k, key, *value,
+      sorted[k]);
+  }
+
+  /*
+   * Make sure bst_rank() counts the keys below both present and absent keys.
+   */
+  printf("\n== Checking bst_rank():\n");
+  for (int i = 0; i <= 128; i += 20) {
+    printf("  - bst_rank(%3d): %2d (expected %2d)\n", i, bst_rank(bst, i),
+      sorted_rank(sorted, NUM_TEST_DATA, i));
+  }
+
+  /*
+   * Remove some keys and make sure bst_size() and the order statistics keep
+   * track of the change.
+   */
+  printf("\n== Removing keys from BST...\n");
+  for (int i = 0; i < NUM_DATA_TO_REMOVE; i++) {
+    bst_remove(bst, TEST_DATA_TO_REMOVE[i]);
+  }
+  printf("  -- removing a key that isn't present...\n");
+  bst_remove(bst, 1000);
+  printf("\n== Checking correct value from bst_size(): %d (expected %d)\n",
+    bst_size(bst), NUM_TEST_DATA - NUM_DATA_TO_REMOVE);
+  printf("\n== Checking bst_select() after removal: key (expected)\n");
+  for (int i = 0, k = 0, r = 0; i < NUM_TEST_DATA; i++) {
+    if (r < NUM_DATA_TO_REMOVE && sorted[i] == TEST_DATA_TO_REMOVE[r]) {
+      r++;
+      continue;
+    }
+    printf("  - bst_select(%2d): %3d (%3d)\n", k, bst_select(bst, k, NULL),
+      sorted[i]);
+    k++;
+  }
+
+  free(sorted);
+  bst_free(bst);
+
+  /*
+   * Compare against a sorted array on a larger random workload in each mode.
+   */
+  printf("\n== Checking order statistics on %d random keys...\n",
+    NUM_RANDOM_KEYS);
+  test_random("plain", BST_PLAIN);
+  test_random("balanced", BST_BALANCED);
+
+  return 0;
+}
@@ -0,0 +1,257 @@
+/*
+ * This file contains executable code for testing the set operations of your
+ * BST implementation (bst_union(), bst_intersect() and bst_difference()),
+ * serially and in parallel.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Keys are drawn from [0, KEY_RANGE).  The large trees used below hold
+ * about half of those keys each, so they are big enough to be combined in
+ * parallel.
+ */
+#define KEY_RANGE 200000
+
+/*
+ * Every value stored in the trees points into one of these arrays: values
+ * inserted into the first tree of an operation point into `values_a`, and
+ * those inserted into the second into `values_b`.
+ */
+int values_a[KEY_RANGE];
+int values_b[KEY_RANGE];
+
+/*
+ * The keys each tree of an operation was built from, as flags indexed by
+ * key.
+ */
+char in_a[KEY_RANGE];
+char in_b[KEY_RANGE];
+
+/*
+ * State of a xorshift random number generator, so the trees are the same on
+ * every run.
+ */
+unsigned long long rng = 88172645463325252ULL;
+
+unsigned long long next_rand() {
+  rng ^= rng << 13;
+  rng ^= rng >> 7;
+  rng ^= rng << 17;
+  return rng;
+}
+
+/*
+ * Builds a tree created with `mode` holding every key whose flag is set in
+ * `in`, inserted in a random order, each with its entry of `values`.
+ */
+struct bst* make_tree(int mode, char* in, int* values) {
+  int* keys = malloc(KEY_RANGE * sizeof(int));
+  int n = 0;
+  for (int key = 0; key < KEY_RANGE; key++) {
+    if (in[key]) {
+      keys[n++] = key;
+    }
+  }
+  for (int i = n - 1; i > 0; i--) {
+    int j = (int)(next_rand() % (unsigned long long)(i + 1));
+    int tmp = keys[i];
+    keys[i] = keys[j];
+    keys[j] = tmp;
+  }
+  struct bst* bst = bst_create_mode(mode);
+  for (int i = 0; i < n; i++) {
+    bst_insert(bst, keys[i], &values[keys[i]]);
+  }
+  free(keys);
+  return bst;
+}
+
+/*
+ * Picks which keys go into each tree: each key is in the first tree with
+ * probability 1/`a_odds` and in the second with probability 1/`b_odds`.
+ */
+void pick_keys(int a_odds, int b_odds) {
+  for (int key = 0; key < KEY_RANGE; key++) {
+    in_a[key] = next_rand() % a_odds == 0;
+    in_b[key] = next_rand() % b_odds == 0;
+  }
+}
+
+/*
+ * Returns 1 if `bst` holds exactly the keys whose `expect` flag is set, in
+ * order, each with the value `pick` says it should have, and 0 otherwise.
+ * `pick` is 'a' or 'b' to say which tree's value a key in both trees
+ * should have.
+ */
+int check(struct bst* bst, char* expect, char pick) {
+  int ok = 1, count = 0, key = 0;
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    void* value;
+    int found = bst_iterator_next(iter, &value);
+    while (key < KEY_RANGE && !expect[key]) {
+      key++;
+    }
+    int from_b = in_b[key] && (!in_a[key] || pick == 'b');
+    ok &= found == key
+      && value == (from_b ? &values_b[key] : &values_a[key]);
+    key++;
+    count++;
+  }
+  bst_iterator_free(iter);
+  int n = 0;
+  for (key = 0; key < KEY_RANGE; key++) {
+    n += expect[key];
+  }
+  return ok && count == n && bst_size(bst) == n;
+}
+
+/*
+ * Runs each set operation on trees created with `mode` with `threads`
+ * threads, for trees of similar sizes and for a small tree combined with a
+ * large one, and prints whether each result is right.
+ */
+void check_mode(const char* name, int mode, int threads) {
+  printf("\n== Set operations on %s trees with %d thread(s)...\n", name,
+    threads);
+  char* expect = malloc(KEY_RANGE);
+  int odds[2][2] = {{2, 2}, {2, 1000}};
+  for (int i = 0; i < 2; i++) {
+    pick_keys(odds[i][0], odds[i][1]);
+    const char* shape = i == 0 ? "similar sizes" : "small b";
+
+    struct bst* a = make_tree(mode, in_a, values_a);
+    struct bst* b = make_tree(mode, in_b, values_b);
+    for (int key = 0; key < KEY_RANGE; key++) {
+      expect[key] = in_a[key] || in_b[key];
+    }
+    bst_union(a, b, threads);
+    int union_ok = check(a, expect, mode & BST_UNIQUE ? 'b' : 'a');
+    bst_free(a);
+
+    a = make_tree(mode, in_a, values_a);
+    b = make_tree(mode, in_b, values_b);
+    for (int key = 0; key < KEY_RANGE; key++) {
+      expect[key] = in_a[key] && in_b[key];
+    }
+    bst_intersect(a, b, threads);
+    int intersect_ok = check(a, expect, 'a');
+    bst_free(a);
+
+    a = make_tree(mode, in_a, values_a);
+    b = make_tree(mode, in_b, values_b);
+    for (int key = 0; key < KEY_RANGE; key++) {
+      expect[key] = in_a[key] && !in_b[key];
+    }
+    bst_difference(a, b, threads);
+    int difference_ok = check(a, expect, 'a');
+    int n = bst_size(a), log = 0;
+    for (; (1 << log) <= n; log++);
+    difference_ok &= bst_height(a) <= 3 * log / 2 + 1;
+    bst_free(a);
+
+    printf("  -- %s: union ok (expect 1): %d, intersection ok (expect 1): "
+      "%d, difference ok (expect 1): %d\n", shape, union_ok, intersect_ok,
+      difference_ok);
+  }
+  free(expect);
+}
+
+/*
+ * Merges a tree holding `copies_b` pairs of every key in [0, n) into one
+ * holding `copies_a` of them, both created with `mode`, and returns whether
+ * every key then lists the values from the first tree before those from
+ * the second, as inserting the pairs one by one would.
+ */
+int check_duplicate_order(int mode, int n, int copies_a, int copies_b) {
+  struct bst* a = bst_create_mode(mode);
+  struct bst* b = bst_create_mode(mode);
+  for (int copy = 0; copy < copies_a; copy++) {
+    for (int key = 0; key < n; key++) {
+      bst_insert(a, key, &values_a[key]);
+    }
+  }
+  for (int copy = 0; copy < copies_b; copy++) {
+    for (int key = 0; key < n; key++) {
+      bst_insert(b, key, &values_b[key]);
+    }
+  }
+  bst_union(a, b, 1);
+  int ok = bst_size(a) == n * (copies_a + copies_b);
+  void* all[16];
+  for (int key = 0; key < n; key++) {
+    int count = bst_get_all(a, key, all, 16);
+    ok &= count == copies_a + copies_b;
+    for (int i = 0; i < count && i < 16; i++) {
+      ok &= all[i] == (i < copies_a ? &values_a[key] : &values_b[key]);
+    }
+  }
+  bst_free(a);
+  return ok;
+}
+
+int main(int argc, char** argv) {
+  for (int key = 0; key < KEY_RANGE; key++) {
+    values_a[key] = key;
+    values_b[key] = key;
+  }
+  check_mode("BST_PLAIN | BST_UNIQUE", BST_PLAIN | BST_UNIQUE, 1);
+  check_mode("BST_BALANCED | BST_UNIQUE", BST_BALANCED | BST_UNIQUE, 1);
+  check_mode("BST_BALANCED | BST_UNIQUE", BST_BALANCED | BST_UNIQUE, 4);
+  check_mode("BST_PLAIN | BST_UNIQUE", BST_PLAIN | BST_UNIQUE, 4);
+
+  printf("\n== Merging trees with duplicate keys...\n");
+  struct bst* a = bst_create_mode(BST_BALANCED);
+  struct bst* b = bst_create_mode(BST_BALANCED);
+  for (int key = 0; key < 100; key++) {
+    bst_insert(a, key, &values_a[key]);
+    bst_insert(b, key / 2, &values_b[key / 2]);
+  }
+  bst_union(a, b, 1);
+  printf("  -- size (expect 200): %d, bst_count(10) (expect 3): %d, "
+    "bst_count(60) (expect 1): %d\n", bst_size(a), bst_count(a, 10),
+    bst_count(a, 60));
+  b = bst_create_mode(BST_BALANCED);
+  for (int key = 40; key < 200; key++) {
+    bst_insert(b, key, NULL);
+  }
+  bst_difference(a, b, 2);
+  printf("  -- after removing keys 40..199: size (expect 120): %d, "
+    "bst_count(10) (expect 3): %d\n", bst_size(a), bst_count(a, 10));
+  bst_free(a);
+  printf("  -- values of each key in insertion order: BST_BALANCED (expect "
+    "1): %d, BST_PLAIN (expect 1): %d, small b (expect 1): %d\n",
+    check_duplicate_order(BST_BALANCED, 1000, 2, 3),
+    check_duplicate_order(BST_PLAIN, 1000, 2, 3),
+    check_duplicate_order(BST_BALANCED, 100, 10, 1));
+
+  printf("\n== Merging BST_MULTI trees...\n");
+  a = bst_create_mode(BST_BALANCED | BST_MULTI);
+  b = bst_create_mode(BST_BALANCED | BST_MULTI);
+  for (int key = 0; key < 100; key++) {
+    bst_insert(a, key, &values_a[key]);
+    bst_insert(a, key, &values_a[key]);
+    if (key % 2 == 0) {
+      bst_insert(b, key, &values_b[key]);
+    }
+  }
+  bst_union(a, b, 1);
+  void* all[4];
+  int n = bst_get_all(a, 10, all, 4);
+  printf("  -- keys (expect 100): %d, values of 10 (expect 3): %d, in order "
+    "(expect 1): %d\n", bst_size(a), n, all[0] == &values_a[10]
+    && all[1] == &values_a[10] && all[2] == &values_b[10]);
+  b = bst_create_mode(BST_BALANCED | BST_MULTI);
+  for (int key = 0; key < 100; key += 3) {
+    bst_insert(b, key, NULL);
+  }
+  bst_intersect(a, b, 1);
+  printf("  -- after keeping multiples of 3: keys (expect 34): %d, values of "
+    "9 (expect 2): %d\n", bst_size(a), bst_count(a, 9));
+  bst_free(a);
+  return 0;
+}
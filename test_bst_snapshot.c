@@ -0,0 +1,188 @@
+/*
+ * This file contains executable code for testing persistent snapshots of
+ * BST_CONCURRENT trees taken with bst_snapshot().  It checks that every
+ * snapshot keeps answering queries exactly as the tree did when the snapshot
+ * was taken, while the tree keeps changing and other snapshots come and go,
+ * and while a writer thread changes the tree under a reader thread.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+
+#include "bst.h"
+
+/*
+ * Range keys are drawn from, number of rounds of writes, number of writes
+ * per round (each round ends with a new snapshot), and maximum number of
+ * snapshots alive at once.
+ */
+#define KEY_RANGE 4000
+#define NUM_ROUNDS 200
+#define WRITES_PER_ROUND 500
+#define MAX_SNAPSHOTS 16
+
+/*
+ * Every value stored in the tree points at the entry of this array that
+ * holds its key.
+ */
+int values[KEY_RANGE];
+
+/*
+ * Returns the next number from a small linear congruential generator whose
+ * state is held in `*state`.
+ */
+unsigned int next_rand(unsigned int* state) {
+  *state = *state * 1103515245u + 12345u;
+  return *state >> 8;
+}
+
+/*
+ * Toggles a random key in or out of the tree and the array recording which
+ * keys it holds.
+ */
+void random_write(struct bst* bst, char* present, unsigned int* state) {
+  int key = next_rand(state) % KEY_RANGE;
+  if (present[key]) {
+    bst_remove(bst, key);
+  } else {
+    bst_insert(bst, key, &values[key]);
+  }
+  present[key] = !present[key];
+}
+
+/*
+ * This is a helper function that checks a tree or snapshot against an array
+ * recording which keys it should hold, and returns the number of problems
+ * found.
+ */
+int check_version(struct bst* bst, const char* present, unsigned int* state) {
+  int problems = 0, size = 0;
+  for (int key = 0; key < KEY_RANGE; key++) {
+    size += present[key];
+    if (bst_get(bst, key) != (present[key] ? &values[key] : NULL)) {
+      problems++;
+    }
+  }
+  if (bst_size(bst) != size) {
+    problems++;
+  }
+
+  for (int i = 0; i < 20; i++) {
+    int lower = next_rand(state) % KEY_RANGE;
+    int upper = lower + next_rand(state) % (KEY_RANGE / 4);
+    long long sum = 0;
+    for (int key = lower; key <= upper && key < KEY_RANGE; key++) {
+      sum += present[key] ? key : 0;
+    }
+    if (bst_range_sum64(bst, lower, upper) != sum) {
+      problems++;
+    }
+  }
+
+  int expect = 0;
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    void* value;
+    int key = bst_iterator_next(iter, &value);
+    while (expect < KEY_RANGE && !present[expect]) {
+      expect++;
+    }
+    if (key != expect || value != &values[key]) {
+      problems++;
+    }
+    expect = key + 1;
+  }
+  bst_iterator_free(iter);
+  return problems;
+}
+
+/*
+ * State shared with the reader thread, which repeatedly checks a snapshot
+ * while the main thread writes to the tree it was taken from.
+ */
+struct bst* reader_snap;
+char reader_present[KEY_RANGE];
+int reader_done;
+
+void* reader(void* arg) {
+  unsigned int state = 99;
+  long problems = 0;
+  while (!__atomic_load_n(&reader_done, __ATOMIC_ACQUIRE)) {
+    problems += check_version(reader_snap, reader_present, &state);
+  }
+  return (void*)problems;
+}
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < KEY_RANGE; i++) {
+    values[i] = i;
+  }
+
+  struct bst* bst = bst_create_mode(BST_CONCURRENT);
+  char present[KEY_RANGE];
+  memset(present, 0, sizeof(present));
+  struct bst* snaps[MAX_SNAPSHOTS];
+  char* snap_present[MAX_SNAPSHOTS];
+  int num_snaps = 0, taken = 0, released = 0, problems = 0;
+  unsigned int state = 1;
+
+  printf("== Taking a snapshot every %d writes for %d rounds...\n",
+    WRITES_PER_ROUND, NUM_ROUNDS);
+  for (int round = 0; round < NUM_ROUNDS; round++) {
+    for (int i = 0; i < WRITES_PER_ROUND; i++) {
+      random_write(bst, present, &state);
+    }
+
+    /*
+     * Release a random snapshot when there are too many, or now and then
+     * anyway, checking it one last time first.
+     */
+    if (num_snaps == MAX_SNAPSHOTS
+        || (num_snaps > 0 && next_rand(&state) % 3 == 0)) {
+      int i = next_rand(&state) % num_snaps;
+      problems += check_version(snaps[i], snap_present[i], &state);
+      bst_free(snaps[i]);
+      free(snap_present[i]);
+      snaps[i] = snaps[--num_snaps];
+      snap_present[i] = snap_present[num_snaps];
+      released++;
+    }
+
+    snaps[num_snaps] = bst_snapshot(bst);
+    snap_present[num_snaps] = malloc(KEY_RANGE);
+    memcpy(snap_present[num_snaps++], present, KEY_RANGE);
+    taken++;
+  }
+  for (int i = 0; i < num_snaps; i++) {
+    problems += check_version(snaps[i], snap_present[i], &state);
+    bst_free(snaps[i]);
+    free(snap_present[i]);
+  }
+  problems += check_version(bst, present, &state);
+  printf("  -- snapshots taken: %d, released early: %d\n", taken, released);
+  printf("  -- problems found (expect 0): %d\n", problems);
+
+  printf("\n== Checking a snapshot from another thread during writes...\n");
+  reader_snap = bst_snapshot(bst);
+  memcpy(reader_present, present, KEY_RANGE);
+  pthread_t thread;
+  pthread_create(&thread, NULL, reader, NULL);
+  for (int i = 0; i < 200000; i++) {
+    random_write(bst, present, &state);
+    if (i % 10000 == 0) {
+      bst_free(bst_snapshot(bst));
+    }
+  }
+  __atomic_store_n(&reader_done, 1, __ATOMIC_RELEASE);
+  void* result;
+  pthread_join(thread, &result);
+  problems = (long)result + check_version(reader_snap, reader_present, &state);
+  bst_free(reader_snap);
+  problems += check_version(bst, present, &state);
+  printf("  -- problems found (expect 0): %d\n", problems);
+  bst_free(bst);
+
+  return 0;
+}
@@ -0,0 +1,154 @@
+/*
+ * This file contains executable code for testing BSTs created in BST_SPLAY
+ * mode.  It checks the splay tree against a BST_BALANCED tree holding the
+ * same keys under a random mix of inserts, removals and lookups, and then
+ * checks that lookups reshape the tree.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Number of random operations applied to both trees in the differential
+ * test, and the range random keys are drawn from.  The key range is small
+ * enough that many keys are duplicated.
+ */
+#define NUM_OPS 200000
+#define KEY_RANGE 5000
+
+/*
+ * Number of keys inserted in ascending order, which leaves a splay tree as
+ * a single chain.
+ */
+#define NUM_SORTED 10000
+
+int main(int argc, char** argv) {
+  /*
+   * Apply the same random operations to a splay tree and a balanced binary
+   * tree and make sure they agree on every query.  Values record the key
+   * they were inserted with, so lookups can be checked even though
+   * duplicate keys may be found in a different order by the two trees.
+   */
+  printf("== Applying %d random operations to splay and balanced BSTs...\n",
+    NUM_OPS);
+  struct bst* splay = bst_create_mode(BST_SPLAY);
+  struct bst* avl = bst_create_mode(BST_BALANCED);
+  int* keys = malloc(KEY_RANGE * sizeof(int));
+  for (int i = 0; i < KEY_RANGE; i++) {
+    keys[i] = i;
+  }
+  int get_mismatches = 0, sum_mismatches = 0, size_mismatches = 0;
+  int rank_mismatches = 0, count_mismatches = 0;
+  srand(5);
+  for (int i = 0; i < NUM_OPS; i++) {
+    int key = rand() % KEY_RANGE;
+    int op = rand() % 5;
+    if (op < 2) {
+      bst_insert(splay, key, &keys[key]);
+      bst_insert(avl, key, &keys[key]);
+    } else if (op < 3) {
+      bst_remove(splay, key);
+      bst_remove(avl, key);
+    }
+    get_mismatches += bst_get(splay, key) != bst_get(avl, key);
+    int lower = rand() % KEY_RANGE;
+    int upper = lower + rand() % 200;
+    sum_mismatches += bst_range_sum64(splay, lower, upper)
+      != bst_range_sum64(avl, lower, upper);
+    size_mismatches += bst_size(splay) != bst_size(avl);
+    rank_mismatches += bst_rank(splay, lower) != bst_rank(avl, lower);
+    count_mismatches += bst_count(splay, key) != bst_count(avl, key);
+  }
+  printf("  -- bst_get() mismatches (expect 0): %d\n", get_mismatches);
+  printf("  -- bst_range_sum64() mismatches (expect 0): %d\n", sum_mismatches);
+  printf("  -- bst_size() mismatches (expect 0): %d\n", size_mismatches);
+  printf("  -- bst_rank() mismatches (expect 0): %d\n", rank_mismatches);
+  printf("  -- bst_count() mismatches (expect 0): %d\n", count_mismatches);
+
+  /*
+   * Both trees hold the same keys, so selecting, batch lookups and iterating
+   * must agree too.
+   */
+  int select_mismatches = 0;
+  for (int k = 0; k < bst_size(splay); k++) {
+    select_mismatches += bst_select(splay, k, NULL)
+      != bst_select(avl, k, NULL);
+  }
+  printf("  -- bst_select() mismatches (expect 0): %d\n", select_mismatches);
+  void** splay_values = malloc(KEY_RANGE * sizeof(void*));
+  void** avl_values = malloc(KEY_RANGE * sizeof(void*));
+  bst_get_batch(splay, keys, KEY_RANGE, splay_values);
+  bst_get_batch(avl, keys, KEY_RANGE, avl_values);
+  int batch_mismatches = 0;
+  for (int i = 0; i < KEY_RANGE; i++) {
+    batch_mismatches += splay_values[i] != avl_values[i];
+  }
+  free(splay_values);
+  free(avl_values);
+  printf("  -- bst_get_batch() mismatches (expect 0): %d\n", batch_mismatches);
+  int iter_mismatches = 0;
+  struct bst_iterator* siter = bst_iterator_create_range(splay, 1000, 2000);
+  struct bst_iterator* aiter = bst_iterator_create_range(avl, 1000, 2000);
+  while (bst_iterator_has_next(aiter)) {
+    void* value;
+    int key = bst_iterator_next(siter, &value);
+    iter_mismatches += key != bst_iterator_next(aiter, NULL)
+      || value != &keys[key];
+  }
+  iter_mismatches += bst_iterator_has_next(siter);
+  bst_iterator_free(siter);
+  bst_iterator_free(aiter);
+  printf("  -- range iterator mismatches (expect 0): %d\n", iter_mismatches);
+
+  /*
+   * Drain both trees completely.
+   */
+  for (int key = 0; key < KEY_RANGE; key++) {
+    while (bst_get(avl, key) != NULL) {
+      bst_remove(avl, key);
+      bst_remove(splay, key);
+    }
+  }
+  printf("\n== Checking splay tree is empty after draining: size %d, height "
+    "%d (expected 0, -1)\n", bst_size(splay), bst_height(splay));
+  bst_free(avl);
+  bst_free(splay);
+
+  /*
+   * Every insert splays the new key to the root, so sorted inserts leave a
+   * chain with the smallest key at the bottom.  Looking that key up moves it
+   * to the root and roughly halves the depth of every node on the way.
+   */
+  printf("\n== Inserting %d sorted keys into a BST_SPLAY | BST_UNIQUE "
+    "tree...\n", NUM_SORTED);
+  splay = bst_create_mode(BST_SPLAY | BST_UNIQUE);
+  for (int i = 0; i < NUM_SORTED; i++) {
+    bst_insert(splay, i, &keys[i % KEY_RANGE]);
+  }
+  printf("  -- height (expect %d): %d\n", NUM_SORTED - 1, bst_height(splay));
+  printf("  -- bst_get(0) (expect 0): %d\n", *(int*)bst_get(splay, 0));
+  printf("  -- height at most %d (expect 1): %d, bst_select(0) (expect 0): "
+    "%d\n", NUM_SORTED / 2 + 1, bst_height(splay) <= NUM_SORTED / 2 + 1,
+    bst_select(splay, 0, NULL));
+  for (int i = 0; i < NUM_SORTED; i++) {
+    bst_get(splay, (int)((i * 7919L) % NUM_SORTED));
+  }
+  printf("  -- height after looking every key up in scrambled order is below "
+    "100 (expect 1): %d\n", bst_height(splay) < 100);
+  void* old = NULL;
+  int replaced = bst_upsert(splay, 42, &keys[7], &old);
+  printf("  -- bst_upsert(42) replaced (expect 1): %d, old value (expect 42): "
+    "%d, new value (expect 7): %d\n", replaced, *(int*)old,
+    *(int*)bst_get(splay, 42));
+  bst_insert(splay, 42, &keys[8]);
+  printf("  -- BST_UNIQUE insert: size (expect %d): %d, value (expect 8): %d\n",
+    NUM_SORTED, bst_size(splay), *(int*)bst_get(splay, 42));
+  printf("  -- bst_get(%d) returns NULL (expect 1): %d\n", NUM_SORTED,
+    bst_get(splay, NUM_SORTED) == NULL);
+  bst_free(splay);
+
+  free(keys);
+  return 0;
+}
@@ -0,0 +1,169 @@
+/*
+ * This file contains executable code for testing splitting and joining BSTs
+ * (bst_split(), bst_join() and bst_remove_range()).
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+
+#include "bst.h"
+
+/*
+ * Number of keys in each tree.  Every tree starts out holding each of the
+ * keys 0..NUM_KEYS-1 once, inserted in a scrambled order.
+ */
+#define NUM_KEYS 10000
+
+/*
+ * Every value stored in the trees points at the entry of this array that
+ * holds its key.
+ */
+int values[NUM_KEYS];
+
+/*
+ * Returns a new tree created with `mode` that holds the keys in [lo, hi).
+ */
+struct bst* make_tree(int mode, int lo, int hi) {
+  struct bst* bst = bst_create_mode(mode);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    int key = (int)((i * 7919L) % NUM_KEYS);
+    if (key >= lo && key < hi) {
+      bst_insert(bst, key, &values[key]);
+    }
+  }
+  return bst;
+}
+
+/*
+ * Checks that `bst` holds exactly the keys in [lo, hi) except those in
+ * [gap_lo, gap_hi), each with its own value and in order, and returns 1 if
+ * it does.  For BST_BALANCED trees, also checks that the tree's height is
+ * within the AVL bound.
+ */
+int holds(struct bst* bst, int mode, int lo, int hi, int gap_lo, int gap_hi) {
+  int expect = lo, count = 0, ok = 1;
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    if (expect == gap_lo) {
+      expect = gap_hi;
+    }
+    void* value;
+    int key = bst_iterator_next(iter, &value);
+    ok &= key == expect && value == &values[key];
+    expect++;
+    count++;
+  }
+  bst_iterator_free(iter);
+  int n = (hi - lo) - (gap_hi - gap_lo);
+  ok &= count == n && bst_size(bst) == n;
+  if (mode == BST_BALANCED && n > 0) {
+    ok &= bst_height(bst) <= (int)(1.45 * log2(n + 2));
+  }
+  return ok;
+}
+
+/*
+ * Splits a tree created with `mode` at a few keys, joins the pieces back
+ * together, and removes a few ranges, printing whether every tree holds the
+ * keys it should after each step.
+ */
+void check_mode(const char* name, int mode) {
+  printf("\n== Splitting and joining %s trees of %d keys...\n", name,
+    NUM_KEYS);
+  int splits[] = {0, 1, NUM_KEYS / 3, NUM_KEYS - 1, NUM_KEYS};
+  for (int i = 0; i < 5; i++) {
+    int at = splits[i];
+    struct bst* left = make_tree(mode, 0, NUM_KEYS);
+    struct bst* right = bst_split(left, at);
+    int split_ok = holds(left, mode, 0, at, 0, 0)
+      && holds(right, mode, at, NUM_KEYS, 0, 0);
+    bst_join(left, right);
+    printf("  -- at %5d: split ok (expect 1): %d, joined ok (expect 1): %d\n",
+      at, split_ok, holds(left, mode, 0, NUM_KEYS, 0, 0));
+    bst_free(left);
+  }
+
+  struct bst* first = make_tree(mode, 0, NUM_KEYS / 2);
+  struct bst* second = make_tree(mode, NUM_KEYS / 2, NUM_KEYS);
+  bst_join(first, second);
+  printf("  -- joining two separate trees (expect 1): %d\n",
+    holds(first, mode, 0, NUM_KEYS, 0, 0));
+  bst_free(first);
+
+  /*
+   * Join pieces split off two different trees, so that neither pool belongs
+   * to one tree alone, and free the trees in an order that leaves each pool
+   * in use until the very end.
+   */
+  struct bst* a = make_tree(mode, 0, NUM_KEYS / 2);
+  struct bst* b = make_tree(mode, NUM_KEYS / 2, NUM_KEYS);
+  struct bst* a_high = bst_split(a, NUM_KEYS / 4);
+  struct bst* b_high = bst_split(b, 3 * NUM_KEYS / 4);
+  bst_join(a_high, b);
+  printf("  -- joining pieces of two trees (expect 1): %d\n",
+    holds(a_high, mode, NUM_KEYS / 4, 3 * NUM_KEYS / 4, 0, 0));
+  bst_insert(a, NUM_KEYS / 4, &values[NUM_KEYS / 4]);
+  bst_free(a_high);
+  printf("  -- the other pieces are intact (expect 1): %d\n",
+    holds(a, mode, 0, NUM_KEYS / 4 + 1, 0, 0)
+    && holds(b_high, mode, 3 * NUM_KEYS / 4, NUM_KEYS, 0, 0));
+  bst_free(a);
+  bst_free(b_high);
+
+  struct bst* bst = make_tree(mode, 0, NUM_KEYS);
+  int removed = bst_remove_range(bst, 1000, 2999);
+  printf("  -- bst_remove_range(1000, 2999) removed (expect 2000): %d, tree "
+    "ok (expect 1): %d\n", removed, holds(bst, mode, 0, NUM_KEYS, 1000, 3000));
+  removed = bst_remove_range(bst, 2000, 3999);
+  printf("  -- bst_remove_range(2000, 3999) removed (expect 1000): %d, tree "
+    "ok (expect 1): %d\n", removed, holds(bst, mode, 0, NUM_KEYS, 1000, 4000));
+  removed = bst_remove_range(bst, 5, 4);
+  printf("  -- bst_remove_range(5, 4) removed (expect 0): %d\n", removed);
+  removed = bst_remove_range(bst, 9000, 2147483647);
+  printf("  -- bst_remove_range(9000, INT_MAX) removed (expect 1000): %d, "
+    "tree ok (expect 1): %d\n", removed, holds(bst, mode, 0, 9000, 1000, 4000));
+  printf("  -- range sum after the removals (expect %lld): %lld\n",
+    (long long)9000 * 8999 / 2 - (long long)(1000 + 3999) * 3000 / 2,
+    bst_range_sum64(bst, 0, NUM_KEYS));
+  bst_free(bst);
+}
+
+int main(int argc, char** argv) {
+  for (int i = 0; i < NUM_KEYS; i++) {
+    values[i] = i;
+  }
+  check_mode("BST_PLAIN", BST_PLAIN);
+  check_mode("BST_BALANCED", BST_BALANCED);
+
+  printf("\n== Removing ranges in the other modes...\n");
+  int modes[] = {BST_BPTREE, BST_CONCURRENT};
+  const char* names[] = {"BST_BPTREE", "BST_CONCURRENT"};
+  for (int i = 0; i < 2; i++) {
+    struct bst* bst = make_tree(modes[i], 0, NUM_KEYS);
+    int removed = bst_remove_range(bst, 100, 8999);
+    printf("  -- %s: removed (expect 8900): %d, tree ok (expect 1): %d\n",
+      names[i], removed, holds(bst, modes[i], 0, NUM_KEYS, 100, 9000));
+    bst_free(bst);
+  }
+
+  printf("\n== Removing a range from a BST_BALANCED | BST_MULTI tree...\n");
+  struct bst* bst = bst_create_mode(BST_BALANCED | BST_MULTI);
+  for (int round = 0; round < 3; round++) {
+    for (int key = 0; key < 100; key++) {
+      bst_insert(bst, key, &values[key]);
+    }
+  }
+  int removed = bst_remove_range(bst, 10, 89);
+  printf("  -- removed (expect 80): %d, keys left (expect 20): %d, "
+    "bst_count(5) (expect 3): %d\n", removed, bst_size(bst),
+    bst_count(bst, 5));
+  struct bst* high = bst_split(bst, 50);
+  printf("  -- split at 50: %d and %d keys (expect 10 and 10)\n",
+    bst_size(bst), bst_size(high));
+  bst_join(bst, high);
+  printf("  -- joined back: %d keys (expect 20), bst_count(95) (expect 3): "
+    "%d\n", bst_size(bst), bst_count(bst, 95));
+  bst_free(bst);
+  return 0;
+}
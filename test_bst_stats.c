@@ -0,0 +1,156 @@
+/*
+ * This file contains executable code for testing the operation counters of
+ * your BST implementation (bst_stats() and bst_stats_reset()).  It must be
+ * linked against a copy of bst.c compiled with BST_STATS defined.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bst.h"
+
+/*
+ * This is the data that's used to test this program.  It forms a tree that
+ * looks like this when inserted into a BST_PLAIN tree:
+ *
+ *               64
+ *              /  \
+ *             /    \
+ *            /      \
+ *           /        \
+ *          32        96
+ *         /  \      /  \
+ *        /    \    /    \
+ *       16    48  80    112
+ *      /  \     \   \   /  \
+ *     8   24    56  88 104 120
+ */
+#define NUM_TEST_DATA 13
+const int TEST_DATA[NUM_TEST_DATA] =
+  {64, 32, 96, 16, 48, 80, 112, 8, 24, 56, 88, 104, 120};
+
+/*
+ * Number of keys in the larger trees used below.
+ */
+#define NUM_KEYS 1000
+
+/*
+ * This is a helper function that prints one kind of operation's counters.
+ */
+void print_op(const char* name, struct bst_op_stats* op) {
+  printf("  -- %s: %llu calls, %llu comparisons, %llu nodes visited\n", name,
+    op->calls, op->comparisons, op->nodes_visited);
+}
+
+/*
+ * This is a helper function that prints the non-empty buckets of a lookup
+ * depth histogram.
+ */
+void print_depths(struct bst_stats* stats) {
+  printf("  -- lookup depths:");
+  for (int d = 0; d < BST_STATS_DEPTHS; d++) {
+    if (stats->depths[d] > 0) {
+      printf(" %d:%llu", d, stats->depths[d]);
+    }
+  }
+  printf("\n");
+}
+
+int main(int argc, char** argv) {
+  struct bst_stats stats;
+  struct bst* bst = bst_create();
+  printf("== Counters are kept: %s\n", bst_stats(bst, &stats) ? "yes" : "no");
+
+  printf("\n== Inserting the test data into a BST_PLAIN tree...\n");
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    bst_insert(bst, TEST_DATA[i], NULL);
+  }
+  bst_stats(bst, &stats);
+  print_op("insert", &stats.insert);
+  printf("  -- allocs: %llu, frees: %llu\n", stats.allocs, stats.frees);
+
+  printf("\n== Looking up every key, then one missing key (100)...\n");
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    bst_get(bst, TEST_DATA[i]);
+  }
+  bst_get(bst, 100);
+  bst_stats(bst, &stats);
+  print_op("get", &stats.get);
+  print_depths(&stats);
+
+  printf("\n== Removing 16, which has two children...\n");
+  bst_remove(bst, 16);
+  bst_stats(bst, &stats);
+  print_op("remove", &stats.remove);
+  printf("  -- allocs: %llu, frees: %llu\n", stats.allocs, stats.frees);
+
+  printf("\n== Resetting the counters...\n");
+  bst_stats_reset(bst);
+  bst_stats(bst, &stats);
+  struct bst_stats zero;
+  memset(&zero, 0, sizeof(zero));
+  printf("  -- all counters are zero: %s\n",
+    memcmp(&stats, &zero, sizeof(stats)) == 0 ? "yes" : "no");
+  bst_free(bst);
+
+  printf("\n== Looking up %d keys one by one and as a batch...\n", NUM_KEYS);
+  int* keys = malloc(NUM_KEYS * sizeof(int));
+  void** values = malloc(NUM_KEYS * sizeof(void*));
+  bst = bst_create_mode(BST_BALANCED);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    keys[i] = (int)((i * 7919L) % NUM_KEYS);
+    if (keys[i] % 2 == 0) {
+      bst_insert(bst, keys[i], NULL);
+    }
+  }
+  bst_stats_reset(bst);
+  for (int i = 0; i < NUM_KEYS; i++) {
+    bst_get(bst, keys[i]);
+  }
+  struct bst_stats single;
+  bst_stats(bst, &single);
+  bst_stats_reset(bst);
+  bst_get_batch(bst, keys, NUM_KEYS, values);
+  bst_stats(bst, &stats);
+  printf("  -- batch counters match single lookups: %s\n",
+    memcmp(&stats, &single, sizeof(stats)) == 0 ? "yes" : "no");
+  int deepest = 0;
+  for (int d = 0; d < BST_STATS_DEPTHS; d++) {
+    deepest = stats.depths[d] > 0 ? d : deepest;
+  }
+  printf("  -- deepest lookup in the balanced tree: %d nodes\n", deepest);
+  bst_free(bst);
+
+  printf("\n== Looking up the largest of %d sorted keys in a BST_PLAIN "
+    "tree...\n", NUM_KEYS);
+  bst = bst_create();
+  for (int i = 0; i < NUM_KEYS; i++) {
+    bst_insert(bst, i, NULL);
+  }
+  bst_stats_reset(bst);
+  bst_get(bst, NUM_KEYS - 1);
+  bst_stats(bst, &stats);
+  print_op("get", &stats.get);
+  printf("  -- counted in the last depth bucket: %s\n",
+    stats.depths[BST_STATS_DEPTHS - 1] == 1 ? "yes" : "no");
+  bst_free(bst);
+
+  printf("\n== Counting in a BST_CONCURRENT tree...\n");
+  bst = bst_create_mode(BST_CONCURRENT);
+  for (int i = 0; i < NUM_TEST_DATA; i++) {
+    bst_insert(bst, TEST_DATA[i], NULL);
+  }
+  bst_remove(bst, 64);
+  bst_get(bst, 64);
+  bst_stats(bst, &stats);
+  printf("  -- insert calls: %llu, remove calls: %llu, get calls: %llu\n",
+    stats.insert.calls, stats.remove.calls, stats.get.calls);
+  printf("  -- every write copied nodes: %s\n",
+    stats.allocs > NUM_TEST_DATA + 1 ? "yes" : "no");
+  bst_free(bst);
+
+  free(values);
+  free(keys);
+  return 0;
+}
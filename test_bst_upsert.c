@@ -0,0 +1,196 @@
+/*
+ * This file contains executable code for testing how your BST implementation
+ * handles duplicate keys: bst_upsert(), BST_UNIQUE and BST_MULTI trees,
+ * bst_count() and bst_get_all().
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "bst.h"
+
+/*
+ * Number of distinct keys in each tree, and the number of times each key is
+ * inserted.
+ */
+#define NUM_KEYS 1000
+#define ROUNDS 3
+
+/*
+ * Every value stored in the trees points at an entry of this array: the
+ * value inserted under key `k` in round `r` is &values[r][k].
+ */
+int values[ROUNDS][NUM_KEYS];
+
+/*
+ * Returns the `i`-th key of a scrambled order of the keys 0..NUM_KEYS-1.
+ */
+int scrambled(int i) {
+  return (int)((i * 7919L) % NUM_KEYS);
+}
+
+/*
+ * Inserts every key ROUNDS times into a tree created with `mode`, with a new
+ * value each round, and prints what the tree holds afterwards.
+ */
+void check_unique(const char* name, int mode) {
+  struct bst* bst = bst_create_mode(mode | BST_UNIQUE);
+  printf("\n== Inserting every key %d times into a %s | BST_UNIQUE tree...\n",
+    ROUNDS, name);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < NUM_KEYS; i++) {
+      bst_insert(bst, scrambled(i), &values[r][scrambled(i)]);
+    }
+  }
+  printf("  -- size (expect %d): %d\n", NUM_KEYS, bst_size(bst));
+  int stale = 0;
+  for (int key = 0; key < NUM_KEYS; key++) {
+    stale += bst_get(bst, key) != &values[ROUNDS - 1][key];
+  }
+  printf("  -- keys without their last value (expect 0): %d\n", stale);
+
+  void* old = NULL;
+  int replaced = bst_upsert(bst, 500, &values[0][500], &old);
+  printf("  -- bst_upsert(500) replaced (expect 1): %d, old value is the last "
+    "one (expect 1): %d\n", replaced, old == &values[ROUNDS - 1][500]);
+  replaced = bst_upsert(bst, NUM_KEYS, &values[0][0], &old);
+  printf("  -- bst_upsert(%d) replaced (expect 0): %d, size (expect %d): %d\n",
+    NUM_KEYS, replaced, NUM_KEYS + 1, bst_size(bst));
+  printf("  -- bst_count(500) (expect 1): %d\n", bst_count(bst, 500));
+
+  bst_remove(bst, 500);
+  printf("  -- bst_get(500) after removing it (expect (nil)): %p\n",
+    bst_get(bst, 500));
+  bst_free(bst);
+}
+
+/*
+ * Inserts every key ROUNDS times into a BST_MULTI tree created with `mode`
+ * and prints what the tree holds afterwards.
+ */
+void check_multi(const char* name, int mode) {
+  struct bst* bst = bst_create_mode(mode | BST_MULTI);
+  printf("\n== Inserting every key %d times into a %s | BST_MULTI tree...\n",
+    ROUNDS, name);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < NUM_KEYS; i++) {
+      bst_insert(bst, scrambled(i), &values[r][scrambled(i)]);
+    }
+  }
+  printf("  -- size (expect %d): %d\n", NUM_KEYS, bst_size(bst));
+
+  int wrong = 0;
+  for (int key = 0; key < NUM_KEYS; key++) {
+    void* all[ROUNDS + 1];
+    int n = bst_get_all(bst, key, all, ROUNDS + 1);
+    wrong += n != ROUNDS || bst_count(bst, key) != ROUNDS;
+    for (int r = 0; r < n && r < ROUNDS; r++) {
+      wrong += all[r] != &values[r][key];
+    }
+    wrong += bst_get(bst, key) != &values[0][key];
+  }
+  printf("  -- keys without all %d values in order (expect 0): %d\n", ROUNDS,
+    wrong);
+
+  int visited = 0, out_of_order = 0;
+  struct bst_iterator* iter = bst_iterator_create(bst);
+  while (bst_iterator_has_next(iter)) {
+    void* value;
+    int key = bst_iterator_next(iter, &value);
+    out_of_order += key != visited || value != &values[0][key];
+    visited++;
+  }
+  bst_iterator_free(iter);
+  printf("  -- keys visited by an iterator (expect %d): %d, wrong (expect 0): "
+    "%d\n", NUM_KEYS, visited, out_of_order);
+
+  void* value;
+  printf("  -- bst_select(10) (expect 10): %d, bst_rank(10) (expect 10): %d\n",
+    bst_select(bst, 10, &value), bst_rank(bst, 10));
+  printf("  -- bst_range_sum(0, 9) (expect 45): %d\n",
+    bst_range_sum(bst, 0, 9));
+
+  for (int key = 0; key < NUM_KEYS; key += 2) {
+    bst_remove(bst, key);
+  }
+  printf("  -- size after removing every even key (expect %d): %d\n",
+    NUM_KEYS / 2, bst_size(bst));
+  printf("  -- bst_count(4) (expect 0): %d, bst_count(5) (expect %d): %d\n",
+    bst_count(bst, 4), ROUNDS, bst_count(bst, 5));
+  bst_free(bst);
+}
+
+/*
+ * Inserts every key ROUNDS times into a tree created with `mode` and no
+ * duplicate key policy, and prints how many values each key has.
+ */
+void check_duplicates(const char* name, int mode) {
+  struct bst* bst = bst_create_mode(mode);
+  printf("\n== Inserting every key %d times into a %s tree...\n", ROUNDS,
+    name);
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int i = 0; i < NUM_KEYS; i++) {
+      bst_insert(bst, scrambled(i), &values[r][scrambled(i)]);
+    }
+  }
+  printf("  -- size (expect %d): %d\n", ROUNDS * NUM_KEYS, bst_size(bst));
+
+  int wrong = 0;
+  for (int key = 0; key < NUM_KEYS; key++) {
+    void* all[ROUNDS];
+    int n = bst_get_all(bst, key, all, ROUNDS);
+    wrong += n != ROUNDS || bst_count(bst, key) != ROUNDS;
+    for (int r = 0; r < ROUNDS; r++) {
+      wrong += all[r] != &values[r][key];
+    }
+  }
+  printf("  -- keys without all %d values in order (expect 0): %d\n", ROUNDS,
+    wrong);
+  printf("  -- bst_count(%d) (expect 0): %d\n", NUM_KEYS,
+    bst_count(bst, NUM_KEYS));
+
+  void* old = NULL;
+  int replaced = bst_upsert(bst, 7, &values[0][0], &old);
+  printf("  -- bst_upsert(7) replaced (expect 1): %d, size (expect %d): %d, "
+    "bst_get(7) is the new value (expect 1): %d\n", replaced,
+    ROUNDS * NUM_KEYS, bst_size(bst), bst_get(bst, 7) == &values[0][0]);
+  printf("  -- bst_count(7) (expect %d): %d\n", ROUNDS, bst_count(bst, 7));
+  bst_free(bst);
+}
+
+int main(int argc, char** argv) {
+  for (int r = 0; r < ROUNDS; r++) {
+    for (int k = 0; k < NUM_KEYS; k++) {
+      values[r][k] = k;
+    }
+  }
+
+  check_unique("BST_PLAIN", BST_PLAIN);
+  check_unique("BST_BALANCED", BST_BALANCED);
+  check_unique("BST_BPTREE", BST_BPTREE);
+  check_unique("BST_CONCURRENT", BST_CONCURRENT);
+
+  check_multi("BST_PLAIN", BST_PLAIN);
+  check_multi("BST_BALANCED", BST_BALANCED);
+
+  check_duplicates("BST_PLAIN", BST_PLAIN);
+  check_duplicates("BST_BALANCED", BST_BALANCED);
+  check_duplicates("BST_BPTREE", BST_BPTREE);
+
+  printf("\n== Replacing a value while a snapshot is live...\n");
+  struct bst* bst = bst_create_mode(BST_CONCURRENT | BST_UNIQUE);
+  for (int key = 0; key < NUM_KEYS; key++) {
+    bst_insert(bst, key, &values[0][key]);
+  }
+  struct bst* snap = bst_snapshot(bst);
+  bst_insert(bst, 42, &values[1][42]);
+  printf("  -- the tree sees the new value (expect 1): %d\n",
+    bst_get(bst, 42) == &values[1][42]);
+  printf("  -- the snapshot sees the old value (expect 1): %d\n",
+    bst_get(snap, 42) == &values[0][42]);
+  printf("  -- sizes (expect %d and %d): %d and %d\n", NUM_KEYS, NUM_KEYS,
+    bst_size(bst), bst_size(snap));
+  bst_free(snap);
+  bst_free(bst);
+  return 0;
+}